@@ -39,6 +39,30 @@ LOCAL_SRC_FILES  := \
 $(SRC)/Source/PopDebug.cpp \
 $(SRC)/Source/PopUnity.cpp \
 $(SRC)/Source/PopReadPixels.cpp \
+$(SRC)/Source/TTextureBackend.cpp \
+$(SRC)/Source/TWriteBudget.cpp \
+$(SRC)/Source/TCache.cpp \
+$(SRC)/Source/TScheduler.cpp \
+$(SRC)/Source/TPixelBufferPool.cpp \
+$(SRC)/Source/THash.cpp \
+$(SRC)/Source/TWorkerPool.cpp \
+$(SRC)/Source/TPixelConvert.cpp \
+$(SRC)/Source/TMipChain.cpp \
+$(SRC)/Source/TBlockCompress.cpp \
+$(SRC)/Source/TTileLayout.cpp \
+$(SRC)/Source/TOpenglTexture.cpp \
+$(SRC)/Source/TAtlas.cpp \
+$(SRC)/Source/TCacheSlots.cpp \
+$(SRC)/Source/TTelemetry.cpp \
+$(SRC)/Source/TWriteBatch.cpp \
+$(SRC)/Source/TMappedFile.cpp \
+$(SRC)/Source/TPngDecode.cpp \
+$(SRC)/Source/TFrameStream.cpp \
+$(SRC)/Source/TTextureDedupe.cpp \
+$(SRC)/Source/TCompletionQueue.cpp \
+$(SRC)/Source/TMemoryBudget.cpp \
+$(SRC)/Source/TBakedTexture.cpp \
+$(SRC)/Source/TReadback.cpp \
 $(SRC)/Source/TStringBuffer.cpp \
 
 
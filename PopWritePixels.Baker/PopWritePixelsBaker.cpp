@@ -0,0 +1,186 @@
+//	offline baker for QueueWritePixelsBaked. Takes a png (or raw pixels), and does everything the plugin would
+//	otherwise do at load time (format conversion, mip generation, block compression), writing a container
+//	laid out in the texture's own rows. see build.sh & Source/TBakedTexture.h
+#include "../Source/TBakedTexture.h"
+#include "../Source/TPixelConvert.h"
+#include "../Source/TPngDecode.h"
+#include "../Source/TBlockCompress.h"
+#include "../Source/TMappedFile.h"
+#include "../Source/TWorkerPool.h"
+#include <SoyUnity.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+
+namespace Baker
+{
+	class TFormat
+	{
+	public:
+		const char*		mName;
+		int				mUnityFormat;		//	UnityEngine.TextureFormat
+	};
+
+	const TFormat		Formats[] =
+	{
+		{ "RGBA32",	4 },
+		{ "RGB24",	3 },
+		{ "Alpha8",	1 },
+		{ "BGRA32",	14 },
+	};
+
+	const char*			BlockFormatNames[] = { "None", "BC1", "BC3", "BC7", "Etc2Rgb", "Etc2Rgba" };
+	const char*			ConversionNames[] = { "None", "RgbToRgba", "SwapRedBlue", "FloatToHalf", "Uint16ToUint8", "LinearFloatToSrgb8" };
+
+	class TOptions
+	{
+	public:
+		std::string					mInput;
+		std::string					mOutput;
+		const TFormat*				mFormat = &Formats[0];
+		size_t						mWidth = 0;			//	raw input only
+		size_t						mHeight = 0;
+		TPixelConversion::Type		mConversion = TPixelConversion::None;	//	raw input only
+		TBakeParams					mParams;
+	};
+
+	template<size_t COUNT>
+	int						ParseName(const char* (&Names)[COUNT],const std::string& Name,const char* What);
+	TOptions				ParseOptions(int argc,const char* argv[]);
+	std::vector<uint8_t>	LoadPixels(const TOptions& Options,SoyPixelsMeta& Meta);
+}
+
+
+template<size_t COUNT>
+int Baker::ParseName(const char* (&Names)[COUNT],const std::string& Name,const char* What)
+{
+	for ( size_t i=0;	i<COUNT;	i++ )
+		if ( Name == Names[i] )
+			return static_cast<int>(i);
+	throw std::runtime_error( std::string("Unknown ") + What + " " + Name );
+}
+
+Baker::TOptions Baker::ParseOptions(int argc,const char* argv[])
+{
+	TOptions Options;
+	std::vector<std::string> Files;
+	for ( int i=1;	i<argc;	i++ )
+	{
+		std::string Arg = argv[i];
+		const char* Value = ( i+1 < argc ) ? argv[i+1] : "";
+
+		if ( Arg == "--nomips" )
+		{
+			Options.mParams.mMips = false;
+			continue;
+		}
+		if ( Arg.compare( 0, 2, "--" ) != 0 )
+		{
+			Files.push_back( Arg );
+			continue;
+		}
+
+		if ( Arg == "--format" )
+		{
+			auto Match = [&](const TFormat& Format)	{	return std::string(Value) == Format.mName;	};
+			auto* Format = std::find_if( std::begin(Formats), std::end(Formats), Match );
+			if ( Format == std::end(Formats) )
+				throw std::runtime_error( std::string("Unknown format ") + Value );
+			Options.mFormat = Format;
+		}
+		else if ( Arg == "--width" )
+			Options.mWidth = std::strtoul( Value, nullptr, 10 );
+		else if ( Arg == "--height" )
+			Options.mHeight = std::strtoul( Value, nullptr, 10 );
+		else if ( Arg == "--convert" )
+			Options.mConversion = static_cast<TPixelConversion::Type>( ParseName( ConversionNames, Value, "conversion" ) );
+		else if ( Arg == "--compress" )
+			Options.mParams.mBlockFormat = static_cast<TBlockFormat::Type>( ParseName( BlockFormatNames, Value, "block format" ) );
+		else if ( Arg == "--quality" )
+			Options.mParams.mCompressQuality = std::atoi( Value );
+		else if ( Arg == "--chunkrows" )
+			Options.mParams.mChunkRows = std::max<size_t>( 1, std::strtoul( Value, nullptr, 10 ) );
+		else
+			throw std::runtime_error( "Unknown argument " + Arg );
+		i++;
+	}
+
+	if ( Files.size() != 2 )
+		throw std::runtime_error("Usage: PopWritePixelsBaker input.png|input.raw output.pwpb [--format RGBA32,RGB24,Alpha8,BGRA32] [--width w --height h (raw)] [--convert RgbToRgba...] [--nomips] [--compress BC1,BC3,BC7,Etc2Rgb,Etc2Rgba] [--quality 0-2] [--chunkrows n]");
+	Options.mInput = Files[0];
+	Options.mOutput = Files[1];
+
+	//	compressed caches have no mips
+	if ( Options.mParams.mBlockFormat != TBlockFormat::None )
+		Options.mParams.mMips = false;
+	return Options;
+}
+
+std::vector<uint8_t> Baker::LoadPixels(const TOptions& Options,SoyPixelsMeta& Meta)
+{
+	TMappedFile File( Options.mInput, 0, 0 );
+	auto Format = Unity::GetPixelFormat( static_cast<Unity::Texture2DPixelFormat::Type>( Options.mFormat->mUnityFormat ) );
+
+	if ( PopWritePixels::IsPng( File.GetData(), File.GetSize() ) )
+	{
+		auto Header = PopWritePixels::ReadPngHeader( File.GetData(), File.GetSize() );
+		Meta = SoyPixelsMeta( Header.mWidth, Header.mHeight, Format );
+
+		//	the plugin's own decoder, so the baked rows are exactly what QueueWritePixelsDecode would write
+		auto& Pool = PopWritePixels::GetPixelBufferPool();
+		uint8_t* DstData = nullptr;
+		auto DstBuffer = Pool.Submit( Pool.Alloc( Meta.GetDataSize(), DstData ) );
+		std::shared_ptr<TDecodePngRows> Decoder( new TDecodePngRows( File.GetData(), File.GetSize(), nullptr, Meta, DstBuffer ) );
+		Decoder->Start( PopWritePixels::GetWorkerPool() );
+		while ( Decoder->GetRowsReady() < Meta.GetHeight() )
+			std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+		return std::vector<uint8_t>( DstData, DstData + Meta.GetDataSize() );
+	}
+
+	if ( Options.mWidth == 0 || Options.mHeight == 0 )
+		throw std::runtime_error("Raw input needs --width and --height");
+	Meta = SoyPixelsMeta( Options.mWidth, Options.mHeight, Format );
+
+	std::vector<uint8_t> Pixels( Meta.GetDataSize() );
+	auto SrcSize = Pixels.size();
+	if ( Options.mConversion != TPixelConversion::None )
+		SrcSize = PopWritePixels::GetConversionSourceRowSize( Options.mConversion, Meta.GetRowDataSize() ) * Meta.GetHeight();
+	if ( File.GetSize() != SrcSize )
+		throw std::runtime_error( "Raw input is " + std::to_string(File.GetSize()) + " bytes, expected " + std::to_string(SrcSize) );
+
+	if ( Options.mConversion != TPixelConversion::None )
+		PopWritePixels::ConvertRows( Options.mConversion, File.GetData(), Pixels.data(), Pixels.size() );
+	else
+		memcpy( Pixels.data(), File.GetData(), Pixels.size() );
+	return Pixels;
+}
+
+
+int main(int argc,const char* argv[])
+{
+	try
+	{
+		auto Options = Baker::ParseOptions( argc, argv );
+		SoyPixelsMeta Meta;
+		auto Pixels = Baker::LoadPixels( Options, Meta );
+		PopWritePixels::BakeTexture( Options.mOutput, Pixels.data(), Meta, Options.mFormat->mUnityFormat, Options.mParams );
+
+		TMappedFile Baked( Options.mOutput, 0, 0 );
+		auto Header = PopWritePixels::ReadBakedHeader( Baked.GetData(), Baked.GetSize() );
+		std::cout << Options.mOutput << ": " << Header.mWidth << "x" << Header.mHeight << " " << Options.mFormat->mName
+		<< " " << Baker::BlockFormatNames[Header.mBlockFormat] << " mips " << Header.mMipCount
+		<< " chunk rows " << Header.mChunkRows << " bytes " << Baked.GetSize() << std::endl;
+		return 0;
+	}
+	catch(std::exception& e)
+	{
+		std::cerr << "Bake failed: " << e.what() << std::endl;
+		return 1;
+	}
+}
@@ -0,0 +1,65 @@
+#!/bin/sh
+
+# builds the offline baker for the desktop it runs on, from the plugin's own sources (png input needs zlib)
+# usage: SOY_PATH=/path/to/SoyLib ./build.sh && ./PopWritePixelsBaker image.png image.pwpb --format RGBA32
+
+if [ -z "$SOY_PATH" ]; then
+	echo "SOY_PATH env var not set"
+	exit 1
+fi
+
+if [ -z "$CXX" ]; then
+	CXX="c++"
+fi
+
+case "$(uname)" in
+	Darwin)	TARGET="TARGET_OSX";;
+	*)		TARGET="TARGET_LINUX";;
+esac
+
+SRC=..
+
+$CXX -std=c++14 -O2 -pthread -D$TARGET -DENABLE_ZLIB \
+-I$SRC/Source -I$SOY_PATH/src \
+$SRC/PopWritePixels.Baker/PopWritePixelsBaker.cpp \
+$SRC/Source/PopDebug.cpp \
+$SRC/Source/PopUnity.cpp \
+$SRC/Source/PopWritePixels.cpp \
+$SRC/Source/TTextureBackend.cpp \
+$SRC/Source/TWriteBudget.cpp \
+$SRC/Source/TCache.cpp \
+$SRC/Source/TScheduler.cpp \
+$SRC/Source/TPixelBufferPool.cpp \
+$SRC/Source/THash.cpp \
+$SRC/Source/TWorkerPool.cpp \
+$SRC/Source/TPixelConvert.cpp \
+$SRC/Source/TMipChain.cpp \
+$SRC/Source/TBlockCompress.cpp \
+$SRC/Source/TTileLayout.cpp \
+$SRC/Source/TOpenglTexture.cpp \
+$SRC/Source/TAtlas.cpp \
+$SRC/Source/TCacheSlots.cpp \
+$SRC/Source/TTelemetry.cpp \
+$SRC/Source/TWriteBatch.cpp \
+$SRC/Source/TMappedFile.cpp \
+$SRC/Source/TPngDecode.cpp \
+$SRC/Source/TFrameStream.cpp \
+$SRC/Source/TTextureDedupe.cpp \
+$SRC/Source/TCompletionQueue.cpp \
+$SRC/Source/TMemoryBudget.cpp \
+$SRC/Source/TBakedTexture.cpp \
+$SRC/Source/TReadback.cpp \
+$SOY_PATH/src/SoyAssert.cpp \
+$SOY_PATH/src/SoyTypes.cpp \
+$SOY_PATH/src/SoyPixels.cpp \
+$SOY_PATH/src/SoyDebug.cpp \
+$SOY_PATH/src/SoyThread.cpp \
+$SOY_PATH/src/SoyEvent.cpp \
+$SOY_PATH/src/SoyString.cpp \
+$SOY_PATH/src/memheap.cpp \
+$SOY_PATH/src/SoyArray.cpp \
+$SOY_PATH/src/SoyUnity.cpp \
+$SOY_PATH/src/SoyTime.cpp \
+-lz -o PopWritePixelsBaker
+
+exit $?
@@ -0,0 +1,593 @@
+//	headless upload benchmark. Drives the plugin through its C exports exactly as unity does, against the
+//	software backend, so numbers are the plugin's own cost (copying, scheduling, hashing...) without a device.
+//	--opengl instead writes to the opengl backend in a surfaceless EGL context (build with ENABLE_OPENGL=1),
+//	and fence_waits is how often the pixel buffer ring found the gpu a whole ring behind.
+//	Prints one json object per configuration (json lines) so runs can be diffed between plugin versions.
+//	With --baked each configuration is also loaded from a baked container (QueueWritePixelsBaked) for load-time comparisons.
+//	--kernels instead checks every pixel conversion kernel this cpu has against the scalar reference, and measures each.
+//	--progressive writes mips smallest first (TMipMode::Progressive); usable_* is then how soon every cache had a mip to show
+//	see build.sh
+#include "../Source/PopWritePixels.h"
+#include "../Source/TTextureBackend.h"
+#include "../Source/TTelemetry.h"
+#include "../Source/TBakedTexture.h"
+#include "../Source/TMipChain.h"
+#include "../Source/TPixelConvert.h"
+#include "../Source/TCompletionQueue.h"
+#include <SoyUnity.h>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+#if defined(ENABLE_OPENGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace Benchmark
+{
+	class TFormat
+	{
+	public:
+		const char*		mName;
+		int				mUnityFormat;		//	UnityEngine.TextureFormat
+		size_t			mBytesPerPixel;
+	};
+
+	const TFormat		Formats[] =
+	{
+		{ "RGBA32",	4,	4 },
+		{ "RGB24",	3,	3 },
+		{ "Alpha8",	1,	1 },
+		{ "BGRA32",	14,	4 },
+	};
+
+	class TConfig
+	{
+	public:
+		size_t			mWidth = 0;
+		size_t			mHeight = 0;
+		const TFormat*	mFormat = nullptr;
+		size_t			mRowsPerFrame = 0;
+		size_t			mCacheCount = 0;
+		bool			mBaked = false;		//	loaded from a container rather than QueueWritePixels
+	};
+
+	//	a write that keeps failing never finishes, so a repeat gives up rather than hang a ci run
+	const uint64_t		MaxRepeatMicrosecs = 60 * 1000000;
+
+	class TResult
+	{
+	public:
+		size_t				mEvents = 0;
+		size_t				mFrames = 0;
+		uint64_t			mRows = 0;
+		uint64_t			mBytes = 0;
+		uint64_t			mWriteMicrosecs = 0;		//	sum of event costs
+		std::vector<uint64_t>	mEventMicrosecs;
+		std::vector<uint64_t>	mCompleteMicrosecs;	//	queue to all caches finished, per repeat
+		std::vector<uint64_t>	mUsableMicrosecs;	//	queue to all caches having a resident mip, per repeat
+		uint64_t			mFenceWaits = 0;		//	all caches, all repeats
+	};
+
+	class TOptions
+	{
+	public:
+		std::vector<size_t>			mSizes = { 256, 1024, 2048, 4096 };
+		std::vector<const TFormat*>	mFormats = { &Formats[0], &Formats[1], &Formats[2] };
+		std::vector<size_t>			mRowsPerFrame = { 32, 128, 512 };
+		std::vector<size_t>			mCacheCounts = { 1, 4, 16 };
+		size_t						mRepeats = 5;
+		size_t						mWarmups = 1;
+		bool						mMips = false;
+		bool						mBaked = false;
+		bool						mProgressive = false;
+		bool						mKernels = false;
+		bool						mOpengl = false;
+		std::string					mBakedFilename = "PopWritePixelsBenchmark.pwpb";	//	written & removed per configuration
+	};
+
+	uint64_t				GetMicrosecs();
+	uint64_t				GetPercentile(std::vector<uint64_t> Values,float Percentile);
+	std::vector<size_t>		ParseList(const char* Arg);
+	TOptions				ParseOptions(int argc,const char* argv[]);
+	TResult					Run(const TConfig& Config,const TOptions& Options);
+	void					CheckCompletions();		//	throws if any write failed
+	std::string				GetName(const TConfig& Config);
+	void					Print(const TConfig& Config,const TOptions& Options,const TResult& Result);
+	bool					RunKernels(const TOptions& Options);	//	false if any kernel differs from the reference
+
+#if defined(ENABLE_OPENGL)
+	//	headless gl context, current on the thread that creates it, which is then our "render thread"
+	class TEglContext
+	{
+	public:
+		TEglContext();
+		~TEglContext();
+
+	private:
+		EGLDisplay		mDisplay = EGL_NO_DISPLAY;
+		EGLContext		mContext = EGL_NO_CONTEXT;
+	};
+#endif
+}
+
+
+uint64_t Benchmark::GetMicrosecs()
+{
+	auto Now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration_cast<std::chrono::microseconds>(Now).count();
+}
+
+uint64_t Benchmark::GetPercentile(std::vector<uint64_t> Values,float Percentile)
+{
+	if ( Values.empty() )
+		return 0;
+	auto Index = std::min( Values.size()-1, static_cast<size_t>( Values.size() * Percentile ) );
+	std::nth_element( Values.begin(), Values.begin() + Index, Values.end() );
+	return Values[Index];
+}
+
+std::vector<size_t> Benchmark::ParseList(const char* Arg)
+{
+	std::vector<size_t> Values;
+	std::stringstream Stream( Arg );
+	std::string Item;
+	while ( std::getline( Stream, Item, ',' ) )
+		Values.push_back( static_cast<size_t>( std::strtoul( Item.c_str(), nullptr, 10 ) ) );
+	return Values;
+}
+
+Benchmark::TOptions Benchmark::ParseOptions(int argc,const char* argv[])
+{
+	TOptions Options;
+	for ( int i=1;	i<argc;	i++ )
+	{
+		std::string Arg = argv[i];
+		const char* Value = ( i+1 < argc ) ? argv[i+1] : "";
+
+		if ( Arg == "--quick" )
+		{
+			Options.mSizes = { 256, 1024 };
+			Options.mRowsPerFrame = { 128 };
+			Options.mCacheCounts = { 1, 4 };
+			Options.mRepeats = 2;
+			continue;
+		}
+		if ( Arg == "--mips" )
+		{
+			Options.mMips = true;
+			continue;
+		}
+		if ( Arg == "--baked" )
+		{
+			Options.mBaked = true;
+			continue;
+		}
+		if ( Arg == "--kernels" )
+		{
+			Options.mKernels = true;
+			continue;
+		}
+		if ( Arg == "--opengl" )
+		{
+#if !defined(ENABLE_OPENGL)
+			throw std::runtime_error("--opengl needs a build with ENABLE_OPENGL=1");
+#endif
+			Options.mOpengl = true;
+			continue;
+		}
+		if ( Arg == "--progressive" )
+		{
+			Options.mProgressive = true;
+			Options.mMips = true;
+			continue;
+		}
+
+		if ( Arg == "--sizes" )
+			Options.mSizes = ParseList( Value );
+		else if ( Arg == "--rows" )
+			Options.mRowsPerFrame = ParseList( Value );
+		else if ( Arg == "--caches" )
+			Options.mCacheCounts = ParseList( Value );
+		else if ( Arg == "--repeats" )
+			Options.mRepeats = std::max<size_t>( 1, std::strtoul( Value, nullptr, 10 ) );
+		else if ( Arg == "--warmups" )
+			Options.mWarmups = std::strtoul( Value, nullptr, 10 );
+		else if ( Arg == "--bakedfile" )
+			Options.mBakedFilename = Value;
+		else if ( Arg == "--formats" )
+		{
+			Options.mFormats.clear();
+			std::stringstream Stream( Value );
+			std::string Name;
+			while ( std::getline( Stream, Name, ',' ) )
+			{
+				auto Match = [&](const TFormat& Format)	{	return Name == Format.mName;	};
+				auto* Format = std::find_if( std::begin(Formats), std::end(Formats), Match );
+				if ( Format == std::end(Formats) )
+					throw std::runtime_error( "Unknown format " + Name );
+				Options.mFormats.push_back( Format );
+			}
+		}
+		else
+		{
+			throw std::runtime_error( "Unknown argument " + Arg + ". Options: --quick --kernels --opengl --mips --progressive --baked --bakedfile path --sizes a,b --formats RGBA32,RGB24,Alpha8,BGRA32 --rows a,b --caches a,b --repeats n --warmups n" );
+		}
+		i++;
+	}
+	return Options;
+}
+
+Benchmark::TResult Benchmark::Run(const TConfig& Config,const TOptions& Options)
+{
+	auto PixelFormat = static_cast<Unity::Texture2DPixelFormat::Type>( Config.mFormat->mUnityFormat );
+	std::vector<int> Caches;
+	for ( size_t c=0;	c<Config.mCacheCount;	c++ )
+	{
+		auto Backend = Options.mOpengl ? TTextureBackendType::Opengl : TTextureBackendType::Software;
+		auto Cache = AllocCacheTextureWithBackend( Config.mWidth, Config.mHeight, PixelFormat, Options.mMips, Backend );
+		if ( Cache == -1 )
+			throw std::runtime_error("AllocCacheTextureWithBackend failed");
+		SetWriteRowsPerFrame( Cache, Config.mRowsPerFrame );
+		if ( Options.mProgressive )
+			SetMipMode( Cache, TMipMode::Progressive );
+		Caches.push_back( Cache );
+	}
+
+	//	not all the same value, so nothing can shortcut it
+	auto DataSize = Config.mWidth * Config.mHeight * Config.mFormat->mBytesPerPixel;
+	std::vector<uint8_t> Pixels( DataSize );
+	for ( size_t i=0;	i<DataSize;	i++ )
+		Pixels[i] = static_cast<uint8_t>( i * 31 );
+
+	//	baked outside the timing, as the baker would be offline
+	if ( Config.mBaked )
+	{
+		SoyPixelsMeta Meta( Config.mWidth, Config.mHeight, Unity::GetPixelFormat( PixelFormat ) );
+		TBakeParams Params;
+		Params.mMips = Options.mMips;
+		Params.mChunkRows = Config.mRowsPerFrame;
+		PopWritePixels::BakeTexture( Options.mBakedFilename, Pixels.data(), Meta, Config.mFormat->mUnityFormat, Params );
+	}
+
+	auto WriteEvent = GetWritePixelsToCacheFunc();
+	TResult Result;
+	for ( size_t r=0;	r<Options.mWarmups + Options.mRepeats;	r++ )
+	{
+		bool Measure = r >= Options.mWarmups;
+		auto QueueStart = GetMicrosecs();
+		for ( auto Cache : Caches )
+		{
+			if ( Config.mBaked )
+			{
+				if ( !QueueWritePixelsBaked( Cache, Options.mBakedFilename.c_str() ) )
+					throw std::runtime_error("QueueWritePixelsBaked failed");
+			}
+			else if ( !QueueWritePixels( Cache, Pixels.data(), static_cast<int>(DataSize) ) )
+				throw std::runtime_error("QueueWritePixels failed");
+		}
+
+		//	one render event per unfinished cache per frame, as the c# JobCache does
+		std::vector<bool> Finished( Caches.size(), false );
+		size_t FinishedCount = 0;
+		std::vector<bool> Usable( Caches.size(), false );
+		size_t UsableCount = 0;
+		while ( FinishedCount < Caches.size() )
+		{
+			for ( size_t c=0;	c<Caches.size();	c++ )
+			{
+				if ( Finished[c] )
+					continue;
+
+				auto EventStart = GetMicrosecs();
+				WriteEvent( Caches[c] );
+				auto EventDuration = GetMicrosecs() - EventStart;
+
+				auto RowsWritten = GetRowsWritten( Caches[c] );
+				if ( RowsWritten < 0 )
+					throw std::runtime_error("GetRowsWritten failed");
+				if ( static_cast<size_t>(RowsWritten) >= Config.mHeight )
+				{
+					Finished[c] = true;
+					FinishedCount++;
+				}
+				if ( !Usable[c] && GetResidentMip( Caches[c] ) >= 0 )
+				{
+					Usable[c] = true;
+					UsableCount++;
+					if ( Measure && UsableCount == Caches.size() )
+						Result.mUsableMicrosecs.push_back( GetMicrosecs() - QueueStart );
+				}
+
+				if ( Measure )
+				{
+					Result.mEvents++;
+					Result.mWriteMicrosecs += EventDuration;
+					Result.mEventMicrosecs.push_back( EventDuration );
+				}
+			}
+			if ( Measure )
+				Result.mFrames++;
+
+			CheckCompletions();
+			if ( GetMicrosecs() - QueueStart > MaxRepeatMicrosecs )
+				throw std::runtime_error("Timed out waiting for writes to finish");
+		}
+
+		if ( Measure )
+		{
+			Result.mCompleteMicrosecs.push_back( GetMicrosecs() - QueueStart );
+			Result.mRows += Config.mHeight * Caches.size();
+			Result.mBytes += DataSize * Caches.size();
+		}
+	}
+
+	for ( auto Cache : Caches )
+	{
+		TCacheStats Stats;
+		if ( !GetCacheStats( Cache, &Stats ) )
+			throw std::runtime_error("GetCacheStats failed");
+		Result.mFenceWaits += Stats.mFenceWaits;
+		ReleaseCache( Cache );
+	}
+	if ( Config.mBaked )
+		std::remove( Options.mBakedFilename.c_str() );
+	return Result;
+}
+
+void Benchmark::CheckCompletions()
+{
+	//	the exports swallow write exceptions, this is the only place a failure shows up
+	TCompletion Completions[64];
+	int Count = 0;
+	while ( ( Count = DrainCompletions( Completions, 64 ) ) > 0 )
+	{
+		for ( int i=0;	i<Count;	i++ )
+			if ( Completions[i].mStatus == TCompletionStatus::Failed )
+				throw std::runtime_error( "Write failed on cache " + std::to_string( Completions[i].mCache ) );
+	}
+	if ( Count < 0 )
+		throw std::runtime_error("DrainCompletions failed");
+}
+
+std::string Benchmark::GetName(const TConfig& Config)
+{
+	std::stringstream Name;
+	Name << Config.mWidth << "x" << Config.mHeight << " " << Config.mFormat->mName
+	<< " rows " << Config.mRowsPerFrame << " caches " << Config.mCacheCount
+	<< ( Config.mBaked ? " baked" : " raw" );
+	return Name.str();
+}
+
+void Benchmark::Print(const TConfig& Config,const TOptions& Options,const TResult& Result)
+{
+	uint64_t CompleteTotal = 0;
+	for ( auto Complete : Result.mCompleteMicrosecs )
+		CompleteTotal += Complete;
+	auto Seconds = std::max<uint64_t>( 1, Result.mWriteMicrosecs ) / 1000000.0;
+	auto CompleteMean = Result.mCompleteMicrosecs.empty() ? 0 : CompleteTotal / Result.mCompleteMicrosecs.size();
+	uint64_t UsableTotal = 0;
+	for ( auto Usable : Result.mUsableMicrosecs )
+		UsableTotal += Usable;
+	auto UsableMean = Result.mUsableMicrosecs.empty() ? 0 : UsableTotal / Result.mUsableMicrosecs.size();
+
+	std::cout << "{"
+	<< "\"width\":" << Config.mWidth
+	<< ",\"height\":" << Config.mHeight
+	<< ",\"format\":\"" << Config.mFormat->mName << "\""
+	<< ",\"backend\":\"" << (Options.mOpengl ? "opengl" : "software") << "\""
+	<< ",\"mips\":" << (Options.mMips ? "true" : "false")
+	<< ",\"progressive\":" << (Options.mProgressive ? "true" : "false")
+	<< ",\"path\":\"" << (Config.mBaked ? "baked" : "raw") << "\""
+	<< ",\"rows_per_frame\":" << Config.mRowsPerFrame
+	<< ",\"caches\":" << Config.mCacheCount
+	<< ",\"repeats\":" << Options.mRepeats
+	<< ",\"frames\":" << Result.mFrames
+	<< ",\"events\":" << Result.mEvents
+	<< ",\"rows_per_sec\":" << static_cast<uint64_t>( Result.mRows / Seconds )
+	<< ",\"bytes_per_sec\":" << static_cast<uint64_t>( Result.mBytes / Seconds )
+	<< ",\"event_p50_us\":" << GetPercentile( Result.mEventMicrosecs, 0.50f )
+	<< ",\"event_p99_us\":" << GetPercentile( Result.mEventMicrosecs, 0.99f )
+	<< ",\"event_max_us\":" << GetPercentile( Result.mEventMicrosecs, 1.0f )
+	<< ",\"complete_mean_us\":" << CompleteMean
+	<< ",\"complete_max_us\":" << GetPercentile( Result.mCompleteMicrosecs, 1.0f )
+	<< ",\"usable_mean_us\":" << UsableMean
+	<< ",\"usable_max_us\":" << GetPercentile( Result.mUsableMicrosecs, 1.0f )
+	<< ",\"fence_waits\":" << Result.mFenceWaits
+	<< "}" << std::endl;
+}
+
+bool Benchmark::RunKernels(const TOptions& Options)
+{
+	const std::pair<TPixelConversion::Type,const char*> Conversions[] =
+	{
+		{ TPixelConversion::RgbToRgba,			"RgbToRgba" },
+		{ TPixelConversion::SwapRedBlue,		"SwapRedBlue" },
+		{ TPixelConversion::FloatToHalf,		"FloatToHalf" },
+		{ TPixelConversion::Uint16ToUint8,		"Uint16ToUint8" },
+		{ TPixelConversion::LinearFloatToSrgb8,	"LinearFloatToSrgb8" },
+	};
+	static const size_t DstSize = 16 * 1024 * 1024;
+
+	bool AllMatch = true;
+	for ( auto& Conversion : Conversions )
+	{
+		auto Type = Conversion.first;
+		auto SrcSize = PopWritePixels::GetConversionSourceRowSize( Type, DstSize );
+		auto DstUnit = PopWritePixels::GetConversionDstUnitSize( Type );
+
+		//	float sources cover negatives, the 0..1 range, half denormals and past half's max; never nan
+		std::vector<uint8_t> Src( SrcSize );
+		bool FloatSource = Type == TPixelConversion::FloatToHalf || Type == TPixelConversion::LinearFloatToSrgb8;
+		if ( FloatSource )
+		{
+			auto* Floats = reinterpret_cast<float*>( Src.data() );
+			for ( size_t i=0;	i<SrcSize/sizeof(float);	i++ )
+			{
+				auto Hash = static_cast<uint32_t>( i * 2654435761u );
+				float Value = ( Hash % 200000 ) / 100000.0f - 0.5f;
+				if ( i % 7 == 0 )
+					Value *= 1e-6f;
+				if ( i % 11 == 0 )
+					Value *= 70000.0f;
+				Floats[i] = Value;
+			}
+		}
+		else
+		{
+			for ( size_t i=0;	i<SrcSize;	i++ )
+				Src[i] = static_cast<uint8_t>( (i * 2654435761u) >> 13 );
+		}
+
+		std::vector<uint8_t> Expected( DstSize );
+		PopWritePixels::ConvertRowsReference( Type, Src.data(), Expected.data(), DstSize );
+
+		auto Best = PopWritePixels::GetConversionKernelName( Type );
+		for ( auto* Kernel : PopWritePixels::GetConversionKernelNames( Type ) )
+		{
+			std::vector<uint8_t> Dst( DstSize, 0xcd );
+			PopWritePixels::ConvertRowsWithKernel( Type, Kernel, Src.data(), Dst.data(), DstSize );
+			bool Match = Dst == Expected;
+
+			//	short runs, so every scalar tail after the vector loops is compared too
+			for ( size_t Units=0;	Units<=67 && Match;	Units++ )
+			{
+				auto Size = Units * DstUnit;
+				std::vector<uint8_t> Short( Size + 1, 0xcd );
+				PopWritePixels::ConvertRowsWithKernel( Type, Kernel, Src.data(), Short.data(), Size );
+				Match = std::equal( Short.begin(), Short.begin() + Size, Expected.begin() ) && Short[Size] == 0xcd;
+			}
+
+			uint64_t BestMicrosecs = UINT64_MAX;
+			for ( size_t r=0;	r<Options.mRepeats;	r++ )
+			{
+				auto Start = GetMicrosecs();
+				PopWritePixels::ConvertRowsWithKernel( Type, Kernel, Src.data(), Dst.data(), DstSize );
+				BestMicrosecs = std::min( BestMicrosecs, GetMicrosecs() - Start );
+			}
+			BestMicrosecs = std::max<uint64_t>( 1, BestMicrosecs );
+
+			std::cout << "{"
+			<< "\"conversion\":\"" << Conversion.second << "\""
+			<< ",\"kernel\":\"" << Kernel << "\""
+			<< ",\"selected\":" << (strcmp( Kernel, Best ) == 0 ? "true" : "false")
+			<< ",\"match\":" << (Match ? "true" : "false")
+			<< ",\"dst_bytes\":" << DstSize
+			<< ",\"best_us\":" << BestMicrosecs
+			<< ",\"mb_per_sec\":" << static_cast<uint64_t>( DstSize / BestMicrosecs )
+			<< "}" << std::endl;
+			if ( !Match )
+				AllMatch = false;
+		}
+	}
+	return AllMatch;
+}
+
+#if defined(ENABLE_OPENGL)
+Benchmark::TEglContext::TEglContext()
+{
+	//	mesa's surfaceless platform needs no display server or gpu; otherwise try the default display
+	auto GetPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>( eglGetProcAddress("eglGetPlatformDisplayEXT") );
+#if defined(EGL_PLATFORM_SURFACELESS_MESA)
+	if ( GetPlatformDisplay )
+		mDisplay = GetPlatformDisplay( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr );
+#endif
+	if ( mDisplay == EGL_NO_DISPLAY )
+		mDisplay = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+	if ( mDisplay == EGL_NO_DISPLAY || !eglInitialize( mDisplay, nullptr, nullptr ) )
+		throw std::runtime_error("Failed to initialise an EGL display");
+
+	auto* Extensions = eglQueryString( mDisplay, EGL_EXTENSIONS );
+	if ( !Extensions || !strstr( Extensions, "EGL_KHR_surfaceless_context" ) )
+		throw std::runtime_error("EGL display has no EGL_KHR_surfaceless_context");
+
+	if ( !eglBindAPI( EGL_OPENGL_API ) )
+		throw std::runtime_error("eglBindAPI(EGL_OPENGL_API) failed");
+
+	//	we never make a surface, but surfaceless displays only have pbuffer configs
+	const EGLint ConfigAttribs[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig Config = nullptr;
+	EGLint ConfigCount = 0;
+	if ( !eglChooseConfig( mDisplay, ConfigAttribs, &Config, 1, &ConfigCount ) || ConfigCount == 0 )
+		throw std::runtime_error("No EGL config for desktop opengl");
+
+	mContext = eglCreateContext( mDisplay, Config, EGL_NO_CONTEXT, nullptr );
+	if ( mContext == EGL_NO_CONTEXT )
+		throw std::runtime_error("eglCreateContext failed");
+	if ( !eglMakeCurrent( mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, mContext ) )
+		throw std::runtime_error("eglMakeCurrent failed");
+}
+
+Benchmark::TEglContext::~TEglContext()
+{
+	eglMakeCurrent( mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+	if ( mContext != EGL_NO_CONTEXT )
+		eglDestroyContext( mDisplay, mContext );
+	eglTerminate( mDisplay );
+}
+#endif
+
+
+int main(int argc,const char* argv[])
+{
+	try
+	{
+		auto Options = Benchmark::ParseOptions( argc, argv );
+		SetLogLevel( TLogLevel::Errors );
+
+		if ( Options.mKernels )
+		{
+			if ( Benchmark::RunKernels( Options ) )
+				return 0;
+			std::cerr << "Benchmark failed: a conversion kernel differs from the reference" << std::endl;
+			return 1;
+		}
+
+#if defined(ENABLE_OPENGL)
+		std::shared_ptr<Benchmark::TEglContext> Context;
+		if ( Options.mOpengl )
+			Context.reset( new Benchmark::TEglContext() );
+#endif
+
+		for ( auto* Format : Options.mFormats )
+		for ( auto Size : Options.mSizes )
+		for ( auto RowsPerFrame : Options.mRowsPerFrame )
+		for ( auto CacheCount : Options.mCacheCounts )
+		for ( auto Baked : { false, true } )
+		{
+			if ( Baked && !Options.mBaked )
+				continue;
+			Benchmark::TConfig Config;
+			Config.mWidth = Size;
+			Config.mHeight = Size;
+			Config.mFormat = Format;
+			Config.mRowsPerFrame = RowsPerFrame;
+			Config.mCacheCount = CacheCount;
+			Config.mBaked = Baked;
+			Benchmark::TResult Result;
+			try
+			{
+				Result = Benchmark::Run( Config, Options );
+			}
+			catch(std::exception& e)
+			{
+				throw std::runtime_error( Benchmark::GetName( Config ) + ": " + e.what() );
+			}
+			Benchmark::Print( Config, Options, Result );
+		}
+		return 0;
+	}
+	catch(std::exception& e)
+	{
+		std::cerr << "Benchmark failed: " << e.what() << std::endl;
+		return 1;
+	}
+}
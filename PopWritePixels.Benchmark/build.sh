@@ -0,0 +1,77 @@
+#!/bin/sh
+
+# builds the headless benchmark for the desktop it runs on, from the plugin's own sources
+# usage: SOY_PATH=/path/to/SoyLib ./build.sh && ./PopWritePixelsBenchmark --quick > results.jsonl
+# ENABLE_OPENGL=1 also builds the opengl backend for --opengl (linux; needs EGL with surfaceless contexts, eg. mesa)
+
+if [ -z "$SOY_PATH" ]; then
+	echo "SOY_PATH env var not set"
+	exit 1
+fi
+
+if [ -z "$CXX" ]; then
+	CXX="c++"
+fi
+
+case "$(uname)" in
+	Darwin)	TARGET="TARGET_OSX";;
+	*)		TARGET="TARGET_LINUX";;
+esac
+
+SRC=..
+
+OPENGL_FLAGS=""
+OPENGL_SRC=""
+OPENGL_LIBS=""
+if [ -n "$ENABLE_OPENGL" ]; then
+	OPENGL_FLAGS="-DENABLE_OPENGL -DGL_GLEXT_PROTOTYPES"
+	OPENGL_SRC="$SOY_PATH/src/SoyOpengl.cpp $SOY_PATH/src/SoyOpenglContext.cpp"
+	OPENGL_LIBS="-lEGL -lGL"
+fi
+
+$CXX -std=c++14 -O2 -pthread -D$TARGET $OPENGL_FLAGS \
+-I$SRC/Source -I$SOY_PATH/src \
+$SRC/PopWritePixels.Benchmark/PopWritePixelsBenchmark.cpp \
+$SRC/Source/PopDebug.cpp \
+$SRC/Source/PopUnity.cpp \
+$SRC/Source/PopWritePixels.cpp \
+$SRC/Source/TTextureBackend.cpp \
+$SRC/Source/TWriteBudget.cpp \
+$SRC/Source/TCache.cpp \
+$SRC/Source/TScheduler.cpp \
+$SRC/Source/TPixelBufferPool.cpp \
+$SRC/Source/THash.cpp \
+$SRC/Source/TWorkerPool.cpp \
+$SRC/Source/TPixelConvert.cpp \
+$SRC/Source/TMipChain.cpp \
+$SRC/Source/TBlockCompress.cpp \
+$SRC/Source/TTileLayout.cpp \
+$SRC/Source/TOpenglTexture.cpp \
+$SRC/Source/TAtlas.cpp \
+$SRC/Source/TCacheSlots.cpp \
+$SRC/Source/TTelemetry.cpp \
+$SRC/Source/TWriteBatch.cpp \
+$SRC/Source/TMappedFile.cpp \
+$SRC/Source/TPngDecode.cpp \
+$SRC/Source/TFrameStream.cpp \
+$SRC/Source/TTextureDedupe.cpp \
+$SRC/Source/TCompletionQueue.cpp \
+$SRC/Source/TMemoryBudget.cpp \
+$SRC/Source/TBakedTexture.cpp \
+$SRC/Source/TReadback.cpp \
+$SOY_PATH/src/SoyAssert.cpp \
+$SOY_PATH/src/SoyTypes.cpp \
+$SOY_PATH/src/SoyPixels.cpp \
+$SOY_PATH/src/SoyDebug.cpp \
+$SOY_PATH/src/SoyThread.cpp \
+$SOY_PATH/src/SoyEvent.cpp \
+$SOY_PATH/src/SoyString.cpp \
+$SOY_PATH/src/memheap.cpp \
+$SOY_PATH/src/SoyArray.cpp \
+$SOY_PATH/src/SoyUnity.cpp \
+$SOY_PATH/src/SoyTime.cpp \
+$OPENGL_SRC \
+$OPENGL_LIBS \
+-o PopWritePixelsBenchmark
+
+exit $?
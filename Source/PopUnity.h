@@ -9,7 +9,7 @@
 #if defined(TARGET_WINDOWS)
 #define __api(returntype)	returntype __stdcall 
 #define __export			extern "C" __declspec(dllexport)
-#elif defined(TARGET_OSX) || defined(TARGET_IOS)|| defined(TARGET_ANDROID)
+#elif defined(TARGET_OSX) || defined(TARGET_IOS)|| defined(TARGET_ANDROID) || defined(TARGET_LINUX)
 #define __api(returntype)	extern "C" returntype
 #define __export			extern "C"
 #endif
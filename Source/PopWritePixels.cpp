@@ -1,4 +1,19 @@
 #include "PopWritePixels.h"
+#include "TCache.h"
+#include "TCacheSlots.h"
+#include "TScheduler.h"
+#include "TPixelConvert.h"
+#include "TBlockCompress.h"
+#include "TWorkerPool.h"
+#include "TAtlas.h"
+#include "TTelemetry.h"
+#include "TWriteBatch.h"
+#include "TPngDecode.h"
+#include "TTextureDedupe.h"
+#include "TCompletionQueue.h"
+#include "TMemoryBudget.h"
+#include "TBakedTexture.h"
+#include "TReadback.h"
 #include <sstream>
 #include <algorithm>
 #include <functional>
@@ -18,113 +33,79 @@
 #endif
 
 
-class TPendingBytes
-{
-public:
-	uint8_t*	mBytes = 0;
-	size_t		mBytesSize = 0;
-	size_t		mRowsWritten = 0;
-};
-
-class TCache
-{
-public:
-	bool			Used() const;
-	void			Release();
-	bool			HasFinished() const;
-	size_t			GetRowsWritten() const;
-	void			WritePixels();
-
-public:
-	size_t			mWriteRowsPerFrame = 256;
-	bool			mEnableMips = true;		//	for new texture
-	bool			mCreatingNewTexture = false;
-	std::shared_ptr<Directx::TTexture>	mAllocatedTexture;
-	void*			mTexturePtr = nullptr;
-	SoyPixelsMeta	mTextureMeta;
-	std::shared_ptr<TPendingBytes>	mPendingBytes;
-};
-
-
 namespace PopWritePixels
 {
-	//	gr: could be big as it's just sitting in memory, but made small so we
-	//	can ensure client is releasing in case in future we NEED releasing
-#define MAX_CACHES	200
-	TCache		gCaches[MAX_CACHES];
+	TCacheSlots		gCaches;
 
-	TCache&		AllocCache(int& CacheIndex);
-	TCache&		GetCache(int CacheIndex);
-	void		ReleaseCache(uint32_t CacheIndex);
+	TWriteBudget	gDefaultWriteBudget;	//	applied to new caches
+	TWriteRateMeter	gWriteRate;
 }
 
 
 
+//	gr: this is on the render thread every frame, so nothing is formatted or printed unless asked for (see TLogLevel)
 template<typename RETURN,typename FUNC>
 RETURN SafeCall(FUNC Function,const char* FunctionName,RETURN ErrorReturn)
 {
-	Soy::TScopeTimerPrint Timer(FunctionName, 1);
 	try
 	{
+		if ( PopWritePixels::IsLogging( TLogLevel::Calls ) )
+		{
+			Soy::TScopeTimerPrint Timer(FunctionName, 0);
+			return Function();
+		}
 		return Function();
 	}
 	catch(std::exception& e)
 	{
-		std::Debug << FunctionName << " exception: " << e.what() << std::endl;
+		if ( PopWritePixels::IsLogging( TLogLevel::Errors ) )
+			std::Debug << FunctionName << " exception: " << e.what() << std::endl;
 		return ErrorReturn;
 	}
 	catch(...)
 	{
-		std::Debug << FunctionName << " unknown exception." << std::endl;
+		if ( PopWritePixels::IsLogging( TLogLevel::Errors ) )
+			std::Debug << FunctionName << " unknown exception." << std::endl;
 		return ErrorReturn;
 	}
 }
 
 
 
-TCache& PopWritePixels::AllocCache(int& CacheIndex)
+TCache& PopWritePixels::AllocCache(int& CacheHandle)
 {
-	for ( int i=0;	i<MAX_CACHES;	i++ )
-	{
-		auto& Cache = gCaches[i];
-		if ( Cache.Used() )
-			continue;
-		
-		CacheIndex = i;
-		return Cache;
-	}
-	
-	throw Soy::AssertException("No free caches");
+	auto& Cache = gCaches.Alloc( CacheHandle );
+	Cache.mHandle = CacheHandle;
+	return Cache;
 }
 
-TCache& PopWritePixels::GetCache(int CacheIndex)
+TCache& PopWritePixels::GetCache(int CacheHandle)
 {
-	if ( CacheIndex < 0 || CacheIndex >= MAX_CACHES )
-	{
-		throw Soy::AssertException("Invalid Cache Index");
-	}
-	
-	auto& Cache = gCaches[CacheIndex];
-	if ( !Cache.Used() )
-	{
-		throw Soy::AssertException("Cache not allocated");
-	}
-	
-	return Cache;
+	return gCaches.Get( CacheHandle );
 }
 
 
-void PopWritePixels::ReleaseCache(uint32_t CacheIndex)
+void PopWritePixels::ReleaseCache(int CacheHandle)
 {
-	if ( CacheIndex >= MAX_CACHES )
-	{
-		throw Soy::AssertException("Invalid Cache Index");
-	}
-	
-	gCaches[CacheIndex].Release();
+	gCaches.Release( CacheHandle );
+}
+
+void PopWritePixels::ReleasePendingCaches()
+{
+	gCaches.ReleasePending();
+}
+
+void PopWritePixels::EnumCaches(std::function<void(TCache&,int)> Enum)
+{
+	gCaches.Enum( Enum );
+}
+
+size_t PopWritePixels::GetCacheSlotIndex(int CacheHandle)
+{
+	return TCacheSlots::GetSlotIndex( CacheHandle );
 }
 
-int AllocCacheRenderTexture(void* TexturePtr,SoyPixelsMeta Meta,bool EnableMips)
+int AllocCacheRenderTexture(void* TexturePtr,SoyPixelsMeta Meta,bool EnableMips,TTextureBackendType::Type BackendType)
 {
 	int CacheIndex = -1;
 	auto& Cache = PopWritePixels::AllocCache(CacheIndex);
@@ -133,6 +114,8 @@ int AllocCacheRenderTexture(void* TexturePtr,SoyPixelsMeta Meta,bool EnableMips)
 	if ( !TexturePtr )
 		Cache.mCreatingNewTexture = true;
 	Cache.mEnableMips = EnableMips;
+	Cache.mBackendType = BackendType;
+	Cache.mWriteBudget = PopWritePixels::gDefaultWriteBudget;
 
 	return CacheIndex;
 }
@@ -143,7 +126,7 @@ __export int AllocCacheTexture2D(void* TexturePtr,int Width,int Height,Unity::Te
 	auto Function = [&]()
 	{
 		SoyPixelsMeta Meta( Width, Height, Unity::GetPixelFormat( PixelFormat ) );
-		return AllocCacheRenderTexture( TexturePtr, Meta, false );
+		return AllocCacheRenderTexture( TexturePtr, Meta, false, TTextureBackendType::Default );
 	};
 	return SafeCall( Function, __func__, -1 );
 }
@@ -153,7 +136,37 @@ __export int AllocCacheTexture(int Width,int Height,Unity::Texture2DPixelFormat:
 	auto Function = [&]()
 	{
 		SoyPixelsMeta Meta( Width, Height, Unity::GetPixelFormat( PixelFormat ) );
-		return AllocCacheRenderTexture( nullptr, Meta, EnableMips );
+		return AllocCacheRenderTexture( nullptr, Meta, EnableMips, TTextureBackendType::Default );
+	};
+	return SafeCall( Function, __func__, -1 );
+}
+
+__export int AllocCacheTextureWithBackend(int Width,int Height,Unity::Texture2DPixelFormat::Type PixelFormat,bool EnableMips,int Backend)
+{
+	auto Function = [&]()
+	{
+		SoyPixelsMeta Meta( Width, Height, Unity::GetPixelFormat( PixelFormat ) );
+		auto BackendType = static_cast<TTextureBackendType::Type>( Backend );
+		return AllocCacheRenderTexture( nullptr, Meta, EnableMips, BackendType );
+	};
+	return SafeCall( Function, __func__, -1 );
+}
+
+__export int AllocCacheTextureCompressed(void* TexturePtr,int Width,int Height,int BlockFormat)
+{
+	auto Function = [&]()
+	{
+		auto Format = static_cast<TBlockFormat::Type>( BlockFormat );
+		//	throws on unknown formats
+		PopWritePixels::GetBlockSize( Format );
+
+		//	we can't create compressed native textures, so without the client's it's headless
+		auto BackendType = TexturePtr ? TTextureBackendType::Default : TTextureBackendType::Software;
+		SoyPixelsMeta Meta( Width, Height, SoyPixelsFormat::RGBA );
+		auto CacheIndex = AllocCacheRenderTexture( TexturePtr, Meta, false, BackendType );
+		auto& Cache = PopWritePixels::GetCache( CacheIndex );
+		Cache.mBlockFormat = Format;
+		return CacheIndex;
 	};
 	return SafeCall( Function, __func__, -1 );
 }
@@ -174,11 +187,13 @@ __api(void) WritePixelsToCache(int CacheIndex)
 {
 	auto Function = [&]()
 	{
-		std::Debug << "WritePixelsWithCache(" << CacheIndex << ")" << std::endl;
+		PopWritePixels::ReleasePendingCaches();
 		auto& Cache = PopWritePixels::GetCache(CacheIndex);
 		
 		//	write any pending pixels
-		Cache.WritePixels();
+		auto FrameStart = PopWritePixels::GetMicrosecsNow();
+		auto BytesWritten = Cache.WritePixels();
+		PopWritePixels::GetPluginTelemetry().OnFrame( BytesWritten, PopWritePixels::GetMicrosecsNow() - FrameStart );
 		return 0;
 	};
 	SafeCall( Function, __func__, 0 );
@@ -190,175 +205,1068 @@ __export UnityRenderingEvent GetWritePixelsToCacheFunc()
 	return WritePixelsToCache;
 }
 
-__export bool QueueWritePixels(int CacheIndex,uint8_t* ByteData, int ByteDataSize)
+
+__api(void) WriteAllPendingCaches(int EventId)
 {
 	auto Function = [&]()
 	{
-		std::Debug << "WritePixels(" << CacheIndex << ")" << std::endl;
-		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		PopWritePixels::ReleasePendingCaches();
+		auto& Scheduler = PopWritePixels::GetScheduler();
+		Scheduler.WriteAllPendingCaches();
+		return 0;
+	};
+	SafeCall( Function, __func__, 0 );
+}
 
-		Cache.mPendingBytes.reset(new TPendingBytes());
-		Cache.mPendingBytes->mBytes = ByteData;
-		Cache.mPendingBytes->mBytesSize = ByteDataSize;
-		return true;
+
+__export UnityRenderingEvent GetWriteAllPendingCachesFunc()
+{
+	return WriteAllPendingCaches;
+}
+
+
+__api(void) WriteAtlases(int EventId)
+{
+	auto Function = [&]()
+	{
+		PopWritePixels::ReleasePendingCaches();
+		PopWritePixels::WriteAtlases();
+		return 0;
 	};
-	return SafeCall( Function, __func__, false );
+	SafeCall( Function, __func__, 0 );
 }
 
-__export int GetRowsWritten(int CacheIndex)
+
+__export UnityRenderingEvent GetWriteAtlasesFunc()
+{
+	return WriteAtlases;
+}
+
+
+__api(void) WriteBatch(int EventId)
 {
 	auto Function = [&]()
 	{
-		std::Debug << "WritePixels(" << CacheIndex << ")" << std::endl;
-		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		PopWritePixels::ReleasePendingCaches();
+		auto FrameStart = PopWritePixels::GetMicrosecsNow();
+		auto BytesWritten = PopWritePixels::GetWriteBatchQueue().WritePending();
+		PopWritePixels::GetPluginTelemetry().OnFrame( BytesWritten, PopWritePixels::GetMicrosecsNow() - FrameStart );
+		return 0;
+	};
+	SafeCall( Function, __func__, 0 );
+}
 
-		return Cache.GetRowsWritten();
+
+__export UnityRenderingEvent GetWriteBatchFunc()
+{
+	return WriteBatch;
+}
+
+__export int AllocAtlas(int PageWidth,int PageHeight,Unity::Texture2DPixelFormat::Type PixelFormat,int MaxPages,int Padding,int Backend)
+{
+	auto Function = [&]()
+	{
+		if ( PageWidth <= 0 || PageHeight <= 0 )
+			throw Soy::AssertException("Invalid atlas page size");
+		SoyPixelsMeta Meta( PageWidth, PageHeight, Unity::GetPixelFormat( PixelFormat ) );
+		auto BackendType = static_cast<TTextureBackendType::Type>( Backend );
+		return PopWritePixels::AllocAtlas( Meta, std::max( 1, MaxPages ), std::max( 0, Padding ), BackendType );
 	};
 	return SafeCall( Function, __func__, -1 );
 }
 
-__export void SetWriteRowsPerFrame(int CacheIndex,int WriteRowsPerFrame)
+__export void ReleaseAtlas(int Atlas)
 {
 	auto Function = [&]()
 	{
-		auto& Cache = PopWritePixels::GetCache(CacheIndex);
-		
-		if ( WriteRowsPerFrame < 1 )
-			WriteRowsPerFrame = 1;
-		Cache.mWriteRowsPerFrame = WriteRowsPerFrame;
+		PopWritePixels::ReleaseAtlas( Atlas );
 		return 0;
 	};
-	SafeCall( Function, __func__, -1 );
+	SafeCall( Function, __func__, 0 );
 }
 
-
-__export void* GetCacheTexture(int CacheIndex)
+__export int AtlasAddImage(int AtlasIndex,uint8_t* ByteData,int ByteDataSize,int Width,int Height,int* Page,float* UvRect)
 {
 	auto Function = [&]()
 	{
-		std::Debug << "GetCacheTexture(" << CacheIndex << ")" << std::endl;
-		auto& Cache = PopWritePixels::GetCache(CacheIndex);
-		if ( Cache.mTexturePtr )
-			return Cache.mTexturePtr;
+		if ( Width <= 0 || Height <= 0 )
+			throw Soy::AssertException("Invalid atlas image size");
+
+		auto Atlas = PopWritePixels::GetAtlas( AtlasIndex );
+		size_t PageIndex = 0;
+		TTextureRect Rect;
+		auto Image = Atlas->AddImage( ByteData, std::max( 0, ByteDataSize ), Width, Height, PageIndex, Rect );
 
-		if ( Cache.mAllocatedTexture )
+		if ( Page )
+			*Page = static_cast<int>( PageIndex );
+		if ( UvRect )
 		{
-			//	unity needs a shader resource view
-			auto& ResourceView = Cache.mAllocatedTexture->GetResourceView();
-			return static_cast<void*>(&ResourceView);
-			//return static_cast<void*>(Cache.mAllocatedTexture.get());
+			auto PageWidth = static_cast<float>( Atlas->mPageMeta.GetWidth() );
+			auto PageHeight = static_cast<float>( Atlas->mPageMeta.GetHeight() );
+			UvRect[0] = Rect.mX / PageWidth;
+			UvRect[1] = Rect.mY / PageHeight;
+			UvRect[2] = Rect.mWidth / PageWidth;
+			UvRect[3] = Rect.mHeight / PageHeight;
 		}
+		return Image;
+	};
+	return SafeCall( Function, __func__, -1 );
+}
 
-		return static_cast<void*>(nullptr);
+__export void AtlasFreeImage(int AtlasIndex,int Image)
+{
+	auto Function = [&]()
+	{
+		auto Atlas = PopWritePixels::GetAtlas( AtlasIndex );
+		Atlas->FreeImage( Image );
+		return 0;
 	};
-	return SafeCall<void*>( Function, __func__, nullptr );
+	SafeCall( Function, __func__, 0 );
 }
 
+__export int GetAtlasPageCount(int AtlasIndex)
+{
+	auto Function = [&]()
+	{
+		auto Atlas = PopWritePixels::GetAtlas( AtlasIndex );
+		return static_cast<int>( Atlas->GetPageCount() );
+	};
+	return SafeCall( Function, __func__, -1 );
+}
 
-bool TCache::Used() const		
+__export void* GetAtlasPageTexture(int AtlasIndex,int Page)
 {
-	if ( mTexturePtr )
-		return true;
-	if ( mAllocatedTexture )
+	auto Function = [&]()
+	{
+		if ( Page < 0 )
+			throw Soy::AssertException("Invalid atlas page");
+		auto Atlas = PopWritePixels::GetAtlas( AtlasIndex );
+		return Atlas->GetPageTexture( Page );
+	};
+	return SafeCall<void*>( Function, __func__, nullptr );
+}
+
+__export bool GetAtlasStats(int AtlasIndex,TAtlasStats* Stats)
+{
+	auto Function = [&]()
+	{
+		if ( !Stats )
+			throw Soy::AssertException("Atlas stats pointer is null");
+		auto Atlas = PopWritePixels::GetAtlas( AtlasIndex );
+		*Stats = Atlas->GetStats();
 		return true;
-	if ( mCreatingNewTexture )
+	};
+	return SafeCall( Function, __func__, false );
+}
+
+__export int AllocReadback(void* TexturePtr,int Width,int Height,Unity::Texture2DPixelFormat::Type PixelFormat,int Backend)
+{
+	auto Function = [&]()
+	{
+		if ( !TexturePtr )
+			throw Soy::AssertException("Readback needs a texture");
+		if ( Width <= 0 || Height <= 0 )
+			throw Soy::AssertException("Invalid readback size");
+		SoyPixelsMeta Meta( Width, Height, Unity::GetPixelFormat( PixelFormat ) );
+		auto BackendType = static_cast<TTextureBackendType::Type>( Backend );
+		return PopWritePixels::AllocReadback( -1, TexturePtr, Meta, BackendType );
+	};
+	return SafeCall( Function, __func__, -1 );
+}
+
+__export int AllocCacheReadback(int CacheIndex)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		if ( Cache.mBlockFormat != TBlockFormat::None )
+			throw Soy::AssertException("Can't read back a compressed texture");
+		return PopWritePixels::AllocReadback( CacheIndex, nullptr, Cache.mTextureMeta, Cache.mBackendType );
+	};
+	return SafeCall( Function, __func__, -1 );
+}
+
+__export void ReleaseReadback(int Readback)
+{
+	auto Function = [&]()
+	{
+		PopWritePixels::ReleaseReadback( Readback );
+		return 0;
+	};
+	SafeCall( Function, __func__, 0 );
+}
+
+__export void SetReadRowsPerFrame(int Readback,int ReadRowsPerFrame)
+{
+	auto Function = [&]()
+	{
+		auto Job = PopWritePixels::GetReadback( Readback );
+		Job->mReadRowsPerFrame = std::max( 1, ReadRowsPerFrame );
+		return 0;
+	};
+	SafeCall( Function, __func__, 0 );
+}
+
+__export bool QueueReadPixels(int Readback,uint8_t* ByteData,int ByteDataSize)
+{
+	auto Function = [&]()
+	{
+		auto Job = PopWritePixels::GetReadback( Readback );
+		Job->Queue( ByteData, std::max( 0, ByteDataSize ) );
 		return true;
+	};
+	return SafeCall( Function, __func__, false );
+}
+
+__export int GetRowsRead(int Readback)
+{
+	auto Function = [&]()
+	{
+		auto Job = PopWritePixels::GetReadback( Readback );
+		return static_cast<int>( Job->GetRowsRead() );
+	};
+	return SafeCall( Function, __func__, -1 );
+}
+
+__export void* GetReadPixels(int Readback,int* ByteDataSize)
+{
+	auto Function = [&]()
+	{
+		auto Job = PopWritePixels::GetReadback( Readback );
+		size_t Size = 0;
+		auto* Bytes = Job->GetBytes( Size );
+		if ( ByteDataSize )
+			*ByteDataSize = static_cast<int>( Size );
+		return static_cast<void*>( Bytes );
+	};
+	return SafeCall( Function, __func__, static_cast<void*>(nullptr) );
+}
 
-	return false;
+__api(void) ReadPixelsToBuffer(int Readback)
+{
+	auto Function = [&]()
+	{
+		PopWritePixels::ReleasePendingCaches();
+		auto Job = PopWritePixels::GetReadback( Readback );
+		Job->Read();
+		return 0;
+	};
+	SafeCall( Function, __func__, 0 );
+}
+
+__export UnityRenderingEvent GetReadPixelsFunc()
+{
+	return ReadPixelsToBuffer;
 }
 
-void TCache::Release() 
+
+__export void SetFrameWriteBudget(int Microsecs,int Bytes)
 {
-	mTexturePtr = nullptr;	
-	mCreatingNewTexture = false; 
-	mAllocatedTexture.reset();
+	auto Function = [&]()
+	{
+		auto& Scheduler = PopWritePixels::GetScheduler();
+		Scheduler.mFrameBudget.mMicrosecs = std::max( 0, Microsecs );
+		Scheduler.mFrameBudget.mBytes = std::max( 0, Bytes );
+		return 0;
+	};
+	SafeCall( Function, __func__, -1 );
+}
 
-	//	verify logic
-	if ( Used() )
-		throw Soy::AssertException("Post Release cache is still marked as used");
+__export void SetCachePriority(int CacheIndex,int Priority)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		Cache.mPriority = Priority;
+		return 0;
+	};
+	SafeCall( Function, __func__, -1 );
 }
 
-size_t TCache::GetRowsWritten() const
+__export void SetCacheDeadline(int CacheIndex,int MicrosecsFromNow)
 {
-	//	waiting for data
-	if ( !mPendingBytes )
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		if ( MicrosecsFromNow < 0 )
+			Cache.mDeadline = 0;
+		else
+			Cache.mDeadline = PopWritePixels::GetMicrosecsNow() + MicrosecsFromNow;
 		return 0;
+	};
+	SafeCall( Function, __func__, -1 );
+}
+
+__export bool QueueWritePixels(int CacheIndex,uint8_t* ByteData, int ByteDataSize)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		//	a negative size would wrap to a huge size_t and pass CheckBytes
+		if ( !ByteData || ByteDataSize <= 0 )
+			throw Soy::AssertException("No bytes to write");
 
-	auto& Pending = *mPendingBytes;
-	return Pending.mRowsWritten;
+		std::shared_ptr<TPendingBytes> Pending( new TPendingBytes() );
+		Pending->mBytes = ByteData;
+		Pending->mBytesSize = ByteDataSize;
+		Cache.QueueBytes( Pending );
+		return true;
+	};
+	return SafeCall( Function, __func__, false );
 }
 
-bool TCache::HasFinished() const
+__export bool QueueWritePixelsRegion(int CacheIndex,uint8_t* ByteData,int ByteDataSize,int x,int y,int Width,int Height)
 {
-	auto RowsWritten = GetRowsWritten();
-	if ( RowsWritten < mTextureMeta.GetHeight() )
-		return false;
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		if ( x < 0 || y < 0 || Width <= 0 || Height <= 0 )
+			throw Soy::AssertException("Invalid write region");
+		if ( !ByteData || ByteDataSize <= 0 )
+			throw Soy::AssertException("No bytes to write");
 
-	return true;
+		std::shared_ptr<TPendingBytes> Pending( new TPendingBytes() );
+		Pending->mBytes = ByteData;
+		Pending->mBytesSize = ByteDataSize;
+		Pending->mRect = TTextureRect( x, y, Width, Height );
+		Cache.QueueBytes( Pending );
+		return true;
+	};
+	return SafeCall( Function, __func__, false );
 }
 
-void TCache::WritePixels()
+__export bool QueueWritePixelsConvert(int CacheIndex,uint8_t* ByteData,int ByteDataSize,int Conversion)
 {
-	if ( !mPendingBytes )
-		throw Soy::AssertException("No queued texture bytes");
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		//	read on a worker thread, so anything out of bounds has to be caught here
+		if ( !ByteData || ByteDataSize <= 0 )
+			throw Soy::AssertException("No bytes to convert");
+		if ( Cache.mBlockFormat != TBlockFormat::None )
+			throw Soy::AssertException("Cache texture is compressed, use QueueWritePixelsCompress");
+		auto ConversionType = static_cast<TPixelConversion::Type>( Conversion );
+		auto& Meta = Cache.mTextureMeta;
+		auto DstRowSize = Meta.GetRowDataSize();
+		auto SrcRowSize = PopWritePixels::GetConversionSourceRowSize( ConversionType, DstRowSize );
+		if ( static_cast<size_t>(ByteDataSize) < SrcRowSize * Meta.GetHeight() )
+			throw Soy::AssertException("Not enough bytes for conversion");
 
-	auto& Pending = *mPendingBytes;
-	SoyPixelsRemote Pixels(Pending.mBytes, Pending.mBytesSize, mTextureMeta);
+		//	convert into pooled memory
+		auto& Pool = PopWritePixels::GetPixelBufferPool();
+		uint8_t* DstData = nullptr;
+		auto DstHandle = Pool.Alloc( Meta.GetDataSize(), DstData );
+		auto DstBuffer = Pool.Submit( DstHandle );
 
+		//	bands big enough to be worth a job, small enough to start uploading early
+		static const size_t BandBytes = 256 * 1024;
+		auto BandRows = std::max<size_t>( 1, BandBytes / DstRowSize );
+		std::shared_ptr<TConvertRows> Converter( new TConvertRows( ConversionType, ByteData, DstBuffer, DstRowSize, Meta.GetHeight(), BandRows ) );
 
-#if defined(ENABLE_DIRECTX)
-	auto DirectxContext = Unity::GetDirectxContextPtr();
+		std::shared_ptr<TPendingBytes> Pending( new TPendingBytes() );
+		Pending->mBuffer = DstBuffer;
+		Pending->mBytes = DstBuffer->mData;
+		Pending->mBytesSize = Meta.GetDataSize();
+		Pending->mProducer = Converter;
+		Cache.QueueBytes( Pending );
+
+		Converter->Start( PopWritePixels::GetWorkerPool() );
+		return true;
+	};
+	return SafeCall( Function, __func__, false );
+}
 
-	if ( DirectxContext )
+__export bool QueueWritePixelsCompress(int CacheIndex,uint8_t* ByteData,int ByteDataSize,int Quality)
+{
+	auto Function = [&]()
 	{
-		//	create  a new texture if there isn't one
-		if ( !mTexturePtr && !mAllocatedTexture )
-		{
-			//auto TextureMode = Directx::TTextureMode::WriteOnly;
-			static auto TextureMode = Directx::TTextureMode::RenderTarget;
-			//auto TextureMode = Directx::TTextureMode::GpuOnly;
-			mAllocatedTexture.reset(new Directx::TTexture(mTextureMeta, *DirectxContext, TextureMode, mEnableMips ));
-		}
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		if ( Cache.mBlockFormat == TBlockFormat::None )
+			throw Soy::AssertException("Cache texture is not compressed");
+		if ( !ByteData || ByteDataSize <= 0 )
+			throw Soy::AssertException("No bytes to compress");
+		auto& Meta = Cache.mTextureMeta;
+		if ( static_cast<size_t>(ByteDataSize) < Meta.GetDataSize() )
+			throw Soy::AssertException("Not enough bytes to compress");
+		auto QualityType = static_cast<TCompressQuality::Type>( Quality );
 
-		auto RowFirst = mPendingBytes->mRowsWritten;
-		auto RowLast = std::min<size_t>(RowFirst + mWriteRowsPerFrame, mTextureMeta.GetHeight() );
-		auto RowCount = RowLast - RowFirst;
+		//	compress into pooled memory
+		auto BlocksSize = PopWritePixels::GetBlockDataSize( Cache.mBlockFormat, Meta.GetWidth(), Meta.GetHeight() );
+		auto& Pool = PopWritePixels::GetPixelBufferPool();
+		uint8_t* DstData = nullptr;
+		auto DstHandle = Pool.Alloc( BlocksSize, DstData );
+		auto DstBuffer = Pool.Submit( DstHandle );
 
-		if ( mAllocatedTexture )
-		{
-			mAllocatedTexture->Write(Pixels, *DirectxContext, RowFirst, RowCount );
-			
-			//	need a texture resource view for unity
-			auto& Device = DirectxContext->LockGetDevice();
-
-			//	only generate mip maps on last row
-			//	gr: we also generate on first, to produce the resource view early
-			bool GenerateMipMaps = false;
-			if ( RowLast == mTextureMeta.GetHeight() )
-				GenerateMipMaps = true;
-			if ( RowFirst == 0 )
-				GenerateMipMaps = true;
-			
-			if ( GenerateMipMaps )
-			{
-				auto& Resource = mAllocatedTexture->GetResourceView(Device);
-				auto& Context = DirectxContext->LockGetContext();
-				Context.GenerateMips(&Resource);
-				DirectxContext->Unlock();
-			}
-			DirectxContext->Unlock();
-		}
-		else
-		{
-			Directx::TTexture Texture(static_cast<ID3D11Texture2D*>(mTexturePtr));
-			Texture.Write(Pixels, *DirectxContext, RowFirst, RowCount);
-		}
-				
-		Pending.mRowsWritten = RowLast;
-		return ;
-	}
-#endif
+		//	bands of source big enough to be worth a job, small enough to start uploading early
+		static const size_t BandBytes = 256 * 1024;
+		auto BandBlockRows = std::max<size_t>( 1, BandBytes / (Meta.GetRowDataSize() * 4) );
+		std::shared_ptr<TCompressRows> Compressor( new TCompressRows( Cache.mBlockFormat, QualityType, ByteData, Meta, DstBuffer, BandBlockRows ) );
+
+		std::shared_ptr<TPendingBytes> Pending( new TPendingBytes() );
+		Pending->mBuffer = DstBuffer;
+		Pending->mBytes = DstBuffer->mData;
+		Pending->mBytesSize = BlocksSize;
+		Pending->mProducer = Compressor;
+		Cache.QueueBytes( Pending );
+
+		Compressor->Start( PopWritePixels::GetWorkerPool() );
+		return true;
+	};
+	return SafeCall( Function, __func__, false );
+}
 
-	throw Soy::AssertException("No device context");
+__export float BenchmarkBlockCompression(int BlockFormat,int Quality,int Width,int Height)
+{
+	auto Function = [&]()
+	{
+		auto Format = static_cast<TBlockFormat::Type>( BlockFormat );
+		auto QualityType = static_cast<TCompressQuality::Type>( Quality );
+		return PopWritePixels::BenchmarkBlockCompression( Format, QualityType, std::max( 0, Width ), std::max( 0, Height ) );
+	};
+	return SafeCall( Function, __func__, -1.0f );
 }
 
+__export void SetChangeDetection(int CacheIndex,bool Enable,int TileWidth)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		Cache.mDetectChanges = Enable;
+		Cache.mChangeTileWidth = std::max( 0, TileWidth );
+		return 0;
+	};
+	SafeCall( Function, __func__, -1 );
+}
+
+__export uint64_t GetBytesSkipped(int CacheIndex)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		return Cache.mBytesSkipped.load();
+	};
+	return SafeCall<uint64_t>( Function, __func__, 0 );
+}
+
+__export void SetContentDedupe(int CacheIndex,bool Enable)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		if ( Enable && Cache.mTexturePtr )
+			throw Soy::AssertException("Can't share a client texture");
+		if ( Enable && Cache.mStreamConfig )
+			throw Soy::AssertException("Can't deduplicate a stream");
+		Cache.mContentDedupe = Enable;
+		return 0;
+	};
+	SafeCall( Function, __func__, -1 );
+}
+
+__export bool GetDedupeStats(TDedupeStats* Stats)
+{
+	auto Function = [&]()
+	{
+		if ( !Stats )
+			throw Soy::AssertException("Dedupe stats pointer is null");
+		*Stats = PopWritePixels::GetTextureDedupe().GetStats();
+		return true;
+	};
+	return SafeCall( Function, __func__, false );
+}
+
+__export void SetMipMode(int CacheIndex,int MipMode)
+{
+	auto Function = [&]()
+	{
+		if ( MipMode != TMipMode::Gpu && MipMode != TMipMode::Cpu && MipMode != TMipMode::Progressive )
+			throw Soy::AssertException("Unknown mip mode");
+
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		Cache.mMipMode = static_cast<TMipMode::Type>( MipMode );
+		return 0;
+	};
+	SafeCall( Function, __func__, -1 );
+}
+
+__export int AllocPixelBuffer(int Size,void** Pointer)
+{
+	auto Function = [&]()
+	{
+		if ( !Pointer )
+			throw Soy::AssertException("Pointer for pixel buffer is null");
+		if ( Size <= 0 )
+			throw Soy::AssertException("Pixel buffer size must be positive");
+
+		auto& Pool = PopWritePixels::GetPixelBufferPool();
+		uint8_t* Data = nullptr;
+		auto Handle = Pool.Alloc( Size, Data );
+		*Pointer = Data;
+		return Handle;
+	};
+	return SafeCall( Function, __func__, -1 );
+}
+
+__export void FreePixelBuffer(int Handle)
+{
+	auto Function = [&]()
+	{
+		auto& Pool = PopWritePixels::GetPixelBufferPool();
+		Pool.Free( Handle );
+		return 0;
+	};
+	SafeCall( Function, __func__, 0 );
+}
+
+__export void TrimPixelBufferPool()
+{
+	auto Function = [&]()
+	{
+		auto& Pool = PopWritePixels::GetPixelBufferPool();
+		Pool.Trim();
+		return 0;
+	};
+	SafeCall( Function, __func__, 0 );
+}
+
+__export bool QueueWritePixelBuffer(int CacheIndex,int BufferHandle)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		auto& Pool = PopWritePixels::GetPixelBufferPool();
+
+		std::shared_ptr<TPendingBytes> Pending( new TPendingBytes() );
+		Pending->mBuffer = Pool.Submit( BufferHandle );
+		Pending->mBytes = Pending->mBuffer->mData;
+		Pending->mBytesSize = Pending->mBuffer->mSize;
+		Cache.QueueBytes( Pending );
+		return true;
+	};
+	return SafeCall( Function, __func__, false );
+}
+
+__export bool QueueWritePixelsFile(int CacheIndex,const char* Filename,uint64_t Offset,uint64_t Size)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		if ( !Filename )
+			throw Soy::AssertException("Filename is null");
+
+		std::shared_ptr<TMappedFile> File( new TMappedFile( Filename, Offset, Size ) );
+		std::shared_ptr<TPendingBytes> Pending( new TPendingBytes() );
+		Pending->mMappedFile = File;
+		Pending->mBytes = File->GetData();
+		Pending->mBytesSize = File->GetSize();
+		Cache.CheckBytes( *Pending );
+
+		//	start reading the first chunk now, so the first write doesn't wait on the disk
+		File->WillNeed( 0, Cache.GetWriteBytes( *Pending ) );
+		Cache.QueueBytes( Pending );
+		return true;
+	};
+	return SafeCall( Function, __func__, false );
+}
+
+__export bool QueueWritePixelsBaked(int CacheIndex,const char* Filename)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		if ( !Filename )
+			throw Soy::AssertException("Filename is null");
+
+		std::shared_ptr<TMappedFile> File( new TMappedFile( Filename, 0, 0 ) );
+		PopWritePixels::QueueBakedFile( Cache, File );
+		return true;
+	};
+	return SafeCall( Function, __func__, false );
+}
+
+void QueueDecode(TCache& Cache,const uint8_t* Data,size_t DataSize,std::shared_ptr<TMappedFile> File)
+{
+	if ( PopWritePixels::IsJpeg( Data, DataSize ) )
+		throw Soy::AssertException("Jpeg decoding isn't supported, only png");
+	if ( Cache.mBlockFormat != TBlockFormat::None )
+		throw Soy::AssertException("Can't decode into a compressed texture");
+
+	//	decode into pooled memory
+	auto& Meta = Cache.mTextureMeta;
+	auto& Pool = PopWritePixels::GetPixelBufferPool();
+	uint8_t* DstData = nullptr;
+	auto DstHandle = Pool.Alloc( Meta.GetDataSize(), DstData );
+	auto DstBuffer = Pool.Submit( DstHandle );
+	std::shared_ptr<TDecodePngRows> Decoder( new TDecodePngRows( Data, DataSize, File, Meta, DstBuffer ) );
+
+	std::shared_ptr<TPendingBytes> Pending( new TPendingBytes() );
+	Pending->mBuffer = DstBuffer;
+	Pending->mBytes = DstBuffer->mData;
+	Pending->mBytesSize = Meta.GetDataSize();
+	Pending->mProducer = Decoder;
+	Cache.QueueBytes( Pending );
+
+	Decoder->Start( PopWritePixels::GetWorkerPool() );
+}
+
+__export bool QueueWritePixelsDecode(int CacheIndex,uint8_t* ByteData,int ByteDataSize)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		if ( !ByteData || ByteDataSize <= 0 )
+			throw Soy::AssertException("No image data");
+		QueueDecode( Cache, ByteData, ByteDataSize, nullptr );
+		return true;
+	};
+	return SafeCall( Function, __func__, false );
+}
+
+__export bool QueueWritePixelsDecodeFile(int CacheIndex,const char* Filename)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		if ( !Filename )
+			throw Soy::AssertException("Filename is null");
+
+		std::shared_ptr<TMappedFile> File( new TMappedFile( Filename, 0, 0 ) );
+		QueueDecode( Cache, File->GetData(), File->GetSize(), File );
+		return true;
+	};
+	return SafeCall( Function, __func__, false );
+}
+
+__export void SetStreamMode(int CacheIndex,int RingSize,int QueueDepth)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		if ( RingSize <= 0 )
+		{
+			Cache.SetStreamMode( nullptr );
+			return 0;
+		}
+		//	with one texture, the front one would be written while it's sampled
+		if ( RingSize < 2 )
+			throw Soy::AssertException("Stream ring needs at least 2 textures");
+		//	the ring starts with the current texture, which may be shared
+		if ( Cache.mContentDedupe )
+			throw Soy::AssertException("Can't stream into a deduplicated cache");
+
+		//	the render thread puts the current texture at the front when it takes this up
+		std::shared_ptr<TFrameStream> Stream( new TFrameStream( RingSize, QueueDepth ) );
+		Cache.SetStreamMode( Stream );
+		return 0;
+	};
+	SafeCall( Function, __func__, -1 );
+}
+
+__export bool QueueStreamFrame(int CacheIndex,uint8_t* ByteData,int ByteDataSize,uint64_t TimestampMicrosecs)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		if ( !Cache.mStreamConfig )
+			throw Soy::AssertException("Cache is not in stream mode");
+		if ( !ByteData || ByteDataSize <= 0 )
+			throw Soy::AssertException("No bytes to write");
+
+		std::shared_ptr<TPendingBytes> Pending( new TPendingBytes() );
+		Pending->mBytes = ByteData;
+		Pending->mBytesSize = ByteDataSize;
+		Pending->mTimestamp = TimestampMicrosecs;
+		Cache.QueueBytes( Pending );
+		return true;
+	};
+	return SafeCall( Function, __func__, false );
+}
+
+__export bool QueueStreamFrameBuffer(int CacheIndex,int BufferHandle,uint64_t TimestampMicrosecs)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		if ( !Cache.mStreamConfig )
+			throw Soy::AssertException("Cache is not in stream mode");
+		auto& Pool = PopWritePixels::GetPixelBufferPool();
+
+		std::shared_ptr<TPendingBytes> Pending( new TPendingBytes() );
+		Pending->mBuffer = Pool.Submit( BufferHandle );
+		Pending->mBytes = Pending->mBuffer->mData;
+		Pending->mBytesSize = Pending->mBuffer->mSize;
+		Pending->mTimestamp = TimestampMicrosecs;
+		Cache.QueueBytes( Pending );
+		return true;
+	};
+	return SafeCall( Function, __func__, false );
+}
+
+__export bool GetStreamStats(int CacheIndex,TStreamStats* Stats)
+{
+	auto Function = [&]()
+	{
+		if ( !Stats )
+			throw Soy::AssertException("Stream stats pointer is null");
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		if ( !Cache.mStreamConfig )
+			throw Soy::AssertException("Cache is not in stream mode");
+		*Stats = Cache.mStreamConfig->GetStats();
+		return true;
+	};
+	return SafeCall( Function, __func__, false );
+}
+
+__export uint64_t GetPluginTimeMicrosecs()
+{
+	return PopWritePixels::GetMicrosecsNow();
+}
+
+__export bool QueueWritePixelsBatch(const TBatchWrite* Writes,int WriteCount)
+{
+	auto Function = [&]()
+	{
+		if ( !Writes || WriteCount < 0 )
+			throw Soy::AssertException("Invalid batch");
+
+		//	pooled buffers are the plugin's once passed in, even if the batch fails, so take them all first
+		auto& Pool = PopWritePixels::GetPixelBufferPool();
+		std::vector<std::shared_ptr<TPixelBuffer>> Buffers( WriteCount );
+		bool BadBuffer = false;
+		for ( int i=0;	i<WriteCount;	i++ )
+		{
+			if ( Writes[i].mBuffer < 0 )
+				continue;
+			try
+			{
+				Buffers[i] = Pool.Submit( Writes[i].mBuffer );
+			}
+			catch(std::exception&)
+			{
+				BadBuffer = true;
+			}
+		}
+		if ( BadBuffer )
+			throw Soy::AssertException("Invalid pixel buffer in batch");
+
+		//	check everything before queueing anything, so a bad record doesn't leave half a batch
+		std::vector<std::shared_ptr<TPendingBytes>> Pendings;
+		std::vector<TCache*> Caches;
+		std::vector<int> CacheHandles;
+		for ( int i=0;	i<WriteCount;	i++ )
+		{
+			auto& Write = Writes[i];
+			auto& Cache = PopWritePixels::GetCache( Write.mCache );
+			if ( Write.mX < 0 || Write.mY < 0 || Write.mWidth < 0 || Write.mHeight < 0 )
+				throw Soy::AssertException("Invalid write region");
+
+			std::shared_ptr<TPendingBytes> Pending( new TPendingBytes() );
+			if ( Buffers[i] )
+			{
+				Pending->mBuffer = Buffers[i];
+				Pending->mBytes = Pending->mBuffer->mData;
+				Pending->mBytesSize = Pending->mBuffer->mSize;
+			}
+			else
+			{
+				if ( !Write.mBytes || Write.mBytesSize <= 0 )
+					throw Soy::AssertException("Batch write has no bytes");
+				Pending->mBytes = Write.mBytes;
+				Pending->mBytesSize = Write.mBytesSize;
+			}
+			Pending->mRect = TTextureRect( Write.mX, Write.mY, Write.mWidth, Write.mHeight );
+			Cache.CheckBytes( *Pending );
+
+			Pendings.push_back( Pending );
+			Caches.push_back( &Cache );
+			CacheHandles.push_back( Write.mCache );
+		}
+
+		for ( size_t i=0;	i<Pendings.size();	i++ )
+		{
+			Caches[i]->mPriority = Writes[i].mPriority;
+			Caches[i]->QueueBytes( Pendings[i] );
+		}
+		PopWritePixels::GetWriteBatchQueue().Push( CacheHandles );
+		return true;
+	};
+	return SafeCall( Function, __func__, false );
+}
+
+__export int GetRowsWritten(int CacheIndex)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+
+		return Cache.GetRowsWritten();
+	};
+	return SafeCall( Function, __func__, -1 );
+}
+
+__export int DrainCompletions(TCompletion* Completions,int MaxCount)
+{
+	auto Function = [&]()
+	{
+		if ( !Completions || MaxCount < 0 )
+			throw Soy::AssertException("Invalid completions buffer");
+		auto& Queue = PopWritePixels::GetCompletionQueue();
+		return static_cast<int>( Queue.Drain( Completions, MaxCount ) );
+	};
+	return SafeCall( Function, __func__, -1 );
+}
+
+__export uint64_t GetCompletionsDropped()
+{
+	return PopWritePixels::GetCompletionQueue().GetDropped();
+}
+
+__export void SetTileChunking(int CacheIndex,int TileWidth,int TileHeight,int TileOrder)
+{
+	auto Function = [&]()
+	{
+		if ( TileOrder != TTileOrder::RowMajor && TileOrder != TTileOrder::Morton )
+			throw Soy::AssertException("Unknown tile order");
+
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		Cache.mTileWidth = std::max( 0, TileWidth );
+		Cache.mTileHeight = std::max( 0, TileHeight );
+		Cache.mTileOrder = static_cast<TTileOrder::Type>( TileOrder );
+		return 0;
+	};
+	SafeCall( Function, __func__, -1 );
+}
+
+__export void SetWriteTilesPerFrame(int CacheIndex,int WriteTilesPerFrame)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		Cache.mWriteTilesPerFrame = std::max( 1, WriteTilesPerFrame );
+		return 0;
+	};
+	SafeCall( Function, __func__, -1 );
+}
+
+__export int GetTilesWritten(int CacheIndex)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		return static_cast<int>( Cache.GetTilesWritten() );
+	};
+	return SafeCall( Function, __func__, -1 );
+}
+
+__export int GetTileCount(int CacheIndex)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		size_t TileWidth = Cache.mTileWidth;
+		size_t TileHeight = Cache.mTileHeight;
+		if ( TileWidth == 0 )
+			return 0;
+		if ( TileHeight == 0 )
+			TileHeight = TileWidth;
+
+		auto& Meta = Cache.mTextureMeta;
+		auto Columns = (Meta.GetWidth() + TileWidth - 1) / TileWidth;
+		auto Rows = (Meta.GetHeight() + TileHeight - 1) / TileHeight;
+		return static_cast<int>( Columns * Rows );
+	};
+	return SafeCall( Function, __func__, -1 );
+}
+
+__export int GetResidentMip(int CacheIndex)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		return Cache.GetResidentMip();
+	};
+	return SafeCall( Function, __func__, -2 );
+}
+
+__export void SetWriteRowsPerFrame(int CacheIndex,int WriteRowsPerFrame)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		
+		if ( WriteRowsPerFrame < 1 )
+			WriteRowsPerFrame = 1;
+		Cache.mWriteRowsPerFrame = WriteRowsPerFrame;
+		return 0;
+	};
+	SafeCall( Function, __func__, -1 );
+}
+
+__export void SetWriteBudget(int CacheIndex,int Microsecs,int Bytes)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		Cache.mWriteBudget.mMicrosecs = std::max( 0, Microsecs );
+		Cache.mWriteBudget.mBytes = std::max( 0, Bytes );
+		return 0;
+	};
+	SafeCall( Function, __func__, -1 );
+}
+
+__export void SetDefaultWriteBudget(int Microsecs,int Bytes)
+{
+	auto Function = [&]()
+	{
+		PopWritePixels::gDefaultWriteBudget.mMicrosecs = std::max( 0, Microsecs );
+		PopWritePixels::gDefaultWriteBudget.mBytes = std::max( 0, Bytes );
+		return 0;
+	};
+	SafeCall( Function, __func__, -1 );
+}
+
+__export float GetWriteBytesPerMicrosecond(int CacheIndex)
+{
+	auto Function = [&]()
+	{
+		//	negative for the rate across all caches
+		if ( CacheIndex < 0 )
+			return PopWritePixels::gWriteRate.GetBytesPerMicrosecond();
+
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		return Cache.mWriteRate.GetBytesPerMicrosecond();
+	};
+	return SafeCall( Function, __func__, -1.f );
+}
+
+
+__export void* GetCacheTexture(int CacheIndex)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		//	unity may be using it from here on
+		Cache.mTextureFetched = true;
+		Cache.mLastUsedTime = PopWritePixels::GetMicrosecsNow();
+		//	until the render thread has taken the stream up, the front is still the cache's texture
+		auto* Front = Cache.mStreamConfig ? Cache.mStreamConfig->mFrontTexture.load() : nullptr;
+		if ( Front )
+			return Front;
+
+		if ( Cache.mTexturePtr )
+			return Cache.mTexturePtr;
+
+		//	null until the render thread has created it
+		return Cache.mNativeTexture.load();
+	};
+	return SafeCall<void*>( Function, __func__, nullptr );
+}
+
+__export void SetMemoryBudget(uint64_t Bytes)
+{
+	auto Function = [&]()
+	{
+		PopWritePixels::GetMemoryBudget().mBudgetBytes = Bytes;
+		return 0;
+	};
+	SafeCall( Function, __func__, -1 );
+}
+
+__export bool GetMemoryUsage(TMemoryUsage* Usage)
+{
+	auto Function = [&]()
+	{
+		if ( !Usage )
+			throw Soy::AssertException("Memory usage pointer is null");
+		*Usage = PopWritePixels::GetMemoryBudget().GetUsage();
+		return true;
+	};
+	return SafeCall( Function, __func__, false );
+}
+
+__export uint64_t GetCacheMemoryBytes(int CacheIndex)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		return Cache.mMemoryBytes.load();
+	};
+	return SafeCall<uint64_t>( Function, __func__, 0 );
+}
+
+__export void SetCacheEvictable(int CacheIndex,bool Evictable)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		Cache.mEvictable = Evictable;
+		return 0;
+	};
+	SafeCall( Function, __func__, -1 );
+}
+
+__export bool IsCacheEvicted(int CacheIndex)
+{
+	auto Function = [&]()
+	{
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		return Cache.mEvicted.load();
+	};
+	return SafeCall( Function, __func__, false );
+}
+
+__export void SetLogLevel(int LogLevel)
+{
+	PopWritePixels::gLogLevel = std::max<int>( TLogLevel::None, std::min<int>( TLogLevel::Calls, LogLevel ) );
+}
+
+__export bool GetCacheStats(int CacheIndex,TCacheStats* Stats)
+{
+	auto Function = [&]()
+	{
+		if ( !Stats )
+			throw Soy::AssertException("Cache stats pointer is null");
+		auto& Cache = PopWritePixels::GetCache(CacheIndex);
+		*Stats = Cache.mTelemetry.GetCacheStats();
+		Stats->mBytesSkipped = Cache.mBytesSkipped.load();
+		Stats->mFenceWaits = Cache.mFenceWaits.load();
+		return true;
+	};
+	return SafeCall( Function, __func__, false );
+}
+
+__export bool GetPluginStats(TPluginStats* Stats)
+{
+	auto Function = [&]()
+	{
+		if ( !Stats )
+			throw Soy::AssertException("Plugin stats pointer is null");
+		*Stats = PopWritePixels::GetPluginTelemetry().GetPluginStats();
+		Stats->mCachesAllocated = PopWritePixels::gCaches.GetAllocatedCount();
+		return true;
+	};
+	return SafeCall( Function, __func__, false );
+}
+
+__export int GetPluginHistogram(int Metric,uint64_t* Buckets,int BucketCount)
+{
+	auto Function = [&]()
+	{
+		if ( !Buckets || BucketCount < 0 )
+			throw Soy::AssertException("Invalid histogram buckets");
+		auto& Histogram = PopWritePixels::GetPluginTelemetry().GetHistogram( static_cast<TTelemetryMetric::Type>( Metric ) );
+		return static_cast<int>( Histogram.GetBuckets( Buckets, BucketCount ) );
+	};
+	return SafeCall( Function, __func__, -1 );
+}
+
+__export void ResetPluginStats()
+{
+	auto Function = [&]()
+	{
+		PopWritePixels::GetPluginTelemetry().Reset();
+		PopWritePixels::GetMemoryBudget().ResetHighWater();
+		return 0;
+	};
+	SafeCall( Function, __func__, -1 );
+}
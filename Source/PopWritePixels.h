@@ -3,6 +3,15 @@
 #include "PopUnity.h"
 #include <functional>
 
+struct TAtlasStats;
+struct TCacheStats;
+struct TPluginStats;
+struct TBatchWrite;
+struct TStreamStats;
+struct TDedupeStats;
+struct TCompletion;
+struct TMemoryUsage;
+
 
 //	alloc a cache/job to write to an existing texture
 __export int		AllocCacheTexture2D(void* TexturePtr, int Width, int Height,Unity::Texture2DPixelFormat::Type PixelFormat);
@@ -10,21 +19,223 @@ __export int		AllocCacheTexture2D(void* TexturePtr, int Width, int Height,Unity:
 //	alloc a new texture	
 __export int		AllocCacheTexture(int Width, int Height,Unity::Texture2DPixelFormat::Type PixelFormat,bool EnableMips);
 
-//	cleanup
+//	alloc a new texture with a specific backend (see TTextureBackendType). Software works without a graphics device
+__export int		AllocCacheTextureWithBackend(int Width, int Height,Unity::Texture2DPixelFormat::Type PixelFormat,bool EnableMips,int Backend);
+
+//	cleanup. The handle is invalid straight away; the cache is reset (and its texture freed) by the next render event
 __export void		ReleaseCache(int Cache);
 
 //	set which pixels to write on next update
 __export bool		QueueWritePixels(int Cache,uint8_t* ByteData, int ByteDataSize);
 
+//	write only part of the texture. ByteData is just the region's pixels, tightly packed.
+//	rows outside the region count as written, so the job finishes at the texture's height as usual
+__export bool		QueueWritePixelsRegion(int Cache,uint8_t* ByteData,int ByteDataSize,int x,int y,int Width,int Height);
+
+//	convert the bytes into the texture's format (see TPixelConversion) on worker threads before writing.
+//	ByteData must stay valid until the job has finished
+__export bool		QueueWritePixelsConvert(int Cache,uint8_t* ByteData,int ByteDataSize,int Conversion);
+
+//	BlockFormat is a TBlockFormat. TexturePtr must have been created in that format, or null for a headless software texture.
+//	QueueWritePixels on these caches takes already compressed blocks
+__export int		AllocCacheTextureCompressed(void* TexturePtr,int Width,int Height,int BlockFormat);
+
+//	compress RGBA32 bytes into the cache's block format on worker threads (see TCompressQuality), uploading
+//	rows of blocks as they finish. ByteData must stay valid until the job has finished
+__export bool		QueueWritePixelsCompress(int Cache,uint8_t* ByteData,int ByteDataSize,int Quality);
+
+//	single-thread encode rate, in megapixels per second, of a synthetic Width x Height image. -1 on error
+__export float		BenchmarkBlockCompression(int BlockFormat,int Quality,int Width,int Height);
+
+//	hash incoming rows (in tiles TileWidth wide, 0 for whole rows) against the previous submission
+//	and only write what changed. Whole-texture submissions only
+__export void		SetChangeDetection(int Cache,bool Enable,int TileWidth);
+
+//	bytes not written because change detection found them unchanged
+__export uint64_t	GetBytesSkipped(int Cache);
+
+//	hash whole-texture submissions on a worker thread, and if another cache (with this enabled) already has, or
+//	is writing, identical pixels in the same meta, share its texture instead of uploading. The texture lives while
+//	any cache uses it; a cache given different pixels gets its own again. Not for client textures or stream mode
+__export void		SetContentDedupe(int Cache,bool Enable);
+__export bool		GetDedupeStats(TDedupeStats* Stats);
+
+//	see TMipMode. Cpu builds each band's mip rows as it's written instead of regenerating the whole chain.
+//	Progressive writes the mips smallest first (so there's a blurry, complete texture within a frame or two) then level 0
+__export void		SetMipMode(int Cache,int MipMode);
+
+//	lease an aligned buffer from the plugin's pool for the client to fill. returns handle, or -1 on error
+__export int		AllocPixelBuffer(int Size,void** Pointer);
+
+//	return a leased buffer which was never queued
+__export void		FreePixelBuffer(int BufferHandle);
+
+//	queue a leased buffer. The handle is no longer valid; the buffer returns to the pool once all its rows are written
+__export bool		QueueWritePixelBuffer(int Cache,int BufferHandle);
+
+//	write straight from a file (raw pixels, or blocks for compressed caches) starting at Offset. Size 0 = to the end.
+//	The file is mapped rather than read, and stays mapped until the write finishes
+__export bool		QueueWritePixelsFile(int Cache,const char* Filename,uint64_t Offset,uint64_t Size);
+//	write a container made by the baker (see TBakedTexture.h, PopWritePixels.Baker). Rows, mips & blocks are already
+//	in the texture's layout, so they go from the mapping to the texture with no conversion or mip generation
+__export bool		QueueWritePixelsBaked(int Cache,const char* Filename);
+
+//	decode a png (size must match the texture) on a worker thread, writing rows as they're decoded so
+//	the upload overlaps the decode. GetRowsWritten is then decode & upload progress. The data is copied
+__export bool		QueueWritePixelsDecode(int Cache,uint8_t* ByteData,int ByteDataSize);
+//	as above, decoding straight from a mapped file
+__export bool		QueueWritePixelsDecodeFile(int Cache,const char* Filename);
+
+//	stream mode, for video & camera feeds. Frames queue (up to QueueDepth, older ones dropped) and each write
+//	event presents the newest complete one, written whole into the next of RingSize textures so the texture
+//	being sampled is never written. GetCacheTexture then returns the front texture, which changes. RingSize 0 = off,
+//	otherwise it must be at least 2.
+//	A client texture (AllocCacheTexture2D) can't be ringed, so is written in place
+__export void		SetStreamMode(int Cache,int RingSize,int QueueDepth);
+//	TimestampMicrosecs is when the frame was captured, in GetPluginTimeMicrosecs() time. 0 = now
+__export bool		QueueStreamFrame(int Cache,uint8_t* ByteData,int ByteDataSize,uint64_t TimestampMicrosecs);
+//	pooled buffers go back to the pool as soon as their frame is written or dropped
+__export bool		QueueStreamFrameBuffer(int Cache,int BufferHandle,uint64_t TimestampMicrosecs);
+__export bool		GetStreamStats(int Cache,TStreamStats* Stats);
+__export uint64_t	GetPluginTimeMicrosecs();
+
+//	queue writes to many caches in one call (see TBatchWrite). All are checked before any are queued;
+//	pooled buffers in the batch belong to the plugin either way.
+//	one GetWriteBatchFunc() event a frame then writes them all, highest priority first, until they finish
+__export bool		QueueWritePixelsBatch(const TBatchWrite* Writes,int WriteCount);
+
+//	free pooled buffers not currently in use
+__export void		TrimPixelBufferPool();
+
 __export void		SetWriteRowsPerFrame(int Cache,int WriteRowsPerFrame);
 
+//	limit each frame's write by time and/or bytes instead of a fixed row count. 0,0 goes back to rows per frame
+//	the row count is resized every frame from the measured write rate
+__export void		SetWriteBudget(int Cache,int Microsecs,int Bytes);
+
+//	budget given to newly allocated caches
+__export void		SetDefaultWriteBudget(int Microsecs,int Bytes);
+
+//	measured write speed of a cache, or of all caches if Cache is negative
+__export float		GetWriteBytesPerMicrosecond(int Cache);
+
 //	how many rows written. negative numbers on error
 __export int		GetRowsWritten(int Cache);
 
+//	every write that finished (or failed) since the last drain, oldest first, instead of polling GetRowsWritten
+//	per job. Call once a frame; returns how many were copied (up to MaxCount, the rest wait), -1 on error.
+//	If not drained the queue fills and further completions are dropped and counted
+__export int		DrainCompletions(TCompletion* Completions,int MaxCount);
+__export uint64_t	GetCompletionsDropped();
+
+//	write in TileWidth x TileHeight tiles (see TTileOrder) instead of rows. TileWidth 0 goes back to rows,
+//	TileHeight 0 makes square tiles. Takes effect from the next submission
+__export void		SetTileChunking(int Cache,int TileWidth,int TileHeight,int TileOrder);
+__export void		SetWriteTilesPerFrame(int Cache,int WriteTilesPerFrame);
+
+//	tile progress of the last submission when tiled, and how many tiles a whole-texture write has. negative on error
+__export int		GetTilesWritten(int Cache);
+__export int		GetTileCount(int Cache);
+
+//	finest mip level of the last submission that's completely written (sampling is clamped to it while
+//	progressive mips stream in), 0 once finished, -1 if nothing's usable yet. -2 on error
+__export int		GetResidentMip(int Cache);
+
 //	if we allocated a texture, this is it (also returns the original texture if we provided one)
 __export void*		GetCacheTexture(int Cache);
 
+//	limit on textures (with mips) & gpu staging the plugin allocates, across all caches. 0 = no limit.
+//	A cache about to create a texture over the limit evicts idle caches, least recently used first, or waits a frame.
+//	Idle is finished, not a client texture, not shared, and either never fetched with GetCacheTexture or marked evictable
+__export void		SetMemoryBudget(uint64_t Bytes);
+__export bool		GetMemoryUsage(TMemoryUsage* Usage);
+__export uint64_t	GetCacheMemoryBytes(int Cache);
+
+//	the client isn't using this cache's texture (eg. it's off screen), so the budget may free it
+__export void		SetCacheEvictable(int Cache,bool Evictable);
+
+//	the texture was freed for the budget. GetCacheTexture is null and progress reads 0 until bytes are queued again
+__export bool		IsCacheEvicted(int Cache);
+
 //	get the "run a job on render thread"
 __export UnityRenderingEvent GetWritePixelsToCacheFunc();
 
+//	get the render event which writes every cache with pending pixels, in priority order,
+//	under the frame budget. Issue this once per frame instead of one event per cache
+__export UnityRenderingEvent GetWriteAllPendingCachesFunc();
+
+//	total budget shared by all caches in WriteAllPendingCaches. 0,0 for no limit
+__export void		SetFrameWriteBudget(int Microsecs,int Bytes);
+
+//	higher priorities are written first
+__export void		SetCachePriority(int Cache,int Priority);
+
+//	caches with deadlines are written before others, earliest first. negative to clear
+__export void		SetCacheDeadline(int Cache,int MicrosecsFromNow);
+
+
+
+//	pack many small images into a few PageWidth x PageHeight textures (see TTextureBackendType for Backend).
+//	Padding is texels left between images. returns atlas handle, -1 on error
+__export int		AllocAtlas(int PageWidth,int PageHeight,Unity::Texture2DPixelFormat::Type PixelFormat,int MaxPages,int Padding,int Backend);
+__export void		ReleaseAtlas(int Atlas);
+
+//	copy an image (tightly packed, page format) into the atlas. Outputs the page it went in and its uv x,y,width,height
+//	in texture row order. Written with the page's other new images on the next atlas event. returns image handle, -1 on error
+__export int		AtlasAddImage(int Atlas,uint8_t* ByteData,int ByteDataSize,int Width,int Height,int* Page,float* UvRect);
+
+//	the image's space can be reused
+__export void		AtlasFreeImage(int Atlas,int Image);
+
+__export int		GetAtlasPageCount(int Atlas);
+
+//	null until the page has been written once
+__export void*		GetAtlasPageTexture(int Atlas,int Page);
+
+__export bool		GetAtlasStats(int Atlas,TAtlasStats* Stats);
+
+//	render event which writes every atlas page's new images in one write per page. WriteAllPendingCaches does this too
+__export UnityRenderingEvent GetWriteAtlasesFunc();
+
+//	writes caches queued with QueueWritePixelsBatch. Not needed with GetWriteAllPendingCachesFunc, which writes everything
+__export UnityRenderingEvent GetWriteBatchFunc();
+
+
+
+//	copy a texture back to the cpu a few rows a frame without stalling (see TReadback). Reads the client's native
+//	texture (see TTextureBackendType for Backend), returns readback handle, -1 on error
+__export int		AllocReadback(void* TexturePtr,int Width,int Height,Unity::Texture2DPixelFormat::Type PixelFormat,int Backend);
+//	as above, reading whatever texture the cache currently has. Works with the software backend, for headless testing
+__export int		AllocCacheReadback(int Cache);
+__export void		ReleaseReadback(int Readback);
+
+//	rows copied each readback event, which is also the size of each staging slot
+__export void		SetReadRowsPerFrame(int Readback,int ReadRowsPerFrame);
+
+//	start reading the whole texture into ByteData, which must stay valid until GetRowsRead reaches the height (or
+//	the next queue). ByteData null reads into a pooled buffer instead, see GetReadPixels
+__export bool		QueueReadPixels(int Readback,uint8_t* ByteData,int ByteDataSize);
+
+//	rows of the last queued read that have landed, from the top. negative numbers on error,
+//	including once a cache readback's cache has been released
+__export int		GetRowsRead(int Readback);
+
+//	where the last queued read is going, valid until the next queue or release
+__export void*		GetReadPixels(int Readback,int* ByteDataSize);
+
+//	render event which lands finished copies & issues the next, one per readback per frame
+__export UnityRenderingEvent GetReadPixelsFunc();
+
+//	see TLogLevel. Defaults to errors only; Calls logs every export with its duration
+__export void		SetLogLevel(int LogLevel);
+
+//	counters & latency summaries (microsecs) for one cache since it was allocated
+__export bool		GetCacheStats(int Cache,TCacheStats* Stats);
+
+//	counters & latency summaries across all caches since the last reset
+__export bool		GetPluginStats(TPluginStats* Stats);
+
+//	raw log2 buckets of a TTelemetryMetric; bucket 0 is 0, bucket n counts [2^(n-1),2^n). returns buckets copied, -1 on error
+__export int		GetPluginHistogram(int Metric,uint64_t* Buckets,int BucketCount);
 
+__export void		ResetPluginStats();
@@ -0,0 +1,338 @@
+#include "TAtlas.h"
+#include "TCache.h"
+#include <SoyTypes.h>
+#include <algorithm>
+#include <cstring>
+
+
+namespace PopWritePixels
+{
+	//	a shelf is only used for images at least this fraction of its height, so short images don't waste tall shelves
+	const size_t	ShelfWasteDivisor = 2;
+
+	std::mutex								gAtlasLock;
+	std::map<int,std::shared_ptr<TAtlas>>	gAtlases;
+	int										gNextAtlas = 1;
+}
+
+
+bool TShelfPacker::Alloc(size_t Width,size_t Height,size_t& x,size_t& y,size_t& ShelfIndex)
+{
+	if ( Width == 0 || Height == 0 || Width > mWidth || Height > mHeight )
+		return false;
+
+	//	best fitting shelf by height, which has a span wide enough
+	size_t BestShelf = mShelves.size();
+	size_t BestSpan = 0;
+	for ( size_t s=0;	s<mShelves.size();	s++ )
+	{
+		auto& Shelf = mShelves[s];
+		if ( Shelf.mHeight < Height )
+			continue;
+		//	empty shelves take anything that fits
+		if ( Shelf.mImageCount > 0 && Shelf.mHeight - Height > Shelf.mHeight / PopWritePixels::ShelfWasteDivisor )
+			continue;
+		if ( BestShelf < mShelves.size() && mShelves[BestShelf].mHeight <= Shelf.mHeight )
+			continue;
+
+		for ( size_t f=0;	f<Shelf.mFree.size();	f++ )
+		{
+			if ( Shelf.mFree[f].mWidth < Width )
+				continue;
+			BestShelf = s;
+			BestSpan = f;
+			break;
+		}
+	}
+
+	//	open a new shelf
+	if ( BestShelf == mShelves.size() )
+	{
+		if ( mNextShelfY + Height > mHeight )
+			return false;
+
+		TShelf Shelf;
+		Shelf.mY = mNextShelfY;
+		Shelf.mHeight = Height;
+		Shelf.mFree.push_back( TSpan{ 0, mWidth } );
+		mShelves.push_back( Shelf );
+		mNextShelfY += Height;
+		BestSpan = 0;
+	}
+
+	auto& Shelf = mShelves[BestShelf];
+	auto& Span = Shelf.mFree[BestSpan];
+	x = Span.mX;
+	y = Shelf.mY;
+	ShelfIndex = BestShelf;
+
+	Span.mX += Width;
+	Span.mWidth -= Width;
+	if ( Span.mWidth == 0 )
+		Shelf.mFree.erase( Shelf.mFree.begin() + BestSpan );
+
+	//	the span is taken for the whole shelf height
+	Shelf.mImageCount++;
+	mUsedPixels += Width * Shelf.mHeight;
+	return true;
+}
+
+void TShelfPacker::Free(size_t ShelfIndex,size_t x,size_t Width)
+{
+	if ( ShelfIndex >= mShelves.size() )
+		throw Soy::AssertException("Atlas shelf out of range");
+
+	auto& Shelf = mShelves[ShelfIndex];
+	auto& FreeSpans = Shelf.mFree;
+	auto Compare = [](const TSpan& a,const TSpan& b)	{	return a.mX < b.mX;	};
+	auto It = FreeSpans.insert( std::lower_bound( FreeSpans.begin(), FreeSpans.end(), TSpan{ x, Width }, Compare ), TSpan{ x, Width } );
+
+	//	merge with the next, then the previous
+	auto Next = It + 1;
+	if ( Next != FreeSpans.end() && It->mX + It->mWidth == Next->mX )
+	{
+		It->mWidth += Next->mWidth;
+		FreeSpans.erase( Next );
+	}
+	if ( It != FreeSpans.begin() )
+	{
+		auto Prev = It - 1;
+		if ( Prev->mX + Prev->mWidth == It->mX )
+		{
+			Prev->mWidth += It->mWidth;
+			FreeSpans.erase( It );
+		}
+	}
+
+	mUsedPixels -= Width * Shelf.mHeight;
+	Shelf.mImageCount--;
+
+	//	give empty shelves at the bottom back to the page
+	while ( !mShelves.empty() && mShelves.back().mImageCount == 0 )
+	{
+		mNextShelfY = mShelves.back().mY;
+		mShelves.pop_back();
+	}
+}
+
+uint64_t TShelfPacker::GetStats(TAtlasStats& Stats) const
+{
+	uint64_t PageArea = static_cast<uint64_t>(mWidth) * mHeight;
+	uint64_t Largest = static_cast<uint64_t>(mWidth) * (mHeight - mNextShelfY);
+	for ( auto& Shelf : mShelves )
+		for ( auto& Span : Shelf.mFree )
+			Largest = std::max<uint64_t>( Largest, static_cast<uint64_t>(Span.mWidth) * Shelf.mHeight );
+
+	Stats.mUsedPixels += mUsedPixels;
+	Stats.mFreePixels += PageArea - mUsedPixels;
+	Stats.mLargestFreePixels = std::max( Stats.mLargestFreePixels, Largest );
+	return Largest;
+}
+
+
+TAtlasPage::TAtlasPage(const SoyPixelsMeta& Meta) :
+	mPacker	( Meta.GetWidth(), Meta.GetHeight() ),
+	mPixels	( Meta.GetDataSize(), 0 )
+{
+}
+
+void TAtlasPage::AddDirty(const TTextureRect& Rect)
+{
+	if ( !IsDirty() )
+	{
+		mDirty = Rect;
+		return;
+	}
+
+	auto Right = std::max( mDirty.mX + mDirty.mWidth, Rect.mX + Rect.mWidth );
+	auto Bottom = std::max( mDirty.mY + mDirty.mHeight, Rect.mY + Rect.mHeight );
+	mDirty.mX = std::min( mDirty.mX, Rect.mX );
+	mDirty.mY = std::min( mDirty.mY, Rect.mY );
+	mDirty.mWidth = Right - mDirty.mX;
+	mDirty.mHeight = Bottom - mDirty.mY;
+}
+
+
+TAtlas::TAtlas(const SoyPixelsMeta& PageMeta,size_t MaxPages,size_t Padding,TTextureBackendType::Type BackendType) :
+	mPageMeta		( PageMeta ),
+	mMaxPages		( std::max<size_t>( 1, MaxPages ) ),
+	mPadding		( Padding ),
+	mBackendType	( BackendType )
+{
+	if ( mPageMeta.GetWidth() == 0 || mPageMeta.GetHeight() == 0 )
+		throw Soy::AssertException("Atlas page size is empty");
+}
+
+int TAtlas::AddImage(const uint8_t* Bytes,size_t BytesSize,size_t Width,size_t Height,size_t& PageIndex,TTextureRect& Rect)
+{
+	auto PixelSize = mPageMeta.GetChannels();
+	auto RowSize = Width * PixelSize;
+	if ( !Bytes )
+		throw Soy::AssertException("Atlas image bytes are null");
+	if ( BytesSize < RowSize * Height )
+		throw Soy::AssertException("Not enough bytes for atlas image");
+
+	std::lock_guard<std::mutex> Lock( mLock );
+
+	auto PaddedWidth = Width + mPadding;
+	auto PaddedHeight = Height + mPadding;
+	size_t x = 0;
+	size_t y = 0;
+	size_t Shelf = 0;
+	PageIndex = mPages.size();
+	for ( size_t p=0;	p<mPages.size();	p++ )
+	{
+		if ( !mPages[p]->mPacker.Alloc( PaddedWidth, PaddedHeight, x, y, Shelf ) )
+			continue;
+		PageIndex = p;
+		break;
+	}
+
+	if ( PageIndex == mPages.size() )
+	{
+		if ( mPages.size() >= mMaxPages )
+			throw Soy::AssertException("Atlas is full");
+
+		std::unique_ptr<TAtlasPage> Page( new TAtlasPage( mPageMeta ) );
+		if ( !Page->mPacker.Alloc( PaddedWidth, PaddedHeight, x, y, Shelf ) )
+			throw Soy::AssertException("Image too big for atlas page");
+		mPages.push_back( std::move(Page) );
+	}
+
+	auto& Page = *mPages[PageIndex];
+	Rect = TTextureRect( x, y, Width, Height );
+
+	auto PageRowSize = mPageMeta.GetRowDataSize();
+	for ( size_t r=0;	r<Height;	r++ )
+		memcpy( Page.mPixels.data() + ((y+r) * PageRowSize) + (x * PixelSize), Bytes + (r * RowSize), RowSize );
+	Page.AddDirty( Rect );
+
+	TAtlasImage Image;
+	Image.mPage = PageIndex;
+	Image.mShelf = Shelf;
+	Image.mRect = Rect;
+	Image.mPaddedWidth = PaddedWidth;
+
+	auto Handle = mNextImage++;
+	mImages[Handle] = Image;
+	return Handle;
+}
+
+void TAtlas::FreeImage(int ImageHandle)
+{
+	std::lock_guard<std::mutex> Lock( mLock );
+	auto It = mImages.find( ImageHandle );
+	if ( It == mImages.end() )
+		throw Soy::AssertException("Invalid atlas image handle");
+
+	//	the old pixels stay in the texture until overwritten, nothing to upload
+	auto& Image = It->second;
+	mPages[Image.mPage]->mPacker.Free( Image.mShelf, Image.mRect.mX, Image.mPaddedWidth );
+	mImages.erase( It );
+}
+
+void* TAtlas::GetPageTexture(size_t PageIndex)
+{
+	std::lock_guard<std::mutex> Lock( mLock );
+	if ( PageIndex >= mPages.size() )
+		throw Soy::AssertException("Atlas page out of range");
+
+	auto& Texture = mPages[PageIndex]->mTexture;
+	if ( !Texture )
+		return nullptr;
+	return Texture->GetNativeTexture();
+}
+
+size_t TAtlas::GetPageCount()
+{
+	std::lock_guard<std::mutex> Lock( mLock );
+	return mPages.size();
+}
+
+TAtlasStats TAtlas::GetStats()
+{
+	std::lock_guard<std::mutex> Lock( mLock );
+	TAtlasStats Stats;
+	Stats.mPageCount = static_cast<int32_t>( mPages.size() );
+	Stats.mImageCount = static_cast<int32_t>( mImages.size() );
+	//	per page, as images can't span pages anyway
+	uint64_t LargestPerPage = 0;
+	for ( auto& Page : mPages )
+		LargestPerPage += Page->mPacker.GetStats( Stats );
+
+	if ( Stats.mFreePixels > 0 )
+		Stats.mFragmentation = 1.0f - ( LargestPerPage / static_cast<float>(Stats.mFreePixels) );
+	return Stats;
+}
+
+size_t TAtlas::WritePages()
+{
+	//	gr: the client adding images waits for this, but it's one write per page
+	std::lock_guard<std::mutex> Lock( mLock );
+	size_t BytesWritten = 0;
+	auto PixelSize = mPageMeta.GetChannels();
+	auto PageRowSize = mPageMeta.GetRowDataSize();
+
+	for ( auto& pPage : mPages )
+	{
+		auto& Page = *pPage;
+		if ( !Page.IsDirty() )
+			continue;
+
+		if ( !Page.mTexture )
+			Page.mTexture = PopWritePixels::AllocTextureBackend( mBackendType, nullptr, mPageMeta, false );
+
+		auto& Dirty = Page.mDirty;
+		auto* Bytes = Page.mPixels.data() + (Dirty.mY * PageRowSize) + (Dirty.mX * PixelSize);
+		Page.mTexture->WriteRect( Bytes, PageRowSize, Dirty, 0 );
+		BytesWritten += Dirty.mWidth * Dirty.mHeight * PixelSize;
+		Dirty = TTextureRect();
+	}
+	return BytesWritten;
+}
+
+
+int PopWritePixels::AllocAtlas(const SoyPixelsMeta& PageMeta,size_t MaxPages,size_t Padding,TTextureBackendType::Type BackendType)
+{
+	std::shared_ptr<TAtlas> Atlas( new TAtlas( PageMeta, MaxPages, Padding, BackendType ) );
+	std::lock_guard<std::mutex> Lock( gAtlasLock );
+	auto AtlasIndex = gNextAtlas++;
+	gAtlases[AtlasIndex] = Atlas;
+	return AtlasIndex;
+}
+
+std::shared_ptr<TAtlas> PopWritePixels::GetAtlas(int AtlasIndex)
+{
+	std::lock_guard<std::mutex> Lock( gAtlasLock );
+	auto It = gAtlases.find( AtlasIndex );
+	if ( It == gAtlases.end() )
+		throw Soy::AssertException("Invalid atlas index");
+	return It->second;
+}
+
+void PopWritePixels::ReleaseAtlas(int AtlasIndex)
+{
+	std::lock_guard<std::mutex> Lock( gAtlasLock );
+	if ( gAtlases.erase( AtlasIndex ) == 0 )
+		throw Soy::AssertException("Invalid atlas index");
+}
+
+size_t PopWritePixels::WriteAtlases()
+{
+	//	copy so we're not holding the global lock while writing
+	std::vector<std::shared_ptr<TAtlas>> Atlases;
+	{
+		std::lock_guard<std::mutex> Lock( gAtlasLock );
+		for ( auto& Atlas : gAtlases )
+			Atlases.push_back( Atlas.second );
+	}
+
+	size_t BytesWritten = 0;
+	auto WriteStart = GetMicrosecsNow();
+	for ( auto& Atlas : Atlases )
+		BytesWritten += Atlas->WritePages();
+
+	if ( BytesWritten > 0 )
+		gWriteRate.Add( BytesWritten, GetMicrosecsNow() - WriteStart );
+	return BytesWritten;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "TTextureBackend.h"
+#include <SoyPixels.h>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <vector>
+
+
+//	gr: matching layout in c#
+struct TAtlasStats
+{
+	int32_t		mPageCount = 0;
+	int32_t		mImageCount = 0;
+	uint64_t	mUsedPixels = 0;		//	including padding & shelf space above shorter images
+	uint64_t	mFreePixels = 0;		//	in allocated pages
+	uint64_t	mLargestFreePixels = 0;	//	biggest single rect we could still fit
+	float		mFragmentation = 0;		//	1 - largest/free per page. 0 when each page's free space is one rect
+};
+
+
+//	shelf packer. Rows (shelves) are opened at the bottom as needed, images go into the
+//	shelf closest to their height. Freed spans merge with their neighbours and are reused,
+//	and empty shelves at the bottom are given back
+class TShelfPacker
+{
+public:
+	class TSpan
+	{
+	public:
+		size_t	mX;
+		size_t	mWidth;
+	};
+
+	class TShelf
+	{
+	public:
+		size_t				mY = 0;
+		size_t				mHeight = 0;
+		size_t				mImageCount = 0;
+		std::vector<TSpan>	mFree;			//	sorted by x
+	};
+
+public:
+	TShelfPacker(size_t Width,size_t Height) :
+		mWidth	( Width ),
+		mHeight	( Height )
+	{
+	}
+
+	//	false if it doesn't fit
+	bool			Alloc(size_t Width,size_t Height,size_t& x,size_t& y,size_t& Shelf);
+	void			Free(size_t Shelf,size_t x,size_t Width);
+	uint64_t		GetStats(TAtlasStats& Stats) const;	//	adds to Stats, returns largest free rect
+
+public:
+	size_t				mWidth;
+	size_t				mHeight;
+	size_t				mNextShelfY = 0;
+	uint64_t			mUsedPixels = 0;
+	std::vector<TShelf>	mShelves;
+};
+
+
+class TAtlasPage
+{
+public:
+	TAtlasPage(const SoyPixelsMeta& Meta);
+
+	bool			IsDirty() const		{	return mDirty.mWidth > 0;	}
+	void			AddDirty(const TTextureRect& Rect);
+
+public:
+	TShelfPacker						mPacker;
+	std::vector<uint8_t>				mPixels;	//	cpu copy of the page, so a frame's uploads are one write
+	TTextureRect						mDirty;		//	union of rects written since the last upload
+	std::shared_ptr<TTextureBackend>	mTexture;	//	created on the render thread
+};
+
+
+class TAtlasImage
+{
+public:
+	size_t			mPage = 0;
+	size_t			mShelf = 0;
+	TTextureRect	mRect;			//	in the page, excluding padding
+	size_t			mPaddedWidth = 0;
+};
+
+
+//	many small images packed into a few big pages, each page is one texture and written
+//	once per frame with everything added to it since the last frame
+class TAtlas
+{
+public:
+	TAtlas(const SoyPixelsMeta& PageMeta,size_t MaxPages,size_t Padding,TTextureBackendType::Type BackendType);
+
+	//	copies the pixels (tightly packed, page format). returns image handle. Throws if no page has room
+	int				AddImage(const uint8_t* Bytes,size_t BytesSize,size_t Width,size_t Height,size_t& Page,TTextureRect& Rect);
+	void			FreeImage(int Image);
+	void*			GetPageTexture(size_t Page);
+	size_t			GetPageCount();
+	TAtlasStats		GetStats();
+
+	//	render thread. upload each page's dirty rect, returns bytes written
+	size_t			WritePages();
+
+public:
+	SoyPixelsMeta				mPageMeta;
+	size_t						mMaxPages;
+	size_t						mPadding;
+	TTextureBackendType::Type	mBackendType;
+
+private:
+	std::mutex								mLock;
+	std::vector<std::unique_ptr<TAtlasPage>>	mPages;
+	std::map<int,TAtlasImage>				mImages;
+	int										mNextImage = 1;
+};
+
+
+namespace PopWritePixels
+{
+	int							AllocAtlas(const SoyPixelsMeta& PageMeta,size_t MaxPages,size_t Padding,TTextureBackendType::Type BackendType);
+	std::shared_ptr<TAtlas>		GetAtlas(int AtlasIndex);
+	void						ReleaseAtlas(int AtlasIndex);
+	size_t						WriteAtlases();		//	render thread. returns bytes written
+}
@@ -0,0 +1,223 @@
+#include "TBakedTexture.h"
+#include "TCache.h"
+#include "TBlockCompress.h"
+#include "TMipChain.h"
+#include "TMappedFile.h"
+#include <SoyUnity.h>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+
+static_assert( sizeof(TBakedHeader) <= PopWritePixels::BakedPayloadAlignment, "Baked header must fit before the first payload" );
+
+
+namespace PopWritePixels
+{
+	size_t		AlignBaked(size_t Offset)	{	return ((Offset + BakedPayloadAlignment - 1) / BakedPayloadAlignment) * BakedPayloadAlignment;	}
+}
+
+
+void PopWritePixels::BakeTexture(const std::string& Filename,const uint8_t* Pixels,const SoyPixelsMeta& Meta,int UnityFormat,const TBakeParams& Params)
+{
+	auto Width = Meta.GetWidth();
+	auto Height = Meta.GetHeight();
+	auto Channels = Meta.GetChannels();
+	bool Compressed = Params.mBlockFormat != TBlockFormat::None;
+	if ( Width == 0 || Height == 0 )
+		throw Soy::AssertException("Can't bake an empty texture");
+	if ( ( Params.mMips || Compressed ) && Meta.GetRowDataSize() != Width * Channels )
+		throw Soy::AssertException("Mips & compression need 8 bit channels");
+	if ( Compressed && Channels != 3 && Channels != 4 )
+		throw Soy::AssertException("Block compression needs rgb or rgba pixels");
+
+	TBakedHeader Header;
+	Header.mWidth = static_cast<uint32_t>( Width );
+	Header.mHeight = static_cast<uint32_t>( Height );
+	Header.mUnityFormat = static_cast<uint32_t>( UnityFormat );
+	Header.mChannels = static_cast<uint32_t>( Channels );
+	Header.mBlockFormat = Params.mBlockFormat;
+	Header.mChunkRows = static_cast<uint32_t>( std::max<size_t>( 1, Params.mChunkRows ) );
+	if ( Compressed )
+		Header.mChunkRows = ((Header.mChunkRows + 3) / 4) * 4;
+
+	//	level payloads, level 0 first
+	std::vector<std::vector<uint8_t>> Levels;
+	if ( Compressed )
+	{
+		auto BlockRowCount = (Height + 3) / 4;
+		std::vector<uint8_t> Blocks( PopWritePixels::GetBlockDataSize( Params.mBlockFormat, Width, Height ) );
+		auto Quality = static_cast<TCompressQuality::Type>( Params.mCompressQuality );
+		PopWritePixels::CompressBlockRows( Params.mBlockFormat, Quality, Pixels, Channels, Width, Height, 0, BlockRowCount, Blocks.data() );
+		Levels.push_back( std::move(Blocks) );
+	}
+	else
+	{
+		Levels.push_back( std::vector<uint8_t>( Pixels, Pixels + Meta.GetDataSize() ) );
+
+		//	same filter as TMipChain, so a baked texture matches one uploaded with cpu mips
+		auto MipCount = Params.mMips ? std::min( PopWritePixels::GetMipCount( Meta ), BakedMaxLevels ) : 1;
+		for ( size_t m=1;	m<MipCount;	m++ )
+		{
+			auto& Parent = Levels[m-1];
+			auto ParentWidth = std::max<size_t>( 1, Width >> (m-1) );
+			auto ParentHeight = std::max<size_t>( 1, Height >> (m-1) );
+			auto MipWidth = std::max<size_t>( 1, Width >> m );
+			auto MipHeight = std::max<size_t>( 1, Height >> m );
+			std::vector<uint8_t> Mip( MipWidth * MipHeight * Channels );
+			for ( size_t y=0;	y<MipHeight;	y++ )
+			{
+				auto y0 = std::min( y*2+0, ParentHeight-1 );
+				auto y1 = std::min( y*2+1, ParentHeight-1 );
+				auto* ParentRow0 = &Parent[y0 * ParentWidth * Channels];
+				auto* ParentRow1 = &Parent[y1 * ParentWidth * Channels];
+				PopWritePixels::DownsampleRow( ParentRow0, ParentRow1, ParentWidth, &Mip[y * MipWidth * Channels], MipWidth, Channels );
+			}
+			Levels.push_back( std::move(Mip) );
+		}
+	}
+
+	Header.mMipCount = static_cast<uint32_t>( Levels.size() );
+	size_t Offset = AlignBaked( sizeof(TBakedHeader) );
+	for ( size_t m=0;	m<Levels.size();	m++ )
+	{
+		auto& Level = Header.mLevels[m];
+		Level.mOffset = Offset;
+		Level.mSize = Levels[m].size();
+		Level.mWidth = static_cast<uint32_t>( std::max<size_t>( 1, Width >> m ) );
+		Level.mHeight = static_cast<uint32_t>( std::max<size_t>( 1, Height >> m ) );
+		Level.mRowPitch = Compressed ? static_cast<uint32_t>( PopWritePixels::GetBlockRowSize( Params.mBlockFormat, Width ) / 4 ) : static_cast<uint32_t>( Level.mWidth * GetPixelSize( Meta ) );
+		Offset = AlignBaked( Offset + Level.mSize );
+	}
+
+	std::ofstream File( Filename, std::ios::binary | std::ios::trunc );
+	if ( !File )
+		throw Soy::AssertException("Failed to open " + Filename + " for writing");
+
+	std::vector<uint8_t> Padding( BakedPayloadAlignment, 0 );
+	size_t Written = 0;
+	auto Write = [&](const void* Data,size_t Size)
+	{
+		File.write( reinterpret_cast<const char*>(Data), Size );
+		Written += Size;
+	};
+	auto PadTo = [&](size_t To)
+	{
+		Write( Padding.data(), To - Written );
+	};
+
+	Write( &Header, sizeof(Header) );
+	for ( size_t m=0;	m<Levels.size();	m++ )
+	{
+		PadTo( Header.mLevels[m].mOffset );
+		Write( Levels[m].data(), Levels[m].size() );
+	}
+
+	File.flush();
+	if ( !File )
+		throw Soy::AssertException("Failed to write " + Filename);
+}
+
+
+TBakedHeader PopWritePixels::ReadBakedHeader(const uint8_t* Data,size_t DataSize)
+{
+	TBakedHeader Header;
+	if ( DataSize < sizeof(Header) )
+		throw Soy::AssertException("File too small for a baked texture header");
+
+	//	copied out as nothing guarantees the data is aligned
+	TBakedHeader Expected;
+	memcpy( &Header, Data, sizeof(Header) );
+	if ( memcmp( Header.mMagic, Expected.mMagic, sizeof(Header.mMagic) ) != 0 )
+		throw Soy::AssertException("Not a baked texture");
+	if ( Header.mVersion != BakedVersion )
+		throw Soy::AssertException("Baked texture version " + std::to_string(Header.mVersion) + " not supported");
+	if ( Header.mMipCount < 1 || Header.mMipCount > BakedMaxLevels )
+		throw Soy::AssertException("Baked texture has an invalid mip count");
+	bool Compressed = Header.mBlockFormat != TBlockFormat::None;
+	auto BlockFormat = static_cast<TBlockFormat::Type>(Header.mBlockFormat);
+	if ( Compressed && Header.mMipCount != 1 )
+		throw Soy::AssertException("Compressed baked textures are level 0 only");
+	if ( Header.mWidth == 0 || Header.mHeight == 0 )
+		throw Soy::AssertException("Baked texture is empty");
+
+	//	the rows are laid out in the pixels' format, so the channels & pitches must agree with it
+	auto Format = Unity::GetPixelFormat( static_cast<Unity::Texture2DPixelFormat::Type>(Header.mUnityFormat) );
+	if ( Format == SoyPixelsFormat::Invalid )
+		throw Soy::AssertException("Baked texture unity format " + std::to_string(Header.mUnityFormat) + " not supported");
+	SoyPixelsMeta FormatMeta( Header.mWidth, Header.mHeight, Format );
+	if ( Header.mChannels != FormatMeta.GetChannels() )
+		throw Soy::AssertException("Baked texture channels don't match its format");
+	auto PixelSize = GetPixelSize( FormatMeta );
+	if ( ( Header.mMipCount > 1 || Compressed ) && PixelSize != Header.mChannels )
+		throw Soy::AssertException("Baked mips & compression need 8 bit channels");
+
+	for ( size_t m=0;	m<Header.mMipCount;	m++ )
+	{
+		auto& Level = Header.mLevels[m];
+		if ( Level.mWidth != std::max<uint32_t>( 1, Header.mWidth >> m ) || Level.mHeight != std::max<uint32_t>( 1, Header.mHeight >> m ) )
+			throw Soy::AssertException("Baked texture level " + std::to_string(m) + " has the wrong size");
+		if ( Level.mOffset > DataSize || Level.mSize > DataSize - Level.mOffset )
+			throw Soy::AssertException("Baked texture level " + std::to_string(m) + " is past the end of the file");
+
+		//	what BakeTexture writes; the cache works out the same pitch from its own meta
+		auto ExpectedPitch = static_cast<uint64_t>(Level.mWidth) * PixelSize;
+		if ( Compressed )
+			ExpectedPitch = GetBlockRowSize( BlockFormat, Level.mWidth ) / 4;
+		if ( Level.mRowPitch != ExpectedPitch )
+			throw Soy::AssertException("Baked texture level " + std::to_string(m) + " has the wrong row pitch");
+
+		auto ExpectedSize = static_cast<uint64_t>(Level.mRowPitch) * Level.mHeight;
+		if ( Compressed )
+			ExpectedSize = GetBlockDataSize( BlockFormat, Level.mWidth, Level.mHeight );
+		if ( Level.mSize < ExpectedSize )
+			throw Soy::AssertException("Baked texture level " + std::to_string(m) + " is truncated");
+	}
+	return Header;
+}
+
+
+void PopWritePixels::QueueBakedFile(TCache& Cache,std::shared_ptr<TMappedFile> File)
+{
+	auto Header = ReadBakedHeader( File->GetData(), File->GetSize() );
+
+	auto& Meta = Cache.mTextureMeta;
+	if ( Header.mWidth != Meta.GetWidth() || Header.mHeight != Meta.GetHeight() )
+		throw Soy::AssertException("Baked texture is a different size to the cache");
+	if ( Header.mBlockFormat != Cache.mBlockFormat )
+		throw Soy::AssertException("Baked texture is a different block format to the cache");
+	if ( Cache.mBlockFormat == TBlockFormat::None )
+	{
+		auto Format = Unity::GetPixelFormat( static_cast<Unity::Texture2DPixelFormat::Type>(Header.mUnityFormat) );
+		if ( Format != Meta.GetFormat() )
+			throw Soy::AssertException("Baked texture is a different format to the cache");
+	}
+
+	auto& Level0 = Header.mLevels[0];
+	std::shared_ptr<TPendingBytes> Pending( new TPendingBytes() );
+	Pending->mMappedFile = File;
+	Pending->mBytes = File->GetData() + Level0.mOffset;
+	Pending->mBytesSize = Level0.mSize;
+	Pending->mChunkRows = Header.mChunkRows;
+
+	//	the texture's own mip count isn't known until it's created, so write whatever the file has
+	if ( Cache.mEnableMips )
+	{
+		for ( size_t m=1;	m<Header.mMipCount;	m++ )
+		{
+			auto& Level = Header.mLevels[m];
+			TBakedMip Mip;
+			Mip.mBytes = File->GetData() + Level.mOffset;
+			Mip.mWidth = Level.mWidth;
+			Mip.mHeight = Level.mHeight;
+			Mip.mRowPitch = Level.mRowPitch;
+			Pending->mBakedMips.push_back( Mip );
+		}
+	}
+	Cache.CheckBytes( *Pending );
+
+	//	start reading the first chunk now, so the first write doesn't wait on the disk
+	File->WillNeed( Level0.mOffset, Cache.GetWriteBytes( *Pending ) );
+	Cache.QueueBytes( Pending );
+}
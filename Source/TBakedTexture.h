@@ -0,0 +1,85 @@
+#pragma once
+
+#include "TTextureBackend.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class TCache;
+class TMappedFile;
+
+
+//	pre-baked upload container (.pwpb). Everything the render thread would otherwise do to a static
+//	asset (conversion, mip generation, block compression) is done offline, so loading is mapping the
+//	file and handing its rows to the texture.
+//	gr: on-disk layout, little endian. Bump the version with any change
+//		header (padded to BakedPayloadAlignment)
+//		level 0 rows, tightly packed (or rows of blocks), padded to BakedPayloadAlignment
+//		level 1 rows ... to level mMipCount-1
+namespace PopWritePixels
+{
+	const uint32_t	BakedVersion = 1;
+	const size_t	BakedMaxLevels = 16;			//	a 32768 texture's full chain
+	const size_t	BakedPayloadAlignment = 4096;	//	page size, so every level starts on its own page
+}
+
+struct TBakedLevel
+{
+	uint64_t	mOffset = 0;		//	from the start of the file
+	uint64_t	mSize = 0;
+	uint32_t	mWidth = 0;
+	uint32_t	mHeight = 0;
+	uint32_t	mRowPitch = 0;		//	bytes per texel row (for block formats, a row of blocks / 4)
+	uint32_t	mReserved = 0;
+};
+
+struct TBakedHeader
+{
+	char		mMagic[4] = { 'P','W','P','B' };
+	uint32_t	mVersion = PopWritePixels::BakedVersion;
+	uint32_t	mWidth = 0;
+	uint32_t	mHeight = 0;
+	uint32_t	mUnityFormat = 0;		//	UnityEngine.TextureFormat of the pixels (source format for block compressed)
+	uint32_t	mChannels = 0;
+	uint32_t	mBlockFormat = TBlockFormat::None;
+	uint32_t	mMipCount = 1;			//	compressed containers are level 0 only, as compressed caches have no mips
+	uint32_t	mChunkRows = 0;			//	rows the baker laid each write out in, the loader writes whole chunks
+	uint32_t	mReserved = 0;
+	TBakedLevel	mLevels[PopWritePixels::BakedMaxLevels];
+};
+
+
+class TBakeParams
+{
+public:
+	bool					mMips = true;
+	TBlockFormat::Type		mBlockFormat = TBlockFormat::None;
+	int						mCompressQuality = 1;		//	TCompressQuality
+	size_t					mChunkRows = 64;
+};
+
+
+//	a mip level straight from the file, written as the level 0 rows it was built from are
+class TBakedMip
+{
+public:
+	const uint8_t*	mBytes = nullptr;
+	size_t			mWidth = 0;
+	size_t			mHeight = 0;
+	size_t			mRowPitch = 0;
+	size_t			mRowsWritten = 0;		//	render thread
+};
+
+
+namespace PopWritePixels
+{
+	//	Pixels is level 0 in Meta's format, 8 bit channels if there are mips or compression. Throws on failure
+	void			BakeTexture(const std::string& Filename,const uint8_t* Pixels,const SoyPixelsMeta& Meta,int UnityFormat,const TBakeParams& Params);
+
+	//	throws if Data isn't a container this version can load
+	TBakedHeader	ReadBakedHeader(const uint8_t* Data,size_t DataSize);
+
+	//	queues level 0 (and the mips) of a mapped container. Throws if it doesn't match the cache
+	void			QueueBakedFile(TCache& Cache,std::shared_ptr<TMappedFile> File);
+}
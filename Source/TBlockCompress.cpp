@@ -0,0 +1,1019 @@
+#include "TBlockCompress.h"
+#include "TWorkerPool.h"
+#include "TWriteBudget.h"
+#include <SoyDebug.h>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+
+namespace PopWritePixels
+{
+	namespace Bc
+	{
+		void	CompressColour(TCompressQuality::Type Quality,const uint8_t Rgba[16*4],uint8_t* Block);
+		void	CompressAlpha(const uint8_t Rgba[16*4],uint8_t* Block);
+		void	CompressBc7(TCompressQuality::Type Quality,const uint8_t Rgba[16*4],uint8_t* Block);
+	}
+
+	namespace Etc
+	{
+		void	CompressColour(TCompressQuality::Type Quality,const uint8_t Rgba[16*4],uint8_t* Block);
+		void	CompressAlpha(TCompressQuality::Type Quality,const uint8_t Rgba[16*4],uint8_t* Block);
+	}
+
+	inline int	Clamp255(int Value)		{	return std::min( 255, std::max( 0, Value ) );	}
+	inline int	Square(int Value)		{	return Value * Value;	}
+
+	//	endpoints along the principal axis of Channels channels. falls back to the bounding box for flat blocks
+	void		GetPrincipalEndpoints(const uint8_t Rgba[16*4],size_t Channels,float Start[4],float End[4]);
+	void		GetBoundingEndpoints(const uint8_t Rgba[16*4],size_t Channels,float Start[4],float End[4]);
+}
+
+
+size_t PopWritePixels::GetBlockSize(TBlockFormat::Type Format)
+{
+	switch ( Format )
+	{
+		case TBlockFormat::BC1:			return 8;
+		case TBlockFormat::BC3:			return 16;
+		case TBlockFormat::BC7:			return 16;
+		case TBlockFormat::Etc2Rgb:		return 8;
+		case TBlockFormat::Etc2Rgba:	return 16;
+		default:
+			break;
+	}
+	throw Soy::AssertException("Unknown block format");
+}
+
+size_t PopWritePixels::GetBlockRowSize(TBlockFormat::Type Format,size_t Width)
+{
+	return ((Width + 3) / 4) * GetBlockSize( Format );
+}
+
+size_t PopWritePixels::GetBlockDataSize(TBlockFormat::Type Format,size_t Width,size_t Height)
+{
+	return GetBlockRowSize( Format, Width ) * ((Height + 3) / 4);
+}
+
+const char* PopWritePixels::GetBlockFormatName(TBlockFormat::Type Format)
+{
+	switch ( Format )
+	{
+		case TBlockFormat::None:		return "None";
+		case TBlockFormat::BC1:			return "BC1";
+		case TBlockFormat::BC3:			return "BC3";
+		case TBlockFormat::BC7:			return "BC7";
+		case TBlockFormat::Etc2Rgb:		return "Etc2Rgb";
+		case TBlockFormat::Etc2Rgba:	return "Etc2Rgba";
+	}
+	return "Unknown";
+}
+
+
+void PopWritePixels::GetBoundingEndpoints(const uint8_t Rgba[16*4],size_t Channels,float Start[4],float End[4])
+{
+	for ( size_t c=0;	c<Channels;	c++ )
+	{
+		int Min = 255;
+		int Max = 0;
+		for ( int i=0;	i<16;	i++ )
+		{
+			Min = std::min<int>( Min, Rgba[i*4+c] );
+			Max = std::max<int>( Max, Rgba[i*4+c] );
+		}
+		//	inset a little, as the extremes are rarely the best endpoints
+		auto Inset = (Max - Min) / 16.0f;
+		Start[c] = Min + Inset;
+		End[c] = Max - Inset;
+	}
+}
+
+void PopWritePixels::GetPrincipalEndpoints(const uint8_t Rgba[16*4],size_t Channels,float Start[4],float End[4])
+{
+	float Mean[4] = {0,0,0,0};
+	for ( int i=0;	i<16;	i++ )
+		for ( size_t c=0;	c<Channels;	c++ )
+			Mean[c] += Rgba[i*4+c];
+	for ( size_t c=0;	c<Channels;	c++ )
+		Mean[c] /= 16.0f;
+
+	float Covariance[4][4] = {};
+	for ( int i=0;	i<16;	i++ )
+	{
+		float Delta[4] = {0,0,0,0};
+		for ( size_t c=0;	c<Channels;	c++ )
+			Delta[c] = Rgba[i*4+c] - Mean[c];
+		for ( size_t a=0;	a<Channels;	a++ )
+			for ( size_t b=0;	b<Channels;	b++ )
+				Covariance[a][b] += Delta[a] * Delta[b];
+	}
+
+	//	power iteration, starting from the bounding box diagonal
+	float BoxStart[4];
+	float BoxEnd[4];
+	GetBoundingEndpoints( Rgba, Channels, BoxStart, BoxEnd );
+	float Axis[4] = {0,0,0,0};
+	for ( size_t c=0;	c<Channels;	c++ )
+		Axis[c] = BoxEnd[c] - BoxStart[c] + 1.0f;
+	for ( int Iteration=0;	Iteration<6;	Iteration++ )
+	{
+		float Next[4] = {0,0,0,0};
+		float Length = 0;
+		for ( size_t a=0;	a<Channels;	a++ )
+		{
+			for ( size_t b=0;	b<Channels;	b++ )
+				Next[a] += Covariance[a][b] * Axis[b];
+			Length = std::max( Length, std::abs(Next[a]) );
+		}
+		if ( Length < 1e-6f )
+		{
+			//	flat block
+			for ( size_t c=0;	c<Channels;	c++ )
+			{
+				Start[c] = Mean[c];
+				End[c] = Mean[c];
+			}
+			return;
+		}
+		for ( size_t c=0;	c<Channels;	c++ )
+			Axis[c] = Next[c] / Length;
+	}
+
+	float AxisLengthSq = 0;
+	for ( size_t c=0;	c<Channels;	c++ )
+		AxisLengthSq += Axis[c] * Axis[c];
+
+	float Min = 0;
+	float Max = 0;
+	for ( int i=0;	i<16;	i++ )
+	{
+		float Projection = 0;
+		for ( size_t c=0;	c<Channels;	c++ )
+			Projection += (Rgba[i*4+c] - Mean[c]) * Axis[c];
+		Min = std::min( Min, Projection );
+		Max = std::max( Max, Projection );
+	}
+	Min /= AxisLengthSq;
+	Max /= AxisLengthSq;
+	for ( size_t c=0;	c<Channels;	c++ )
+	{
+		Start[c] = std::min( 255.0f, std::max( 0.0f, Mean[c] + Axis[c] * Min ) );
+		End[c] = std::min( 255.0f, std::max( 0.0f, Mean[c] + Axis[c] * Max ) );
+	}
+}
+
+
+namespace PopWritePixels
+{
+	namespace Bc
+	{
+		uint16_t	To565(const float Rgb[3]);
+		void		From565(uint16_t Colour,int Rgb[3]);
+		int			GetColourIndexes(uint16_t Colour0,uint16_t Colour1,const uint8_t Rgba[16*4],uint32_t& Indexes);
+		void		RefineColour(const uint8_t Rgba[16*4],uint32_t Indexes,float Start[3],float End[3]);
+		void		WriteColour(uint16_t Colour0,uint16_t Colour1,uint32_t Indexes,uint8_t* Block);
+	}
+}
+
+uint16_t PopWritePixels::Bc::To565(const float Rgb[3])
+{
+	auto r = static_cast<int>( Rgb[0] * 31.0f / 255.0f + 0.5f );
+	auto g = static_cast<int>( Rgb[1] * 63.0f / 255.0f + 0.5f );
+	auto b = static_cast<int>( Rgb[2] * 31.0f / 255.0f + 0.5f );
+	r = std::min( 31, std::max( 0, r ) );
+	g = std::min( 63, std::max( 0, g ) );
+	b = std::min( 31, std::max( 0, b ) );
+	return static_cast<uint16_t>( (r << 11) | (g << 5) | b );
+}
+
+void PopWritePixels::Bc::From565(uint16_t Colour,int Rgb[3])
+{
+	auto r = (Colour >> 11) & 31;
+	auto g = (Colour >> 5) & 63;
+	auto b = Colour & 31;
+	Rgb[0] = (r << 3) | (r >> 2);
+	Rgb[1] = (g << 2) | (g >> 4);
+	Rgb[2] = (b << 3) | (b >> 2);
+}
+
+//	always the 4 colour palette, so Colour0 must be > Colour1. returns the error
+int PopWritePixels::Bc::GetColourIndexes(uint16_t Colour0,uint16_t Colour1,const uint8_t Rgba[16*4],uint32_t& Indexes)
+{
+	int Palette[4][3];
+	From565( Colour0, Palette[0] );
+	From565( Colour1, Palette[1] );
+	for ( int c=0;	c<3;	c++ )
+	{
+		Palette[2][c] = (2*Palette[0][c] + Palette[1][c]) / 3;
+		Palette[3][c] = (Palette[0][c] + 2*Palette[1][c]) / 3;
+	}
+
+	int Error = 0;
+	Indexes = 0;
+	for ( int i=0;	i<16;	i++ )
+	{
+		auto* Texel = &Rgba[i*4];
+		int BestIndex = 0;
+		int BestError = INT32_MAX;
+		for ( int p=0;	p<4;	p++ )
+		{
+			auto e = Square(Texel[0]-Palette[p][0]) + Square(Texel[1]-Palette[p][1]) + Square(Texel[2]-Palette[p][2]);
+			if ( e < BestError )
+			{
+				BestError = e;
+				BestIndex = p;
+			}
+		}
+		Error += BestError;
+		Indexes |= static_cast<uint32_t>(BestIndex) << (i*2);
+	}
+	return Error;
+}
+
+//	least squares endpoints for the current indexes
+void PopWritePixels::Bc::RefineColour(const uint8_t Rgba[16*4],uint32_t Indexes,float Start[3],float End[3])
+{
+	static const float Weights[4] = { 1.0f, 0.0f, 2.0f/3.0f, 1.0f/3.0f };
+	float AlphaSq = 0;
+	float BetaSq = 0;
+	float AlphaBeta = 0;
+	float AlphaX[3] = {0,0,0};
+	float BetaX[3] = {0,0,0};
+	for ( int i=0;	i<16;	i++ )
+	{
+		auto Alpha = Weights[ (Indexes >> (i*2)) & 3 ];
+		auto Beta = 1.0f - Alpha;
+		AlphaSq += Alpha * Alpha;
+		BetaSq += Beta * Beta;
+		AlphaBeta += Alpha * Beta;
+		for ( int c=0;	c<3;	c++ )
+		{
+			AlphaX[c] += Alpha * Rgba[i*4+c];
+			BetaX[c] += Beta * Rgba[i*4+c];
+		}
+	}
+
+	auto Determinant = AlphaSq * BetaSq - AlphaBeta * AlphaBeta;
+	if ( std::abs(Determinant) < 1e-6f )
+		return;
+
+	for ( int c=0;	c<3;	c++ )
+	{
+		auto a = (AlphaX[c] * BetaSq - BetaX[c] * AlphaBeta) / Determinant;
+		auto b = (BetaX[c] * AlphaSq - AlphaX[c] * AlphaBeta) / Determinant;
+		End[c] = std::min( 255.0f, std::max( 0.0f, a ) );
+		Start[c] = std::min( 255.0f, std::max( 0.0f, b ) );
+	}
+}
+
+void PopWritePixels::Bc::WriteColour(uint16_t Colour0,uint16_t Colour1,uint32_t Indexes,uint8_t* Block)
+{
+	Block[0] = static_cast<uint8_t>( Colour0 & 0xff );
+	Block[1] = static_cast<uint8_t>( Colour0 >> 8 );
+	Block[2] = static_cast<uint8_t>( Colour1 & 0xff );
+	Block[3] = static_cast<uint8_t>( Colour1 >> 8 );
+	for ( int i=0;	i<4;	i++ )
+		Block[4+i] = static_cast<uint8_t>( Indexes >> (i*8) );
+}
+
+void PopWritePixels::Bc::CompressColour(TCompressQuality::Type Quality,const uint8_t Rgba[16*4],uint8_t* Block)
+{
+	float Start[4];
+	float End[4];
+	if ( Quality == TCompressQuality::Fast )
+		GetBoundingEndpoints( Rgba, 3, Start, End );
+	else
+		GetPrincipalEndpoints( Rgba, 3, Start, End );
+
+	auto Colour0 = To565( End );
+	auto Colour1 = To565( Start );
+	if ( Colour0 < Colour1 )
+		std::swap( Colour0, Colour1 );
+
+	//	flat; one colour, every index 0
+	if ( Colour0 == Colour1 )
+	{
+		WriteColour( Colour0, Colour1, 0, Block );
+		return;
+	}
+
+	uint32_t Indexes = 0;
+	auto Error = GetColourIndexes( Colour0, Colour1, Rgba, Indexes );
+
+	if ( Quality == TCompressQuality::High )
+	{
+		for ( int Iteration=0;	Iteration<2 && Error>0;	Iteration++ )
+		{
+			float RefinedStart[3] = { Start[0], Start[1], Start[2] };
+			float RefinedEnd[3] = { End[0], End[1], End[2] };
+			RefineColour( Rgba, Indexes, RefinedStart, RefinedEnd );
+			auto Refined0 = To565( RefinedEnd );
+			auto Refined1 = To565( RefinedStart );
+			if ( Refined0 < Refined1 )
+				std::swap( Refined0, Refined1 );
+			if ( Refined0 == Refined1 )
+				break;
+
+			uint32_t RefinedIndexes = 0;
+			auto RefinedError = GetColourIndexes( Refined0, Refined1, Rgba, RefinedIndexes );
+			if ( RefinedError >= Error )
+				break;
+			Error = RefinedError;
+			Indexes = RefinedIndexes;
+			Colour0 = Refined0;
+			Colour1 = Refined1;
+			std::copy( RefinedStart, RefinedStart+3, Start );
+			std::copy( RefinedEnd, RefinedEnd+3, End );
+		}
+	}
+
+	WriteColour( Colour0, Colour1, Indexes, Block );
+}
+
+//	bc4 style, 8 value palette
+void PopWritePixels::Bc::CompressAlpha(const uint8_t Rgba[16*4],uint8_t* Block)
+{
+	int Alpha0 = 0;
+	int Alpha1 = 255;
+	for ( int i=0;	i<16;	i++ )
+	{
+		Alpha0 = std::max<int>( Alpha0, Rgba[i*4+3] );
+		Alpha1 = std::min<int>( Alpha1, Rgba[i*4+3] );
+	}
+
+	uint64_t Indexes = 0;
+	if ( Alpha0 != Alpha1 )
+	{
+		int Palette[8];
+		Palette[0] = Alpha0;
+		Palette[1] = Alpha1;
+		for ( int p=1;	p<7;	p++ )
+			Palette[p+1] = ((7-p)*Alpha0 + p*Alpha1 + 3) / 7;
+
+		for ( int i=0;	i<16;	i++ )
+		{
+			int a = Rgba[i*4+3];
+			int BestIndex = 0;
+			int BestError = INT32_MAX;
+			for ( int p=0;	p<8;	p++ )
+			{
+				auto e = std::abs( a - Palette[p] );
+				if ( e < BestError )
+				{
+					BestError = e;
+					BestIndex = p;
+				}
+			}
+			Indexes |= static_cast<uint64_t>(BestIndex) << (i*3);
+		}
+	}
+
+	Block[0] = static_cast<uint8_t>( Alpha0 );
+	Block[1] = static_cast<uint8_t>( Alpha1 );
+	for ( int i=0;	i<6;	i++ )
+		Block[2+i] = static_cast<uint8_t>( Indexes >> (i*8) );
+}
+
+
+namespace PopWritePixels
+{
+	namespace Bc
+	{
+		const int	Bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		//	7 bits + shared pbit per endpoint
+		class TBc7Endpoint
+		{
+		public:
+			int		mValue[4];		//	7 bit
+			int		mPbit;
+
+			int		Get(int Channel) const	{	return (mValue[Channel] << 1) | mPbit;	}
+		};
+
+		TBc7Endpoint	QuantiseBc7(const float Colour[4],int Pbit);
+		TBc7Endpoint	QuantiseBc7(const float Colour[4]);
+		int				GetBc7Indexes(const TBc7Endpoint& Start,const TBc7Endpoint& End,const uint8_t Rgba[16*4],uint8_t Indexes[16]);
+		void			RefineBc7(const uint8_t Rgba[16*4],const uint8_t Indexes[16],float Start[4],float End[4]);
+		void			WriteBc7(TBc7Endpoint Start,TBc7Endpoint End,uint8_t Indexes[16],uint8_t* Block);
+	}
+}
+
+PopWritePixels::Bc::TBc7Endpoint PopWritePixels::Bc::QuantiseBc7(const float Colour[4],int Pbit)
+{
+	TBc7Endpoint Endpoint;
+	Endpoint.mPbit = Pbit;
+	for ( int c=0;	c<4;	c++ )
+	{
+		auto Value = static_cast<int>( (Colour[c] - Pbit) / 2.0f + 0.5f );
+		Endpoint.mValue[c] = std::min( 127, std::max( 0, Value ) );
+	}
+	return Endpoint;
+}
+
+//	pick the pbit which loses least
+PopWritePixels::Bc::TBc7Endpoint PopWritePixels::Bc::QuantiseBc7(const float Colour[4])
+{
+	TBc7Endpoint Best;
+	float BestError = -1;
+	for ( int Pbit=0;	Pbit<2;	Pbit++ )
+	{
+		auto Endpoint = QuantiseBc7( Colour, Pbit );
+		float Error = 0;
+		for ( int c=0;	c<4;	c++ )
+		{
+			auto Delta = Endpoint.Get(c) - Colour[c];
+			Error += Delta * Delta;
+		}
+		if ( BestError < 0 || Error < BestError )
+		{
+			BestError = Error;
+			Best = Endpoint;
+		}
+	}
+	return Best;
+}
+
+int PopWritePixels::Bc::GetBc7Indexes(const TBc7Endpoint& Start,const TBc7Endpoint& End,const uint8_t Rgba[16*4],uint8_t Indexes[16])
+{
+	int Palette[16][4];
+	for ( int p=0;	p<16;	p++ )
+		for ( int c=0;	c<4;	c++ )
+			Palette[p][c] = ( (64-Bc7Weights[p]) * Start.Get(c) + Bc7Weights[p] * End.Get(c) + 32 ) >> 6;
+
+	int Error = 0;
+	for ( int i=0;	i<16;	i++ )
+	{
+		auto* Texel = &Rgba[i*4];
+		int BestIndex = 0;
+		int BestError = INT32_MAX;
+		for ( int p=0;	p<16;	p++ )
+		{
+			auto e = Square(Texel[0]-Palette[p][0]) + Square(Texel[1]-Palette[p][1]) + Square(Texel[2]-Palette[p][2]) + Square(Texel[3]-Palette[p][3]);
+			if ( e < BestError )
+			{
+				BestError = e;
+				BestIndex = p;
+			}
+		}
+		Error += BestError;
+		Indexes[i] = static_cast<uint8_t>( BestIndex );
+	}
+	return Error;
+}
+
+void PopWritePixels::Bc::RefineBc7(const uint8_t Rgba[16*4],const uint8_t Indexes[16],float Start[4],float End[4])
+{
+	float AlphaSq = 0;
+	float BetaSq = 0;
+	float AlphaBeta = 0;
+	float AlphaX[4] = {0,0,0,0};
+	float BetaX[4] = {0,0,0,0};
+	for ( int i=0;	i<16;	i++ )
+	{
+		auto Beta = Bc7Weights[Indexes[i]] / 64.0f;
+		auto Alpha = 1.0f - Beta;
+		AlphaSq += Alpha * Alpha;
+		BetaSq += Beta * Beta;
+		AlphaBeta += Alpha * Beta;
+		for ( int c=0;	c<4;	c++ )
+		{
+			AlphaX[c] += Alpha * Rgba[i*4+c];
+			BetaX[c] += Beta * Rgba[i*4+c];
+		}
+	}
+
+	auto Determinant = AlphaSq * BetaSq - AlphaBeta * AlphaBeta;
+	if ( std::abs(Determinant) < 1e-6f )
+		return;
+
+	for ( int c=0;	c<4;	c++ )
+	{
+		auto a = (AlphaX[c] * BetaSq - BetaX[c] * AlphaBeta) / Determinant;
+		auto b = (BetaX[c] * AlphaSq - AlphaX[c] * AlphaBeta) / Determinant;
+		Start[c] = std::min( 255.0f, std::max( 0.0f, a ) );
+		End[c] = std::min( 255.0f, std::max( 0.0f, b ) );
+	}
+}
+
+void PopWritePixels::Bc::WriteBc7(TBc7Endpoint Start,TBc7Endpoint End,uint8_t Indexes[16],uint8_t* Block)
+{
+	//	the anchor (first) index has an implicit 0 top bit
+	if ( Indexes[0] & 8 )
+	{
+		std::swap( Start, End );
+		for ( int i=0;	i<16;	i++ )
+			Indexes[i] = 15 - Indexes[i];
+	}
+
+	uint64_t Bits[2] = {0,0};
+	size_t Position = 0;
+	auto Write = [&](uint64_t Value,size_t Count)
+	{
+		for ( size_t b=0;	b<Count;	b++,Position++ )
+			Bits[Position/64] |= ((Value >> b) & 1) << (Position%64);
+	};
+
+	//	mode 6
+	Write( 1 << 6, 7 );
+	for ( int c=0;	c<4;	c++ )
+	{
+		Write( Start.mValue[c], 7 );
+		Write( End.mValue[c], 7 );
+	}
+	Write( Start.mPbit, 1 );
+	Write( End.mPbit, 1 );
+	Write( Indexes[0], 3 );
+	for ( int i=1;	i<16;	i++ )
+		Write( Indexes[i], 4 );
+
+	for ( int i=0;	i<16;	i++ )
+		Block[i] = static_cast<uint8_t>( Bits[i/8] >> ((i%8)*8) );
+}
+
+void PopWritePixels::Bc::CompressBc7(TCompressQuality::Type Quality,const uint8_t Rgba[16*4],uint8_t* Block)
+{
+	float Start[4];
+	float End[4];
+	if ( Quality == TCompressQuality::Fast )
+		GetBoundingEndpoints( Rgba, 4, Start, End );
+	else
+		GetPrincipalEndpoints( Rgba, 4, Start, End );
+
+	auto StartEndpoint = QuantiseBc7( Start );
+	auto EndEndpoint = QuantiseBc7( End );
+	uint8_t Indexes[16];
+	auto Error = GetBc7Indexes( StartEndpoint, EndEndpoint, Rgba, Indexes );
+
+	if ( Quality == TCompressQuality::High )
+	{
+		for ( int Iteration=0;	Iteration<2 && Error>0;	Iteration++ )
+		{
+			float RefinedStart[4];
+			float RefinedEnd[4];
+			std::copy( Start, Start+4, RefinedStart );
+			std::copy( End, End+4, RefinedEnd );
+			RefineBc7( Rgba, Indexes, RefinedStart, RefinedEnd );
+
+			//	every pbit pairing, rather than trusting the per-endpoint guess
+			bool Improved = false;
+			for ( int Pbits=0;	Pbits<4;	Pbits++ )
+			{
+				auto RefinedStartEndpoint = QuantiseBc7( RefinedStart, Pbits & 1 );
+				auto RefinedEndEndpoint = QuantiseBc7( RefinedEnd, Pbits >> 1 );
+				uint8_t RefinedIndexes[16];
+				auto RefinedError = GetBc7Indexes( RefinedStartEndpoint, RefinedEndEndpoint, Rgba, RefinedIndexes );
+				if ( RefinedError >= Error )
+					continue;
+				Error = RefinedError;
+				StartEndpoint = RefinedStartEndpoint;
+				EndEndpoint = RefinedEndEndpoint;
+				std::copy( RefinedIndexes, RefinedIndexes+16, Indexes );
+				Improved = true;
+			}
+			if ( !Improved )
+				break;
+			std::copy( RefinedStart, RefinedStart+4, Start );
+			std::copy( RefinedEnd, RefinedEnd+4, End );
+		}
+	}
+
+	WriteBc7( StartEndpoint, EndEndpoint, Indexes, Block );
+}
+
+
+namespace PopWritePixels
+{
+	namespace Etc
+	{
+		const int	Modifiers[8][2] =
+		{
+			{ 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 },
+		};
+
+		const int	AlphaModifiers[16][8] =
+		{
+			{ -3, -6, -9, -15, 2, 5, 8, 14 },
+			{ -3, -7, -10, -13, 2, 6, 9, 12 },
+			{ -2, -5, -8, -13, 1, 4, 7, 12 },
+			{ -2, -4, -6, -13, 1, 3, 5, 12 },
+			{ -3, -6, -8, -12, 2, 5, 7, 11 },
+			{ -3, -7, -9, -11, 2, 6, 8, 10 },
+			{ -4, -7, -8, -11, 3, 6, 7, 10 },
+			{ -3, -5, -8, -11, 2, 4, 7, 10 },
+			{ -2, -6, -8, -10, 1, 5, 7, 9 },
+			{ -2, -5, -8, -10, 1, 4, 7, 9 },
+			{ -2, -4, -8, -10, 1, 3, 7, 9 },
+			{ -2, -5, -7, -10, 1, 4, 6, 9 },
+			{ -3, -4, -7, -10, 2, 3, 6, 9 },
+			{ -1, -2, -3, -10, 0, 1, 2, 9 },
+			{ -4, -6, -8, -9, 3, 5, 7, 8 },
+			{ -3, -5, -7, -9, 2, 4, 6, 8 },
+		};
+
+		//	one half of the block with its base colour decided
+		class TSubBlock
+		{
+		public:
+			int			mError = INT32_MAX;
+			int			mTable = 0;
+			uint8_t		mIndexes[16];		//	by texel, only ours are set
+		};
+
+		bool		InSubBlock(int x,int y,bool Flip,int SubBlock);
+		TSubBlock	FitSubBlock(const uint8_t Rgba[16*4],bool Flip,int SubBlock,const int Base[3]);
+		void		WriteBlock(uint64_t Bits,uint8_t* Block);
+
+		inline int	Expand4(int Value)	{	return (Value << 4) | Value;	}
+		inline int	Expand5(int Value)	{	return (Value << 3) | (Value >> 2);	}
+	}
+}
+
+bool PopWritePixels::Etc::InSubBlock(int x,int y,bool Flip,int SubBlock)
+{
+	auto First = Flip ? (y < 2) : (x < 2);
+	return First == (SubBlock == 0);
+}
+
+PopWritePixels::Etc::TSubBlock PopWritePixels::Etc::FitSubBlock(const uint8_t Rgba[16*4],bool Flip,int SubBlock,const int Base[3])
+{
+	TSubBlock Best;
+	for ( int t=0;	t<8;	t++ )
+	{
+		TSubBlock Fit;
+		Fit.mTable = t;
+		Fit.mError = 0;
+		//	pixel index bits (msb,lsb); 0=+small 1=+large 2=-small 3=-large
+		const int Deltas[4] = { Modifiers[t][0], Modifiers[t][1], -Modifiers[t][0], -Modifiers[t][1] };
+		for ( int y=0;	y<4;	y++ )
+		{
+			for ( int x=0;	x<4;	x++ )
+			{
+				if ( !InSubBlock( x, y, Flip, SubBlock ) )
+					continue;
+				auto* Texel = &Rgba[(y*4+x)*4];
+				int BestIndex = 0;
+				int BestError = INT32_MAX;
+				for ( int m=0;	m<4;	m++ )
+				{
+					auto e = Square( Texel[0] - Clamp255(Base[0]+Deltas[m]) );
+					e += Square( Texel[1] - Clamp255(Base[1]+Deltas[m]) );
+					e += Square( Texel[2] - Clamp255(Base[2]+Deltas[m]) );
+					if ( e < BestError )
+					{
+						BestError = e;
+						BestIndex = m;
+					}
+				}
+				Fit.mError += BestError;
+				Fit.mIndexes[y*4+x] = static_cast<uint8_t>( BestIndex );
+			}
+		}
+		if ( Fit.mError < Best.mError )
+			Best = Fit;
+	}
+	return Best;
+}
+
+//	etc blocks are big endian
+void PopWritePixels::Etc::WriteBlock(uint64_t Bits,uint8_t* Block)
+{
+	for ( int i=0;	i<8;	i++ )
+		Block[i] = static_cast<uint8_t>( Bits >> ((7-i)*8) );
+}
+
+//	individual & differential modes only, which are valid etc1 too
+void PopWritePixels::Etc::CompressColour(TCompressQuality::Type Quality,const uint8_t Rgba[16*4],uint8_t* Block)
+{
+	int BestError = INT32_MAX;
+	uint64_t BestBits = 0;
+
+	for ( int Flip=0;	Flip<2;	Flip++ )
+	{
+		float Average[2][3] = {};
+		for ( int y=0;	y<4;	y++ )
+			for ( int x=0;	x<4;	x++ )
+				for ( int c=0;	c<3;	c++ )
+					Average[InSubBlock(x,y,Flip!=0,0)?0:1][c] += Rgba[(y*4+x)*4+c] / 8.0f;
+
+		//	base colours to try, quantised, and whether they're differential
+		struct TCandidate
+		{
+			int		mQuantised[2][3];
+			bool	mDifferential;
+		};
+		TCandidate Candidates[6];
+		size_t CandidateCount = 0;
+
+		TCandidate Differential;
+		Differential.mDifferential = true;
+		bool DifferentialValid = true;
+		for ( int c=0;	c<3;	c++ )
+		{
+			Differential.mQuantised[0][c] = static_cast<int>( Average[0][c] * 31.0f / 255.0f + 0.5f );
+			Differential.mQuantised[1][c] = static_cast<int>( Average[1][c] * 31.0f / 255.0f + 0.5f );
+			auto Delta = Differential.mQuantised[1][c] - Differential.mQuantised[0][c];
+			if ( Delta < -4 || Delta > 3 )
+				DifferentialValid = false;
+		}
+		if ( DifferentialValid )
+			Candidates[CandidateCount++] = Differential;
+
+		TCandidate Individual;
+		Individual.mDifferential = false;
+		for ( int s=0;	s<2;	s++ )
+			for ( int c=0;	c<3;	c++ )
+				Individual.mQuantised[s][c] = static_cast<int>( Average[s][c] * 15.0f / 255.0f + 0.5f );
+		if ( !DifferentialValid || Quality != TCompressQuality::Fast )
+			Candidates[CandidateCount++] = Individual;
+
+		//	nudge the brightness of each half, as the clamped modifiers often suit a different base
+		if ( Quality == TCompressQuality::High )
+		{
+			for ( int Nudge=-1;	Nudge<=1;	Nudge+=2 )
+			{
+				for ( int s=0;	s<2;	s++ )
+				{
+					auto Nudged = Individual;
+					for ( int c=0;	c<3;	c++ )
+						Nudged.mQuantised[s][c] = std::min( 15, std::max( 0, Nudged.mQuantised[s][c] + Nudge ) );
+					Candidates[CandidateCount++] = Nudged;
+				}
+			}
+		}
+
+		for ( size_t CandidateIndex=0;	CandidateIndex<CandidateCount;	CandidateIndex++ )
+		{
+			auto& Candidate = Candidates[CandidateIndex];
+			int Base[2][3];
+			for ( int s=0;	s<2;	s++ )
+				for ( int c=0;	c<3;	c++ )
+					Base[s][c] = Candidate.mDifferential ? Expand5( Candidate.mQuantised[s][c] ) : Expand4( Candidate.mQuantised[s][c] );
+
+			auto Fit0 = FitSubBlock( Rgba, Flip!=0, 0, Base[0] );
+			auto Fit1 = FitSubBlock( Rgba, Flip!=0, 1, Base[1] );
+			auto Error = Fit0.mError + Fit1.mError;
+			if ( Error >= BestError )
+				continue;
+
+			uint64_t Bits = 0;
+			for ( int c=0;	c<3;	c++ )
+			{
+				auto Shift = 59 - (c*8);
+				if ( Candidate.mDifferential )
+				{
+					auto Delta = Candidate.mQuantised[1][c] - Candidate.mQuantised[0][c];
+					Bits |= static_cast<uint64_t>( Candidate.mQuantised[0][c] ) << Shift;
+					Bits |= static_cast<uint64_t>( Delta & 7 ) << (Shift-3);
+				}
+				else
+				{
+					Bits |= static_cast<uint64_t>( Candidate.mQuantised[0][c] ) << (Shift+1);
+					Bits |= static_cast<uint64_t>( Candidate.mQuantised[1][c] ) << (Shift-3);
+				}
+			}
+			Bits |= static_cast<uint64_t>( Fit0.mTable ) << 37;
+			Bits |= static_cast<uint64_t>( Fit1.mTable ) << 34;
+			Bits |= static_cast<uint64_t>( Candidate.mDifferential ? 1 : 0 ) << 33;
+			Bits |= static_cast<uint64_t>( Flip ) << 32;
+
+			//	indexes are column major; msbs in the top half
+			for ( int y=0;	y<4;	y++ )
+			{
+				for ( int x=0;	x<4;	x++ )
+				{
+					auto Texel = y*4+x;
+					auto Index = InSubBlock( x, y, Flip!=0, 0 ) ? Fit0.mIndexes[Texel] : Fit1.mIndexes[Texel];
+					auto Bit = x*4+y;
+					Bits |= static_cast<uint64_t>( Index >> 1 ) << (16+Bit);
+					Bits |= static_cast<uint64_t>( Index & 1 ) << Bit;
+				}
+			}
+
+			BestError = Error;
+			BestBits = Bits;
+		}
+	}
+
+	WriteBlock( BestBits, Block );
+}
+
+//	eac
+void PopWritePixels::Etc::CompressAlpha(TCompressQuality::Type Quality,const uint8_t Rgba[16*4],uint8_t* Block)
+{
+	int Min = 255;
+	int Max = 0;
+	for ( int i=0;	i<16;	i++ )
+	{
+		Min = std::min<int>( Min, Rgba[i*4+3] );
+		Max = std::max<int>( Max, Rgba[i*4+3] );
+	}
+
+	int BestError = INT32_MAX;
+	uint64_t BestBits = 0;
+	//	fast tries the widest & narrowest spread tables
+	static const int FastTables[] = { 3, 13 };
+	auto TableCount = Quality == TCompressQuality::Fast ? 2 : 16;
+	for ( int TableIndex=0;	TableIndex<TableCount;	TableIndex++ )
+	{
+		auto t = Quality == TCompressQuality::Fast ? FastTables[TableIndex] : TableIndex;
+		auto& Table = AlphaModifiers[t];
+		auto Range = Table[7] - Table[3];
+		auto Multiplier = std::min( 15, std::max( 1, ((Max - Min) + Range/2) / Range ) );
+		auto Base = Clamp255( static_cast<int>( std::lround( (Min + Max) / 2.0f - (Table[3] + Table[7]) * Multiplier / 2.0f ) ) );
+
+		int Error = 0;
+		uint64_t Bits = static_cast<uint64_t>( Base ) << 56;
+		Bits |= static_cast<uint64_t>( (Multiplier << 4) | t ) << 48;
+		for ( int y=0;	y<4;	y++ )
+		{
+			for ( int x=0;	x<4;	x++ )
+			{
+				int a = Rgba[(y*4+x)*4+3];
+				int BestIndex = 0;
+				int BestTexelError = INT32_MAX;
+				for ( int m=0;	m<8;	m++ )
+				{
+					auto e = std::abs( a - Clamp255( Base + Table[m] * Multiplier ) );
+					if ( e < BestTexelError )
+					{
+						BestTexelError = e;
+						BestIndex = m;
+					}
+				}
+				Error += BestTexelError * BestTexelError;
+				auto Bit = x*4+y;
+				Bits |= static_cast<uint64_t>( BestIndex ) << (45 - Bit*3);
+			}
+		}
+
+		if ( Error < BestError )
+		{
+			BestError = Error;
+			BestBits = Bits;
+		}
+	}
+
+	WriteBlock( BestBits, Block );
+}
+
+
+void PopWritePixels::CompressBlock(TBlockFormat::Type Format,TCompressQuality::Type Quality,const uint8_t Rgba[16*4],uint8_t* Block)
+{
+	switch ( Format )
+	{
+		case TBlockFormat::BC1:
+			Bc::CompressColour( Quality, Rgba, Block );
+			return;
+
+		case TBlockFormat::BC3:
+			Bc::CompressAlpha( Rgba, Block );
+			Bc::CompressColour( Quality, Rgba, Block+8 );
+			return;
+
+		case TBlockFormat::BC7:
+			Bc::CompressBc7( Quality, Rgba, Block );
+			return;
+
+		case TBlockFormat::Etc2Rgb:
+			Etc::CompressColour( Quality, Rgba, Block );
+			return;
+
+		case TBlockFormat::Etc2Rgba:
+			Etc::CompressAlpha( Quality, Rgba, Block );
+			Etc::CompressColour( Quality, Rgba, Block+8 );
+			return;
+
+		default:
+			break;
+	}
+	throw Soy::AssertException("Unknown block format");
+}
+
+void PopWritePixels::CompressBlockRows(TBlockFormat::Type Format,TCompressQuality::Type Quality,const uint8_t* Src,size_t Channels,size_t Width,size_t Height,size_t BlockRowFirst,size_t BlockRowCount,uint8_t* Dst)
+{
+	if ( Channels != 3 && Channels != 4 )
+		throw Soy::AssertException("Block compression needs 8 bit rgb or rgba");
+
+	auto BlockSize = GetBlockSize( Format );
+	auto BlockColumns = (Width + 3) / 4;
+	auto SrcRowSize = Width * Channels;
+	uint8_t Rgba[16*4];
+
+	for ( size_t by=BlockRowFirst;	by<BlockRowFirst+BlockRowCount;	by++ )
+	{
+		for ( size_t bx=0;	bx<BlockColumns;	bx++ )
+		{
+			for ( size_t y=0;	y<4;	y++ )
+			{
+				auto* Row = Src + std::min( by*4+y, Height-1 ) * SrcRowSize;
+				for ( size_t x=0;	x<4;	x++ )
+				{
+					auto* Texel = Row + std::min( bx*4+x, Width-1 ) * Channels;
+					auto* Out = &Rgba[(y*4+x)*4];
+					Out[0] = Texel[0];
+					Out[1] = Texel[1];
+					Out[2] = Texel[2];
+					Out[3] = Channels == 4 ? Texel[3] : 255;
+				}
+			}
+			CompressBlock( Format, Quality, Rgba, Dst );
+			Dst += BlockSize;
+		}
+	}
+}
+
+float PopWritePixels::BenchmarkBlockCompression(TBlockFormat::Type Format,TCompressQuality::Type Quality,size_t Width,size_t Height)
+{
+	if ( Width == 0 || Height == 0 )
+		throw Soy::AssertException("Benchmark image is empty");
+
+	//	gradients with some noise & hard edges, so blocks aren't all trivially flat
+	std::vector<uint8_t> Pixels( Width * Height * 4 );
+	uint32_t Noise = 1;
+	for ( size_t y=0;	y<Height;	y++ )
+	{
+		for ( size_t x=0;	x<Width;	x++ )
+		{
+			Noise = Noise * 1664525u + 1013904223u;
+			auto* Texel = &Pixels[(y*Width+x)*4];
+			auto Edge = ((x / 13) + (y / 7)) % 2 ? 40 : 0;
+			Texel[0] = static_cast<uint8_t>( Clamp255( static_cast<int>( x * 255 / Width ) + Edge ) );
+			Texel[1] = static_cast<uint8_t>( y * 255 / Height );
+			Texel[2] = static_cast<uint8_t>( Noise >> 24 );
+			Texel[3] = static_cast<uint8_t>( Clamp255( 255 - Edge*3 ) );
+		}
+	}
+	std::vector<uint8_t> Blocks( GetBlockDataSize( Format, Width, Height ) );
+
+	auto Start = GetMicrosecsNow();
+	CompressBlockRows( Format, Quality, Pixels.data(), 4, Width, Height, 0, (Height+3)/4, Blocks.data() );
+	auto Duration = std::max<uint64_t>( 1, GetMicrosecsNow() - Start );
+
+	//	pixels per microsecond is megapixels per second
+	return static_cast<float>( Width * Height ) / static_cast<float>( Duration );
+}
+
+
+
+TCompressRows::TCompressRows(TBlockFormat::Type Format,TCompressQuality::Type Quality,const uint8_t* Src,const SoyPixelsMeta& SrcMeta,std::shared_ptr<TPixelBuffer> Dst,size_t BandBlockRows) :
+	mFormat			( Format ),
+	mQuality		( Quality ),
+	mSrc			( Src ),
+	mSrcMeta		( SrcMeta ),
+	mDst			( Dst ),
+	mBandBlockRows	( std::max<size_t>( 1, BandBlockRows ) ),
+	mFailed			( false )
+{
+	mBlockRowCount = (mSrcMeta.GetHeight() + 3) / 4;
+	mBandCount = (mBlockRowCount + mBandBlockRows - 1) / mBandBlockRows;
+	mBandDone.reset( new std::atomic<bool>[mBandCount] );
+	for ( size_t b=0;	b<mBandCount;	b++ )
+		mBandDone[b] = false;
+}
+
+void TCompressRows::Start(TWorkerPool& Pool)
+{
+	//	the jobs keep us (and the output buffer) alive
+	auto This = shared_from_this();
+	for ( size_t b=0;	b<mBandCount;	b++ )
+	{
+		auto Job = [This,b]
+		{
+			This->CompressBand( b );
+		};
+		Pool.Push( Job );
+	}
+}
+
+void TCompressRows::CompressBand(size_t Band)
+{
+	try
+	{
+		auto BlockRowFirst = Band * mBandBlockRows;
+		auto BlockRowCount = std::min( mBandBlockRows, mBlockRowCount - BlockRowFirst );
+		auto BlockRowSize = PopWritePixels::GetBlockRowSize( mFormat, mSrcMeta.GetWidth() );
+		auto* Dst = mDst->mData + (BlockRowFirst * BlockRowSize);
+		PopWritePixels::CompressBlockRows( mFormat, mQuality, mSrc, mSrcMeta.GetChannels(), mSrcMeta.GetWidth(), mSrcMeta.GetHeight(), BlockRowFirst, BlockRowCount, Dst );
+		mBandDone[Band] = true;
+	}
+	catch(std::exception& e)
+	{
+		std::Debug << "Block compression failed: " << e.what() << std::endl;
+		mFailed = true;
+	}
+}
+
+size_t TCompressRows::GetRowsReady()
+{
+	if ( mFailed )
+		throw Soy::AssertException("Block compression failed");
+
+	while ( mBandsReady < mBandCount && mBandDone[mBandsReady] )
+		mBandsReady++;
+
+	return std::min( mSrcMeta.GetHeight(), mBandsReady * mBandBlockRows * 4 );
+}
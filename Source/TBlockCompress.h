@@ -0,0 +1,66 @@
+#pragma once
+
+#include "TCache.h"
+#include <atomic>
+#include <memory>
+
+
+class TWorkerPool;
+
+
+//	gr: matching values in c#
+namespace TCompressQuality
+{
+	enum Type
+	{
+		Fast = 0,		//	bounding box endpoints
+		Normal = 1,		//	principal axis endpoints
+		High = 2,		//	principal axis + least squares refinement & wider searches
+	};
+}
+
+
+namespace PopWritePixels
+{
+	size_t		GetBlockSize(TBlockFormat::Type Format);		//	bytes per 4x4 block
+	size_t		GetBlockRowSize(TBlockFormat::Type Format,size_t Width);
+	size_t		GetBlockDataSize(TBlockFormat::Type Format,size_t Width,size_t Height);
+	const char*	GetBlockFormatName(TBlockFormat::Type Format);
+
+	//	Rgba is 16 texels, row by row
+	void		CompressBlock(TBlockFormat::Type Format,TCompressQuality::Type Quality,const uint8_t Rgba[16*4],uint8_t* Block);
+
+	//	Src is 8 bit rgb or rgba (Channels), Width x Height. Edge blocks repeat the last texel
+	void		CompressBlockRows(TBlockFormat::Type Format,TCompressQuality::Type Quality,const uint8_t* Src,size_t Channels,size_t Width,size_t Height,size_t BlockRowFirst,size_t BlockRowCount,uint8_t* Dst);
+
+	//	single-thread encode rate of a synthetic image, in megapixels per second, for picking formats & presets per device
+	float		BenchmarkBlockCompression(TBlockFormat::Type Format,TCompressQuality::Type Quality,size_t Width,size_t Height);
+}
+
+
+//	compresses bands of block rows on worker threads; the render thread writes them as they're ready.
+//	rows ready are texel rows, so always multiples of 4 (or the height)
+class TCompressRows : public TRowProducer, public std::enable_shared_from_this<TCompressRows>
+{
+public:
+	TCompressRows(TBlockFormat::Type Format,TCompressQuality::Type Quality,const uint8_t* Src,const SoyPixelsMeta& SrcMeta,std::shared_ptr<TPixelBuffer> Dst,size_t BandBlockRows);
+
+	void			Start(TWorkerPool& Pool);
+	virtual size_t	GetRowsReady() override;
+
+private:
+	void			CompressBand(size_t Band);
+
+private:
+	TBlockFormat::Type				mFormat;
+	TCompressQuality::Type			mQuality;
+	const uint8_t*					mSrc;
+	SoyPixelsMeta					mSrcMeta;
+	std::shared_ptr<TPixelBuffer>	mDst;		//	keep the buffer ours until workers are done, even if the write is dropped
+	size_t							mBlockRowCount;
+	size_t							mBandBlockRows;
+	size_t							mBandCount;
+	std::unique_ptr<std::atomic<bool>[]>	mBandDone;
+	std::atomic<bool>				mFailed;
+	size_t							mBandsReady = 0;	//	contiguous from the top, render thread only
+};
@@ -0,0 +1,1081 @@
+#include "TCache.h"
+#include "THash.h"
+#include "TBlockCompress.h"
+#include "TWorkerPool.h"
+#include <algorithm>
+
+
+
+bool TCache::Used() const		
+{
+	if ( mTexturePtr )
+		return true;
+	if ( mTexture )
+		return true;
+	if ( mCreatingNewTexture )
+		return true;
+
+	return false;
+}
+
+void TCache::Release() 
+{
+	mTexturePtr = nullptr;	
+	mCreatingNewTexture = false; 
+	mBackendType = TTextureBackendType::Default;
+	mBlockFormat = TBlockFormat::None;
+	mTexture.reset();
+	mMipMode = TMipMode::Gpu;
+	mMipChain.reset();
+	mNextBytes.Clear();
+	mCurrentBytes.reset();
+	mProgress = 0;
+	mTileProgress = 0;
+	mMipProgress = 0;
+	mLastSubmission = 0;
+	mTileWidth = 0;
+	mTileHeight = 0;
+	mTileOrder = TTileOrder::RowMajor;
+	mWriteTilesPerFrame = 16;
+	mTileLayout.reset();
+	mWriteRate = TWriteRateMeter();
+	mLastWriteRowCount = 0;
+	mDetectChanges = false;
+	mChangeTileWidth = 0;
+	mRowHashes.clear();
+	mBytesSkipped = 0;
+	mFenceWaits = 0;
+	mNativeTexture = nullptr;
+	mMemoryBytes = 0;
+	mTelemetry.Reset();
+	mPriority = 0;
+	mDeadline = 0;
+	mFramesWaiting = 0;
+	mStream.reset();
+	mStreamConfig.reset();
+	delete mNextStream.exchange( nullptr );
+	DetachSharedTexture();
+	mContentDedupe = false;
+	mHandle = -1;
+	mLastUsedTime = 0;
+	mTextureFetched = false;
+	mEvictable = false;
+	mEvicted = false;
+
+	//	verify logic
+	if ( Used() )
+		throw Soy::AssertException("Post Release cache is still marked as used");
+}
+
+bool TSubmissionSlot::Push(std::shared_ptr<TPendingBytes> Pending)
+{
+	auto* Next = new std::shared_ptr<TPendingBytes>( Pending );
+	auto* Replaced = mNext.exchange( Next );
+	//	render thread never took it, so it's ours to free
+	delete Replaced;
+	return Replaced != nullptr;
+}
+
+std::shared_ptr<TPendingBytes> TSubmissionSlot::Pop()
+{
+	auto* Next = mNext.exchange( nullptr );
+	if ( !Next )
+		return nullptr;
+
+	auto Pending = *Next;
+	delete Next;
+	return Pending;
+}
+
+void TSubmissionSlot::Clear()
+{
+	delete mNext.exchange( nullptr );
+}
+
+
+void TCache::CheckBytes(TPendingBytes& Pending) const
+{
+	//	default to the whole texture
+	auto& Rect = Pending.mRect;
+	if ( Rect.mWidth == 0 && Rect.mHeight == 0 )
+		Rect = TTextureRect( 0, 0, mTextureMeta.GetWidth(), mTextureMeta.GetHeight() );
+	if ( Rect.mWidth == 0 || Rect.mHeight == 0 )
+		throw Soy::AssertException("Write region is empty");
+	if ( Rect.mX + Rect.mWidth > mTextureMeta.GetWidth() || Rect.mY + Rect.mHeight > mTextureMeta.GetHeight() )
+		throw Soy::AssertException("Write region outside texture");
+
+	if ( mBlockFormat != TBlockFormat::None )
+	{
+		if ( Rect.mWidth != mTextureMeta.GetWidth() || Rect.mHeight != mTextureMeta.GetHeight() )
+			throw Soy::AssertException("Compressed textures can only be written whole");
+		if ( Pending.mBytesSize < PopWritePixels::GetBlockDataSize( mBlockFormat, Rect.mWidth, Rect.mHeight ) )
+			throw Soy::AssertException("Not enough bytes for compressed texture");
+	}
+	else if ( Pending.mBytesSize < Rect.mWidth * Rect.mHeight * PopWritePixels::GetPixelSize( mTextureMeta ) )
+	{
+		throw Soy::AssertException("Not enough bytes for write region");
+	}
+
+	//	a region would write into a texture other caches may be showing
+	if ( mContentDedupe && ( Rect.mWidth != mTextureMeta.GetWidth() || Rect.mHeight != mTextureMeta.GetHeight() ) )
+		throw Soy::AssertException("Deduplicated caches can only be written whole");
+}
+
+void TCache::QueueBytes(std::shared_ptr<TPendingBytes> Pending)
+{
+	CheckBytes( *Pending );
+
+	Pending->mQueueTime = PopWritePixels::GetMicrosecsNow();
+	Pending->mMipMode = mMipMode;
+	Pending->mSubmission = mLastSubmission + 1;
+	//	publish the id first, so progress reads 0 until the render thread picks this up
+	mLastSubmission = Pending->mSubmission;
+	if ( Pending->mTimestamp == 0 )
+		Pending->mTimestamp = Pending->mQueueTime;
+
+	//	bytes still being produced can't be hashed yet, so they're written as usual
+	if ( mContentDedupe && !Pending->mProducer )
+	{
+		auto DataSize = mTextureMeta.GetDataSize();
+		if ( mBlockFormat != TBlockFormat::None )
+			DataSize = PopWritePixels::GetBlockDataSize( mBlockFormat, mTextureMeta.GetWidth(), mTextureMeta.GetHeight() );
+		Pending->mContentHash.reset( new TContentHash() );
+		Pending->mContentHash->Start( PopWritePixels::GetWorkerPool(), Pending, DataSize );
+	}
+
+	auto Replaced = mNextBytes.Push( Pending );
+	if ( mStreamConfig )
+	{
+		mStreamConfig->mFramesQueued++;
+		if ( Replaced )
+			mStreamConfig->mFramesDropped++;
+	}
+	mTelemetry.OnQueued();
+	PopWritePixels::GetPluginTelemetry().OnQueued();
+}
+
+size_t TCache::GetRowsWritten() const
+{
+	uint64_t Progress = mProgress;
+	auto Submission = static_cast<uint32_t>( Progress >> 32 );
+	auto Rows = static_cast<uint32_t>( Progress & 0xffffffff );
+
+	//	waiting for data, or the latest data hasn't started yet
+	if ( Submission == 0 || Submission != mLastSubmission )
+		return 0;
+
+	return Rows;
+}
+
+size_t TCache::GetTilesWritten() const
+{
+	uint64_t Progress = mTileProgress;
+	auto Submission = static_cast<uint32_t>( Progress >> 32 );
+	auto Tiles = static_cast<uint32_t>( Progress & 0xffffffff );
+
+	if ( Submission == 0 || Submission != mLastSubmission )
+		return 0;
+
+	return Tiles;
+}
+
+int TCache::GetResidentMip() const
+{
+	//	regions, followers & non-progressive writes only have level 0
+	if ( HasFinished() )
+		return 0;
+
+	uint64_t Progress = mMipProgress;
+	auto Submission = static_cast<uint32_t>( Progress >> 32 );
+	auto Levels = static_cast<uint32_t>( Progress & 0xffffffff );
+	if ( Submission == 0 || Submission != mLastSubmission )
+		return -1;
+
+	return static_cast<int>(Levels) - 1;
+}
+
+bool TCache::HasFinished() const
+{
+	auto RowsWritten = GetRowsWritten();
+	if ( RowsWritten < mTextureMeta.GetHeight() )
+		return false;
+
+	return true;
+}
+
+bool TCache::HasPendingWork() const
+{
+	if ( mNextBytes.HasPending() )
+		return true;
+
+	if ( mNextStream.load() )
+		return true;
+
+	if ( mStream && !mStream->mFrames.empty() )
+		return true;
+
+	if ( !mCurrentBytes )
+		return false;
+
+	return !mCurrentBytes->IsFinished();
+}
+
+size_t TCache::WritePixels(size_t MaxRows)
+{
+	try
+	{
+		auto Bytes = WriteNextBytes( MaxRows );
+		PublishTexture();
+		return Bytes;
+	}
+	catch(std::exception&)
+	{
+		PublishTexture();
+		//	tell the client once, it'll keep retrying (and throwing) like before
+		if ( mCurrentBytes && !mCurrentBytes->mFailureReported && !mStream )
+		{
+			mCurrentBytes->mFailureReported = true;
+			PushCompletion( *mCurrentBytes, TCompletionStatus::Failed, PopWritePixels::GetMicrosecsNow() );
+		}
+		throw;
+	}
+}
+
+void TCache::PublishTexture()
+{
+	mNativeTexture = mTexture ? mTexture->GetNativeTexture() : nullptr;
+	mMemoryBytes = GetMemoryBytes();
+	if ( mTexture )
+		mFenceWaits = mTexture->GetFenceWaits();
+}
+
+void TCache::PushCompletion(TPendingBytes& Pending,TCompletionStatus::Type Status,uint64_t Now)
+{
+	TCompletion Completion;
+	Completion.mCache = mHandle;
+	Completion.mStatus = Status;
+	Completion.mSubmission = Pending.mSubmission;
+	Completion.mRowsWritten = static_cast<uint32_t>( Pending.mRowsWritten );
+	Completion.mQueueTime = Pending.mQueueTime;
+	Completion.mFirstRowTime = Pending.mFirstRowTime;
+	Completion.mCompleteTime = Now;
+	PopWritePixels::GetCompletionQueue().Push( Completion );
+}
+
+size_t TCache::WriteNextBytes(size_t MaxRows)
+{
+	ApplyStreamMode();
+
+	//	frames are always written whole, so the budget doesn't apply
+	if ( mStream )
+		return WriteStreamFrame();
+
+	//	move onto the next submission once the current one is done (or there isn't one)
+	if ( !mCurrentBytes || mCurrentBytes->IsFinished() )
+	{
+		auto Next = mNextBytes.Pop();
+		if ( Next )
+		{
+			mCurrentBytes = Next;
+			mProgress = static_cast<uint64_t>(Next->mSubmission) << 32;
+			mTileProgress = static_cast<uint64_t>(Next->mSubmission) << 32;
+			mMipProgress = static_cast<uint64_t>(Next->mSubmission) << 32;
+			//	whatever this is changes the texture, which other caches may be using
+			DetachSharedTexture();
+			mEvicted = false;
+		}
+	}
+
+	if ( mCurrentBytes && mCurrentBytes->mContentHash && !mCurrentBytes->mDedupeResolved )
+	{
+		if ( !ResolveDedupe( *mCurrentBytes ) )
+			return 0;
+	}
+
+	return WriteCurrentBytes( MaxRows );
+}
+
+bool TCache::ResolveDedupe(TPendingBytes& Pending)
+{
+	auto& Hash = *Pending.mContentHash;
+	if ( !Hash.mReady )
+		return false;
+	Pending.mDedupeResolved = true;
+
+	TContentKey Key;
+	Key.mHash[0] = Hash.mHash[0];
+	Key.mHash[1] = Hash.mHash[1];
+	Key.mWidth = mTextureMeta.GetWidth();
+	Key.mHeight = mTextureMeta.GetHeight();
+	Key.mFormat = mTextureMeta.GetFormat();
+	Key.mBlockFormat = mBlockFormat;
+	Key.mMips = mEnableMips;
+	Key.mMipMode = Pending.mMipMode;
+	Key.mBackend = mBackendType;
+
+	auto& Dedupe = PopWritePixels::GetTextureDedupe();
+	Dedupe.mLookups++;
+	auto Shared = Dedupe.Find( Key );
+	if ( Shared )
+	{
+		Dedupe.mHits++;
+		if ( !Shared->IsComplete() )
+			Dedupe.mInFlightHits++;
+		Dedupe.mBytesSaved += Pending.mBytesSize;
+		mTexture = Shared->mTexture;
+		mRowHashes.clear();
+		mMipChain.reset();
+		mSharedTexture = Shared;
+		mSharedWriter = false;
+		return true;
+	}
+
+	//	first with this content, so we write it and anything matching follows.
+	//	the texture may not exist yet, it's made (within the memory budget) on the first write
+	Shared.reset( new TSharedTexture() );
+	Shared->mKey = Key;
+	Shared->mTexture = mTexture;
+	Shared->mWriting = true;
+	Dedupe.Register( Shared );
+	mSharedTexture = Shared;
+	mSharedWriter = true;
+	return true;
+}
+
+size_t TCache::FollowSharedTexture(TPendingBytes& Pending)
+{
+	//	only progress, the writer's doing the rows. Never goes backwards if it restarts
+	auto& Shared = *mSharedTexture;
+	if ( !mTexture )
+		mTexture = Shared.mTexture;
+	auto RowsWritten = std::min( Shared.mRowsWritten, Pending.mRect.mHeight );
+	if ( RowsWritten <= Pending.mRowsWritten )
+		return 0;
+	Pending.mRowsWritten = RowsWritten;
+
+	if ( Pending.IsFinished() )
+	{
+		Pending.mBuffer.reset();
+		Pending.mMappedFile.reset();
+		auto Now = PopWritePixels::GetMicrosecsNow();
+		mTelemetry.OnComplete( Now - Pending.mQueueTime );
+		PopWritePixels::GetPluginTelemetry().OnComplete( Now - Pending.mQueueTime );
+		PushCompletion( Pending, TCompletionStatus::Complete, Now );
+	}
+
+	mProgress = ( static_cast<uint64_t>(Pending.mSubmission) << 32 ) | static_cast<uint64_t>(RowsWritten);
+	return 0;
+}
+
+void TCache::DetachSharedTexture()
+{
+	if ( !mSharedTexture )
+		return;
+
+	auto& Shared = *mSharedTexture;
+	//	leaving part way through; the next cache with the same content takes over
+	if ( mSharedWriter && !Shared.IsComplete() )
+		Shared.mWriting = false;
+
+	if ( mSharedTexture.use_count() == 1 )
+	{
+		//	nobody else is using it, so keep the texture and just forget what's in it
+		PopWritePixels::GetTextureDedupe().Unregister( Shared );
+	}
+	else
+	{
+		mTexture.reset();
+		mRowHashes.clear();
+		mMipChain.reset();
+	}
+	mSharedTexture.reset();
+	mSharedWriter = false;
+}
+
+bool TCache::IsStreamFrameReady(TPendingBytes& Pending)
+{
+	if ( !Pending.mProducer )
+		return true;
+	return Pending.mProducer->GetRowsReady() >= Pending.mRect.mHeight;
+}
+
+void TCache::SetStreamMode(std::shared_ptr<TFrameStream> Stream)
+{
+	mStreamConfig = Stream;
+	//	latest wins, like mNextBytes
+	auto* Next = new std::shared_ptr<TFrameStream>( Stream );
+	delete mNextStream.exchange( Next );
+}
+
+void TCache::ApplyStreamMode()
+{
+	auto* Next = mNextStream.exchange( nullptr );
+	if ( !Next )
+		return;
+	auto Stream = *Next;
+	delete Next;
+
+	//	anything already written stays up until the first frame
+	if ( Stream && mTexture )
+	{
+		Stream->mRing[0] = mTexture;
+		Stream->mFrontTexture = mTexture->GetNativeTexture();
+	}
+	mStream = Stream;
+}
+
+size_t TCache::WriteStreamFrame()
+{
+	auto& Stream = *mStream;
+
+	//	the slot has already dropped anything queued before this
+	auto Next = mNextBytes.Pop();
+	if ( Next )
+		Stream.mFrames.push_back( Next );
+	while ( Stream.mFrames.size() > Stream.mQueueDepth )
+	{
+		Stream.mFrames.pop_front();
+		Stream.mFramesDropped++;
+	}
+
+	//	newest frame with all its rows produced; anything older is stale.
+	//	a frame whose conversion/decode failed is lost, rather than the stream
+	int Newest = -1;
+	for ( size_t i=0;	i<Stream.mFrames.size();	)
+	{
+		try
+		{
+			if ( IsStreamFrameReady( *Stream.mFrames[i] ) )
+				Newest = static_cast<int>(i);
+			i++;
+		}
+		catch(std::exception&)
+		{
+			Stream.mFrames.erase( Stream.mFrames.begin() + i );
+			Stream.mFramesDropped++;
+		}
+	}
+	if ( Newest < 0 )
+		return 0;
+
+	//	write into the texture after the front one. A client texture can't be ringed
+	auto RingSize = mTexturePtr ? 1 : Stream.mRing.size();
+	auto WriteIndex = (Stream.mFrontIndex + 1) % RingSize;
+	auto& RingTexture = Stream.mRing[WriteIndex];
+	if ( !RingTexture )
+	{
+		//	frames stay queued until there's room
+		if ( !MakeRoomForTexture() )
+			return 0;
+		RingTexture = PopWritePixels::AllocTextureBackend( mBackendType, mTexturePtr, mTextureMeta, mEnableMips, mBlockFormat );
+	}
+	//	frames also stay queued until the gpu has caught up with this texture's last upload
+	auto& FrameRect = Stream.mFrames[Newest]->mRect;
+	if ( !RingTexture->IsReadyToWrite( GetRowPitch( FrameRect ), FrameRect.mHeight ) )
+		return 0;
+
+	Stream.mFramesDropped += Newest;
+	mCurrentBytes = Stream.mFrames[Newest];
+	Stream.mFrames.erase( Stream.mFrames.begin(), Stream.mFrames.begin() + Newest + 1 );
+	mProgress = static_cast<uint64_t>(mCurrentBytes->mSubmission) << 32;
+	mTileProgress = static_cast<uint64_t>(mCurrentBytes->mSubmission) << 32;
+
+	if ( mTexture != RingTexture )
+	{
+		//	the hashes were of a different texture
+		mRowHashes.clear();
+		mTexture = RingTexture;
+	}
+
+	size_t BytesWritten = 0;
+	auto& Pending = *mCurrentBytes;
+	while ( !Pending.IsFinished() )
+	{
+		auto RowsBefore = Pending.mRowsWritten;
+		auto TilesBefore = Pending.mTilesWritten;
+		BytesWritten += WriteCurrentBytes( SIZE_MAX );
+		if ( Pending.mRowsWritten == RowsBefore && Pending.mTilesWritten == TilesBefore )
+			throw Soy::AssertException("Stream frame write made no progress");
+	}
+
+	//	present
+	auto Now = PopWritePixels::GetMicrosecsNow();
+	Stream.mFrontIndex = WriteIndex;
+	Stream.mFrontTexture = mTexture->GetNativeTexture();
+	Stream.mFramesPresented++;
+	Stream.mLatency.Add( Now - std::min( Now, Pending.mTimestamp ) );
+	return BytesWritten;
+}
+
+size_t TCache::GetRowPitch(const TTextureRect& Rect) const
+{
+	//	compressed textures are written in rows of blocks, this is then per texel row for the budgets
+	if ( mBlockFormat != TBlockFormat::None )
+		return PopWritePixels::GetBlockRowSize( mBlockFormat, Rect.mWidth ) / 4;
+	return Rect.mWidth * PopWritePixels::GetPixelSize( mTextureMeta );
+}
+
+size_t TCache::GetWriteRowCount(size_t RowPitch,size_t MaxRows,size_t ChunkRows) const
+{
+	size_t RowsPerFrame = mWriteRowsPerFrame;
+	auto WriteBudget = mWriteBudget;
+	if ( WriteBudget.IsEnabled() )
+		RowsPerFrame = WriteBudget.GetRowCount( RowPitch, mWriteRate, mLastWriteRowCount );
+	RowsPerFrame = std::max<size_t>( 1, std::min( RowsPerFrame, MaxRows ) );
+	if ( mBlockFormat != TBlockFormat::None )
+		RowsPerFrame = ((RowsPerFrame + 3) / 4) * 4;
+	if ( ChunkRows > 0 )
+		RowsPerFrame = ((RowsPerFrame + ChunkRows - 1) / ChunkRows) * ChunkRows;
+	return RowsPerFrame;
+}
+
+size_t TCache::GetWriteBytes(const TPendingBytes& Pending) const
+{
+	auto& Rect = Pending.mRect;
+	auto RowPitch = GetRowPitch( Rect );
+	auto Rows = GetWriteRowCount( RowPitch, SIZE_MAX, Pending.mChunkRows );
+
+	//	tiles are read a row of tiles at a time, whatever the budget
+	size_t TileWidth = mTileWidth;
+	if ( mBlockFormat == TBlockFormat::None && ( TileWidth > 0 || Pending.mTileLayout ) )
+	{
+		size_t TileHeight = mTileHeight;
+		Rows = TileHeight > 0 ? TileHeight : TileWidth;
+		if ( Pending.mTileLayout )
+			Rows = Pending.mTileLayout->mTileHeight;
+	}
+	return std::min( Rows, Rect.mHeight ) * RowPitch;
+}
+
+size_t TCache::WriteCurrentBytes(size_t MaxRows)
+{
+	if ( !mCurrentBytes )
+		throw Soy::AssertException("No queued texture bytes");
+
+	auto& Pending = *mCurrentBytes;
+	if ( Pending.IsFinished() )
+		return 0;
+
+	//	another cache is writing (or has written) this content into our texture
+	if ( mSharedTexture && !mSharedWriter )
+	{
+		if ( mSharedTexture->mWriting || mSharedTexture->IsComplete() )
+			return FollowSharedTexture( Pending );
+
+		//	its writer went away part way through; our bytes are the same, so carry on from the top
+		mSharedTexture->mWriting = true;
+		mSharedTexture->mRowsWritten = 0;
+		mSharedWriter = true;
+		Pending.mRowsWritten = 0;
+	}
+
+	auto& Rect = Pending.mRect;
+	bool Compressed = mBlockFormat != TBlockFormat::None;
+	auto RowPitch = GetRowPitch( Rect );
+	auto DataSize = RowPitch * Rect.mHeight;
+	if ( Compressed )
+		DataSize = PopWritePixels::GetBlockDataSize( mBlockFormat, Rect.mWidth, Rect.mHeight );
+	if ( Pending.mBytesSize < DataSize )
+		throw Soy::AssertException("Not enough bytes queued for the rows");
+
+	//	create a new texture if there isn't one (or wrap the client's)
+	if ( !mTexture )
+	{
+		if ( !MakeRoomForTexture() )
+			return 0;
+		mTexture = PopWritePixels::AllocTextureBackend( mBackendType, mTexturePtr, mTextureMeta, mEnableMips, mBlockFormat );
+		mRowHashes.clear();
+		mMipChain.reset();
+	}
+
+	//	tiles are written as regions, which compressed textures can't do
+	bool Tiled = ( mTileWidth > 0 || Pending.mTileLayout ) && !Compressed;
+	bool WholeTexture = Rect.mWidth == mTextureMeta.GetWidth() && Rect.mHeight == mTextureMeta.GetHeight();
+	//	regions fall back to gpu mips, as we'd need the rest of the texture to filter the edges
+	auto MipCount = mTexture->GetMipCount();
+	//	stream frames are written whole, so there's no time for a coarse texture to be seen
+	bool Progressive = Pending.mMipMode == TMipMode::Progressive && WholeTexture && !Compressed && !Tiled && !mStream && MipCount > 1;
+	bool MipsFirst = Progressive && !( Pending.mMipsStarted && Pending.mMipLevel == 0 );
+	auto RowFirst = Pending.mRowsWritten;
+	auto RowLast = RowFirst;
+	size_t RowsPerFrame = 0;
+
+	if ( !Tiled )
+	{
+		RowsPerFrame = GetWriteRowCount( RowPitch, MaxRows, Pending.mChunkRows );
+		RowLast = std::min<size_t>(RowFirst + RowsPerFrame, Rect.mHeight );
+		if ( MipsFirst )
+			RowLast = RowFirst;
+
+		//	only write what's been produced so far
+		if ( Pending.mProducer && !MipsFirst )
+		{
+			RowLast = std::min( RowLast, Pending.mProducer->GetRowsReady() );
+			if ( RowLast <= RowFirst )
+				return 0;
+		}
+	}
+	auto RowCount = RowLast - RowFirst;
+	//	rather than have the backend wait on the gpu, leave the rows for next frame
+	if ( !Tiled && !MipsFirst && RowCount > 0 && !mTexture->IsReadyToWrite( RowPitch, RowCount ) )
+		return 0;
+	size_t BytesWritten = RowCount * RowPitch;
+	size_t WriteCount = RowCount;		//	rows or tiles, for the budget
+	bool BakedMips = !Progressive && WholeTexture && !Compressed && MipCount > 1 && MipCount <= Pending.mBakedMips.size()+1;
+	bool CpuMips = Pending.mMipMode == TMipMode::Cpu && WholeTexture && !Compressed && MipCount > 1 && !BakedMips;
+
+	auto WriteStart = PopWritePixels::GetMicrosecsNow();
+	mLastUsedTime = WriteStart;
+	if ( Tiled )
+	{
+		BytesWritten = WriteTiles( Pending, MaxRows, WriteCount );
+		if ( WriteCount == 0 )
+			return 0;
+		RowLast = std::min( Rect.mHeight, Pending.mTileRowsComplete * Pending.mTileLayout->mTileHeight );
+	}
+	else if ( MipsFirst )
+	{
+		//	same budget as level 0 rows, so the smallest levels all go in the first frame
+		BytesWritten = WriteProgressiveMips( Pending, RowsPerFrame * RowPitch );
+		if ( BytesWritten == 0 )
+			return 0;
+		WriteCount = (BytesWritten + RowPitch - 1) / RowPitch;
+	}
+	else if ( Compressed )
+	{
+		auto BlockRowPitch = RowPitch * 4;
+		auto BlockRowFirst = RowFirst / 4;
+		auto BlockRowCount = ((RowLast + 3) / 4) - BlockRowFirst;
+		mTexture->WriteBlockRows( Pending.mBytes + (BlockRowFirst * BlockRowPitch), BlockRowPitch, BlockRowFirst, BlockRowCount );
+		BytesWritten = BlockRowCount * BlockRowPitch;
+	}
+	else if ( mDetectChanges && WholeTexture )
+	{
+		BytesWritten = WriteChangedRows( Pending, RowFirst, RowCount );
+		mBytesSkipped += (RowCount * RowPitch) - BytesWritten;
+	}
+	else if ( WholeTexture )
+	{
+		SoyPixelsRemote Pixels(Pending.mBytes, Pending.mBytesSize, mTextureMeta);
+		mTexture->Write( Pixels, RowFirst, RowCount );
+	}
+	else
+	{
+		//	hashes of these rows no longer match the texture
+		InvalidateRowHashes( TTextureRect( Rect.mX, Rect.mY + RowFirst, Rect.mWidth, RowCount ) );
+		TTextureRect WriteRect( Rect.mX, Rect.mY + RowFirst, Rect.mWidth, RowCount );
+		mTexture->WriteRect( Pending.mBytes + (RowFirst * RowPitch), RowPitch, WriteRect, 0 );
+	}
+
+	//	write the mip rows this band completes
+	if ( CpuMips )
+	{
+		if ( !mMipChain )
+			mMipChain.reset( new TMipChain( mTextureMeta, mTexture->GetMipCount() ) );
+		if ( RowFirst == 0 )
+			mMipChain->Reset();
+		BytesWritten += mMipChain->WriteRows( Pending.mBytes, RowLast, *mTexture );
+	}
+	else if ( BakedMips )
+	{
+		if ( RowFirst == 0 )
+			for ( auto& Mip : Pending.mBakedMips )
+				Mip.mRowsWritten = 0;
+		BytesWritten += WriteBakedMips( Pending, RowLast );
+	}
+	auto WriteEnd = PopWritePixels::GetMicrosecsNow();
+	auto WriteDuration = WriteEnd - WriteStart;
+	auto& PluginTelemetry = PopWritePixels::GetPluginTelemetry();
+	if ( BytesWritten > 0 )
+	{
+		mWriteRate.Add( BytesWritten, WriteDuration );
+		PopWritePixels::gWriteRate.Add( BytesWritten, WriteDuration );
+	}
+	mTelemetry.OnWrite( BytesWritten, WriteDuration );
+	PluginTelemetry.OnWrite( BytesWritten, WriteDuration );
+	if ( !Pending.mFirstRowWritten && ( RowLast > 0 || Pending.mTilesWritten > 0 || MipsFirst ) )
+	{
+		Pending.mFirstRowWritten = true;
+		Pending.mFirstRowTime = WriteEnd;
+		mTelemetry.OnFirstRow( WriteEnd - Pending.mQueueTime );
+		PluginTelemetry.OnFirstRow( WriteEnd - Pending.mQueueTime );
+	}
+	mLastWriteRowCount = WriteCount;
+
+	//	only generate mip maps on last row
+	//	gr: we used to also generate on first, to produce the resource view early, but the backend does that now
+	//	gpu can't render into compressed textures, so they just get level 0
+	if ( !CpuMips && !BakedMips && !Progressive && !Compressed && RowLast == Rect.mHeight && RowFirst < RowLast )
+		mTexture->GenerateMips();
+	//	every level is there now
+	if ( Progressive && RowLast == Rect.mHeight && RowFirst < RowLast )
+		mTexture->SetMinMipLevel( 0 );
+
+	Pending.mRowsWritten = RowLast;
+	if ( mSharedTexture && mSharedWriter )
+	{
+		if ( !mSharedTexture->mTexture )
+			mSharedTexture->mTexture = mTexture;
+		mSharedTexture->mRowsWritten = RowLast;
+		if ( mSharedTexture->IsComplete() )
+			mSharedTexture->mWriting = false;
+	}
+
+	//	have the os read in the chunk we'll want next frame while the gpu gets on with this one
+	if ( Pending.mMappedFile && !Pending.IsFinished() )
+	{
+		//	the bytes aren't always at the start of the mapping (eg. a baked container's level 0)
+		auto BytesOffset = Pending.mBytes - Pending.mMappedFile->GetData();
+		Pending.mMappedFile->WillNeed( BytesOffset + (RowLast * RowPitch), GetWriteBytes( Pending ) );
+	}
+
+	//	give pooled memory back as soon as we're done with it
+	if ( Pending.IsFinished() )
+	{
+		Pending.mBuffer.reset();
+		Pending.mProducer.reset();
+		Pending.mMappedFile.reset();
+		Pending.mBakedMips.clear();
+		Pending.mMipBuild.reset();
+		mTelemetry.OnComplete( WriteEnd - Pending.mQueueTime );
+		PluginTelemetry.OnComplete( WriteEnd - Pending.mQueueTime );
+		//	stream frames are presented rather than completed, see GetStreamStats
+		if ( !mStream )
+			PushCompletion( Pending, TCompletionStatus::Complete, WriteEnd );
+	}
+
+	//	rows outside a region count as written, so we're finished at the texture's height
+	auto RowsWritten = mTextureMeta.GetHeight() - (Rect.mHeight - RowLast);
+	mProgress = ( static_cast<uint64_t>(Pending.mSubmission) << 32 ) | static_cast<uint64_t>(RowsWritten);
+	if ( Tiled )
+		mTileProgress = ( static_cast<uint64_t>(Pending.mSubmission) << 32 ) | static_cast<uint64_t>(Pending.mTilesWritten);
+	return BytesWritten;
+}
+
+
+bool TCache::MakeRoomForTexture()
+{
+	//	wrapping the client's texture doesn't allocate one
+	if ( mTexturePtr )
+		return true;
+	auto Bytes = PopWritePixels::GetTextureBytes( mTextureMeta, mEnableMips, mBlockFormat );
+	return PopWritePixels::GetMemoryBudget().MakeRoom( Bytes );
+}
+
+size_t TCache::GetMemoryBytes() const
+{
+	size_t Bytes = 0;
+	//	our texture is one of the ring's
+	if ( mStream )
+	{
+		for ( auto& Texture : mStream->mRing )
+			if ( Texture )
+				Bytes += Texture->GetTextureBytes() + Texture->GetStagingBytes();
+		return Bytes;
+	}
+
+	if ( mTexture )
+		Bytes += mTexture->GetTextureBytes() + mTexture->GetStagingBytes();
+	return Bytes;
+}
+
+bool TCache::IsEvictable() const
+{
+	if ( mTexturePtr || !mTexture || mStream )
+		return false;
+	if ( HasPendingWork() )
+		return false;
+
+	//	a deduplicated cache is showing it too (the registry holds one reference of its own)
+	auto Users = mTexture.use_count() - ( mSharedTexture ? 1 : 0 );
+	if ( Users > 1 )
+		return false;
+
+	if ( mTextureFetched && !mEvictable )
+		return false;
+	return true;
+}
+
+size_t TCache::Evict()
+{
+	auto Bytes = GetMemoryBytes();
+	DetachSharedTexture();
+	mTexture.reset();
+	mMipChain.reset();
+	mRowHashes.clear();
+	mCurrentBytes.reset();
+
+	//	progress reads 0 again until the client queues something
+	mProgress = static_cast<uint64_t>(mLastSubmission.load()) << 32;
+	mTileProgress = static_cast<uint64_t>(mLastSubmission.load()) << 32;
+	mMipProgress = static_cast<uint64_t>(mLastSubmission.load()) << 32;
+	mEvicted = true;
+	PublishTexture();
+	return Bytes;
+}
+
+
+size_t TCache::WriteTiles(TPendingBytes& Pending,size_t MaxRows,size_t& TileCount)
+{
+	auto& Rect = Pending.mRect;
+	auto PixelSize = PopWritePixels::GetPixelSize( mTextureMeta );
+	auto RowPitch = Rect.mWidth * PixelSize;
+
+	//	fix the layout for this submission on its first write
+	if ( !Pending.mTileLayout )
+	{
+		size_t TileWidth = mTileWidth;
+		size_t TileHeight = mTileHeight;
+		TTileOrder::Type TileOrder = mTileOrder;
+		//	tiling was turned off since WriteCurrentBytes looked; rows from next frame
+		if ( TileWidth == 0 )
+		{
+			TileCount = 0;
+			return 0;
+		}
+		if ( TileHeight == 0 )
+			TileHeight = TileWidth;
+		if ( !mTileLayout || !mTileLayout->IsSame( Rect.mWidth, Rect.mHeight, TileWidth, TileHeight, TileOrder ) )
+			mTileLayout.reset( new TTileLayout( Rect.mWidth, Rect.mHeight, TileWidth, TileHeight, TileOrder ) );
+		Pending.mTileLayout = mTileLayout;
+		Pending.mTileRowTilesWritten.assign( mTileLayout->mRows, 0 );
+	}
+	auto& Layout = *Pending.mTileLayout;
+
+	auto TileBytes = Layout.mTileWidth * Layout.mTileHeight * PixelSize;
+	size_t TilesPerFrame = mWriteTilesPerFrame;
+	auto WriteBudget = mWriteBudget;
+	if ( WriteBudget.IsEnabled() )
+		TilesPerFrame = WriteBudget.GetRowCount( TileBytes, mWriteRate, mLastWriteRowCount );
+	//	scheduler limits are in texture rows
+	if ( MaxRows != SIZE_MAX )
+		TilesPerFrame = std::min( TilesPerFrame, (MaxRows * mTextureMeta.GetRowDataSize()) / TileBytes );
+	TilesPerFrame = std::max<size_t>( 1, TilesPerFrame );
+
+	auto RowsReady = Pending.mProducer ? Pending.mProducer->GetRowsReady() : Rect.mHeight;
+
+	size_t BytesWritten = 0;
+	TileCount = 0;
+	while ( TileCount < TilesPerFrame && Pending.mTilesWritten < Layout.GetTileCount() )
+	{
+		size_t Column;
+		size_t Row;
+		Layout.GetTile( Pending.mTilesWritten, Column, Row );
+		auto x = Column * Layout.mTileWidth;
+		auto y = Row * Layout.mTileHeight;
+		auto Width = std::min( Layout.mTileWidth, Rect.mWidth - x );
+		auto Height = std::min( Layout.mTileHeight, Rect.mHeight - y );
+
+		//	in order, so stop at the first tile that hasn't been produced
+		if ( y + Height > RowsReady )
+			break;
+
+		TTextureRect TileRect( Rect.mX + x, Rect.mY + y, Width, Height );
+		InvalidateRowHashes( TileRect );
+		mTexture->WriteRect( Pending.mBytes + (y * RowPitch) + (x * PixelSize), RowPitch, TileRect, 0 );
+		BytesWritten += Width * Height * PixelSize;
+
+		Pending.mTilesWritten++;
+		Pending.mTileRowTilesWritten[Row]++;
+		TileCount++;
+	}
+
+	while ( Pending.mTileRowsComplete < Layout.mRows && Pending.mTileRowTilesWritten[Pending.mTileRowsComplete] == Layout.mColumns )
+		Pending.mTileRowsComplete++;
+
+	return BytesWritten;
+}
+
+
+void TCache::InvalidateRowHashes(const TTextureRect& Rect)
+{
+	if ( mRowHashes.empty() )
+		return;
+
+	auto Columns = mRowHashes.size() / mTextureMeta.GetHeight();
+	for ( size_t y=Rect.mY;	y<Rect.mY+Rect.mHeight;	y++ )
+		for ( size_t c=0;	c<Columns;	c++ )
+			mRowHashes[ y*Columns + c ] = 0;
+}
+
+
+size_t TCache::WriteBakedMips(TPendingBytes& Pending,size_t Level0RowsReady)
+{
+	size_t BytesWritten = 0;
+	auto LevelCount = std::min( Pending.mBakedMips.size(), mTexture->GetMipCount()-1 );
+	auto ParentHeight = mTextureMeta.GetHeight();
+	auto ParentRowsReady = Level0RowsReady;
+
+	for ( size_t l=0;	l<LevelCount;	l++ )
+	{
+		auto& Mip = Pending.mBakedMips[l];
+
+		//	the rows TMipChain could build from the parent rows so far
+		auto RowsReady = ParentRowsReady / 2;
+		if ( ParentRowsReady == ParentHeight )
+			RowsReady = Mip.mHeight;
+		RowsReady = std::min( RowsReady, Mip.mHeight );
+
+		auto RowFirst = Mip.mRowsWritten;
+		if ( RowsReady <= RowFirst )
+			break;
+
+		TTextureRect Rect( 0, RowFirst, Mip.mWidth, RowsReady - RowFirst );
+		mTexture->WriteRect( Mip.mBytes + RowFirst*Mip.mRowPitch, Mip.mRowPitch, Rect, l+1 );
+		BytesWritten += Rect.mHeight * Mip.mRowPitch;
+		Mip.mRowsWritten = RowsReady;
+
+		ParentHeight = Mip.mHeight;
+		ParentRowsReady = RowsReady;
+	}
+	return BytesWritten;
+}
+
+size_t TCache::WriteProgressiveMips(TPendingBytes& Pending,size_t MaxBytes)
+{
+	auto MipCount = mTexture->GetMipCount();
+	bool Baked = MipCount <= Pending.mBakedMips.size()+1;
+
+	//	otherwise every level needs all of level 0, so wait for it and build them on a worker
+	if ( !Baked && !Pending.mMipBuild )
+	{
+		if ( Pending.mProducer && Pending.mProducer->GetRowsReady() < Pending.mRect.mHeight )
+			return 0;
+		//	a build for an earlier submission may still be using the last chain
+		if ( !mMipChain || mMipChain.use_count() > 1 )
+			mMipChain.reset( new TMipChain( mTextureMeta, MipCount ) );
+		Pending.mMipBuild.reset( new TMipBuild() );
+		Pending.mMipBuild->Start( PopWritePixels::GetWorkerPool(), mCurrentBytes, mMipChain );
+	}
+	if ( !Baked && !Pending.mMipBuild->mReady )
+		return 0;
+
+	if ( !Pending.mMipsStarted )
+	{
+		Pending.mMipsStarted = true;
+		Pending.mMipLevel = MipCount-1;
+		Pending.mMipRowsWritten = 0;
+	}
+
+	size_t BytesWritten = 0;
+	while ( Pending.mMipLevel > 0 && BytesWritten < MaxBytes )
+	{
+		auto Level = Pending.mMipLevel;
+		const uint8_t* Bytes = nullptr;
+		size_t Width = 0;
+		size_t Height = 0;
+		size_t RowPitch = 0;
+		if ( Baked )
+		{
+			auto& Mip = Pending.mBakedMips[Level-1];
+			Bytes = Mip.mBytes;
+			Width = Mip.mWidth;
+			Height = Mip.mHeight;
+			RowPitch = Mip.mRowPitch;
+		}
+		else
+		{
+			auto& Chain = *Pending.mMipBuild->mChain;
+			auto MipMeta = Chain.GetMipMeta( Level );
+			Bytes = Chain.GetMipPixels( Level );
+			Width = MipMeta.GetWidth();
+			Height = MipMeta.GetHeight();
+			RowPitch = MipMeta.GetRowDataSize();
+		}
+
+		auto RowFirst = Pending.mMipRowsWritten;
+		auto RowCount = std::max<size_t>( 1, (MaxBytes - BytesWritten) / RowPitch );
+		RowCount = std::min( RowCount, Height - RowFirst );
+		TTextureRect Rect( 0, RowFirst, Width, RowCount );
+		mTexture->WriteRect( Bytes + RowFirst*RowPitch, RowPitch, Rect, Level );
+		BytesWritten += RowCount * RowPitch;
+		Pending.mMipRowsWritten += RowCount;
+		if ( Pending.mMipRowsWritten < Height )
+			break;
+
+		//	this level's complete, so it can be sampled
+		mTexture->SetMinMipLevel( Level );
+		mMipProgress = ( static_cast<uint64_t>(Pending.mSubmission) << 32 ) | static_cast<uint64_t>(Level+1);
+		Pending.mMipLevel--;
+		Pending.mMipRowsWritten = 0;
+	}
+	return BytesWritten;
+}
+
+size_t TCache::WriteChangedRows(TPendingBytes& Pending,size_t RowFirst,size_t RowCount)
+{
+	auto Width = mTextureMeta.GetWidth();
+	auto PixelSize = PopWritePixels::GetPixelSize( mTextureMeta );
+	auto RowPitch = mTextureMeta.GetRowDataSize();
+	size_t ChangeTileWidth = mChangeTileWidth;
+	auto TileWidth = ChangeTileWidth > 0 ? std::min( ChangeTileWidth, Width ) : Width;
+	auto Columns = (Width + TileWidth - 1) / TileWidth;
+	if ( mRowHashes.size() != Columns * mTextureMeta.GetHeight() )
+		mRowHashes.assign( Columns * mTextureMeta.GetHeight(), 0 );
+
+	size_t BytesWritten = 0;
+
+	//	consecutive changed rows are written together, spanning the union of their changed tiles
+	size_t BandFirst = 0;
+	size_t BandCount = 0;
+	size_t BandColumnFirst = Columns;
+	size_t BandColumnLast = 0;
+	auto FlushBand = [&]()
+	{
+		if ( BandCount == 0 )
+			return;
+		auto x = BandColumnFirst * TileWidth;
+		auto Right = std::min( Width, (BandColumnLast+1) * TileWidth );
+		TTextureRect Rect( x, BandFirst, Right - x, BandCount );
+		auto* Bytes = Pending.mBytes + (BandFirst * RowPitch) + (x * PixelSize);
+		mTexture->WriteRect( Bytes, RowPitch, Rect, 0 );
+		BytesWritten += Rect.mWidth * PixelSize * Rect.mHeight;
+		BandCount = 0;
+		BandColumnFirst = Columns;
+		BandColumnLast = 0;
+	};
+
+	try
+	{
+		for ( size_t y=RowFirst;	y<RowFirst+RowCount;	y++ )
+		{
+			bool RowChanged = false;
+			auto* Row = Pending.mBytes + (y * RowPitch);
+			for ( size_t c=0;	c<Columns;	c++ )
+			{
+				auto x = c * TileWidth;
+				auto TileBytes = (std::min( Width, x + TileWidth ) - x) * PixelSize;
+				auto Hash = PopWritePixels::HashBytes( Row + (x*PixelSize), TileBytes );
+				if ( Hash == 0 )
+					Hash = 1;
+				auto& OldHash = mRowHashes[ y*Columns + c ];
+				if ( Hash == OldHash )
+					continue;
+				OldHash = Hash;
+				RowChanged = true;
+				BandColumnFirst = std::min( BandColumnFirst, c );
+				BandColumnLast = std::max( BandColumnLast, c );
+			}
+
+			if ( RowChanged )
+			{
+				if ( BandCount == 0 )
+					BandFirst = y;
+				BandCount++;
+			}
+			else
+			{
+				FlushBand();
+			}
+		}
+		FlushBand();
+	}
+	catch(...)
+	{
+		//	don't know what made it into the texture any more
+		mRowHashes.clear();
+		throw;
+	}
+
+	return BytesWritten;
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+#include "TTextureBackend.h"
+#include "TWriteBudget.h"
+#include "TPixelBufferPool.h"
+#include "TMipChain.h"
+#include "TTileLayout.h"
+#include "TTelemetry.h"
+#include "TMappedFile.h"
+#include "TFrameStream.h"
+#include "TTextureDedupe.h"
+#include "TCompletionQueue.h"
+#include "TMemoryBudget.h"
+#include "TBakedTexture.h"
+#include <SoyPixels.h>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <vector>
+
+
+//	something still filling in mBytes on another thread (conversion, decoding...)
+class TRowProducer
+{
+public:
+	virtual ~TRowProducer()	{}
+
+	//	rows from the top which are ready to write. Throws if production failed
+	virtual size_t	GetRowsReady()=0;
+};
+
+
+class TPendingBytes
+{
+public:
+	uint8_t*	mBytes = 0;
+	size_t		mBytesSize = 0;
+	size_t		mRowsWritten = 0;		//	render thread only
+	uint32_t	mSubmission = 0;
+	uint64_t	mQueueTime = 0;			//	PopWritePixels::GetMicrosecsNow() when queued
+	uint64_t	mTimestamp = 0;			//	capture time in the same clock, for stream latency. 0 = mQueueTime
+	bool		mFirstRowWritten = false;
+	uint64_t	mFirstRowTime = 0;
+	bool		mFailureReported = false;	//	render thread
+	TTextureRect	mRect;					//	where in the texture mBytes goes. Usually all of it
+	std::shared_ptr<TPixelBuffer>	mBuffer;	//	if the bytes are a pooled buffer, this keeps it leased until written
+	std::shared_ptr<TRowProducer>	mProducer;	//	null if all rows are ready
+	std::shared_ptr<TMappedFile>	mMappedFile;	//	if the bytes are a file mapping, this keeps it mapped until written
+	std::shared_ptr<TContentHash>	mContentHash;	//	when deduplicating, nothing is written until this is ready
+	bool		mDedupeResolved = false;		//	render thread
+	size_t		mChunkRows = 0;				//	when set, rows are written in whole chunks of this many (see TBakedHeader)
+	std::vector<TBakedMip>	mBakedMips;		//	[0] is level 1. Written instead of generating mips, when the texture has no more levels than these
+
+	//	the cache's mode when this was queued, so SetMipMode applies from the next submission rather than part way through one.
+	//	TMipMode::Progressive writes the mips first, smallest first, then level 0 as usual
+	TMipMode::Type	mMipMode = TMipMode::Gpu;
+	bool		mMipsStarted = false;		//	render thread
+	size_t		mMipLevel = 0;				//	render thread. being written, 0 once the mips are done
+	size_t		mMipRowsWritten = 0;		//	render thread
+	std::shared_ptr<TMipBuild>	mMipBuild;	//	building them from level 0, when they're not baked
+
+	//	when written in tiles, the layout is fixed for the submission once started
+	std::shared_ptr<TTileLayout>	mTileLayout;
+	size_t		mTilesWritten = 0;
+	std::vector<size_t>	mTileRowTilesWritten;	//	per row of tiles
+	size_t		mTileRowsComplete = 0;			//	contiguous from the top
+
+	bool		IsFinished() const		{	return mRowsWritten >= mRect.mHeight;	}
+};
+
+
+//	lock-free handoff from the main thread (single producer) to the render thread (single consumer)
+//	latest wins; a submission the render thread hasn't taken yet is replaced
+class TSubmissionSlot
+{
+public:
+	TSubmissionSlot() : mNext(nullptr)	{}
+	~TSubmissionSlot()					{	Clear();	}
+
+	bool							Push(std::shared_ptr<TPendingBytes> Pending);	//	returns true if it replaced one
+	std::shared_ptr<TPendingBytes>	Pop();
+	bool							HasPending() const	{	return mNext.load() != nullptr;	}
+	void							Clear();
+
+private:
+	std::atomic<std::shared_ptr<TPendingBytes>*>	mNext;
+};
+
+class TCache
+{
+public:
+	TCache() :
+		mWriteRowsPerFrame	( 256 ),
+		mLastWriteRowCount	( 0 ),
+		mNextStream		( nullptr ),
+		mLastSubmission	( 0 ),
+		mProgress		( 0 ),
+		mTileProgress	( 0 ),
+		mMipProgress	( 0 ),
+		mTileWidth		( 0 ),
+		mTileHeight		( 0 ),
+		mTileOrder		( TTileOrder::RowMajor ),
+		mWriteTilesPerFrame	( 16 ),
+		mDetectChanges	( false ),
+		mChangeTileWidth	( 0 ),
+		mBytesSkipped	( 0 ),
+		mFenceWaits		( 0 ),
+		mNativeTexture	( nullptr ),
+		mMemoryBytes	( 0 ),
+		mLastUsedTime	( 0 ),
+		mTextureFetched	( false ),
+		mEvictable		( false ),
+		mEvicted		( false ),
+		mPriority		( 0 ),
+		mDeadline		( 0 )
+	{
+	}
+	~TCache()
+	{
+		delete mNextStream.exchange( nullptr );
+	}
+
+	bool			Used() const;
+	void			Release();
+	bool			HasFinished() const;
+	bool			HasPendingWork() const;				//	render thread
+	size_t			GetRowsWritten() const;				//	progress of the last queued submission, any thread
+	size_t			GetTilesWritten() const;			//	as above, when written in tiles
+	int				GetResidentMip() const;				//	finest level of the last queued submission that's complete, -1 for none
+	void			CheckBytes(TPendingBytes& Pending) const;		//	fills in the default region, throws if it can't be queued
+	void			QueueBytes(std::shared_ptr<TPendingBytes> Pending);	//	main thread, never blocks
+	void			SetStreamMode(std::shared_ptr<TFrameStream> Stream);	//	main thread, null to stop streaming
+	size_t			WritePixels(size_t MaxRows=SIZE_MAX);	//	returns bytes written
+	size_t			GetMemoryBytes() const;				//	texture(s) & staging. Shared textures count in each cache
+	//	bytes of Pending the next write reads, to prefetch a mapped file. Before it's queued, or on the render thread
+	size_t			GetWriteBytes(const TPendingBytes& Pending) const;
+	bool			IsEvictable() const;				//	render thread
+	size_t			Evict();							//	render thread. returns bytes it was using
+
+private:
+	size_t			WriteNextBytes(size_t MaxRows);
+	size_t			WriteCurrentBytes(size_t MaxRows);
+	size_t			GetRowPitch(const TTextureRect& Rect) const;	//	queued bytes per texel row of Rect
+	size_t			GetWriteRowCount(size_t RowPitch,size_t MaxRows,size_t ChunkRows) const;	//	from the budget or rows per frame
+	void			PushCompletion(TPendingBytes& Pending,TCompletionStatus::Type Status,uint64_t Now);
+	void			ApplyStreamMode();					//	takes up the last SetStreamMode
+	size_t			WriteStreamFrame();					//	returns bytes written
+	bool			IsStreamFrameReady(TPendingBytes& Pending);	//	throws if it failed
+	size_t			WriteChangedRows(TPendingBytes& Pending,size_t RowFirst,size_t RowCount);
+	size_t			WriteTiles(TPendingBytes& Pending,size_t MaxRows,size_t& TileCount);	//	returns bytes
+	void			InvalidateRowHashes(const TTextureRect& Rect);
+	bool			ResolveDedupe(TPendingBytes& Pending);		//	false until the hash is ready
+	size_t			FollowSharedTexture(TPendingBytes& Pending);
+	void			DetachSharedTexture();
+	size_t			WriteBakedMips(TPendingBytes& Pending,size_t Level0RowsReady);	//	returns bytes written
+	size_t			WriteProgressiveMips(TPendingBytes& Pending,size_t MaxBytes);	//	returns bytes written
+	bool			MakeRoomForTexture();				//	false to wait a frame
+	void			PublishTexture();					//	render thread, after anything that may have replaced mTexture
+
+public:
+	int				mHandle = -1;			//	for completions
+	std::atomic<size_t>	mWriteRowsPerFrame;	//	this & the budget are set from the main thread
+	TWriteBudget	mWriteBudget;			//	when enabled, replaces mWriteRowsPerFrame
+	TWriteRateMeter	mWriteRate;
+	std::atomic<size_t>	mLastWriteRowCount;	//	render thread, read when sizing a prefetch
+	bool			mEnableMips = true;		//	for new texture
+	TBlockFormat::Type	mBlockFormat = TBlockFormat::None;	//	texture is compressed; queued bytes are then blocks, mTextureMeta describes the source
+	TMipMode::Type	mMipMode = TMipMode::Gpu;	//	main thread, each submission takes it as it's queued
+	std::shared_ptr<TMipChain>			mMipChain;		//	cpu mip levels, when mMipMode is Cpu or Progressive
+	bool			mCreatingNewTexture = false;
+	TTextureBackendType::Type			mBackendType = TTextureBackendType::Default;
+	std::shared_ptr<TTextureBackend>	mTexture;		//	created on first write as it may need the render thread
+	void*			mTexturePtr = nullptr;
+	SoyPixelsMeta	mTextureMeta;
+	TSubmissionSlot					mNextBytes;			//	queued while mCurrentBytes is still uploading
+	std::atomic<std::shared_ptr<TFrameStream>*>	mNextStream;	//	SetStreamMode the render thread hasn't taken yet. Holds null to stop streaming
+	std::shared_ptr<TPendingBytes>	mCurrentBytes;		//	render thread only
+	std::atomic<uint32_t>			mLastSubmission;	//	last id queued
+	std::atomic<uint64_t>			mProgress;			//	submission<<32 | rows written, so reads can't tear
+	std::atomic<uint64_t>			mTileProgress;		//	submission<<32 | tiles written
+	std::atomic<uint64_t>			mMipProgress;		//	submission<<32 | finest complete mip+1, while progressive mips are written
+
+	//	when mTileWidth is set, writes are split into 2D tiles rather than rows, and the
+	//	per-frame amount (or budget) is in tiles. For textures too wide for even a row a frame.
+	//	Set from the main thread, a submission's layout is fixed on its first write
+	std::atomic<size_t>				mTileWidth;
+	std::atomic<size_t>				mTileHeight;
+	std::atomic<TTileOrder::Type>	mTileOrder;
+	std::atomic<size_t>				mWriteTilesPerFrame;
+	std::shared_ptr<TTileLayout>	mTileLayout;		//	last layout, reused while the settings match
+
+	//	when enabled, rows (split into tiles of mChangeTileWidth, 0 = whole row) are hashed
+	//	and only the ones which differ from the last submission are written. Set from the main thread
+	std::atomic<bool>		mDetectChanges;
+	std::atomic<size_t>		mChangeTileWidth;
+	std::vector<uint64_t>	mRowHashes;			//	row * tile column. 0 = unknown
+	std::atomic<uint64_t>	mBytesSkipped;
+	std::atomic<uint64_t>	mFenceWaits;		//	copied from mTexture by the render thread, for GetCacheStats
+
+	//	mTexture is only for the render thread; other threads read these, which it publishes (see PublishTexture)
+	std::atomic<void*>		mNativeTexture;
+	std::atomic<uint64_t>	mMemoryBytes;		//	GetMemoryBytes()
+
+	TTelemetry		mTelemetry;
+
+	//	when set, queued bytes are a stream of frames rather than one-shot writes. Set before queueing.
+	//	The render thread takes a new stream up on its next write, so each thread has its own reference
+	std::shared_ptr<TFrameStream>	mStream;			//	render thread
+	std::shared_ptr<TFrameStream>	mStreamConfig;		//	main thread, the last one set
+
+	//	when enabled, whole-texture submissions are hashed and share the texture of any other
+	//	cache with identical content (and meta) instead of uploading it again
+	bool			mContentDedupe = false;
+	std::shared_ptr<TSharedTexture>	mSharedTexture;		//	render thread. mTexture is its texture
+	bool			mSharedWriter = false;				//	we're the one writing mSharedTexture
+
+	//	for the memory budget. A texture the client has fetched (GetCacheTexture) may be in use by unity,
+	//	so is only evicted when the client says it isn't (mEvictable). Evicted caches are written again by queueing
+	std::atomic<uint64_t>	mLastUsedTime;		//	written or fetched, PopWritePixels::GetMicrosecsNow()
+	std::atomic<bool>		mTextureFetched;
+	std::atomic<bool>		mEvictable;			//	SetCacheEvictable, from the main thread
+	std::atomic<bool>		mEvicted;
+
+	//	for the scheduler. Priority & deadline are set from the main thread
+	std::atomic<int>		mPriority;			//	higher goes first
+	std::atomic<uint64_t>	mDeadline;			//	PopWritePixels::GetMicrosecsNow() time, 0 for none
+	size_t					mFramesWaiting = 0;	//	render thread. frames we had work but were skipped
+};
+
+
+namespace PopWritePixels
+{
+	extern TWriteRateMeter	gWriteRate;				//	across all caches
+
+	//	caches are addressed by generation-tagged handles (see TCacheSlots), which throw once released
+	TCache&		AllocCache(int& CacheHandle);
+	TCache&		GetCache(int CacheHandle);
+	void		ReleaseCache(int CacheHandle);
+	void		ReleasePendingCaches();						//	render thread, at the start of every event
+	void		EnumCaches(std::function<void(TCache&,int)> Enum);	//	allocated caches & their handles
+	size_t		GetCacheSlotIndex(int CacheHandle);			//	stable position, for round-robin ordering
+}
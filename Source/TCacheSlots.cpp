@@ -0,0 +1,143 @@
+#include "TCacheSlots.h"
+#include <SoyTypes.h>
+#include <sstream>
+
+
+TCacheSlots::TCacheSlots() :
+	mSlotCount	( 0 ),
+	mBlocks		( new std::atomic<TSlot*>[MaxSlots / BlockSize] ),
+	mHasPending	( false )
+{
+	for ( size_t b=0;	b<MaxSlots / BlockSize;	b++ )
+		mBlocks[b] = nullptr;
+}
+
+TCacheSlots::~TCacheSlots()
+{
+	for ( size_t b=0;	b<MaxSlots / BlockSize;	b++ )
+		delete[] mBlocks[b].load();
+}
+
+TCacheSlots::TSlot* TCacheSlots::GetSlot(size_t Index)
+{
+	if ( Index >= mSlotCount )
+		return nullptr;
+
+	auto* Block = mBlocks[Index / BlockSize].load();
+	return &Block[Index % BlockSize];
+}
+
+int TCacheSlots::MakeHandle(size_t Index,uint32_t Generation) const
+{
+	return static_cast<int>( (Generation << IndexBits) | static_cast<uint32_t>(Index) );
+}
+
+TCache& TCacheSlots::Alloc(int& Handle)
+{
+	std::lock_guard<std::mutex> Lock( mLock );
+
+	size_t Index;
+	if ( !mFreeSlots.empty() )
+	{
+		Index = mFreeSlots.back();
+		mFreeSlots.pop_back();
+	}
+	else
+	{
+		Index = mSlotCount;
+		if ( Index >= MaxSlots )
+			throw Soy::AssertException("No free caches");
+
+		//	publish the block before the count, so readers never see a slot without one
+		auto& Block = mBlocks[Index / BlockSize];
+		if ( !Block.load() )
+			Block = new TSlot[BlockSize];
+		mSlotCount = Index + 1;
+	}
+
+	auto& Slot = *GetSlot( Index );
+	Slot.mAllocated = true;
+	mAllocatedCount++;
+	Handle = MakeHandle( Index, Slot.mGeneration );
+	return Slot.mCache;
+}
+
+TCache& TCacheSlots::Get(int Handle)
+{
+	if ( Handle < 0 )
+		throw Soy::AssertException("Invalid cache handle");
+
+	auto Index = GetSlotIndex( Handle );
+	auto Generation = ( static_cast<uint32_t>(Handle) >> IndexBits ) & GenerationMask;
+	auto* Slot = GetSlot( Index );
+	if ( !Slot )
+		throw Soy::AssertException("Invalid cache handle");
+
+	if ( !Slot->mAllocated || Slot->mGeneration != Generation )
+	{
+		std::stringstream Error;
+		Error << "Stale cache handle " << Handle << " (slot " << Index << " generation " << Generation << " has been released)";
+		throw Soy::AssertException( Error.str() );
+	}
+
+	return Slot->mCache;
+}
+
+void TCacheSlots::Release(int Handle)
+{
+	std::lock_guard<std::mutex> Lock( mLock );
+
+	//	throws on stale handles
+	Get( Handle );
+	auto& Slot = *GetSlot( GetSlotIndex( Handle ) );
+
+	//	invalidate the handle first, so nothing new finds it
+	auto NextGeneration = ( Slot.mGeneration + 1 ) & GenerationMask;
+	if ( NextGeneration == 0 )
+		NextGeneration = 1;
+	Slot.mGeneration = NextGeneration;
+	Slot.mAllocated = false;
+	mAllocatedCount--;
+
+	mPendingSlots.push_back( GetSlotIndex( Handle ) );
+	mHasPending = true;
+}
+
+void TCacheSlots::ReleasePending()
+{
+	if ( !mHasPending )
+		return;
+
+	std::vector<size_t> Released;
+	{
+		std::lock_guard<std::mutex> Lock( mLock );
+		std::swap( Released, mPendingSlots );
+		mHasPending = false;
+	}
+
+	//	these slots are in neither list, so can't be allocated while we reset them
+	for ( auto Index : Released )
+	{
+		GetSlot( Index )->mCache.Release();
+		std::lock_guard<std::mutex> Lock( mLock );
+		mFreeSlots.push_back( Index );
+	}
+}
+
+void TCacheSlots::Enum(std::function<void(TCache&,int)> Enum)
+{
+	size_t SlotCount = mSlotCount;
+	for ( size_t i=0;	i<SlotCount;	i++ )
+	{
+		auto& Slot = *GetSlot( i );
+		if ( !Slot.mAllocated )
+			continue;
+		Enum( Slot.mCache, MakeHandle( i, Slot.mGeneration ) );
+	}
+}
+
+size_t TCacheSlots::GetAllocatedCount()
+{
+	std::lock_guard<std::mutex> Lock( mLock );
+	return mAllocatedCount;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "TCache.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <functional>
+
+
+//	growable store of caches, addressed by handles carrying the slot's generation so a handle
+//	kept after ReleaseCache can't alias whichever job reuses the slot.
+//	Slots never move; they're allocated in blocks hung off a fixed table, so lookups from the
+//	render thread don't need the lock. Alloc & release lock, and are safe from any thread.
+//	Releasing only invalidates the handle; the cache itself is reset, and the slot freed, by the
+//	render thread's next ReleasePending, so it's never reset under a write in progress
+class TCacheSlots
+{
+public:
+	static const int		IndexBits = 20;
+	static const int		GenerationBits = 11;	//	handles stay positive ints for c#
+	static const uint32_t	IndexMask = (1u << IndexBits) - 1;
+	static const uint32_t	GenerationMask = (1u << GenerationBits) - 1;
+	static const size_t		BlockSize = 64;
+	static const size_t		MaxSlots = 1u << IndexBits;
+
+	class TSlot
+	{
+	public:
+		TSlot() : mGeneration( 1 ), mAllocated( false )	{}
+
+		TCache					mCache;
+		std::atomic<uint32_t>	mGeneration;
+		std::atomic<bool>		mAllocated;
+	};
+
+public:
+	TCacheSlots();
+	~TCacheSlots();
+
+	TCache&			Alloc(int& Handle);
+	TCache&			Get(int Handle);				//	throws on stale or invalid handles
+	void			Release(int Handle);
+	void			ReleasePending();				//	render thread
+	void			Enum(std::function<void(TCache&,int)> Enum);	//	allocated caches with their handles
+	size_t			GetAllocatedCount();
+
+	static size_t	GetSlotIndex(int Handle)		{	return static_cast<uint32_t>(Handle) & IndexMask;	}
+
+private:
+	TSlot*			GetSlot(size_t Index);			//	null if not allocated yet
+	int				MakeHandle(size_t Index,uint32_t Generation) const;
+
+private:
+	std::mutex							mLock;
+	std::atomic<size_t>					mSlotCount;			//	slots ever created
+	std::unique_ptr<std::atomic<TSlot*>[]>	mBlocks;		//	MaxSlots / BlockSize entries
+	std::vector<size_t>					mFreeSlots;			//	released slot indexes, reused last in first out
+	std::vector<size_t>					mPendingSlots;		//	released, but the render thread hasn't reset the cache yet
+	std::atomic<bool>					mHasPending;		//	so the render thread only locks when there's something to do
+	size_t								mAllocatedCount = 0;
+};
@@ -0,0 +1,50 @@
+#include "TCompletionQueue.h"
+#include <algorithm>
+
+
+namespace PopWritePixels
+{
+	TCompletionQueue	gCompletionQueue;
+}
+
+
+TCompletionQueue& PopWritePixels::GetCompletionQueue()
+{
+	return gCompletionQueue;
+}
+
+
+TCompletionQueue::TCompletionQueue() :
+	mRing		( new TCompletion[Capacity] ),
+	mWriteIndex	( 0 ),
+	mReadIndex	( 0 ),
+	mDropped	( 0 )
+{
+}
+
+void TCompletionQueue::Push(const TCompletion& Completion)
+{
+	//	indexes only ever increase, the slot is index % capacity
+	auto Write = mWriteIndex.load( std::memory_order_relaxed );
+	auto Read = mReadIndex.load( std::memory_order_acquire );
+	if ( Write - Read >= Capacity )
+	{
+		mDropped.fetch_add( 1, std::memory_order_relaxed );
+		return;
+	}
+
+	mRing[Write % Capacity] = Completion;
+	mWriteIndex.store( Write + 1, std::memory_order_release );
+}
+
+size_t TCompletionQueue::Drain(TCompletion* Completions,size_t MaxCount)
+{
+	auto Read = mReadIndex.load( std::memory_order_relaxed );
+	auto Write = mWriteIndex.load( std::memory_order_acquire );
+	auto Count = std::min( MaxCount, Write - Read );
+	for ( size_t i=0;	i<Count;	i++ )
+		Completions[i] = mRing[(Read + i) % Capacity];
+
+	mReadIndex.store( Read + Count, std::memory_order_release );
+	return Count;
+}
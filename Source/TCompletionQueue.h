@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+
+
+//	gr: matching values in c#
+namespace TCompletionStatus
+{
+	enum Type
+	{
+		Complete = 0,	//	last row handed to the graphics api
+		Failed = 1,		//	writing threw (eg. conversion/decode failed). Reported once per submission
+	};
+}
+
+//	gr: matching layout in c#
+//	times are GetPluginTimeMicrosecs()
+struct TCompletion
+{
+	int32_t		mCache = -1;
+	int32_t		mStatus = TCompletionStatus::Complete;
+	uint32_t	mSubmission = 0;		//	nth QueueWritePixels* to this cache, from 1
+	uint32_t	mRowsWritten = 0;
+	uint64_t	mQueueTime = 0;
+	uint64_t	mFirstRowTime = 0;		//	0 if nothing was written
+	uint64_t	mCompleteTime = 0;
+};
+
+
+//	fixed size single-producer (render thread) single-consumer (main thread) ring, so finishing a job
+//	doesn't need a poll per job per frame to find out. If nobody drains it, it fills and drops
+class TCompletionQueue
+{
+public:
+	static const size_t	Capacity = 4096;
+
+public:
+	TCompletionQueue();
+
+	void				Push(const TCompletion& Completion);		//	render thread
+	size_t				Drain(TCompletion* Completions,size_t MaxCount);	//	main thread
+	uint64_t			GetDropped() const		{	return mDropped.load( std::memory_order_relaxed );	}
+
+private:
+	std::unique_ptr<TCompletion[]>	mRing;
+	std::atomic<size_t>		mWriteIndex;	//	only the producer changes
+	std::atomic<size_t>		mReadIndex;		//	only the consumer changes
+	std::atomic<uint64_t>	mDropped;
+};
+
+
+namespace PopWritePixels
+{
+	TCompletionQueue&	GetCompletionQueue();
+}
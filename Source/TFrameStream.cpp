@@ -0,0 +1,25 @@
+#include "TFrameStream.h"
+#include "TCache.h"
+#include <algorithm>
+
+
+TFrameStream::TFrameStream(size_t RingSize,size_t QueueDepth) :
+	mQueueDepth			( std::max<size_t>( 1, QueueDepth ) ),
+	mRing				( std::max<size_t>( 2, RingSize ) ),
+	mFrontTexture		( nullptr ),
+	mFramesQueued		( 0 ),
+	mFramesPresented	( 0 ),
+	mFramesDropped		( 0 )
+{
+}
+
+TStreamStats TFrameStream::GetStats() const
+{
+	TStreamStats Stats;
+	Stats.mFramesQueued = mFramesQueued.load( std::memory_order_relaxed );
+	Stats.mFramesPresented = mFramesPresented.load( std::memory_order_relaxed );
+	Stats.mFramesDropped = mFramesDropped.load( std::memory_order_relaxed );
+	Stats.mFrameNumber = Stats.mFramesPresented;
+	Stats.mLatency = mLatency.GetSummary();
+	return Stats;
+}
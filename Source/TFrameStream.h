@@ -0,0 +1,46 @@
+#pragma once
+
+#include "TTelemetry.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+class TPendingBytes;
+class TTextureBackend;
+
+
+//	gr: matching layout in c#
+struct TStreamStats
+{
+	uint64_t			mFramesQueued = 0;
+	uint64_t			mFramesPresented = 0;
+	uint64_t			mFramesDropped = 0;		//	replaced by a newer frame before they were written
+	uint64_t			mFrameNumber = 0;		//	of the front texture, changes when a new frame is presented
+	THistogramSummary	mLatency;				//	microsecs from the frame's timestamp to being presented
+};
+
+
+//	a cache in stream mode keeps a short queue of frames and presents the newest complete one each event,
+//	written whole into the next texture of a ring, so the texture being sampled is never the one being written
+class TFrameStream
+{
+public:
+	TFrameStream(size_t RingSize,size_t QueueDepth);
+
+	TStreamStats		GetStats() const;
+
+public:
+	size_t				mQueueDepth;
+	std::vector<std::shared_ptr<TTextureBackend>>	mRing;			//	render thread
+	size_t				mFrontIndex = 0;							//	render thread
+	std::deque<std::shared_ptr<TPendingBytes>>		mFrames;		//	render thread, oldest first
+
+	std::atomic<void*>		mFrontTexture;		//	native texture of the newest presented frame, for any thread
+	std::atomic<uint64_t>	mFramesQueued;
+	std::atomic<uint64_t>	mFramesPresented;
+	std::atomic<uint64_t>	mFramesDropped;
+	THistogram				mLatency;
+};
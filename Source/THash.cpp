@@ -0,0 +1,101 @@
+#include "THash.h"
+#include <cstring>
+
+
+namespace PopWritePixels
+{
+	const uint64_t	HashPrime0 = 0x9E3779B185EBCA87ull;
+	const uint64_t	HashPrime1 = 0xC2B2AE3D27D4EB4Full;
+
+	inline uint64_t	RotateLeft(uint64_t x,int r)	{	return (x << r) | (x >> (64 - r));	}
+	inline uint64_t	HashMix(uint64_t Hash,uint64_t Value)
+	{
+		Hash ^= RotateLeft( Value * HashPrime1, 31 ) * HashPrime0;
+		return RotateLeft( Hash, 27 ) * HashPrime0 + HashPrime1;
+	}
+	inline uint64_t	HashAvalanche(uint64_t Hash)
+	{
+		Hash ^= Hash >> 33;
+		Hash *= HashPrime1;
+		Hash ^= Hash >> 29;
+		return Hash;
+	}
+
+	//	returns how many bytes went into the lanes
+	size_t			HashLanes(const uint8_t* Data,size_t Size,uint64_t Lanes[4]);
+	uint64_t		HashTail(uint64_t Hash,const uint8_t* Data,size_t Size);
+}
+
+
+size_t PopWritePixels::HashLanes(const uint8_t* Data,size_t Size,uint64_t Lanes[4])
+{
+	//	4 independent lanes so the multiplies pipeline
+	size_t i = 0;
+	for ( ;	i+32<=Size;	i+=32 )
+	{
+		for ( int l=0;	l<4;	l++ )
+		{
+			uint64_t Value;
+			memcpy( &Value, Data + i + l*8, sizeof(Value) );
+			Lanes[l] = HashMix( Lanes[l], Value );
+		}
+	}
+	return i;
+}
+
+uint64_t PopWritePixels::HashTail(uint64_t Hash,const uint8_t* Data,size_t Size)
+{
+	size_t i = 0;
+	for ( ;	i+8<=Size;	i+=8 )
+	{
+		uint64_t Value;
+		memcpy( &Value, Data + i, sizeof(Value) );
+		Hash = HashMix( Hash, Value );
+	}
+
+	if ( i < Size )
+	{
+		uint64_t Value = 0;
+		memcpy( &Value, Data + i, Size - i );
+		Hash = HashMix( Hash, Value );
+	}
+	return Hash;
+}
+
+
+uint64_t PopWritePixels::HashBytes(const uint8_t* Data,size_t Size,uint64_t Seed)
+{
+	uint64_t Hash = Seed ^ (Size * HashPrime0);
+
+	uint64_t Lanes[4] = { Hash, Hash + HashPrime1, Hash - HashPrime0, Hash ^ HashPrime1 };
+	auto LaneBytes = HashLanes( Data, Size, Lanes );
+	for ( int l=0;	l<4;	l++ )
+		Hash = HashMix( Hash, Lanes[l] );
+
+	Hash = HashTail( Hash, Data + LaneBytes, Size - LaneBytes );
+	return HashAvalanche( Hash );
+}
+
+
+void PopWritePixels::HashBytes128(const uint8_t* Data,size_t Size,uint64_t Hash[2])
+{
+	uint64_t Start = Size * HashPrime0;
+
+	uint64_t Lanes[4] = { Start, Start + HashPrime1, Start - HashPrime0, Start ^ HashPrime1 };
+	auto LaneBytes = HashLanes( Data, Size, Lanes );
+
+	//	the lanes are 256 bits of state; fold them in opposite orders from different seeds
+	Hash[0] = Start;
+	Hash[1] = Start ^ HashPrime1;
+	for ( int l=0;	l<4;	l++ )
+	{
+		Hash[0] = HashMix( Hash[0], Lanes[l] );
+		Hash[1] = HashMix( Hash[1], RotateLeft( Lanes[3-l], 17 ) );
+	}
+
+	for ( int h=0;	h<2;	h++ )
+	{
+		Hash[h] = HashTail( Hash[h], Data + LaneBytes, Size - LaneBytes );
+		Hash[h] = HashAvalanche( Hash[h] );
+	}
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace PopWritePixels
+{
+	//	fast non-cryptographic hash for comparing pixel data
+	uint64_t	HashBytes(const uint8_t* Data,size_t Size,uint64_t Seed=0);
+
+	//	same pass, finished two ways, for identifying whole images where a collision would show the wrong one
+	void		HashBytes128(const uint8_t* Data,size_t Size,uint64_t Hash[2]);
+}
@@ -0,0 +1,148 @@
+#include "TMappedFile.h"
+#include <SoyTypes.h>
+#include <sstream>
+#include <algorithm>
+
+#if defined(TARGET_WINDOWS)
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+namespace PopWritePixels
+{
+	size_t		GetMappingGranularity();
+	void		ThrowMappingError(const std::string& Filename,const char* Error);
+}
+
+
+size_t PopWritePixels::GetMappingGranularity()
+{
+#if defined(TARGET_WINDOWS)
+	SYSTEM_INFO Info;
+	GetSystemInfo( &Info );
+	return Info.dwAllocationGranularity;
+#else
+	return static_cast<size_t>( sysconf(_SC_PAGESIZE) );
+#endif
+}
+
+void PopWritePixels::ThrowMappingError(const std::string& Filename,const char* Error)
+{
+	std::stringstream Message;
+	Message << "Failed to map " << Filename << ": " << Error;
+	throw Soy::AssertException( Message.str() );
+}
+
+
+TMappedFile::TMappedFile(const std::string& Filename,uint64_t Offset,uint64_t Size)
+{
+	auto Granularity = PopWritePixels::GetMappingGranularity();
+	uint64_t FileSize = 0;
+
+#if defined(TARGET_WINDOWS)
+	auto File = CreateFileA( Filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+	if ( File == INVALID_HANDLE_VALUE )
+		PopWritePixels::ThrowMappingError( Filename, "could not open file" );
+	LARGE_INTEGER FileSizeLarge;
+	if ( !GetFileSizeEx( File, &FileSizeLarge ) )
+	{
+		CloseHandle( File );
+		PopWritePixels::ThrowMappingError( Filename, "could not get file size" );
+	}
+	FileSize = static_cast<uint64_t>( FileSizeLarge.QuadPart );
+#else
+	auto File = open( Filename.c_str(), O_RDONLY );
+	if ( File == -1 )
+		PopWritePixels::ThrowMappingError( Filename, "could not open file" );
+	struct stat FileStat;
+	if ( fstat( File, &FileStat ) != 0 )
+	{
+		close( File );
+		PopWritePixels::ThrowMappingError( Filename, "could not get file size" );
+	}
+	FileSize = static_cast<uint64_t>( FileStat.st_size );
+#endif
+
+	if ( Size == 0 && Offset < FileSize )
+		Size = FileSize - Offset;
+	if ( Size == 0 || Offset + Size > FileSize || Offset + Size < Offset )
+	{
+#if defined(TARGET_WINDOWS)
+		CloseHandle( File );
+#else
+		close( File );
+#endif
+		PopWritePixels::ThrowMappingError( Filename, "range outside the file" );
+	}
+
+	//	views have to start on the granularity, so map from below and point into it
+	auto ViewOffset = Offset - (Offset % Granularity);
+	auto ViewSize = static_cast<size_t>( (Offset - ViewOffset) + Size );
+
+#if defined(TARGET_WINDOWS)
+	mFileMapping = CreateFileMappingA( File, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	//	the mapping keeps the file open
+	CloseHandle( File );
+	if ( !mFileMapping )
+		PopWritePixels::ThrowMappingError( Filename, "CreateFileMapping failed" );
+	mView = MapViewOfFile( mFileMapping, FILE_MAP_READ, static_cast<DWORD>(ViewOffset >> 32), static_cast<DWORD>(ViewOffset & 0xffffffff), ViewSize );
+	if ( !mView )
+	{
+		CloseHandle( mFileMapping );
+		PopWritePixels::ThrowMappingError( Filename, "MapViewOfFile failed" );
+	}
+#else
+	auto* View = mmap( nullptr, ViewSize, PROT_READ, MAP_SHARED, File, static_cast<off_t>(ViewOffset) );
+	//	the mapping keeps the file open
+	close( File );
+	if ( View == MAP_FAILED )
+		PopWritePixels::ThrowMappingError( Filename, "mmap failed" );
+	mView = View;
+	//	rows are consumed top to bottom, so read ahead aggressively & drop pages behind us first
+	madvise( mView, ViewSize, MADV_SEQUENTIAL );
+#endif
+
+	mViewSize = ViewSize;
+	mData = static_cast<uint8_t*>(mView) + (Offset - ViewOffset);
+	mSize = static_cast<size_t>( Size );
+}
+
+TMappedFile::~TMappedFile()
+{
+#if defined(TARGET_WINDOWS)
+	UnmapViewOfFile( mView );
+	CloseHandle( mFileMapping );
+#else
+	munmap( mView, mViewSize );
+#endif
+}
+
+void TMappedFile::WillNeed(size_t Offset,size_t Size)
+{
+	if ( Offset >= mSize || Size == 0 )
+		return;
+	Size = std::min( Size, mSize - Offset );
+
+	//	hints have to be page aligned
+	static const size_t PageSize = PopWritePixels::GetMappingGranularity();
+	auto* Start = mData + Offset;
+	auto* AlignedStart = static_cast<uint8_t*>(mView) + (((Start - static_cast<uint8_t*>(mView)) / PageSize) * PageSize);
+	auto AlignedSize = static_cast<size_t>( (Start + Size) - AlignedStart );
+
+#if defined(TARGET_WINDOWS)
+	//	gr: PrefetchVirtualMemory is windows 8+, without it we rely on FILE_FLAG_SEQUENTIAL_SCAN readahead
+#if defined(_WIN32_WINNT_WIN8) && (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+	WIN32_MEMORY_RANGE_ENTRY Range;
+	Range.VirtualAddress = AlignedStart;
+	Range.NumberOfBytes = AlignedSize;
+	PrefetchVirtualMemory( GetCurrentProcess(), 1, &Range, 0 );
+#endif
+#else
+	madvise( AlignedStart, AlignedSize, MADV_WILLNEED );
+#endif
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+//	read-only view of a file (or a byte range of it), mapped for as long as this lives.
+//	Pages are read in by the os as they're touched, so nothing is copied into the heap
+class TMappedFile
+{
+public:
+	TMappedFile(const std::string& Filename,uint64_t Offset,uint64_t Size);	//	Size 0 = to the end of the file
+	~TMappedFile();
+
+	uint8_t*		GetData() const		{	return mData;	}
+	size_t			GetSize() const		{	return mSize;	}
+
+	//	ask the os to start reading these bytes (relative to GetData()) before we touch them. Clamped to the view
+	void			WillNeed(size_t Offset,size_t Size);
+
+private:
+	void*			mView = nullptr;		//	aligned down to the mapping granularity
+	size_t			mViewSize = 0;
+	uint8_t*		mData = nullptr;
+	size_t			mSize = 0;
+#if defined(TARGET_WINDOWS)
+	void*			mFileMapping = nullptr;
+#endif
+};
@@ -0,0 +1,110 @@
+#include "TMemoryBudget.h"
+#include "TCache.h"
+#include "TPixelBufferPool.h"
+#include "TBlockCompress.h"
+#include <SoyPixels.h>
+#include <algorithm>
+#include <vector>
+
+
+namespace PopWritePixels
+{
+	TMemoryBudget	gMemoryBudget;
+}
+
+
+TMemoryBudget& PopWritePixels::GetMemoryBudget()
+{
+	return gMemoryBudget;
+}
+
+size_t PopWritePixels::GetTextureBytes(const SoyPixelsMeta& Meta,bool EnableMips,TBlockFormat::Type BlockFormat)
+{
+	size_t Bytes = 0;
+	auto Width = Meta.GetWidth();
+	auto Height = Meta.GetHeight();
+	auto PixelSize = GetPixelSize( Meta );
+	auto MipCount = EnableMips ? GetMipCount( Meta ) : 1;
+	for ( size_t m=0;	m<MipCount;	m++ )
+	{
+		if ( BlockFormat != TBlockFormat::None )
+			Bytes += GetBlockDataSize( BlockFormat, Width, Height );
+		else
+			Bytes += Width * Height * PixelSize;
+		Width = std::max<size_t>( 1, Width/2 );
+		Height = std::max<size_t>( 1, Height/2 );
+	}
+	return Bytes;
+}
+
+
+void TMemoryBudget::OnAlloc(size_t Bytes)
+{
+	auto Used = mUsedBytes.fetch_add( Bytes ) + Bytes;
+	auto HighWater = mHighWaterBytes.load( std::memory_order_relaxed );
+	while ( Used > HighWater && !mHighWaterBytes.compare_exchange_weak( HighWater, Used, std::memory_order_relaxed ) )
+	{
+	}
+}
+
+void TMemoryBudget::OnFree(size_t Bytes)
+{
+	mUsedBytes.fetch_sub( Bytes );
+}
+
+bool TMemoryBudget::MakeRoom(size_t Bytes)
+{
+	uint64_t Budget = mBudgetBytes;
+	if ( Budget == 0 )
+		return true;
+	if ( Bytes > Budget )
+		throw Soy::AssertException("Texture is bigger than the whole memory budget");
+	if ( mUsedBytes + Bytes <= Budget )
+		return true;
+
+	std::vector<TCache*> Idle;
+	auto AddIdle = [&](TCache& Cache,int CacheHandle)
+	{
+		if ( Cache.IsEvictable() )
+			Idle.push_back( &Cache );
+	};
+	PopWritePixels::EnumCaches( AddIdle );
+
+	auto Compare = [](const TCache* a,const TCache* b)
+	{
+		return a->mLastUsedTime < b->mLastUsedTime;
+	};
+	std::sort( Idle.begin(), Idle.end(), Compare );
+
+	for ( auto* Cache : Idle )
+	{
+		if ( mUsedBytes + Bytes <= Budget )
+			break;
+		mEvictedBytes += Cache->Evict();
+		mEvictions++;
+	}
+
+	if ( mUsedBytes + Bytes <= Budget )
+		return true;
+
+	mAllocationsDeferred++;
+	return false;
+}
+
+void TMemoryBudget::ResetHighWater()
+{
+	mHighWaterBytes = mUsedBytes.load();
+}
+
+TMemoryUsage TMemoryBudget::GetUsage()
+{
+	TMemoryUsage Usage;
+	Usage.mBudgetBytes = mBudgetBytes.load( std::memory_order_relaxed );
+	Usage.mUsedBytes = mUsedBytes.load( std::memory_order_relaxed );
+	Usage.mHighWaterBytes = mHighWaterBytes.load( std::memory_order_relaxed );
+	Usage.mPooledBytes = PopWritePixels::GetPixelBufferPool().GetPooledBytes();
+	Usage.mEvictions = mEvictions.load( std::memory_order_relaxed );
+	Usage.mEvictedBytes = mEvictedBytes.load( std::memory_order_relaxed );
+	Usage.mAllocationsDeferred = mAllocationsDeferred.load( std::memory_order_relaxed );
+	return Usage;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include "TTextureBackend.h"
+
+
+//	gr: matching layout in c#
+struct TMemoryUsage
+{
+	uint64_t	mBudgetBytes = 0;			//	0 = no limit
+	uint64_t	mUsedBytes = 0;				//	textures (with mips) we allocated, and gpu staging
+	uint64_t	mHighWaterBytes = 0;		//	since the last ResetPluginStats
+	uint64_t	mPooledBytes = 0;			//	host pixel buffers, not part of the budget (see TrimPixelBufferPool)
+	uint64_t	mEvictions = 0;
+	uint64_t	mEvictedBytes = 0;
+	uint64_t	mAllocationsDeferred = 0;	//	frames a texture waited for room
+};
+
+
+//	plugin-wide limit on what we allocate. Backends report their bytes as they're created & destroyed;
+//	a cache about to create a texture first makes room, evicting idle caches least recently used first,
+//	and waits a frame if there still isn't any
+class TMemoryBudget
+{
+public:
+	TMemoryBudget() :
+		mBudgetBytes		( 0 ),
+		mUsedBytes			( 0 ),
+		mHighWaterBytes		( 0 ),
+		mEvictions			( 0 ),
+		mEvictedBytes		( 0 ),
+		mAllocationsDeferred( 0 )
+	{
+	}
+
+	void			OnAlloc(size_t Bytes);		//	any thread
+	void			OnFree(size_t Bytes);
+	//	render thread. false if Bytes won't fit yet. Throws if they never will
+	bool			MakeRoom(size_t Bytes);
+	void			ResetHighWater();
+	TMemoryUsage	GetUsage();
+
+public:
+	std::atomic<uint64_t>	mBudgetBytes;
+
+private:
+	std::atomic<uint64_t>	mUsedBytes;
+	std::atomic<uint64_t>	mHighWaterBytes;
+	std::atomic<uint64_t>	mEvictions;
+	std::atomic<uint64_t>	mEvictedBytes;
+	std::atomic<uint64_t>	mAllocationsDeferred;
+};
+
+
+namespace PopWritePixels
+{
+	TMemoryBudget&	GetMemoryBudget();
+
+	//	level 0 and the mip chain (if enabled) of a texture we'd allocate. Compressed textures are sized in blocks
+	size_t			GetTextureBytes(const SoyPixelsMeta& Meta,bool EnableMips,TBlockFormat::Type BlockFormat=TBlockFormat::None);
+}
@@ -0,0 +1,195 @@
+#include "TMipChain.h"
+#include "TTextureBackend.h"
+#include "TCache.h"
+#include "TWorkerPool.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENABLE_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ENABLE_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+
+namespace PopWritePixels
+{
+	//	rounds up, same as pavgb/vrhadd so the simd and scalar paths match exactly
+	inline uint8_t	Average(uint8_t a,uint8_t b)	{	return static_cast<uint8_t>( (a + b + 1) >> 1 );	}
+}
+
+
+void PopWritePixels::DownsampleRowReference(const uint8_t* ParentRow0,const uint8_t* ParentRow1,size_t ParentWidth,uint8_t* Row,size_t Width,size_t Channels)
+{
+	for ( size_t x=0;	x<Width;	x++ )
+	{
+		auto x0 = std::min( x*2+0, ParentWidth-1 );
+		auto x1 = std::min( x*2+1, ParentWidth-1 );
+		for ( size_t c=0;	c<Channels;	c++ )
+		{
+			auto Left = Average( ParentRow0[x0*Channels+c], ParentRow1[x0*Channels+c] );
+			auto Right = Average( ParentRow0[x1*Channels+c], ParentRow1[x1*Channels+c] );
+			Row[x*Channels+c] = Average( Left, Right );
+		}
+	}
+}
+
+void PopWritePixels::DownsampleRow(const uint8_t* ParentRow0,const uint8_t* ParentRow1,size_t ParentWidth,uint8_t* Row,size_t Width,size_t Channels)
+{
+	size_t x = 0;
+
+#if defined(ENABLE_SIMD_SSE2)
+	if ( Channels == 4 )
+	{
+		//	8 parent pixels -> 4 pixels
+		for ( ;	(x+4)*2<=ParentWidth;	x+=4 )
+		{
+			auto a0 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(ParentRow0 + x*8) );
+			auto a1 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(ParentRow0 + x*8 + 16) );
+			auto b0 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(ParentRow1 + x*8) );
+			auto b1 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(ParentRow1 + x*8 + 16) );
+			auto v0 = _mm_avg_epu8( a0, b0 );
+			auto v1 = _mm_avg_epu8( a1, b1 );
+			//	split even & odd pixels
+			auto Even = _mm_castps_si128( _mm_shuffle_ps( _mm_castsi128_ps(v0), _mm_castsi128_ps(v1), _MM_SHUFFLE(2,0,2,0) ) );
+			auto Odd = _mm_castps_si128( _mm_shuffle_ps( _mm_castsi128_ps(v0), _mm_castsi128_ps(v1), _MM_SHUFFLE(3,1,3,1) ) );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>(Row + x*4), _mm_avg_epu8( Even, Odd ) );
+		}
+	}
+#elif defined(ENABLE_SIMD_NEON)
+	if ( Channels == 4 )
+	{
+		//	16 parent pixels -> 8 pixels
+		for ( ;	(x+8)*2<=ParentWidth;	x+=8 )
+		{
+			auto a = vld4q_u8( ParentRow0 + x*8 );
+			auto b = vld4q_u8( ParentRow1 + x*8 );
+			uint8x8x4_t Out;
+			for ( int c=0;	c<4;	c++ )
+			{
+				auto v = vrhaddq_u8( a.val[c], b.val[c] );
+				//	pairs of neighbours are now adjacent bytes
+				auto Pairs = vuzp_u8( vget_low_u8(v), vget_high_u8(v) );
+				Out.val[c] = vrhadd_u8( Pairs.val[0], Pairs.val[1] );
+			}
+			vst4_u8( Row + x*4, Out );
+		}
+	}
+#endif
+
+	if ( x < Width )
+	{
+		//	tail; offsets so the reference's clamping still applies
+		auto ParentOffset = x*2;
+		DownsampleRowReference( ParentRow0 + ParentOffset*Channels, ParentRow1 + ParentOffset*Channels, ParentWidth - ParentOffset, Row + x*Channels, Width - x, Channels );
+	}
+}
+
+
+TMipChain::TMipChain(const SoyPixelsMeta& Meta,size_t MipCount) :
+	mMeta	( Meta )
+{
+	auto Levels = MipCount > 1 ? MipCount-1 : 0;
+	mMips.resize( Levels );
+	mRowsDone.resize( Levels, 0 );
+	for ( size_t l=0;	l<Levels;	l++ )
+		mMips[l].resize( GetMipMeta(l+1).GetDataSize() );
+}
+
+SoyPixelsMeta TMipChain::GetMipMeta(size_t MipLevel) const
+{
+	auto Width = std::max<size_t>( 1, mMeta.GetWidth() >> MipLevel );
+	auto Height = std::max<size_t>( 1, mMeta.GetHeight() >> MipLevel );
+	return SoyPixelsMeta( Width, Height, mMeta.GetFormat() );
+}
+
+void TMipChain::Reset()
+{
+	std::fill( mRowsDone.begin(), mRowsDone.end(), 0 );
+}
+
+size_t TMipChain::WriteRows(const uint8_t* Level0,size_t Level0RowsReady,TTextureBackend& Texture)
+{
+	size_t BytesWritten = 0;
+	auto Channels = mMeta.GetChannels();
+	auto* Parent = Level0;
+	auto ParentMeta = mMeta;
+	auto ParentRowsReady = Level0RowsReady;
+
+	for ( size_t l=0;	l<mMips.size();	l++ )
+	{
+		auto MipMeta = GetMipMeta(l+1);
+		auto* Mip = mMips[l].data();
+		auto RowSize = MipMeta.GetRowDataSize();
+		auto ParentRowSize = ParentMeta.GetRowDataSize();
+
+		//	a row needs both parent rows (or the last, odd, parent row once the parent is complete)
+		auto RowsReady = ParentRowsReady / 2;
+		if ( ParentRowsReady == ParentMeta.GetHeight() )
+			RowsReady = MipMeta.GetHeight();
+		RowsReady = std::min( RowsReady, MipMeta.GetHeight() );
+
+		auto RowFirst = mRowsDone[l];
+		if ( RowsReady <= RowFirst )
+			break;
+
+		for ( size_t y=RowFirst;	y<RowsReady;	y++ )
+		{
+			auto y0 = std::min( y*2+0, ParentMeta.GetHeight()-1 );
+			auto y1 = std::min( y*2+1, ParentMeta.GetHeight()-1 );
+			PopWritePixels::DownsampleRow( Parent + y0*ParentRowSize, Parent + y1*ParentRowSize, ParentMeta.GetWidth(), Mip + y*RowSize, MipMeta.GetWidth(), Channels );
+		}
+
+		TTextureRect Rect( 0, RowFirst, MipMeta.GetWidth(), RowsReady - RowFirst );
+		Texture.WriteRect( Mip + RowFirst*RowSize, RowSize, Rect, l+1 );
+		BytesWritten += Rect.mHeight * RowSize;
+		mRowsDone[l] = RowsReady;
+
+		Parent = Mip;
+		ParentMeta = MipMeta;
+		ParentRowsReady = RowsReady;
+	}
+
+	return BytesWritten;
+}
+
+void TMipChain::Build(const uint8_t* Level0)
+{
+	auto Channels = mMeta.GetChannels();
+	auto* Parent = Level0;
+	auto ParentMeta = mMeta;
+
+	for ( size_t l=0;	l<mMips.size();	l++ )
+	{
+		auto MipMeta = GetMipMeta(l+1);
+		auto* Mip = mMips[l].data();
+		auto RowSize = MipMeta.GetRowDataSize();
+		auto ParentRowSize = ParentMeta.GetRowDataSize();
+
+		for ( size_t y=0;	y<MipMeta.GetHeight();	y++ )
+		{
+			auto y0 = std::min( y*2+0, ParentMeta.GetHeight()-1 );
+			auto y1 = std::min( y*2+1, ParentMeta.GetHeight()-1 );
+			PopWritePixels::DownsampleRow( Parent + y0*ParentRowSize, Parent + y1*ParentRowSize, ParentMeta.GetWidth(), Mip + y*RowSize, MipMeta.GetWidth(), Channels );
+		}
+		mRowsDone[l] = MipMeta.GetHeight();
+
+		Parent = Mip;
+		ParentMeta = MipMeta;
+	}
+}
+
+
+void TMipBuild::Start(TWorkerPool& Pool,std::shared_ptr<TPendingBytes> Pending,std::shared_ptr<TMipChain> Chain)
+{
+	mChain = Chain;
+	auto Job = [Pending,Chain]
+	{
+		Chain->Build( Pending->mBytes );
+		Pending->mMipBuild->mReady = true;
+	};
+	Pool.Push( Job );
+}
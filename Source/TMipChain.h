@@ -0,0 +1,71 @@
+#pragma once
+
+#include <SoyPixels.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+
+class TTextureBackend;
+class TPendingBytes;
+class TWorkerPool;
+
+
+//	gr: matching values in c#
+namespace TMipMode
+{
+	enum Type
+	{
+		Gpu = 0,		//	GenerateMips on the first & last chunk
+		Cpu = 1,		//	build each band's mip rows on the cpu and write them with the band
+		Progressive = 2,	//	write the mips smallest first, then level 0, clamping sampling to the levels complete
+	};
+}
+
+
+//	builds mip levels 1..N on the cpu as rows of level 0 arrive, so a partially written
+//	texture has correct mips for the rows it has, and no full-chain gpu passes are needed.
+//	2x2 box filter on 8 bit channels
+class TMipChain
+{
+public:
+	TMipChain(const SoyPixelsMeta& Meta,size_t MipCount);
+
+	void			Reset();		//	new submission
+	//	level 0 rows [0..Level0RowsReady) are final, write any mip rows that are now complete.
+	//	returns bytes written
+	size_t			WriteRows(const uint8_t* Level0,size_t Level0RowsReady,TTextureBackend& Texture);
+	//	every level from a complete level 0, without writing any
+	void			Build(const uint8_t* Level0);
+
+	SoyPixelsMeta	GetMipMeta(size_t MipLevel) const;
+	const uint8_t*	GetMipPixels(size_t MipLevel) const	{	return mMips[MipLevel-1].data();	}
+
+private:
+	SoyPixelsMeta						mMeta;
+	std::vector<std::vector<uint8_t>>	mMips;			//	[0] is level 1
+	std::vector<size_t>					mRowsDone;		//	[0] is level 1
+};
+
+
+//	a progressive submission's mips, built from all of level 0 on a worker thread
+class TMipBuild
+{
+public:
+	TMipBuild() : mReady(false)	{}
+
+	//	the job keeps the pending bytes alive until it's built the chain
+	void				Start(TWorkerPool& Pool,std::shared_ptr<TPendingBytes> Pending,std::shared_ptr<TMipChain> Chain);
+
+public:
+	std::atomic<bool>			mReady;
+	std::shared_ptr<TMipChain>	mChain;
+};
+
+
+namespace PopWritePixels
+{
+	//	one row of the next mip from two parent rows
+	void	DownsampleRow(const uint8_t* ParentRow0,const uint8_t* ParentRow1,size_t ParentWidth,uint8_t* Row,size_t Width,size_t Channels);
+	void	DownsampleRowReference(const uint8_t* ParentRow0,const uint8_t* ParentRow1,size_t ParentWidth,uint8_t* Row,size_t Width,size_t Channels);
+}
@@ -0,0 +1,568 @@
+#include "TOpenglTexture.h"
+#include "TMemoryBudget.h"
+
+#if defined(ENABLE_OPENGL)
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+
+namespace PopWritePixels
+{
+	//	big enough for a few rows of most textures, so a chunk is usually a single copy
+	const size_t	PixelBufferSegmentSize = 1024 * 1024;
+	//	a chunk bigger than this is split over segments rather than growing the ring without limit
+	const size_t	PixelBufferMaxSegmentSize = 16 * 1024 * 1024;
+	//	enough in flight for the cpu to be writing one segment while the gpu copies the last two
+	const size_t	PixelBufferSegmentCount = 3;
+	//	a ring the gpu keeps falling behind is doubled up to this, after which it's just replaced
+	const size_t	PixelBufferMaxSegmentCount = 16;
+
+	void			CheckOpenglError(const char* Context);
+	void			GetUploadFormat(SoyPixelsFormat::Type Format,GLenum& InternalFormat,GLenum& UploadFormat);
+	bool			HasBufferStorage();
+
+	std::mutex				gDeferredDeleteLock;
+	std::vector<GLuint>		gDeferredTextures;
+	std::vector<GLuint>		gDeferredBuffers;
+	std::vector<GLsync>		gDeferredFences;
+	std::vector<GLuint>		gDeferredFramebuffers;
+
+	//	unity doesn't expect its gl state to change under it, so what we bind or set is put back on scope exit
+	class TRestoreOpenglState
+	{
+	public:
+		TRestoreOpenglState();
+		~TRestoreOpenglState();
+
+	private:
+		GLint		mTexture = 0;
+		GLint		mUnpackBuffer = 0;
+		GLint		mPackBuffer = 0;
+		GLint		mUnpackAlignment = 4;
+		GLint		mUnpackRowLength = 0;
+		GLint		mPackAlignment = 4;
+	};
+}
+
+
+PopWritePixels::TRestoreOpenglState::TRestoreOpenglState()
+{
+	glGetIntegerv( GL_TEXTURE_BINDING_2D, &mTexture );
+	glGetIntegerv( GL_PIXEL_UNPACK_BUFFER_BINDING, &mUnpackBuffer );
+	glGetIntegerv( GL_PIXEL_PACK_BUFFER_BINDING, &mPackBuffer );
+	glGetIntegerv( GL_UNPACK_ALIGNMENT, &mUnpackAlignment );
+	glGetIntegerv( GL_UNPACK_ROW_LENGTH, &mUnpackRowLength );
+	glGetIntegerv( GL_PACK_ALIGNMENT, &mPackAlignment );
+}
+
+PopWritePixels::TRestoreOpenglState::~TRestoreOpenglState()
+{
+	glBindTexture( GL_TEXTURE_2D, static_cast<GLuint>(mTexture) );
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, static_cast<GLuint>(mUnpackBuffer) );
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, static_cast<GLuint>(mPackBuffer) );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, mUnpackAlignment );
+	glPixelStorei( GL_UNPACK_ROW_LENGTH, mUnpackRowLength );
+	glPixelStorei( GL_PACK_ALIGNMENT, mPackAlignment );
+}
+
+
+void PopWritePixels::CheckOpenglError(const char* Context)
+{
+	auto Error = glGetError();
+	if ( Error == GL_NO_ERROR )
+		return;
+
+	std::stringstream ErrorString;
+	ErrorString << "Opengl error 0x" << std::hex << Error << " in " << Context;
+	throw Soy::AssertException( ErrorString.str() );
+}
+
+void PopWritePixels::GetUploadFormat(SoyPixelsFormat::Type Format,GLenum& InternalFormat,GLenum& UploadFormat)
+{
+	switch ( Format )
+	{
+		case SoyPixelsFormat::RGBA:
+			InternalFormat = GL_RGBA8;
+			UploadFormat = GL_RGBA;
+			return;
+
+		case SoyPixelsFormat::RGB:
+			InternalFormat = GL_RGB8;
+			UploadFormat = GL_RGB;
+			return;
+
+		case SoyPixelsFormat::Greyscale:
+			InternalFormat = GL_R8;
+			UploadFormat = GL_RED;
+			return;
+
+#if defined(GL_BGRA)
+		//	gles has no bgra upload without extensions
+		case SoyPixelsFormat::BGRA:
+			InternalFormat = GL_RGBA8;
+			UploadFormat = GL_BGRA;
+			return;
+#endif
+
+		default:
+			break;
+	}
+
+	std::stringstream Error;
+	Error << "Pixel format " << static_cast<int>(Format) << " not supported by opengl texture backend";
+	throw Soy::AssertException( Error.str() );
+}
+
+bool PopWritePixels::HasBufferStorage()
+{
+#if defined(GL_MAP_PERSISTENT_BIT)
+	//	core from 4.4, otherwise an extension
+	GLint Major = 0;
+	GLint Minor = 0;
+	glGetIntegerv( GL_MAJOR_VERSION, &Major );
+	glGetIntegerv( GL_MINOR_VERSION, &Minor );
+	auto* Version = reinterpret_cast<const char*>( glGetString( GL_VERSION ) );
+	bool Es = Version && strstr( Version, "OpenGL ES" ) != nullptr;
+	if ( !Es && ( Major > 4 || (Major == 4 && Minor >= 4) ) )
+		return true;
+
+	GLint ExtensionCount = 0;
+	glGetIntegerv( GL_NUM_EXTENSIONS, &ExtensionCount );
+	for ( GLint e=0;	e<ExtensionCount;	e++ )
+	{
+		auto* Extension = reinterpret_cast<const char*>( glGetStringi( GL_EXTENSIONS, e ) );
+		if ( !Extension )
+			continue;
+		if ( strcmp( Extension, "GL_ARB_buffer_storage" ) == 0 )
+			return !Es;
+		//	gr: gles would need the EXT entry point loaded, which we don't do yet
+	}
+#endif
+	return false;
+}
+
+
+void PopWritePixels::DeleteOpenglObjectsLater(GLuint Texture,GLuint Buffer,const std::vector<GLsync>& Fences,GLuint Framebuffer)
+{
+	std::lock_guard<std::mutex> Lock( gDeferredDeleteLock );
+	if ( Framebuffer != 0 )
+		gDeferredFramebuffers.push_back( Framebuffer );
+	if ( Texture != 0 )
+		gDeferredTextures.push_back( Texture );
+	if ( Buffer != 0 )
+		gDeferredBuffers.push_back( Buffer );
+	for ( auto Fence : Fences )
+		if ( Fence )
+			gDeferredFences.push_back( Fence );
+}
+
+void PopWritePixels::DeleteDeferredOpenglObjects()
+{
+	std::lock_guard<std::mutex> Lock( gDeferredDeleteLock );
+	for ( auto Fence : gDeferredFences )
+		glDeleteSync( Fence );
+	if ( !gDeferredFramebuffers.empty() )
+		glDeleteFramebuffers( static_cast<GLsizei>(gDeferredFramebuffers.size()), gDeferredFramebuffers.data() );
+	if ( !gDeferredBuffers.empty() )
+		glDeleteBuffers( static_cast<GLsizei>(gDeferredBuffers.size()), gDeferredBuffers.data() );
+	if ( !gDeferredTextures.empty() )
+		glDeleteTextures( static_cast<GLsizei>(gDeferredTextures.size()), gDeferredTextures.data() );
+	gDeferredFences.clear();
+	gDeferredFramebuffers.clear();
+	gDeferredBuffers.clear();
+	gDeferredTextures.clear();
+}
+
+
+
+TPixelBufferRing::TPixelBufferRing(size_t SegmentSize,size_t SegmentCount) :
+	mSegmentSize	( SegmentSize ),
+	mFences			( std::max<size_t>( 2, SegmentCount ), nullptr ),
+	mSegment		( mFences.size()-1 )
+{
+	PopWritePixels::TRestoreOpenglState RestoreState;
+	auto BufferSize = mSegmentSize * mFences.size();
+	glGenBuffers( 1, &mBuffer );
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, mBuffer );
+
+#if defined(GL_MAP_PERSISTENT_BIT)
+	if ( PopWritePixels::HasBufferStorage() )
+	{
+		GLbitfield Flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage( GL_PIXEL_UNPACK_BUFFER, BufferSize, nullptr, Flags );
+		mPersistentData = static_cast<uint8_t*>( glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, BufferSize, Flags ) );
+	}
+#endif
+	if ( !mPersistentData )
+		glBufferData( GL_PIXEL_UNPACK_BUFFER, BufferSize, nullptr, GL_STREAM_DRAW );
+
+	PopWritePixels::CheckOpenglError("TPixelBufferRing alloc");
+	PopWritePixels::GetMemoryBudget().OnAlloc( GetBufferSize() );
+}
+
+TPixelBufferRing::~TPixelBufferRing()
+{
+	PopWritePixels::GetMemoryBudget().OnFree( GetBufferSize() );
+	//	deleting the buffer unmaps it
+	PopWritePixels::DeleteOpenglObjectsLater( 0, mBuffer, mFences );
+}
+
+uint8_t* TPixelBufferRing::Lock(size_t Bytes)
+{
+	if ( mLocked )
+		throw Soy::AssertException("Pixel buffer ring already locked");
+	if ( Bytes > mSegmentSize )
+		throw Soy::AssertException("Pixel buffer ring write larger than a segment");
+
+	auto NextSegment = (mSegment + 1) % mFences.size();
+	auto& Fence = mFences[NextSegment];
+	if ( Fence )
+	{
+		//	gpu is still copying out of this segment, which only happens when it's a whole ring behind.
+		//	Flush so it gets there, but don't wait on it; the caller moves to a bigger ring
+		auto Result = glClientWaitSync( Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0 );
+		if ( Result == GL_TIMEOUT_EXPIRED )
+		{
+			mFenceWaits++;
+			return nullptr;
+		}
+		if ( Result == GL_WAIT_FAILED )
+			throw Soy::AssertException("glClientWaitSync failed");
+		glDeleteSync( Fence );
+		Fence = nullptr;
+	}
+	mSegment = NextSegment;
+
+	auto Offset = mSegment * mSegmentSize;
+	uint8_t* Data = nullptr;
+	if ( mPersistentData )
+	{
+		Data = mPersistentData + Offset;
+	}
+	else
+	{
+		//	the fence says the gpu is done with it, so no need for the driver to synchronise
+		GLbitfield Flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+		glBindBuffer( GL_PIXEL_UNPACK_BUFFER, mBuffer );
+		Data = static_cast<uint8_t*>( glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, Offset, Bytes, Flags ) );
+		glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+		if ( !Data )
+		{
+			PopWritePixels::CheckOpenglError("glMapBufferRange");
+			throw Soy::AssertException("glMapBufferRange returned null");
+		}
+	}
+
+	mLockedBytes = Bytes;
+	mLocked = true;
+	return Data;
+}
+
+bool TPixelBufferRing::IsFree(size_t SegmentCount)
+{
+	for ( size_t i=1;	i<=std::min( SegmentCount, mFences.size() );	i++ )
+	{
+		auto& Fence = mFences[(mSegment + i) % mFences.size()];
+		if ( !Fence )
+			continue;
+
+		auto Result = glClientWaitSync( Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0 );
+		if ( Result == GL_TIMEOUT_EXPIRED )
+		{
+			mFenceWaits++;
+			return false;
+		}
+		if ( Result == GL_WAIT_FAILED )
+			throw Soy::AssertException("glClientWaitSync failed");
+		glDeleteSync( Fence );
+		Fence = nullptr;
+	}
+	return true;
+}
+
+size_t TPixelBufferRing::Unlock()
+{
+	if ( !mLocked )
+		throw Soy::AssertException("Pixel buffer ring not locked");
+
+	if ( !mPersistentData )
+	{
+		glBindBuffer( GL_PIXEL_UNPACK_BUFFER, mBuffer );
+		glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER );
+		glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+	}
+	mLocked = false;
+	return mSegment * mSegmentSize;
+}
+
+void TPixelBufferRing::Fence()
+{
+	auto& Fence = mFences[mSegment];
+	if ( Fence )
+		glDeleteSync( Fence );
+	Fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+}
+
+
+
+TOpenglTexture::TOpenglTexture(void* TexturePtr,const SoyPixelsMeta& Meta,bool EnableMips) :
+	TTextureBackend	( Meta, EnableMips )
+{
+	PopWritePixels::DeleteDeferredOpenglObjects();
+	PopWritePixels::TRestoreOpenglState RestoreState;
+
+	GLenum InternalFormat;
+	PopWritePixels::GetUploadFormat( mMeta.GetFormat(), InternalFormat, mFormat );
+
+	if ( TexturePtr )
+	{
+		//	unity gives us the texture name
+		mTexture = static_cast<GLuint>( reinterpret_cast<uintptr_t>( TexturePtr ) );
+		glBindTexture( GL_TEXTURE_2D, mTexture );
+		GLint Levels = 0;
+		glGetTexParameteriv( GL_TEXTURE_2D, GL_TEXTURE_IMMUTABLE_LEVELS, &Levels );
+		//	mutable textures report 0, and we can't know what levels were specified
+		mMipCount = std::max<GLint>( 1, Levels );
+	}
+	else
+	{
+		mMipCount = mEnableMips ? PopWritePixels::GetMipCount(mMeta) : 1;
+		glGenTextures( 1, &mTexture );
+		glBindTexture( GL_TEXTURE_2D, mTexture );
+		glTexStorage2D( GL_TEXTURE_2D, static_cast<GLsizei>(mMipCount), InternalFormat, static_cast<GLsizei>(mMeta.GetWidth()), static_cast<GLsizei>(mMeta.GetHeight()) );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mMipCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		mAllocated = true;
+	}
+	PopWritePixels::CheckOpenglError("TOpenglTexture alloc");
+}
+
+TOpenglTexture::~TOpenglTexture()
+{
+	mRing.reset();
+	if ( mAllocated )
+		PopWritePixels::DeleteOpenglObjectsLater( mTexture, 0, std::vector<GLsync>() );
+}
+
+void TOpenglTexture::Write(const SoyPixelsImpl& Pixels,size_t RowFirst,size_t RowCount)
+{
+	auto RowSize = mMeta.GetRowDataSize();
+	auto& Src = Pixels.GetPixelsArray();
+	if ( Src.GetDataSize() < (RowFirst+RowCount) * RowSize )
+		throw Soy::AssertException("Not enough pixel data for rows");
+
+	TTextureRect Rect( 0, RowFirst, mMeta.GetWidth(), RowCount );
+	WriteRect( Src.GetArray() + (RowFirst * RowSize), RowSize, Rect, 0 );
+}
+
+TPixelBufferRing& TOpenglTexture::GetRing(size_t RowSize,size_t RowCount)
+{
+	//	a segment per chunk, so each frame's chunk is one copy and the ring holds the last few frames'.
+	//	Grown when a bigger chunk comes along, so a big chunk doesn't lap the ring in a single write
+	auto ChunkSize = std::min( RowSize * RowCount, PopWritePixels::PixelBufferMaxSegmentSize );
+	auto SegmentSize = std::max( { PopWritePixels::PixelBufferSegmentSize, mMeta.GetRowDataSize(), ChunkSize } );
+	//	chunks split over segments need all of them, plus the one the gpu may still be reading
+	auto BandRows = std::max<size_t>( 1, SegmentSize / RowSize );
+	auto Bands = (RowCount + BandRows - 1) / BandRows;
+	auto SegmentCount = std::max( PopWritePixels::PixelBufferSegmentCount, Bands + 1 );
+	if ( !mRing || mRing->GetSegmentSize() < SegmentSize || mRing->GetSegmentCount() < SegmentCount )
+	{
+		if ( mRing )
+		{
+			SegmentSize = std::max( SegmentSize, mRing->GetSegmentSize() );
+			SegmentCount = std::max( SegmentCount, mRing->GetSegmentCount() );
+		}
+		AllocRing( SegmentSize, SegmentCount );
+	}
+	return *mRing;
+}
+
+void TOpenglTexture::AllocRing(size_t SegmentSize,size_t SegmentCount)
+{
+	//	the old buffer is deleted later, and gl keeps it until the copies out of it are done
+	if ( mRing )
+		mRetiredFenceWaits += mRing->mFenceWaits;
+	mRing.reset( new TPixelBufferRing( SegmentSize, SegmentCount ) );
+}
+
+bool TOpenglTexture::IsReadyToWrite(size_t RowSize,size_t RowCount)
+{
+	if ( RowSize == 0 || RowCount == 0 )
+		return true;
+
+	PopWritePixels::DeleteDeferredOpenglObjects();
+	auto& Ring = GetRing( RowSize, RowCount );
+	auto BandRows = std::max<size_t>( 1, Ring.GetSegmentSize() / RowSize );
+	auto Bands = (RowCount + BandRows - 1) / BandRows;
+	return Ring.IsFree( Bands );
+}
+
+void TOpenglTexture::WriteRect(const uint8_t* Bytes,size_t RowPitch,const TTextureRect& Rect,size_t MipLevel)
+{
+	if ( MipLevel >= mMipCount )
+		throw Soy::AssertException("Opengl texture mip level out of range");
+	auto MipWidth = std::max<size_t>( 1, mMeta.GetWidth() >> MipLevel );
+	auto MipHeight = std::max<size_t>( 1, mMeta.GetHeight() >> MipLevel );
+	if ( Rect.mX + Rect.mWidth > MipWidth || Rect.mY + Rect.mHeight > MipHeight )
+		throw Soy::AssertException("Opengl texture rect write out of bounds");
+
+	PopWritePixels::DeleteDeferredOpenglObjects();
+	PopWritePixels::TRestoreOpenglState RestoreState;
+
+	auto PixelSize = PopWritePixels::GetPixelSize( mMeta );
+	auto RectRowSize = Rect.mWidth * PixelSize;
+	GetRing( RectRowSize, Rect.mHeight );
+
+	glBindTexture( GL_TEXTURE_2D, mTexture );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+
+	//	bands of rows that fit in a segment. The copy into the next segment overlaps the gpu reading the last
+	auto BandRows = std::max<size_t>( 1, mRing->GetSegmentSize() / RectRowSize );
+	for ( size_t y=0;	y<Rect.mHeight;	y+=BandRows )
+	{
+		auto Rows = std::min( BandRows, Rect.mHeight - y );
+		auto* Dst = mRing->Lock( Rows * RectRowSize );
+		if ( !Dst )
+		{
+			//	the gpu is a whole ring behind, which IsReadyToWrite doesn't cover for mips or many small rects
+			//	in a frame. Rather than wait on it, carry on in a bigger ring
+			auto SegmentCount = std::min( mRing->GetSegmentCount() * 2, PopWritePixels::PixelBufferMaxSegmentCount );
+			AllocRing( mRing->GetSegmentSize(), std::max( SegmentCount, mRing->GetSegmentCount() ) );
+			Dst = mRing->Lock( Rows * RectRowSize );
+		}
+		for ( size_t r=0;	r<Rows;	r++ )
+			memcpy( Dst + (r * RectRowSize), Bytes + ((y+r) * RowPitch), RectRowSize );
+		auto Offset = mRing->Unlock();
+
+		glBindBuffer( GL_PIXEL_UNPACK_BUFFER, mRing->GetBuffer() );
+		auto* BufferOffset = reinterpret_cast<const void*>( static_cast<uintptr_t>( Offset ) );
+		glTexSubImage2D( GL_TEXTURE_2D, static_cast<GLint>(MipLevel), static_cast<GLint>(Rect.mX), static_cast<GLint>(Rect.mY + y), static_cast<GLsizei>(Rect.mWidth), static_cast<GLsizei>(Rows), mFormat, mType, BufferOffset );
+		mRing->Fence();
+	}
+
+	PopWritePixels::CheckOpenglError("TOpenglTexture::WriteRect");
+}
+
+void TOpenglTexture::GenerateMips()
+{
+	if ( mMipCount <= 1 )
+		return;
+
+	PopWritePixels::TRestoreOpenglState RestoreState;
+	glBindTexture( GL_TEXTURE_2D, mTexture );
+	glGenerateMipmap( GL_TEXTURE_2D );
+	PopWritePixels::CheckOpenglError("glGenerateMipmap");
+}
+
+void TOpenglTexture::SetMinMipLevel(size_t MipLevel)
+{
+	if ( mMipCount <= 1 )
+		return;
+
+	//	base level rather than GL_TEXTURE_MIN_LOD, which magnification ignores
+	PopWritePixels::TRestoreOpenglState RestoreState;
+	glBindTexture( GL_TEXTURE_2D, mTexture );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(MipLevel) );
+	PopWritePixels::CheckOpenglError("TOpenglTexture::SetMinMipLevel");
+}
+
+void* TOpenglTexture::GetNativeTexture()
+{
+	return reinterpret_cast<void*>( static_cast<uintptr_t>( mTexture ) );
+}
+
+std::shared_ptr<TTextureReader> TOpenglTexture::AllocReader(size_t SlotRows,size_t SlotCount)
+{
+	return std::shared_ptr<TTextureReader>( new TOpenglTextureReader( mTexture, mMeta, mFormat, mType, SlotRows, SlotCount ) );
+}
+
+
+
+TOpenglTextureReader::TOpenglTextureReader(GLuint Texture,const SoyPixelsMeta& Meta,GLenum Format,GLenum Type,size_t SlotRows,size_t SlotCount) :
+	TTextureReader	( SlotRows, SlotCount ),
+	mTexture		( Texture ),
+	mMeta			( Meta ),
+	mFormat			( Format ),
+	mType			( Type ),
+	mSegmentSize	( SlotRows * Meta.GetRowDataSize() ),
+	mFences			( SlotCount, nullptr ),
+	mSlotRowCounts	( SlotCount, 0 )
+{
+	PopWritePixels::DeleteDeferredOpenglObjects();
+
+	PopWritePixels::TRestoreOpenglState RestoreState;
+	glGenFramebuffers( 1, &mFramebuffer );
+	glGenBuffers( 1, &mBuffer );
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, mBuffer );
+	glBufferData( GL_PIXEL_PACK_BUFFER, mSegmentSize * SlotCount, nullptr, GL_STREAM_READ );
+	PopWritePixels::CheckOpenglError("TOpenglTextureReader alloc");
+	SetStagingBytes( mSegmentSize * SlotCount );
+}
+
+TOpenglTextureReader::~TOpenglTextureReader()
+{
+	PopWritePixels::DeleteOpenglObjectsLater( 0, mBuffer, mFences, mFramebuffer );
+}
+
+void TOpenglTextureReader::BeginRead(size_t Slot,size_t RowFirst,size_t RowCount)
+{
+	if ( RowCount > mSlotRows || RowFirst + RowCount > mMeta.GetHeight() )
+		throw Soy::AssertException("Opengl texture read out of bounds");
+
+	PopWritePixels::DeleteDeferredOpenglObjects();
+
+	//	unity's framebuffer is put back after
+	PopWritePixels::TRestoreOpenglState RestoreState;
+	GLint UnityFramebuffer = 0;
+	glGetIntegerv( GL_READ_FRAMEBUFFER_BINDING, &UnityFramebuffer );
+	glBindFramebuffer( GL_READ_FRAMEBUFFER, mFramebuffer );
+	glFramebufferTexture2D( GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mTexture, 0 );
+
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, mBuffer );
+	glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+	auto* BufferOffset = reinterpret_cast<void*>( static_cast<uintptr_t>( Slot * mSegmentSize ) );
+	glReadPixels( 0, static_cast<GLint>(RowFirst), static_cast<GLsizei>(mMeta.GetWidth()), static_cast<GLsizei>(RowCount), mFormat, mType, BufferOffset );
+	glBindFramebuffer( GL_READ_FRAMEBUFFER, static_cast<GLuint>(UnityFramebuffer) );
+
+	auto& Fence = mFences[Slot];
+	if ( Fence )
+		glDeleteSync( Fence );
+	Fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	mSlotRowCounts[Slot] = RowCount;
+	PopWritePixels::CheckOpenglError("TOpenglTextureReader::BeginRead");
+}
+
+bool TOpenglTextureReader::EndRead(size_t Slot,uint8_t* Dst,size_t DstRowPitch)
+{
+	auto& Fence = mFences[Slot];
+	if ( !Fence )
+		throw Soy::AssertException("Opengl read slot has nothing in flight");
+
+	//	flush so the fence is submitted, but never wait for it
+	auto Result = glClientWaitSync( Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0 );
+	if ( Result == GL_TIMEOUT_EXPIRED )
+		return false;
+	if ( Result == GL_WAIT_FAILED )
+		throw Soy::AssertException("glClientWaitSync failed");
+	glDeleteSync( Fence );
+	Fence = nullptr;
+
+	auto RowSize = mMeta.GetRowDataSize();
+	auto Size = mSlotRowCounts[Slot] * RowSize;
+	PopWritePixels::TRestoreOpenglState RestoreState;
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, mBuffer );
+	auto* Src = static_cast<const uint8_t*>( glMapBufferRange( GL_PIXEL_PACK_BUFFER, Slot * mSegmentSize, Size, GL_MAP_READ_BIT ) );
+	if ( !Src )
+	{
+		PopWritePixels::CheckOpenglError("glMapBufferRange");
+		throw Soy::AssertException("glMapBufferRange returned null");
+	}
+	for ( size_t r=0;	r<mSlotRowCounts[Slot];	r++ )
+		memcpy( Dst + (r * DstRowPitch), Src + (r * RowSize), RowSize );
+	glUnmapBuffer( GL_PIXEL_PACK_BUFFER );
+	return true;
+}
+#endif
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "TTextureBackend.h"
+
+#if defined(ENABLE_OPENGL)
+#include <SoyOpengl.h>
+#include <memory>
+#include <vector>
+
+
+//	a pixel buffer object split into segments which are written by the cpu while the gpu copies
+//	out of the others. Each segment has a fence, and if the gpu is a whole ring behind Lock fails rather than waits.
+//	Mapped persistently where the driver has buffer storage (GL 4.4 / EXT_buffer_storage),
+//	otherwise each segment is mapped unsynchronised as it's used
+class TPixelBufferRing
+{
+public:
+	TPixelBufferRing(size_t SegmentSize,size_t SegmentCount);
+	~TPixelBufferRing();
+
+	//	map the next segment, or null if the gpu is still reading it. Bytes must fit in a segment
+	uint8_t*		Lock(size_t Bytes);
+	//	true if the gpu is done with the next SegmentCount segments, without waiting for it
+	bool			IsFree(size_t SegmentCount);
+	//	unmap, and returns the offset in the buffer to pass to glTexSubImage2D while the buffer is bound
+	size_t			Unlock();
+	//	after the gl commands reading the segment have been issued
+	void			Fence();
+
+	GLuint			GetBuffer() const		{	return mBuffer;	}
+	size_t			GetSegmentSize() const	{	return mSegmentSize;	}
+	size_t			GetSegmentCount() const	{	return mFences.size();	}
+	size_t			GetBufferSize() const	{	return mSegmentSize * mFences.size();	}
+
+public:
+	size_t			mFenceWaits = 0;		//	times the gpu was a ring behind and Lock or IsFree failed, for profiling
+
+private:
+	GLuint				mBuffer = 0;
+	size_t				mSegmentSize;
+	uint8_t*			mPersistentData = nullptr;	//	null if not persistently mapped
+	std::vector<GLsync>	mFences;					//	per segment
+	size_t				mSegment = 0;				//	current/last locked
+	size_t				mLockedBytes = 0;
+	bool				mLocked = false;
+};
+
+
+//	reads rows of a texture into a GL_PIXEL_PACK_BUFFER split into a segment per slot, through a framebuffer
+//	it's attached to. Each segment is fenced and only mapped once the fence has signalled.
+//	gles only guarantees RGBA/UNSIGNED_BYTE reads, other formats depend on the driver
+class TOpenglTextureReader : public TTextureReader
+{
+public:
+	TOpenglTextureReader(GLuint Texture,const SoyPixelsMeta& Meta,GLenum Format,GLenum Type,size_t SlotRows,size_t SlotCount);
+	~TOpenglTextureReader();
+
+	virtual void	BeginRead(size_t Slot,size_t RowFirst,size_t RowCount) override;
+	virtual bool	EndRead(size_t Slot,uint8_t* Dst,size_t DstRowPitch) override;
+
+private:
+	GLuint				mTexture;
+	SoyPixelsMeta		mMeta;
+	GLenum				mFormat;
+	GLenum				mType;
+	GLuint				mFramebuffer = 0;
+	GLuint				mBuffer = 0;
+	size_t				mSegmentSize;
+	std::vector<GLsync>	mFences;			//	per slot
+	std::vector<size_t>	mSlotRowCounts;
+};
+
+
+//	streams rows into a GL/GLES3 texture through a TPixelBufferRing, so glTexSubImage2D
+//	reads from gpu memory and returns immediately. Needs a context current on the calling thread;
+//	unity's render thread, or any headless (EGL surfaceless, OSMesa) context
+class TOpenglTexture : public TTextureBackend
+{
+public:
+	TOpenglTexture(void* TexturePtr,const SoyPixelsMeta& Meta,bool EnableMips);
+	~TOpenglTexture();
+
+	virtual void	Write(const SoyPixelsImpl& Pixels,size_t RowFirst,size_t RowCount) override;
+	virtual void	WriteRect(const uint8_t* Bytes,size_t RowPitch,const TTextureRect& Rect,size_t MipLevel) override;
+	virtual void	GenerateMips() override;
+	virtual void*	GetNativeTexture() override;
+	virtual size_t	GetMipCount() const override	{	return mMipCount;	}
+	virtual std::shared_ptr<TTextureReader>	AllocReader(size_t SlotRows,size_t SlotCount) override;
+	virtual void	SetMinMipLevel(size_t MipLevel) override;
+
+	virtual size_t	GetStagingBytes() const override	{	return mRing ? mRing->GetBufferSize() : 0;	}
+	virtual size_t	GetFenceWaits() const override		{	return mRetiredFenceWaits + (mRing ? mRing->mFenceWaits : 0);	}
+	virtual bool	IsReadyToWrite(size_t RowSize,size_t RowCount) override;
+
+private:
+	//	creates or grows the ring to fit a chunk of rows
+	TPixelBufferRing&	GetRing(size_t RowSize,size_t RowCount);
+	void			AllocRing(size_t SegmentSize,size_t SegmentCount);
+
+private:
+	GLuint			mTexture = 0;
+	bool			mAllocated = false;
+	size_t			mMipCount = 1;
+	GLenum			mFormat = GL_RGBA;			//	upload format/type of mMeta
+	GLenum			mType = GL_UNSIGNED_BYTE;
+	std::shared_ptr<TPixelBufferRing>	mRing;	//	created on first write, grown to fit the chunks
+	size_t			mRetiredFenceWaits = 0;		//	from rings we've grown out of
+};
+
+
+namespace PopWritePixels
+{
+	//	gl objects can only be deleted with the context current, so ones released elsewhere
+	//	(eg. ReleaseCache on the main thread) are deleted on the next render thread call
+	void		DeleteOpenglObjectsLater(GLuint Texture,GLuint Buffer,const std::vector<GLsync>& Fences,GLuint Framebuffer=0);
+	void		DeleteDeferredOpenglObjects();
+}
+#endif
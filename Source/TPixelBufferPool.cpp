@@ -0,0 +1,161 @@
+#include "TPixelBufferPool.h"
+#include <SoyTypes.h>
+#include <cstdlib>
+
+#if defined(TARGET_WINDOWS)
+#include <malloc.h>
+#endif
+
+
+namespace PopWritePixels
+{
+	const size_t		PixelBufferAlignment = 64;		//	cache line, and enough for any simd loads
+	const size_t		MinPixelBufferCapacity = 4*1024;
+
+	uint8_t*			AllocAligned(size_t Size);
+	void				FreeAligned(uint8_t* Data);
+}
+
+
+uint8_t* PopWritePixels::AllocAligned(size_t Size)
+{
+#if defined(TARGET_WINDOWS)
+	auto* Data = _aligned_malloc( Size, PixelBufferAlignment );
+#else
+	void* Data = nullptr;
+	if ( posix_memalign( &Data, PixelBufferAlignment, Size ) != 0 )
+		Data = nullptr;
+#endif
+	if ( !Data )
+		throw Soy::AssertException("Failed to allocate pixel buffer");
+	return static_cast<uint8_t*>(Data);
+}
+
+void PopWritePixels::FreeAligned(uint8_t* Data)
+{
+#if defined(TARGET_WINDOWS)
+	_aligned_free( Data );
+#else
+	free( Data );
+#endif
+}
+
+
+TPixelBufferPool& PopWritePixels::GetPixelBufferPool()
+{
+	//	never destroyed; buffers still held by caches (which are global too) come back
+	//	through their deleters during static destruction, in whatever order that runs
+	static auto* gPool = new TPixelBufferPool();
+	return *gPool;
+}
+
+
+TPixelBufferPool::~TPixelBufferPool()
+{
+	Trim();
+	for ( auto& Leased : mLeased )
+	{
+		PopWritePixels::FreeAligned( Leased.second->mData );
+		delete Leased.second;
+	}
+}
+
+size_t TPixelBufferPool::GetBucketCapacity(size_t Size)
+{
+	size_t Capacity = PopWritePixels::MinPixelBufferCapacity;
+	while ( Capacity < Size )
+		Capacity *= 2;
+	return Capacity;
+}
+
+int TPixelBufferPool::Alloc(size_t Size,uint8_t*& Data)
+{
+	if ( Size == 0 )
+		throw Soy::AssertException("Pixel buffer size must be non-zero");
+
+	auto Capacity = GetBucketCapacity( Size );
+
+	std::lock_guard<std::mutex> Lock( mLock );
+	TPixelBuffer* Buffer = nullptr;
+	auto& Bucket = mFreeBuffers[Capacity];
+	if ( !Bucket.empty() )
+	{
+		Buffer = Bucket.back();
+		Bucket.pop_back();
+	}
+	else
+	{
+		Buffer = new TPixelBuffer();
+		Buffer->mCapacity = Capacity;
+		Buffer->mData = PopWritePixels::AllocAligned( Capacity );
+	}
+	Buffer->mSize = Size;
+
+	auto Handle = mNextHandle++;
+	//	keep handles positive
+	if ( mNextHandle <= 0 )
+		mNextHandle = 1;
+	mLeased[Handle] = Buffer;
+	Data = Buffer->mData;
+	return Handle;
+}
+
+void TPixelBufferPool::Free(int Handle)
+{
+	auto Buffer = Submit( Handle );
+	//	returns to the pool as it goes out of scope
+}
+
+std::shared_ptr<TPixelBuffer> TPixelBufferPool::Submit(int Handle)
+{
+	TPixelBuffer* Buffer = nullptr;
+	{
+		std::lock_guard<std::mutex> Lock( mLock );
+		auto It = mLeased.find( Handle );
+		if ( It == mLeased.end() )
+			throw Soy::AssertException("Unknown pixel buffer handle");
+		Buffer = It->second;
+		mLeased.erase( It );
+	}
+
+	auto Deleter = [this](TPixelBuffer* Buffer)
+	{
+		Return( Buffer );
+	};
+	return std::shared_ptr<TPixelBuffer>( Buffer, Deleter );
+}
+
+void TPixelBufferPool::Return(TPixelBuffer* Buffer)
+{
+	std::lock_guard<std::mutex> Lock( mLock );
+	mFreeBuffers[Buffer->mCapacity].push_back( Buffer );
+}
+
+void TPixelBufferPool::Trim()
+{
+	std::lock_guard<std::mutex> Lock( mLock );
+	for ( auto& Bucket : mFreeBuffers )
+	{
+		for ( auto* Buffer : Bucket.second )
+		{
+			PopWritePixels::FreeAligned( Buffer->mData );
+			delete Buffer;
+		}
+	}
+	mFreeBuffers.clear();
+}
+
+size_t TPixelBufferPool::GetPooledBytes()
+{
+	std::lock_guard<std::mutex> Lock( mLock );
+	size_t Bytes = 0;
+	for ( auto& Bucket : mFreeBuffers )
+		Bytes += Bucket.first * Bucket.second.size();
+	return Bytes;
+}
+
+size_t TPixelBufferPool::GetLeasedCount()
+{
+	std::lock_guard<std::mutex> Lock( mLock );
+	return mLeased.size();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <vector>
+
+
+//	aligned host memory owned by the plugin, which the client fills directly
+class TPixelBuffer
+{
+public:
+	uint8_t*	mData = nullptr;
+	size_t		mSize = 0;			//	size requested
+	size_t		mCapacity = 0;		//	bucket size
+};
+
+
+//	buffers are bucketed by power-of-two capacity and recycled, so streaming doesn't allocate every upload
+class TPixelBufferPool
+{
+public:
+	~TPixelBufferPool();
+
+	//	lease a buffer to the client, the handle is valid until Submit or Free
+	int								Alloc(size_t Size,uint8_t*& Data);
+	void							Free(int Handle);
+	//	take ownership of a leased buffer. It returns to the pool when the last reference goes
+	std::shared_ptr<TPixelBuffer>	Submit(int Handle);
+	void							Trim();		//	free all unused buffers
+
+	size_t							GetPooledBytes();
+	size_t							GetLeasedCount();
+
+private:
+	void							Return(TPixelBuffer* Buffer);
+	static size_t					GetBucketCapacity(size_t Size);
+
+private:
+	std::mutex									mLock;
+	std::map<size_t,std::vector<TPixelBuffer*>>	mFreeBuffers;	//	by capacity
+	std::map<int,TPixelBuffer*>					mLeased;
+	int											mNextHandle = 1;
+};
+
+
+namespace PopWritePixels
+{
+	TPixelBufferPool&	GetPixelBufferPool();
+}
@@ -0,0 +1,686 @@
+#include "TPixelConvert.h"
+#include "TWorkerPool.h"
+#include <SoyDebug.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ENABLE_SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ENABLE_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+//	let gcc/clang build individual functions for instruction sets the rest of the build doesn't assume.
+//	msvc lets us use any intrinsic anyway
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_TARGET(Features)	__attribute__((target(Features)))
+#else
+#define SIMD_TARGET(Features)
+#endif
+
+
+typedef void(*TConvertKernel)(const uint8_t* Src,uint8_t* Dst,size_t Count);
+
+class TConversionInfo
+{
+public:
+	size_t			mSrcBytesPerUnit;
+	size_t			mDstBytesPerUnit;
+};
+
+
+namespace PopWritePixels
+{
+	TConversionInfo		GetConversionInfo(TPixelConversion::Type Conversion);
+	TConvertKernel		GetReferenceKernel(TPixelConversion::Type Conversion);
+	TConvertKernel		GetBestKernel(TPixelConversion::Type Conversion,const char*& Name);
+	std::vector<std::pair<const char*,TConvertKernel>>	GetKernels(TPixelConversion::Type Conversion);
+
+	uint16_t			FloatToHalf(float Value);
+	uint8_t				LinearToSrgb8(float Value);
+	const uint8_t*		GetLinearToSrgb8Table();		//	4096 entries over 0..1
+	const float*		GetSrgb8Thresholds();			//	smallest linear value giving each level, and one past 255
+	const size_t		LinearToSrgbTableSize = 4096;
+
+	namespace Cpu
+	{
+		bool			HasSsse3();
+		bool			HasAvx2();
+		bool			HasF16c();
+	}
+}
+
+
+
+//	scalar reference kernels. Count is in units of GetConversionInfo
+namespace PopWritePixels
+{
+	void	RgbToRgba_Scalar(const uint8_t* Src,uint8_t* Dst,size_t Count)
+	{
+		for ( size_t i=0;	i<Count;	i++ )
+		{
+			Dst[i*4+0] = Src[i*3+0];
+			Dst[i*4+1] = Src[i*3+1];
+			Dst[i*4+2] = Src[i*3+2];
+			Dst[i*4+3] = 255;
+		}
+	}
+
+	void	SwapRedBlue_Scalar(const uint8_t* Src,uint8_t* Dst,size_t Count)
+	{
+		for ( size_t i=0;	i<Count;	i++ )
+		{
+			auto r = Src[i*4+0];
+			auto b = Src[i*4+2];
+			Dst[i*4+0] = b;
+			Dst[i*4+1] = Src[i*4+1];
+			Dst[i*4+2] = r;
+			Dst[i*4+3] = Src[i*4+3];
+		}
+	}
+
+	void	FloatToHalf_Scalar(const uint8_t* Src,uint8_t* Dst,size_t Count)
+	{
+		for ( size_t i=0;	i<Count;	i++ )
+		{
+			float Value;
+			memcpy( &Value, Src + i*4, sizeof(Value) );
+			auto Half = FloatToHalf( Value );
+			memcpy( Dst + i*2, &Half, sizeof(Half) );
+		}
+	}
+
+	void	Uint16ToUint8_Scalar(const uint8_t* Src,uint8_t* Dst,size_t Count)
+	{
+		for ( size_t i=0;	i<Count;	i++ )
+		{
+			uint16_t Value;
+			memcpy( &Value, Src + i*2, sizeof(Value) );
+			Dst[i] = static_cast<uint8_t>( Value >> 8 );
+		}
+	}
+
+	void	LinearFloatToSrgb8_Scalar(const uint8_t* Src,uint8_t* Dst,size_t Count)
+	{
+		for ( size_t i=0;	i<Count;	i++ )
+		{
+			float Rgba[4];
+			memcpy( Rgba, Src + i*16, sizeof(Rgba) );
+			Dst[i*4+0] = LinearToSrgb8( Rgba[0] );
+			Dst[i*4+1] = LinearToSrgb8( Rgba[1] );
+			Dst[i*4+2] = LinearToSrgb8( Rgba[2] );
+			auto Alpha = std::min( 1.f, std::max( 0.f, Rgba[3] ) );
+			Dst[i*4+3] = static_cast<uint8_t>( Alpha * 255.f + 0.5f );
+		}
+	}
+}
+
+
+#if defined(ENABLE_SIMD_X86)
+namespace PopWritePixels
+{
+	SIMD_TARGET("ssse3")
+	void	RgbToRgba_Ssse3(const uint8_t* Src,uint8_t* Dst,size_t Count)
+	{
+		auto Shuffle = _mm_setr_epi8( 0,1,2,-1, 3,4,5,-1, 6,7,8,-1, 9,10,11,-1 );
+		auto Alpha = _mm_set1_epi32( static_cast<int>(0xff000000) );
+		size_t i = 0;
+		//	each load reads 16 bytes but uses 12, so stay clear of the end
+		for ( ;	i+6<=Count;	i+=4 )
+		{
+			auto Rgb = _mm_loadu_si128( reinterpret_cast<const __m128i*>(Src + i*3) );
+			auto Rgba = _mm_or_si128( _mm_shuffle_epi8( Rgb, Shuffle ), Alpha );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>(Dst + i*4), Rgba );
+		}
+		RgbToRgba_Scalar( Src + i*3, Dst + i*4, Count - i );
+	}
+
+	SIMD_TARGET("avx2")
+	void	RgbToRgba_Avx2(const uint8_t* Src,uint8_t* Dst,size_t Count)
+	{
+		auto Shuffle = _mm256_setr_epi8( 0,1,2,-1, 3,4,5,-1, 6,7,8,-1, 9,10,11,-1, 0,1,2,-1, 3,4,5,-1, 6,7,8,-1, 9,10,11,-1 );
+		auto Alpha = _mm256_set1_epi32( static_cast<int>(0xff000000) );
+		size_t i = 0;
+		for ( ;	i+10<=Count;	i+=8 )
+		{
+			auto Low = _mm_loadu_si128( reinterpret_cast<const __m128i*>(Src + i*3) );
+			auto High = _mm_loadu_si128( reinterpret_cast<const __m128i*>(Src + i*3 + 12) );
+			auto Rgb = _mm256_inserti128_si256( _mm256_castsi128_si256(Low), High, 1 );
+			auto Rgba = _mm256_or_si256( _mm256_shuffle_epi8( Rgb, Shuffle ), Alpha );
+			_mm256_storeu_si256( reinterpret_cast<__m256i*>(Dst + i*4), Rgba );
+		}
+		RgbToRgba_Scalar( Src + i*3, Dst + i*4, Count - i );
+	}
+
+	SIMD_TARGET("ssse3")
+	void	SwapRedBlue_Ssse3(const uint8_t* Src,uint8_t* Dst,size_t Count)
+	{
+		auto Shuffle = _mm_setr_epi8( 2,1,0,3, 6,5,4,7, 10,9,8,11, 14,13,12,15 );
+		size_t i = 0;
+		for ( ;	i+4<=Count;	i+=4 )
+		{
+			auto Pixels = _mm_loadu_si128( reinterpret_cast<const __m128i*>(Src + i*4) );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>(Dst + i*4), _mm_shuffle_epi8( Pixels, Shuffle ) );
+		}
+		SwapRedBlue_Scalar( Src + i*4, Dst + i*4, Count - i );
+	}
+
+	SIMD_TARGET("avx2")
+	void	SwapRedBlue_Avx2(const uint8_t* Src,uint8_t* Dst,size_t Count)
+	{
+		auto Shuffle = _mm256_setr_epi8( 2,1,0,3, 6,5,4,7, 10,9,8,11, 14,13,12,15, 2,1,0,3, 6,5,4,7, 10,9,8,11, 14,13,12,15 );
+		size_t i = 0;
+		for ( ;	i+8<=Count;	i+=8 )
+		{
+			auto Pixels = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(Src + i*4) );
+			_mm256_storeu_si256( reinterpret_cast<__m256i*>(Dst + i*4), _mm256_shuffle_epi8( Pixels, Shuffle ) );
+		}
+		SwapRedBlue_Scalar( Src + i*4, Dst + i*4, Count - i );
+	}
+
+	SIMD_TARGET("avx,f16c")
+	void	FloatToHalf_F16c(const uint8_t* Src,uint8_t* Dst,size_t Count)
+	{
+		size_t i = 0;
+		for ( ;	i+8<=Count;	i+=8 )
+		{
+			auto Floats = _mm256_loadu_ps( reinterpret_cast<const float*>(Src + i*4) );
+			auto Halfs = _mm256_cvtps_ph( Floats, _MM_FROUND_TO_NEAREST_INT );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>(Dst + i*2), Halfs );
+		}
+		FloatToHalf_Scalar( Src + i*4, Dst + i*2, Count - i );
+	}
+
+	void	Uint16ToUint8_Sse2(const uint8_t* Src,uint8_t* Dst,size_t Count)
+	{
+		size_t i = 0;
+		for ( ;	i+16<=Count;	i+=16 )
+		{
+			auto a = _mm_loadu_si128( reinterpret_cast<const __m128i*>(Src + i*2) );
+			auto b = _mm_loadu_si128( reinterpret_cast<const __m128i*>(Src + i*2 + 16) );
+			auto Packed = _mm_packus_epi16( _mm_srli_epi16( a, 8 ), _mm_srli_epi16( b, 8 ) );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>(Dst + i), Packed );
+		}
+		Uint16ToUint8_Scalar( Src + i*2, Dst + i, Count - i );
+	}
+
+	SIMD_TARGET("avx2")
+	void	Uint16ToUint8_Avx2(const uint8_t* Src,uint8_t* Dst,size_t Count)
+	{
+		size_t i = 0;
+		for ( ;	i+32<=Count;	i+=32 )
+		{
+			auto a = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(Src + i*2) );
+			auto b = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(Src + i*2 + 32) );
+			auto Packed = _mm256_packus_epi16( _mm256_srli_epi16( a, 8 ), _mm256_srli_epi16( b, 8 ) );
+			//	pack works within 128 bit lanes, put the quarters back in order
+			Packed = _mm256_permute4x64_epi64( Packed, _MM_SHUFFLE(3,1,2,0) );
+			_mm256_storeu_si256( reinterpret_cast<__m256i*>(Dst + i), Packed );
+		}
+		Uint16ToUint8_Scalar( Src + i*2, Dst + i, Count - i );
+	}
+
+	void	LinearFloatToSrgb8_Sse2(const uint8_t* Src,uint8_t* Dst,size_t Count)
+	{
+		//	clamp & scale 4 channels at once, then table lookup (no gather below avx2)
+		auto* Table = GetLinearToSrgb8Table();
+		auto* Thresholds = GetSrgb8Thresholds();
+		auto Zero = _mm_setzero_ps();
+		auto One = _mm_set1_ps( 1.f );
+		auto Scale = _mm_setr_ps( LinearToSrgbTableSize-1, LinearToSrgbTableSize-1, LinearToSrgbTableSize-1, 255.f );
+		auto Half = _mm_set1_ps( 0.5f );
+		for ( size_t i=0;	i<Count;	i++ )
+		{
+			auto Rgba = _mm_loadu_ps( reinterpret_cast<const float*>(Src + i*16) );
+			Rgba = _mm_min_ps( _mm_max_ps( Rgba, Zero ), One );
+			auto Index = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( Rgba, Scale ), Half ) );
+			alignas(16) int32_t Indexes[4];
+			alignas(16) float Values[4];
+			_mm_store_si128( reinterpret_cast<__m128i*>(Indexes), Index );
+			_mm_store_ps( Values, Rgba );
+			for ( int c=0;	c<3;	c++ )
+			{
+				//	the table is within a level of the answer (half a table step is < 0.5 levels at the
+				//	steepest), the thresholds make it exactly the reference's
+				int Level = Table[Indexes[c]];
+				Level += Values[c] >= Thresholds[Level+1];
+				Level -= Values[c] < Thresholds[Level];
+				Dst[i*4+c] = static_cast<uint8_t>( Level );
+			}
+			Dst[i*4+3] = static_cast<uint8_t>( Indexes[3] );
+		}
+	}
+}
+#endif
+
+
+#if defined(ENABLE_SIMD_NEON)
+namespace PopWritePixels
+{
+	void	RgbToRgba_Neon(const uint8_t* Src,uint8_t* Dst,size_t Count)
+	{
+		size_t i = 0;
+		for ( ;	i+16<=Count;	i+=16 )
+		{
+			auto Rgb = vld3q_u8( Src + i*3 );
+			uint8x16x4_t Rgba;
+			Rgba.val[0] = Rgb.val[0];
+			Rgba.val[1] = Rgb.val[1];
+			Rgba.val[2] = Rgb.val[2];
+			Rgba.val[3] = vdupq_n_u8( 255 );
+			vst4q_u8( Dst + i*4, Rgba );
+		}
+		RgbToRgba_Scalar( Src + i*3, Dst + i*4, Count - i );
+	}
+
+	void	SwapRedBlue_Neon(const uint8_t* Src,uint8_t* Dst,size_t Count)
+	{
+		size_t i = 0;
+		for ( ;	i+16<=Count;	i+=16 )
+		{
+			auto Pixels = vld4q_u8( Src + i*4 );
+			auto Red = Pixels.val[0];
+			Pixels.val[0] = Pixels.val[2];
+			Pixels.val[2] = Red;
+			vst4q_u8( Dst + i*4, Pixels );
+		}
+		SwapRedBlue_Scalar( Src + i*4, Dst + i*4, Count - i );
+	}
+
+#if defined(__aarch64__)
+	void	FloatToHalf_Neon(const uint8_t* Src,uint8_t* Dst,size_t Count)
+	{
+		size_t i = 0;
+		for ( ;	i+4<=Count;	i+=4 )
+		{
+			auto Floats = vld1q_f32( reinterpret_cast<const float*>(Src + i*4) );
+			auto Halfs = vreinterpret_u16_f16( vcvt_f16_f32( Floats ) );
+			vst1_u16( reinterpret_cast<uint16_t*>(Dst + i*2), Halfs );
+		}
+		FloatToHalf_Scalar( Src + i*4, Dst + i*2, Count - i );
+	}
+#endif
+
+	void	Uint16ToUint8_Neon(const uint8_t* Src,uint8_t* Dst,size_t Count)
+	{
+		size_t i = 0;
+		for ( ;	i+8<=Count;	i+=8 )
+		{
+			auto Values = vld1q_u16( reinterpret_cast<const uint16_t*>(Src + i*2) );
+			vst1_u8( Dst + i, vshrn_n_u16( Values, 8 ) );
+		}
+		Uint16ToUint8_Scalar( Src + i*2, Dst + i, Count - i );
+	}
+}
+#endif
+
+
+
+uint16_t PopWritePixels::FloatToHalf(float Value)
+{
+	uint32_t Bits;
+	memcpy( &Bits, &Value, sizeof(Bits) );
+
+	uint32_t Sign = (Bits >> 16) & 0x8000;
+	int32_t Exponent = static_cast<int32_t>((Bits >> 23) & 0xff) - 127 + 15;
+	uint32_t Mantissa = Bits & 0x7fffff;
+
+	//	nan/inf
+	if ( ((Bits >> 23) & 0xff) == 0xff )
+		return static_cast<uint16_t>( Sign | 0x7c00 | (Mantissa ? 0x200 : 0) );
+
+	//	overflow to inf
+	if ( Exponent >= 31 )
+		return static_cast<uint16_t>( Sign | 0x7c00 );
+
+	//	denormal or zero
+	if ( Exponent <= 0 )
+	{
+		if ( Exponent < -10 )
+			return static_cast<uint16_t>( Sign );
+		Mantissa |= 0x800000;
+		auto Shift = static_cast<uint32_t>( 14 - Exponent );
+		uint32_t Half = Mantissa >> Shift;
+		//	round to nearest even
+		uint32_t Remainder = Mantissa & ((1u << Shift) - 1);
+		uint32_t Midpoint = 1u << (Shift - 1);
+		if ( Remainder > Midpoint || (Remainder == Midpoint && (Half & 1)) )
+			Half++;
+		return static_cast<uint16_t>( Sign | Half );
+	}
+
+	uint32_t Half = Sign | (static_cast<uint32_t>(Exponent) << 10) | (Mantissa >> 13);
+	uint32_t Remainder = Mantissa & 0x1fff;
+	//	round to nearest even, carrying into the exponent is correct (and may give inf)
+	if ( Remainder > 0x1000 || (Remainder == 0x1000 && (Half & 1)) )
+		Half++;
+	return static_cast<uint16_t>( Half );
+}
+
+uint8_t PopWritePixels::LinearToSrgb8(float Value)
+{
+	Value = std::min( 1.f, std::max( 0.f, Value ) );
+	float Srgb;
+	if ( Value <= 0.0031308f )
+		Srgb = Value * 12.92f;
+	else
+		Srgb = 1.055f * std::pow( Value, 1.f/2.4f ) - 0.055f;
+	return static_cast<uint8_t>( Srgb * 255.f + 0.5f );
+}
+
+const uint8_t* PopWritePixels::GetLinearToSrgb8Table()
+{
+	static uint8_t gTable[LinearToSrgbTableSize];
+	static bool gInitialised = [&]
+	{
+		for ( size_t i=0;	i<LinearToSrgbTableSize;	i++ )
+			gTable[i] = LinearToSrgb8( static_cast<float>(i) / static_cast<float>(LinearToSrgbTableSize-1) );
+		return true;
+	}();
+	(void)gInitialised;
+	return gTable;
+}
+
+const float* PopWritePixels::GetSrgb8Thresholds()
+{
+	static float gThresholds[257];
+	static bool gInitialised = [&]
+	{
+		gThresholds[256] = 2.f;
+		//	positive floats order the same as their bits, so search those
+		for ( int Level=0;	Level<256;	Level++ )
+		{
+			uint32_t Low = 0;
+			uint32_t High = 0x3f800000;		//	1.0
+			while ( Low < High )
+			{
+				auto Mid = Low + (High - Low) / 2;
+				float Value;
+				memcpy( &Value, &Mid, sizeof(Value) );
+				if ( LinearToSrgb8( Value ) >= Level )
+					High = Mid;
+				else
+					Low = Mid + 1;
+			}
+			memcpy( &gThresholds[Level], &Low, sizeof(float) );
+		}
+		return true;
+	}();
+	(void)gInitialised;
+	return gThresholds;
+}
+
+
+#if defined(ENABLE_SIMD_X86)
+#if defined(_MSC_VER)
+namespace PopWritePixels
+{
+	namespace Cpu
+	{
+		bool	HasCpuidBit(int Leaf,int Register,int Bit)
+		{
+			int Info[4];
+			__cpuidex( Info, Leaf, 0 );
+			return ( Info[Register] & (1<<Bit) ) != 0;
+		}
+	}
+}
+bool PopWritePixels::Cpu::HasSsse3()	{	return HasCpuidBit( 1, 2, 9 );	}
+bool PopWritePixels::Cpu::HasF16c()		{	return HasCpuidBit( 1, 2, 29 ) && HasCpuidBit( 1, 2, 28 );	}
+//	gr: should also check the os saves ymm registers (xgetbv) for avx
+bool PopWritePixels::Cpu::HasAvx2()		{	return HasCpuidBit( 7, 1, 5 ) && HasCpuidBit( 1, 2, 28 );	}
+#else
+bool PopWritePixels::Cpu::HasSsse3()	{	return __builtin_cpu_supports("ssse3");	}
+bool PopWritePixels::Cpu::HasAvx2()		{	return __builtin_cpu_supports("avx2");	}
+bool PopWritePixels::Cpu::HasF16c()		{	return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");	}
+#endif
+#endif
+
+
+TConversionInfo PopWritePixels::GetConversionInfo(TPixelConversion::Type Conversion)
+{
+	switch ( Conversion )
+	{
+		case TPixelConversion::RgbToRgba:			return TConversionInfo{ 3, 4 };
+		case TPixelConversion::SwapRedBlue:			return TConversionInfo{ 4, 4 };
+		case TPixelConversion::FloatToHalf:			return TConversionInfo{ 4, 2 };
+		case TPixelConversion::Uint16ToUint8:		return TConversionInfo{ 2, 1 };
+		case TPixelConversion::LinearFloatToSrgb8:	return TConversionInfo{ 16, 4 };
+		default:
+			break;
+	}
+	throw Soy::AssertException("Unknown pixel conversion");
+}
+
+TConvertKernel PopWritePixels::GetReferenceKernel(TPixelConversion::Type Conversion)
+{
+	switch ( Conversion )
+	{
+		case TPixelConversion::RgbToRgba:			return RgbToRgba_Scalar;
+		case TPixelConversion::SwapRedBlue:			return SwapRedBlue_Scalar;
+		case TPixelConversion::FloatToHalf:			return FloatToHalf_Scalar;
+		case TPixelConversion::Uint16ToUint8:		return Uint16ToUint8_Scalar;
+		case TPixelConversion::LinearFloatToSrgb8:	return LinearFloatToSrgb8_Scalar;
+		default:
+			break;
+	}
+	throw Soy::AssertException("Unknown pixel conversion");
+}
+
+TConvertKernel PopWritePixels::GetBestKernel(TPixelConversion::Type Conversion,const char*& Name)
+{
+#if defined(ENABLE_SIMD_X86)
+	static bool Ssse3 = Cpu::HasSsse3();
+	static bool Avx2 = Cpu::HasAvx2();
+	static bool F16c = Cpu::HasF16c();
+
+	switch ( Conversion )
+	{
+		case TPixelConversion::RgbToRgba:
+			if ( Avx2 )		{	Name = "avx2";	return RgbToRgba_Avx2;	}
+			if ( Ssse3 )	{	Name = "ssse3";	return RgbToRgba_Ssse3;	}
+			break;
+		case TPixelConversion::SwapRedBlue:
+			if ( Avx2 )		{	Name = "avx2";	return SwapRedBlue_Avx2;	}
+			if ( Ssse3 )	{	Name = "ssse3";	return SwapRedBlue_Ssse3;	}
+			break;
+		case TPixelConversion::FloatToHalf:
+			if ( F16c )		{	Name = "f16c";	return FloatToHalf_F16c;	}
+			break;
+		case TPixelConversion::Uint16ToUint8:
+			if ( Avx2 )		{	Name = "avx2";	return Uint16ToUint8_Avx2;	}
+			Name = "sse2";
+			return Uint16ToUint8_Sse2;
+		case TPixelConversion::LinearFloatToSrgb8:
+			Name = "sse2";
+			return LinearFloatToSrgb8_Sse2;
+		default:
+			break;
+	}
+#elif defined(ENABLE_SIMD_NEON)
+	switch ( Conversion )
+	{
+		case TPixelConversion::RgbToRgba:		Name = "neon";	return RgbToRgba_Neon;
+		case TPixelConversion::SwapRedBlue:		Name = "neon";	return SwapRedBlue_Neon;
+#if defined(__aarch64__)
+		case TPixelConversion::FloatToHalf:		Name = "neon";	return FloatToHalf_Neon;
+#endif
+		case TPixelConversion::Uint16ToUint8:	Name = "neon";	return Uint16ToUint8_Neon;
+		default:
+			break;
+	}
+#endif
+
+	Name = "scalar";
+	return GetReferenceKernel( Conversion );
+}
+
+std::vector<std::pair<const char*,TConvertKernel>> PopWritePixels::GetKernels(TPixelConversion::Type Conversion)
+{
+	std::vector<std::pair<const char*,TConvertKernel>> Kernels;
+#if defined(ENABLE_SIMD_X86)
+	switch ( Conversion )
+	{
+		case TPixelConversion::RgbToRgba:
+			if ( Cpu::HasAvx2() )	Kernels.push_back( { "avx2", RgbToRgba_Avx2 } );
+			if ( Cpu::HasSsse3() )	Kernels.push_back( { "ssse3", RgbToRgba_Ssse3 } );
+			break;
+		case TPixelConversion::SwapRedBlue:
+			if ( Cpu::HasAvx2() )	Kernels.push_back( { "avx2", SwapRedBlue_Avx2 } );
+			if ( Cpu::HasSsse3() )	Kernels.push_back( { "ssse3", SwapRedBlue_Ssse3 } );
+			break;
+		case TPixelConversion::FloatToHalf:
+			if ( Cpu::HasF16c() )	Kernels.push_back( { "f16c", FloatToHalf_F16c } );
+			break;
+		case TPixelConversion::Uint16ToUint8:
+			if ( Cpu::HasAvx2() )	Kernels.push_back( { "avx2", Uint16ToUint8_Avx2 } );
+			Kernels.push_back( { "sse2", Uint16ToUint8_Sse2 } );
+			break;
+		case TPixelConversion::LinearFloatToSrgb8:
+			Kernels.push_back( { "sse2", LinearFloatToSrgb8_Sse2 } );
+			break;
+		default:
+			break;
+	}
+#elif defined(ENABLE_SIMD_NEON)
+	switch ( Conversion )
+	{
+		case TPixelConversion::RgbToRgba:		Kernels.push_back( { "neon", RgbToRgba_Neon } );	break;
+		case TPixelConversion::SwapRedBlue:		Kernels.push_back( { "neon", SwapRedBlue_Neon } );	break;
+#if defined(__aarch64__)
+		case TPixelConversion::FloatToHalf:		Kernels.push_back( { "neon", FloatToHalf_Neon } );	break;
+#endif
+		case TPixelConversion::Uint16ToUint8:	Kernels.push_back( { "neon", Uint16ToUint8_Neon } );	break;
+		default:
+			break;
+	}
+#endif
+
+	Kernels.push_back( { "scalar", GetReferenceKernel( Conversion ) } );
+	return Kernels;
+}
+
+std::vector<const char*> PopWritePixels::GetConversionKernelNames(TPixelConversion::Type Conversion)
+{
+	std::vector<const char*> Names;
+	for ( auto& Kernel : GetKernels( Conversion ) )
+		Names.push_back( Kernel.first );
+	return Names;
+}
+
+void PopWritePixels::ConvertRowsWithKernel(TPixelConversion::Type Conversion,const char* KernelName,const uint8_t* Src,uint8_t* Dst,size_t DstSize)
+{
+	auto Info = GetConversionInfo( Conversion );
+	for ( auto& Kernel : GetKernels( Conversion ) )
+	{
+		if ( strcmp( Kernel.first, KernelName ) != 0 )
+			continue;
+		Kernel.second( Src, Dst, DstSize / Info.mDstBytesPerUnit );
+		return;
+	}
+	throw Soy::AssertException( std::string("No ") + KernelName + " kernel for this conversion" );
+}
+
+size_t PopWritePixels::GetConversionSourceRowSize(TPixelConversion::Type Conversion,size_t DstRowSize)
+{
+	auto Info = GetConversionInfo( Conversion );
+	if ( DstRowSize % Info.mDstBytesPerUnit != 0 )
+		throw Soy::AssertException("Row size doesn't fit conversion");
+	return (DstRowSize / Info.mDstBytesPerUnit) * Info.mSrcBytesPerUnit;
+}
+
+size_t PopWritePixels::GetConversionDstUnitSize(TPixelConversion::Type Conversion)
+{
+	return GetConversionInfo( Conversion ).mDstBytesPerUnit;
+}
+
+void PopWritePixels::ConvertRows(TPixelConversion::Type Conversion,const uint8_t* Src,uint8_t* Dst,size_t DstSize)
+{
+	const char* Name = nullptr;
+	auto Kernel = GetBestKernel( Conversion, Name );
+	auto Info = GetConversionInfo( Conversion );
+	Kernel( Src, Dst, DstSize / Info.mDstBytesPerUnit );
+}
+
+void PopWritePixels::ConvertRowsReference(TPixelConversion::Type Conversion,const uint8_t* Src,uint8_t* Dst,size_t DstSize)
+{
+	auto Kernel = GetReferenceKernel( Conversion );
+	auto Info = GetConversionInfo( Conversion );
+	Kernel( Src, Dst, DstSize / Info.mDstBytesPerUnit );
+}
+
+const char* PopWritePixels::GetConversionKernelName(TPixelConversion::Type Conversion)
+{
+	const char* Name = nullptr;
+	GetBestKernel( Conversion, Name );
+	return Name;
+}
+
+
+
+TConvertRows::TConvertRows(TPixelConversion::Type Conversion,const uint8_t* Src,std::shared_ptr<TPixelBuffer> Dst,size_t DstRowSize,size_t RowCount,size_t BandRows) :
+	mConversion		( Conversion ),
+	mSrc			( Src ),
+	mDst			( Dst ),
+	mDstRowSize		( DstRowSize ),
+	mRowCount		( RowCount ),
+	mBandRows		( std::max<size_t>( 1, BandRows ) ),
+	mFailed			( false )
+{
+	mBandCount = (mRowCount + mBandRows - 1) / mBandRows;
+	mBandDone.reset( new std::atomic<bool>[mBandCount] );
+	for ( size_t b=0;	b<mBandCount;	b++ )
+		mBandDone[b] = false;
+}
+
+void TConvertRows::Start(TWorkerPool& Pool)
+{
+	//	the jobs keep us (and the output buffer) alive
+	auto This = shared_from_this();
+	for ( size_t b=0;	b<mBandCount;	b++ )
+	{
+		auto Job = [This,b]
+		{
+			This->ConvertBand( b );
+		};
+		Pool.Push( Job );
+	}
+}
+
+void TConvertRows::ConvertBand(size_t Band)
+{
+	try
+	{
+		auto RowFirst = Band * mBandRows;
+		auto RowCount = std::min( mBandRows, mRowCount - RowFirst );
+		auto SrcRowSize = PopWritePixels::GetConversionSourceRowSize( mConversion, mDstRowSize );
+		auto* Src = mSrc + (RowFirst * SrcRowSize);
+		auto* Dst = mDst->mData + (RowFirst * mDstRowSize);
+		PopWritePixels::ConvertRows( mConversion, Src, Dst, RowCount * mDstRowSize );
+		mBandDone[Band] = true;
+	}
+	catch(std::exception& e)
+	{
+		std::Debug << "Pixel conversion failed: " << e.what() << std::endl;
+		mFailed = true;
+	}
+}
+
+size_t TConvertRows::GetRowsReady()
+{
+	if ( mFailed )
+		throw Soy::AssertException("Pixel conversion failed");
+
+	while ( mBandsReady < mBandCount && mBandDone[mBandsReady] )
+		mBandsReady++;
+
+	return std::min( mRowCount, mBandsReady * mBandRows );
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "TCache.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+
+class TWorkerPool;
+
+
+//	gr: matching values in c#
+//	conversions of incoming bytes into the texture's format, for sources the gpu can't take directly
+namespace TPixelConversion
+{
+	enum Type
+	{
+		None = 0,
+		RgbToRgba = 1,				//	8 bit, alpha = 255
+		SwapRedBlue = 2,			//	8 bit BGRA <-> RGBA
+		FloatToHalf = 3,			//	per component
+		Uint16ToUint8 = 4,			//	per component, keeps the high byte
+		LinearFloatToSrgb8 = 5,		//	RGBA float to RGBA 8 bit, alpha stays linear
+	};
+}
+
+
+namespace PopWritePixels
+{
+	//	bytes of source needed to produce DstRowSize bytes
+	size_t		GetConversionSourceRowSize(TPixelConversion::Type Conversion,size_t DstRowSize);
+	//	destination bytes per converted unit; sizes passed to ConvertRows are multiples of this
+	size_t		GetConversionDstUnitSize(TPixelConversion::Type Conversion);
+
+	//	fastest kernel for this cpu
+	void		ConvertRows(TPixelConversion::Type Conversion,const uint8_t* Src,uint8_t* Dst,size_t DstSize);
+	//	scalar implementation, which the simd kernels should match
+	void		ConvertRowsReference(TPixelConversion::Type Conversion,const uint8_t* Src,uint8_t* Dst,size_t DstSize);
+	//	"scalar", "ssse3", "avx2" etc
+	const char*	GetConversionKernelName(TPixelConversion::Type Conversion);
+
+	//	every kernel this cpu can run for the conversion, fastest first and the reference last, so each can be tested
+	std::vector<const char*>	GetConversionKernelNames(TPixelConversion::Type Conversion);
+	void		ConvertRowsWithKernel(TPixelConversion::Type Conversion,const char* KernelName,const uint8_t* Src,uint8_t* Dst,size_t DstSize);
+}
+
+
+//	converts bands of rows on worker threads; the render thread writes them as they're ready
+class TConvertRows : public TRowProducer, public std::enable_shared_from_this<TConvertRows>
+{
+public:
+	TConvertRows(TPixelConversion::Type Conversion,const uint8_t* Src,std::shared_ptr<TPixelBuffer> Dst,size_t DstRowSize,size_t RowCount,size_t BandRows);
+
+	void			Start(TWorkerPool& Pool);
+	virtual size_t	GetRowsReady() override;
+
+private:
+	void			ConvertBand(size_t Band);
+
+private:
+	TPixelConversion::Type			mConversion;
+	const uint8_t*					mSrc;
+	std::shared_ptr<TPixelBuffer>	mDst;		//	keep the buffer ours until workers are done, even if the write is dropped
+	size_t							mDstRowSize;
+	size_t							mRowCount;
+	size_t							mBandRows;
+	size_t							mBandCount;
+	std::unique_ptr<std::atomic<bool>[]>	mBandDone;
+	std::atomic<bool>				mFailed;
+	size_t							mBandsReady = 0;	//	contiguous from the top, render thread only
+};
@@ -0,0 +1,381 @@
+#include "TPngDecode.h"
+#include "TWorkerPool.h"
+#include <SoyDebug.h>
+#include <SoyTypes.h>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+#if defined(ENABLE_ZLIB)
+#include <zlib.h>
+#endif
+
+
+namespace PopWritePixels
+{
+	namespace TPngColourType
+	{
+		enum Type
+		{
+			Greyscale = 0,
+			Rgb = 2,
+			Palette = 3,
+			GreyscaleAlpha = 4,
+			Rgba = 6,
+		};
+	}
+
+	uint32_t		ReadBigEndian32(const uint8_t* Data);
+	size_t			GetPngSamplesPerPixel(uint8_t ColourType);
+	size_t			GetPngRowSize(const TPngHeader& Header);			//	without the filter byte
+	size_t			GetPngPixelStride(const TPngHeader& Header);		//	bytes back to the same sample of the previous pixel, for filters
+	uint8_t			PaethPredictor(int a,int b,int c);
+	void			UnfilterPngRow(uint8_t Filter,uint8_t* Row,const uint8_t* PrevRow,size_t RowSize,size_t Stride);
+}
+
+
+uint32_t PopWritePixels::ReadBigEndian32(const uint8_t* Data)
+{
+	return (Data[0] << 24) | (Data[1] << 16) | (Data[2] << 8) | (Data[3] << 0);
+}
+
+bool PopWritePixels::IsPng(const uint8_t* Data,size_t Size)
+{
+	static const uint8_t Magic[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	return Size >= sizeof(Magic) && memcmp( Data, Magic, sizeof(Magic) ) == 0;
+}
+
+bool PopWritePixels::IsJpeg(const uint8_t* Data,size_t Size)
+{
+	return Size >= 3 && Data[0] == 0xff && Data[1] == 0xd8 && Data[2] == 0xff;
+}
+
+size_t PopWritePixels::GetPngSamplesPerPixel(uint8_t ColourType)
+{
+	switch ( ColourType )
+	{
+		case TPngColourType::Greyscale:			return 1;
+		case TPngColourType::Rgb:				return 3;
+		case TPngColourType::Palette:			return 1;
+		case TPngColourType::GreyscaleAlpha:	return 2;
+		case TPngColourType::Rgba:				return 4;
+		default:
+			throw Soy::AssertException("Unknown png colour type");
+	}
+}
+
+size_t PopWritePixels::GetPngRowSize(const TPngHeader& Header)
+{
+	auto Bits = Header.mWidth * GetPngSamplesPerPixel( Header.mColourType ) * Header.mBitDepth;
+	return (Bits + 7) / 8;
+}
+
+size_t PopWritePixels::GetPngPixelStride(const TPngHeader& Header)
+{
+	auto Bits = GetPngSamplesPerPixel( Header.mColourType ) * Header.mBitDepth;
+	return std::max<size_t>( 1, Bits / 8 );
+}
+
+TPngHeader PopWritePixels::ReadPngHeader(const uint8_t* Png,size_t PngSize)
+{
+	if ( !IsPng( Png, PngSize ) )
+		throw Soy::AssertException("Data is not a png");
+
+	//	IHDR is always first
+	if ( PngSize < 8 + 8 + 13 || memcmp( Png + 12, "IHDR", 4 ) != 0 )
+		throw Soy::AssertException("Png is missing its header");
+
+	auto* Ihdr = Png + 16;
+	TPngHeader Header;
+	Header.mWidth = ReadBigEndian32( Ihdr + 0 );
+	Header.mHeight = ReadBigEndian32( Ihdr + 4 );
+	Header.mBitDepth = Ihdr[8];
+	Header.mColourType = Ihdr[9];
+	Header.mInterlace = Ihdr[12];
+
+	GetPngSamplesPerPixel( Header.mColourType );
+	if ( Header.mWidth == 0 || Header.mHeight == 0 )
+		throw Soy::AssertException("Png is empty");
+	if ( Header.mBitDepth != 1 && Header.mBitDepth != 2 && Header.mBitDepth != 4 && Header.mBitDepth != 8 && Header.mBitDepth != 16 )
+		throw Soy::AssertException("Unsupported png bit depth");
+	//	gr: adam7 passes each cover the whole image, so there are no finished rows to write until the last pass
+	if ( Header.mInterlace != 0 )
+		throw Soy::AssertException("Interlaced pngs can't be decoded progressively");
+	return Header;
+}
+
+uint8_t PopWritePixels::PaethPredictor(int a,int b,int c)
+{
+	auto p = a + b - c;
+	auto pa = abs( p - a );
+	auto pb = abs( p - b );
+	auto pc = abs( p - c );
+	if ( pa <= pb && pa <= pc )
+		return static_cast<uint8_t>(a);
+	if ( pb <= pc )
+		return static_cast<uint8_t>(b);
+	return static_cast<uint8_t>(c);
+}
+
+void PopWritePixels::UnfilterPngRow(uint8_t Filter,uint8_t* Row,const uint8_t* PrevRow,size_t RowSize,size_t Stride)
+{
+	switch ( Filter )
+	{
+		case 0:
+			return;
+
+		case 1:	//	sub
+			for ( size_t i=Stride;	i<RowSize;	i++ )
+				Row[i] += Row[i-Stride];
+			return;
+
+		case 2:	//	up
+			for ( size_t i=0;	i<RowSize;	i++ )
+				Row[i] += PrevRow[i];
+			return;
+
+		case 3:	//	average
+			for ( size_t i=0;	i<RowSize;	i++ )
+			{
+				int Left = i >= Stride ? Row[i-Stride] : 0;
+				Row[i] += static_cast<uint8_t>( (Left + PrevRow[i]) / 2 );
+			}
+			return;
+
+		case 4:	//	paeth
+			for ( size_t i=0;	i<RowSize;	i++ )
+			{
+				int Left = i >= Stride ? Row[i-Stride] : 0;
+				int UpLeft = i >= Stride ? PrevRow[i-Stride] : 0;
+				Row[i] += PaethPredictor( Left, PrevRow[i], UpLeft );
+			}
+			return;
+
+		default:
+			throw Soy::AssertException("Unknown png row filter");
+	}
+}
+
+
+TDecodePngRows::TDecodePngRows(const uint8_t* Png,size_t PngSize,std::shared_ptr<TMappedFile> File,const SoyPixelsMeta& DstMeta,std::shared_ptr<TPixelBuffer> Dst) :
+	mFile		( File ),
+	mPng		( Png ),
+	mPngSize	( PngSize ),
+	mDstMeta	( DstMeta ),
+	mDst		( Dst ),
+	mRowsReady	( 0 ),
+	mFailed		( false )
+{
+#if !defined(ENABLE_ZLIB)
+	throw Soy::AssertException("Png decoding isn't built on this platform (needs ENABLE_ZLIB)");
+#endif
+	mHeader = PopWritePixels::ReadPngHeader( mPng, mPngSize );
+	if ( mHeader.mWidth != mDstMeta.GetWidth() || mHeader.mHeight != mDstMeta.GetHeight() )
+		throw Soy::AssertException("Png dimensions don't match the texture");
+	if ( mDst->mSize < mDstMeta.GetDataSize() )
+		throw Soy::AssertException("Decode buffer too small");
+
+	if ( !mFile )
+	{
+		mPngCopy.assign( Png, Png + PngSize );
+		mPng = mPngCopy.data();
+	}
+
+	//	opaque greyscale ramp until a PLTE says otherwise
+	for ( int i=0;	i<256;	i++ )
+	{
+		mPalette[i*4+0] = mPalette[i*4+1] = mPalette[i*4+2] = static_cast<uint8_t>(i);
+		mPalette[i*4+3] = 255;
+	}
+}
+
+void TDecodePngRows::Start(TWorkerPool& Pool)
+{
+	//	the job keeps us (and the output buffer) alive
+	auto This = shared_from_this();
+	auto Job = [This]
+	{
+		try
+		{
+			This->Decode();
+		}
+		catch(std::exception& e)
+		{
+			if ( PopWritePixels::IsLogging( TLogLevel::Errors ) )
+				std::Debug << "Png decode failed: " << e.what() << std::endl;
+			This->mFailed = true;
+		}
+	};
+	Pool.Push( Job );
+}
+
+size_t TDecodePngRows::GetRowsReady()
+{
+	if ( mFailed )
+		throw Soy::AssertException("Png decode failed");
+	return mRowsReady.load( std::memory_order_acquire );
+}
+
+void TDecodePngRows::Decode()
+{
+#if defined(ENABLE_ZLIB)
+	auto RowSize = PopWritePixels::GetPngRowSize( mHeader );
+	auto Stride = PopWritePixels::GetPngPixelStride( mHeader );
+
+	//	filter byte + row, and the previous row for the up/average/paeth filters
+	std::vector<uint8_t> Row( RowSize + 1 );
+	std::vector<uint8_t> PrevRow( RowSize + 1, 0 );
+	size_t RowFilled = 0;
+	size_t y = 0;
+
+	z_stream Stream;
+	memset( &Stream, 0, sizeof(Stream) );
+	if ( inflateInit( &Stream ) != Z_OK )
+		throw Soy::AssertException("inflateInit failed");
+
+	try
+	{
+		size_t ChunkPos = 8;
+		while ( y < mHeader.mHeight )
+		{
+			if ( ChunkPos + 12 > mPngSize )
+				throw Soy::AssertException("Png ended before all rows were decoded");
+
+			auto ChunkSize = PopWritePixels::ReadBigEndian32( mPng + ChunkPos );
+			auto* ChunkType = mPng + ChunkPos + 4;
+			auto* ChunkData = mPng + ChunkPos + 8;
+			if ( ChunkPos + 12 + ChunkSize > mPngSize )
+				throw Soy::AssertException("Png chunk is truncated");
+			ChunkPos += 12 + ChunkSize;
+
+			if ( memcmp( ChunkType, "PLTE", 4 ) == 0 )
+			{
+				for ( size_t i=0;	i<std::min<size_t>( 256, ChunkSize / 3 );	i++ )
+				{
+					mPalette[i*4+0] = ChunkData[i*3+0];
+					mPalette[i*4+1] = ChunkData[i*3+1];
+					mPalette[i*4+2] = ChunkData[i*3+2];
+				}
+				continue;
+			}
+
+			if ( memcmp( ChunkType, "tRNS", 4 ) == 0 && mHeader.mColourType == PopWritePixels::TPngColourType::Palette )
+			{
+				for ( size_t i=0;	i<std::min<size_t>( 256, ChunkSize );	i++ )
+					mPalette[i*4+3] = ChunkData[i];
+				continue;
+			}
+
+			if ( memcmp( ChunkType, "IDAT", 4 ) != 0 )
+				continue;
+
+			//	inflate this chunk a row at a time, publishing each as it completes
+			Stream.next_in = const_cast<Bytef*>( ChunkData );
+			Stream.avail_in = ChunkSize;
+			while ( Stream.avail_in > 0 && y < mHeader.mHeight )
+			{
+				Stream.next_out = Row.data() + RowFilled;
+				Stream.avail_out = static_cast<uInt>( Row.size() - RowFilled );
+				auto Result = inflate( &Stream, Z_NO_FLUSH );
+				if ( Result != Z_OK && Result != Z_STREAM_END && Result != Z_BUF_ERROR )
+					throw Soy::AssertException("Png data is corrupt");
+				RowFilled = Row.size() - Stream.avail_out;
+
+				if ( RowFilled == Row.size() )
+				{
+					PopWritePixels::UnfilterPngRow( Row[0], Row.data() + 1, PrevRow.data() + 1, RowSize, Stride );
+					WriteRow( Row.data() + 1, y );
+					std::swap( Row, PrevRow );
+					RowFilled = 0;
+					y++;
+					mRowsReady.store( y, std::memory_order_release );
+				}
+
+				if ( Result == Z_STREAM_END )
+					break;
+				//	needs more input
+				if ( Result == Z_BUF_ERROR && Stream.avail_in == 0 )
+					break;
+			}
+		}
+	}
+	catch(...)
+	{
+		inflateEnd( &Stream );
+		throw;
+	}
+	inflateEnd( &Stream );
+#endif
+}
+
+void TDecodePngRows::WriteRow(const uint8_t* Row,size_t y)
+{
+	auto Width = mHeader.mWidth;
+	auto BitDepth = mHeader.mBitDepth;
+	auto ColourType = mHeader.mColourType;
+	auto SamplesPerPixel = PopWritePixels::GetPngSamplesPerPixel( ColourType );
+	auto DstChannels = mDstMeta.GetChannels();
+	bool SwapRedBlue = mDstMeta.GetFormat() == SoyPixelsFormat::BGRA;
+	auto* Dst = mDst->mData + (y * mDstMeta.GetRowDataSize());
+
+	//	8 bit sample of this pixel, low bit depths scaled up, 16 bit reduced to the high byte
+	auto GetSample = [&](size_t x,size_t Sample) -> uint8_t
+	{
+		auto Index = x * SamplesPerPixel + Sample;
+		if ( BitDepth == 8 )
+			return Row[Index];
+		if ( BitDepth == 16 )
+			return Row[Index*2];
+
+		auto Bit = Index * BitDepth;
+		auto Value = ( Row[Bit/8] >> (8 - BitDepth - (Bit%8)) ) & ((1 << BitDepth) - 1);
+		//	palette indexes aren't intensities
+		if ( ColourType == PopWritePixels::TPngColourType::Palette )
+			return static_cast<uint8_t>(Value);
+		return static_cast<uint8_t>( (Value * 255) / ((1 << BitDepth) - 1) );
+	};
+
+	for ( size_t x=0;	x<Width;	x++ )
+	{
+		uint8_t Rgba[4];
+		switch ( ColourType )
+		{
+			case PopWritePixels::TPngColourType::Greyscale:
+				Rgba[0] = Rgba[1] = Rgba[2] = GetSample( x, 0 );
+				Rgba[3] = 255;
+				break;
+			case PopWritePixels::TPngColourType::GreyscaleAlpha:
+				Rgba[0] = Rgba[1] = Rgba[2] = GetSample( x, 0 );
+				Rgba[3] = GetSample( x, 1 );
+				break;
+			case PopWritePixels::TPngColourType::Rgb:
+				Rgba[0] = GetSample( x, 0 );
+				Rgba[1] = GetSample( x, 1 );
+				Rgba[2] = GetSample( x, 2 );
+				Rgba[3] = 255;
+				break;
+			case PopWritePixels::TPngColourType::Palette:
+				memcpy( Rgba, &mPalette[GetSample( x, 0 ) * 4], 4 );
+				break;
+			default:
+				Rgba[0] = GetSample( x, 0 );
+				Rgba[1] = GetSample( x, 1 );
+				Rgba[2] = GetSample( x, 2 );
+				Rgba[3] = GetSample( x, 3 );
+				break;
+		}
+		if ( SwapRedBlue )
+			std::swap( Rgba[0], Rgba[2] );
+
+		//	1 channel = red/luminance, 2 = luminance & alpha
+		auto* DstPixel = Dst + (x * DstChannels);
+		if ( DstChannels == 2 )
+		{
+			DstPixel[0] = Rgba[0];
+			DstPixel[1] = Rgba[3];
+			continue;
+		}
+		for ( size_t c=0;	c<DstChannels && c<4;	c++ )
+			DstPixel[c] = Rgba[c];
+	}
+}
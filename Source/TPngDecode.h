@@ -0,0 +1,61 @@
+#pragma once
+
+#include "TCache.h"
+#include <memory>
+#include <atomic>
+#include <vector>
+
+class TWorkerPool;
+
+//	zlib is linked on android (see Android.mk); define ENABLE_ZLIB in other builds which link it
+#if defined(TARGET_ANDROID) && !defined(ENABLE_ZLIB)
+#define ENABLE_ZLIB
+#endif
+
+
+class TPngHeader
+{
+public:
+	size_t		mWidth = 0;
+	size_t		mHeight = 0;
+	uint8_t		mBitDepth = 0;
+	uint8_t		mColourType = 0;
+	uint8_t		mInterlace = 0;
+};
+
+
+//	decodes a png top to bottom on a worker thread, each row is ready as soon as it's inflated & unfiltered.
+//	Output is converted to the texture's 8 bit format
+class TDecodePngRows : public TRowProducer, public std::enable_shared_from_this<TDecodePngRows>
+{
+public:
+	//	if File is null, the png is copied, so the caller can let go of it
+	TDecodePngRows(const uint8_t* Png,size_t PngSize,std::shared_ptr<TMappedFile> File,const SoyPixelsMeta& DstMeta,std::shared_ptr<TPixelBuffer> Dst);
+
+	void			Start(TWorkerPool& Pool);
+	virtual size_t	GetRowsReady() override;
+
+private:
+	void			Decode();
+	void			WriteRow(const uint8_t* Row,size_t y);
+
+private:
+	std::vector<uint8_t>			mPngCopy;
+	std::shared_ptr<TMappedFile>	mFile;
+	const uint8_t*					mPng;
+	size_t							mPngSize;
+	TPngHeader						mHeader;
+	SoyPixelsMeta					mDstMeta;
+	std::shared_ptr<TPixelBuffer>	mDst;		//	keep the buffer ours until the decode is done, even if the write is dropped
+	uint8_t							mPalette[256*4];
+	std::atomic<size_t>				mRowsReady;
+	std::atomic<bool>				mFailed;
+};
+
+
+namespace PopWritePixels
+{
+	bool			IsPng(const uint8_t* Data,size_t Size);
+	bool			IsJpeg(const uint8_t* Data,size_t Size);
+	TPngHeader		ReadPngHeader(const uint8_t* Png,size_t PngSize);	//	throws if not a png we can decode
+}
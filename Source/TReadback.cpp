@@ -0,0 +1,211 @@
+#include "TReadback.h"
+#include "TCache.h"
+#include "TWriteBudget.h"
+#include <algorithm>
+#include <map>
+
+
+namespace PopWritePixels
+{
+	std::mutex									gReadbackLock;
+	std::map<int,std::shared_ptr<TReadback>>	gReadbacks;
+	int											gNextReadback = 1;
+}
+
+
+TReadback::TReadback(int CacheHandle,void* TexturePtr,const SoyPixelsMeta& Meta,TTextureBackendType::Type BackendType) :
+	mMeta				( Meta ),
+	mReadRowsPerFrame	( 256 ),
+	mCacheHandle		( CacheHandle ),
+	mTexturePtr			( TexturePtr ),
+	mBackendType		( BackendType ),
+	mLastSubmission		( 0 ),
+	mProgress			( 0 ),
+	mCacheReleased		( false )
+{
+}
+
+void TReadback::Queue(uint8_t* Bytes,size_t BytesSize)
+{
+	if ( mCacheReleased )
+		throw Soy::AssertException("Readback's cache has been released");
+
+	std::shared_ptr<TReadRequest> Request( new TReadRequest() );
+	if ( Bytes )
+	{
+		if ( BytesSize < mMeta.GetDataSize() )
+			throw Soy::AssertException("Not enough bytes to read the texture into");
+		Request->mBytes = Bytes;
+		Request->mBytesSize = BytesSize;
+	}
+	else
+	{
+		auto& Pool = PopWritePixels::GetPixelBufferPool();
+		uint8_t* Data = nullptr;
+		Request->mBuffer = Pool.Submit( Pool.Alloc( mMeta.GetDataSize(), Data ) );
+		Request->mBytes = Data;
+		Request->mBytesSize = mMeta.GetDataSize();
+	}
+	Request->mQueueTime = PopWritePixels::GetMicrosecsNow();
+
+	std::lock_guard<std::mutex> Lock( mRequestLock );
+	Request->mSubmission = mLastSubmission + 1;
+	//	publish the id first, so progress reads 0 until the render thread picks this up
+	mLastSubmission = Request->mSubmission;
+	mNextRequest = Request;
+	mLastRequest = Request;
+}
+
+uint8_t* TReadback::GetBytes(size_t& BytesSize)
+{
+	std::lock_guard<std::mutex> Lock( mRequestLock );
+	if ( !mLastRequest )
+		throw Soy::AssertException("Nothing has been queued to read");
+	BytesSize = mLastRequest->mBytesSize;
+	return mLastRequest->mBytes;
+}
+
+size_t TReadback::GetRowsRead() const
+{
+	if ( mCacheReleased )
+		throw Soy::AssertException("Readback's cache has been released");
+
+	uint64_t Progress = mProgress;
+	auto Submission = static_cast<uint32_t>( Progress >> 32 );
+	auto Rows = static_cast<uint32_t>( Progress & 0xffffffff );
+
+	if ( Submission == 0 || Submission != mLastSubmission )
+		return 0;
+	return Rows;
+}
+
+std::shared_ptr<TTextureBackend> TReadback::GetTexture()
+{
+	//	a cache's texture can be replaced (streams, eviction), so follow it
+	if ( mCacheHandle != -1 )
+	{
+		try
+		{
+			return PopWritePixels::GetCache( mCacheHandle ).mTexture;
+		}
+		catch(std::exception&)
+		{
+			//	released; the handle carries its generation so it stays dead, and there's nothing more to read
+			mCacheReleased = true;
+			return nullptr;
+		}
+	}
+
+	if ( !mTexture )
+		return PopWritePixels::AllocTextureBackend( mBackendType, mTexturePtr, mMeta, false );
+	return mTexture;
+}
+
+size_t TReadback::Read()
+{
+	//	anything still in flight for the previous request is abandoned
+	{
+		std::lock_guard<std::mutex> Lock( mRequestLock );
+		if ( mNextRequest )
+		{
+			mCurrentRequest = mNextRequest;
+			mNextRequest.reset();
+			mSlotsInFlight.clear();
+		}
+	}
+	if ( !mCurrentRequest || mCacheReleased )
+		return 0;
+
+	auto& Request = *mCurrentRequest;
+	auto Height = mMeta.GetHeight();
+	if ( Request.IsFinished( Height ) )
+		return 0;
+
+	//	cache hasn't made its texture yet, or has gone; stop rather than look it up again every frame
+	auto Texture = GetTexture();
+	if ( mCacheReleased )
+	{
+		mSlotsInFlight.clear();
+		mReader.reset();
+		mTexture.reset();
+		mCurrentRequest.reset();
+		return 0;
+	}
+	if ( !Texture )
+		return 0;
+
+	//	staging is sized by rows per frame, so a change (or a new texture) starts a new ring from the last landed row
+	auto SlotRows = std::max<size_t>( 1, mReadRowsPerFrame );
+	if ( !mReader || Texture != mTexture || mReader->mSlotRows != SlotRows )
+	{
+		mReader.reset();
+		mTexture = Texture;
+		mReader = mTexture->AllocReader( SlotRows, DefaultSlotCount );
+		mSlotsInFlight.clear();
+		mNextSlot = 0;
+	}
+	if ( mSlotsInFlight.empty() )
+		Request.mRowsIssued = Request.mRowsRead;
+
+	//	land finished copies oldest first, so rows stay contiguous from the top
+	auto RowSize = mMeta.GetRowDataSize();
+	size_t BytesRead = 0;
+	while ( !mSlotsInFlight.empty() )
+	{
+		auto Slot = mSlotsInFlight.front();
+		auto* Dst = Request.mBytes + (Request.mRowsRead * RowSize);
+		if ( !mReader->EndRead( Slot, Dst, RowSize ) )
+			break;
+
+		auto Rows = std::min( SlotRows, Height - Request.mRowsRead );
+		Request.mRowsRead += Rows;
+		BytesRead += Rows * RowSize;
+		mSlotsInFlight.pop_front();
+	}
+
+	//	one slot a frame, like a cache's rows per frame
+	if ( Request.mRowsIssued < Height && mSlotsInFlight.size() < mReader->mSlotCount )
+	{
+		auto Rows = std::min( SlotRows, Height - Request.mRowsIssued );
+		mReader->BeginRead( mNextSlot, Request.mRowsIssued, Rows );
+		mSlotsInFlight.push_back( mNextSlot );
+		mNextSlot = (mNextSlot + 1) % mReader->mSlotCount;
+		Request.mRowsIssued += Rows;
+	}
+
+	mProgress = ( static_cast<uint64_t>(Request.mSubmission) << 32 ) | static_cast<uint64_t>(Request.mRowsRead);
+
+	//	staging isn't needed between reads
+	if ( Request.IsFinished( Height ) )
+	{
+		mReader.reset();
+		mTexture.reset();
+	}
+	return BytesRead;
+}
+
+
+int PopWritePixels::AllocReadback(int CacheHandle,void* TexturePtr,const SoyPixelsMeta& Meta,TTextureBackendType::Type BackendType)
+{
+	std::shared_ptr<TReadback> Readback( new TReadback( CacheHandle, TexturePtr, Meta, BackendType ) );
+	std::lock_guard<std::mutex> Lock( gReadbackLock );
+	auto ReadbackIndex = gNextReadback++;
+	gReadbacks[ReadbackIndex] = Readback;
+	return ReadbackIndex;
+}
+
+std::shared_ptr<TReadback> PopWritePixels::GetReadback(int ReadbackIndex)
+{
+	std::lock_guard<std::mutex> Lock( gReadbackLock );
+	auto It = gReadbacks.find( ReadbackIndex );
+	if ( It == gReadbacks.end() )
+		throw Soy::AssertException("Invalid readback index");
+	return It->second;
+}
+
+void PopWritePixels::ReleaseReadback(int ReadbackIndex)
+{
+	std::lock_guard<std::mutex> Lock( gReadbackLock );
+	if ( gReadbacks.erase( ReadbackIndex ) == 0 )
+		throw Soy::AssertException("Invalid readback index");
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "TTextureBackend.h"
+#include "TPixelBufferPool.h"
+#include <SoyPixels.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+
+class TReadRequest
+{
+public:
+	uint8_t*	mBytes = nullptr;
+	size_t		mBytesSize = 0;
+	std::shared_ptr<TPixelBuffer>	mBuffer;	//	when the client didn't give us somewhere to read to
+	uint32_t	mSubmission = 0;
+	uint64_t	mQueueTime = 0;
+	size_t		mRowsIssued = 0;		//	render thread
+	size_t		mRowsRead = 0;			//	render thread. contiguous from the top
+
+	bool		IsFinished(size_t Height) const	{	return mRowsRead >= Height;	}
+};
+
+
+//	the mirror of a cache: copies a texture to the cpu a few rows a frame, through a ring of staging
+//	slots (see TTextureReader) that are only mapped once their copy has landed, so there's no
+//	ReadPixels-style stall. Rows land top down in the client's buffer, or a pooled one
+class TReadback
+{
+public:
+	static const size_t	DefaultSlotCount = 3;	//	a frame or two of gpu latency, and one being issued
+
+public:
+	TReadback(int CacheHandle,void* TexturePtr,const SoyPixelsMeta& Meta,TTextureBackendType::Type BackendType);
+
+	void			Queue(uint8_t* Bytes,size_t BytesSize);		//	main thread. null to read into a pooled buffer
+	size_t			Read();										//	render thread, returns bytes read
+	size_t			GetRowsRead() const;						//	progress of the last queued read, any thread. Throws once the cache is released
+	uint8_t*		GetBytes(size_t& BytesSize);				//	where the last queued read goes, until the next
+
+private:
+	std::shared_ptr<TTextureBackend>	GetTexture();
+
+public:
+	SoyPixelsMeta				mMeta;
+	std::atomic<size_t>			mReadRowsPerFrame;		//	also the size of a staging slot
+
+private:
+	int							mCacheHandle;			//	reading a cache's texture, -1 for the client's
+	void*						mTexturePtr;
+	TTextureBackendType::Type	mBackendType;
+
+	std::mutex							mRequestLock;
+	std::shared_ptr<TReadRequest>		mNextRequest;		//	queued, not yet picked up
+	std::shared_ptr<TReadRequest>		mLastRequest;		//	last queued, for GetBytes
+	std::atomic<uint32_t>				mLastSubmission;	//	last id queued
+	std::atomic<uint64_t>				mProgress;			//	submission<<32 | rows read
+	std::atomic<bool>					mCacheReleased;		//	the job stops, rather than look up a dead handle every frame
+
+	//	render thread only. The texture outlives its reader
+	std::shared_ptr<TTextureBackend>	mTexture;
+	std::shared_ptr<TTextureReader>		mReader;
+	std::shared_ptr<TReadRequest>		mCurrentRequest;
+	std::deque<size_t>					mSlotsInFlight;		//	oldest first
+	size_t								mNextSlot = 0;
+};
+
+
+namespace PopWritePixels
+{
+	int							AllocReadback(int CacheHandle,void* TexturePtr,const SoyPixelsMeta& Meta,TTextureBackendType::Type BackendType);
+	std::shared_ptr<TReadback>	GetReadback(int ReadbackIndex);
+	void						ReleaseReadback(int ReadbackIndex);
+}
@@ -0,0 +1,153 @@
+#include "TScheduler.h"
+#include "TCache.h"
+#include "TAtlas.h"
+#include "TWriteBatch.h"
+#include <SoyDebug.h>
+#include <algorithm>
+#include <vector>
+#include <limits>
+
+
+namespace PopWritePixels
+{
+	TScheduler	gScheduler;
+}
+
+
+TScheduler& PopWritePixels::GetScheduler()
+{
+	return gScheduler;
+}
+
+
+class TSchedulerCandidate
+{
+public:
+	TCache*		mCache = nullptr;
+	int			mCacheHandle = -1;
+	uint64_t	mDeadline = 0;				//	max for none
+	int64_t		mEffectivePriority = 0;
+	int			mRoundRobinOrder = 0;
+};
+
+
+void TScheduler::WriteAllPendingCaches()
+{
+	auto FrameStart = PopWritePixels::GetMicrosecsNow();
+	uint64_t BytesWritten = 0;
+	uint64_t AtlasBytesWritten = 0;
+	std::vector<TSchedulerCandidate> Candidates;
+	auto RoundRobinStart = mRoundRobinStart;
+	auto StarvationFrames = std::max<size_t>( 1, mStarvationFrames );
+	//	one budget for the whole frame, even if it's set again part way through
+	uint64_t BudgetMicrosecs = mFrameBudget.mMicrosecs;
+	uint64_t BudgetBytes = mFrameBudget.mBytes;
+
+	auto AddCandidate = [&](TCache& Cache,int CacheHandle)
+	{
+		if ( !Cache.HasPendingWork() )
+			return;
+
+		TSchedulerCandidate Candidate;
+		Candidate.mCache = &Cache;
+		auto SlotIndex = static_cast<int>( PopWritePixels::GetCacheSlotIndex( CacheHandle ) );
+		Candidate.mCacheHandle = CacheHandle;
+		auto Aging = Cache.mFramesWaiting / StarvationFrames;
+		Candidate.mEffectivePriority = static_cast<int64_t>(Cache.mPriority) + static_cast<int64_t>(Aging);
+		//	anything with a deadline goes before things without, but a cache that's been skipped
+		//	for mStarvationFrames is due now, so deadlines in the future can't starve it
+		uint64_t Deadline = Cache.mDeadline;
+		Candidate.mDeadline = Deadline ? Deadline : std::numeric_limits<uint64_t>::max();
+		if ( Aging > 0 )
+			Candidate.mDeadline = std::min( Candidate.mDeadline, FrameStart );
+		Candidate.mRoundRobinOrder = SlotIndex - RoundRobinStart;
+		if ( Candidate.mRoundRobinOrder < 0 )
+			Candidate.mRoundRobinOrder += std::numeric_limits<int>::max() / 2;
+		Candidates.push_back( Candidate );
+	};
+	PopWritePixels::EnumCaches( AddCandidate );
+
+	//	batched caches are among these, so the batch event has nothing left to do
+	PopWritePixels::GetWriteBatchQueue().Clear();
+
+	//	atlas pages are one small write each, so they don't wait for the budget
+	try
+	{
+		AtlasBytesWritten = PopWritePixels::WriteAtlases();
+	}
+	catch(std::exception& e)
+	{
+		if ( PopWritePixels::IsLogging( TLogLevel::Errors ) )
+			std::Debug << "WriteAllPendingCaches atlas exception: " << e.what() << std::endl;
+	}
+
+	if ( Candidates.empty() )
+	{
+		PopWritePixels::GetPluginTelemetry().OnFrame( AtlasBytesWritten + BytesWritten, PopWritePixels::GetMicrosecsNow() - FrameStart );
+		return;
+	}
+
+	auto Compare = [](const TSchedulerCandidate& a,const TSchedulerCandidate& b)
+	{
+		if ( a.mDeadline != b.mDeadline )
+			return a.mDeadline < b.mDeadline;
+		if ( a.mEffectivePriority != b.mEffectivePriority )
+			return a.mEffectivePriority > b.mEffectivePriority;
+		return a.mRoundRobinOrder < b.mRoundRobinOrder;
+	};
+	std::sort( Candidates.begin(), Candidates.end(), Compare );
+
+	auto BudgetStart = PopWritePixels::GetMicrosecsNow();
+	size_t Serviced = 0;
+
+	for ( auto& Candidate : Candidates )
+	{
+		auto& Cache = *Candidate.mCache;
+		size_t MaxRows = SIZE_MAX;
+
+		if ( BudgetMicrosecs > 0 || BudgetBytes > 0 )
+		{
+			auto Elapsed = PopWritePixels::GetMicrosecsNow() - BudgetStart;
+
+			//	always write something each frame so we progress
+			if ( Serviced > 0 )
+			{
+				if ( BudgetMicrosecs > 0 && Elapsed >= BudgetMicrosecs )
+					break;
+				if ( BudgetBytes > 0 && BytesWritten >= BudgetBytes )
+					break;
+			}
+
+			TWriteBudget Remaining;
+			if ( BudgetMicrosecs > 0 )
+				Remaining.mMicrosecs = BudgetMicrosecs - std::min( Elapsed, BudgetMicrosecs );
+			if ( BudgetBytes > 0 )
+				Remaining.mBytes = BudgetBytes - std::min( BytesWritten, BudgetBytes );
+
+			//	budget may be spent already (first cache), still do a row
+			if ( Remaining.IsEnabled() )
+				MaxRows = Remaining.GetRowCount( Cache.mTextureMeta.GetRowDataSize(), PopWritePixels::gWriteRate, SIZE_MAX/2 );
+			else
+				MaxRows = 1;
+		}
+
+		try
+		{
+			BytesWritten += Cache.WritePixels( MaxRows );
+		}
+		catch(std::exception& e)
+		{
+			if ( PopWritePixels::IsLogging( TLogLevel::Errors ) )
+				std::Debug << "WriteAllPendingCaches cache " << Candidate.mCacheHandle << " exception: " << e.what() << std::endl;
+		}
+		Cache.mFramesWaiting = 0;
+		Serviced++;
+		mRoundRobinStart = static_cast<int>( PopWritePixels::GetCacheSlotIndex( Candidate.mCacheHandle ) ) + 1;
+	}
+
+	//	anyone we didn't get to gets a little more important
+	for ( size_t i=Serviced;	i<Candidates.size();	i++ )
+		Candidates[i].mCache->mFramesWaiting++;
+
+	PopWritePixels::GetPluginTelemetry().OnFrame( AtlasBytesWritten + BytesWritten, PopWritePixels::GetMicrosecsNow() - FrameStart );
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "TWriteBudget.h"
+#include <cstddef>
+
+
+//	writes all pending caches from one render event, sharing one per-frame budget.
+//	order is earliest deadline, then priority (raised the longer a cache has been skipped),
+//	then round-robin from where the last frame stopped. A cache skipped for long enough is due now
+class TScheduler
+{
+public:
+	void			WriteAllPendingCaches();
+
+public:
+	TWriteBudget	mFrameBudget;				//	disabled = every pending cache writes its own chunk
+	size_t			mStarvationFrames = 8;		//	every N frames skipped adds 1 priority
+	int				mRoundRobinStart = 0;		//	cache slot to start from next frame
+};
+
+
+namespace PopWritePixels
+{
+	TScheduler&		GetScheduler();
+}
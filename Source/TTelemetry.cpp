@@ -0,0 +1,188 @@
+#include "TTelemetry.h"
+#include <SoyTypes.h>
+#include <algorithm>
+
+
+namespace PopWritePixels
+{
+	std::atomic<int>	gLogLevel( POPWRITEPIXELS_DEFAULT_LOG_LEVEL );
+
+	size_t				GetBucket(uint64_t Value);
+	uint64_t			GetBucketUpperBound(size_t Bucket);
+}
+
+
+size_t PopWritePixels::GetBucket(uint64_t Value)
+{
+	size_t Bucket = 0;
+	while ( Value > 0 && Bucket < THistogram::BucketCount-1 )
+	{
+		Value >>= 1;
+		Bucket++;
+	}
+	return Bucket;
+}
+
+uint64_t PopWritePixels::GetBucketUpperBound(size_t Bucket)
+{
+	if ( Bucket == 0 )
+		return 0;
+	return (1ull << Bucket) - 1;
+}
+
+TTelemetry& PopWritePixels::GetPluginTelemetry()
+{
+	static TTelemetry gTelemetry;
+	return gTelemetry;
+}
+
+
+void THistogram::Add(uint64_t Value)
+{
+	auto Bucket = PopWritePixels::GetBucket( Value );
+	mBuckets[Bucket].fetch_add( 1, std::memory_order_relaxed );
+	mCount.fetch_add( 1, std::memory_order_relaxed );
+	mSum.fetch_add( Value, std::memory_order_relaxed );
+
+	auto Max = mMax.load( std::memory_order_relaxed );
+	while ( Value > Max && !mMax.compare_exchange_weak( Max, Value, std::memory_order_relaxed ) )
+	{
+	}
+}
+
+void THistogram::Reset()
+{
+	for ( auto& Bucket : mBuckets )
+		Bucket = 0;
+	mCount = 0;
+	mSum = 0;
+	mMax = 0;
+}
+
+uint64_t THistogram::GetPercentile(float Percentile,uint64_t Count) const
+{
+	auto Target = static_cast<uint64_t>( Count * Percentile );
+	uint64_t Seen = 0;
+	for ( size_t b=0;	b<BucketCount;	b++ )
+	{
+		Seen += mBuckets[b].load( std::memory_order_relaxed );
+		if ( Seen > Target )
+			return PopWritePixels::GetBucketUpperBound( b );
+	}
+	return mMax.load( std::memory_order_relaxed );
+}
+
+THistogramSummary THistogram::GetSummary() const
+{
+	//	not a snapshot, values may be mid-update, but each is individually valid
+	THistogramSummary Summary;
+	Summary.mCount = mCount.load( std::memory_order_relaxed );
+	Summary.mMax = mMax.load( std::memory_order_relaxed );
+	if ( Summary.mCount == 0 )
+		return Summary;
+
+	Summary.mMean = mSum.load( std::memory_order_relaxed ) / Summary.mCount;
+	Summary.mP50 = std::min( Summary.mMax, GetPercentile( 0.50f, Summary.mCount ) );
+	Summary.mP99 = std::min( Summary.mMax, GetPercentile( 0.99f, Summary.mCount ) );
+	return Summary;
+}
+
+size_t THistogram::GetBuckets(uint64_t* Buckets,size_t Count) const
+{
+	Count = std::min( Count, BucketCount );
+	for ( size_t b=0;	b<Count;	b++ )
+		Buckets[b] = mBuckets[b].load( std::memory_order_relaxed );
+	return Count;
+}
+
+
+void TTelemetry::Reset()
+{
+	mSubmissions = 0;
+	mCompleted = 0;
+	mWrites = 0;
+	mBytesWritten = 0;
+	mFrames = 0;
+	mQueueToFirstRow.Reset();
+	mQueueToComplete.Reset();
+	mWriteMicrosecs.Reset();
+	mWriteBytes.Reset();
+	mFrameBytes.Reset();
+	mFrameMicrosecs.Reset();
+}
+
+void TTelemetry::OnQueued()
+{
+	mSubmissions.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void TTelemetry::OnWrite(uint64_t Bytes,uint64_t Microsecs)
+{
+	mWrites.fetch_add( 1, std::memory_order_relaxed );
+	mBytesWritten.fetch_add( Bytes, std::memory_order_relaxed );
+	mWriteMicrosecs.Add( Microsecs );
+	mWriteBytes.Add( Bytes );
+}
+
+void TTelemetry::OnFirstRow(uint64_t QueueMicrosecs)
+{
+	mQueueToFirstRow.Add( QueueMicrosecs );
+}
+
+void TTelemetry::OnComplete(uint64_t QueueMicrosecs)
+{
+	mCompleted.fetch_add( 1, std::memory_order_relaxed );
+	mQueueToComplete.Add( QueueMicrosecs );
+}
+
+void TTelemetry::OnFrame(uint64_t Bytes,uint64_t Microsecs)
+{
+	mFrames.fetch_add( 1, std::memory_order_relaxed );
+	mFrameBytes.Add( Bytes );
+	mFrameMicrosecs.Add( Microsecs );
+}
+
+THistogram& TTelemetry::GetHistogram(TTelemetryMetric::Type Metric)
+{
+	switch ( Metric )
+	{
+		case TTelemetryMetric::QueueToFirstRow:	return mQueueToFirstRow;
+		case TTelemetryMetric::QueueToComplete:	return mQueueToComplete;
+		case TTelemetryMetric::WriteMicrosecs:	return mWriteMicrosecs;
+		case TTelemetryMetric::FrameBytes:		return mFrameBytes;
+		case TTelemetryMetric::FrameMicrosecs:	return mFrameMicrosecs;
+		default:
+			break;
+	}
+	throw Soy::AssertException("Unknown telemetry metric");
+}
+
+TCacheStats TTelemetry::GetCacheStats() const
+{
+	TCacheStats Stats;
+	Stats.mSubmissions = mSubmissions.load( std::memory_order_relaxed );
+	Stats.mCompleted = mCompleted.load( std::memory_order_relaxed );
+	Stats.mWrites = mWrites.load( std::memory_order_relaxed );
+	Stats.mBytesWritten = mBytesWritten.load( std::memory_order_relaxed );
+	Stats.mQueueToFirstRow = mQueueToFirstRow.GetSummary();
+	Stats.mQueueToComplete = mQueueToComplete.GetSummary();
+	Stats.mWriteMicrosecs = mWriteMicrosecs.GetSummary();
+	Stats.mWriteBytes = mWriteBytes.GetSummary();
+	return Stats;
+}
+
+TPluginStats TTelemetry::GetPluginStats() const
+{
+	TPluginStats Stats;
+	Stats.mSubmissions = mSubmissions.load( std::memory_order_relaxed );
+	Stats.mCompleted = mCompleted.load( std::memory_order_relaxed );
+	Stats.mWrites = mWrites.load( std::memory_order_relaxed );
+	Stats.mBytesWritten = mBytesWritten.load( std::memory_order_relaxed );
+	Stats.mFrames = mFrames.load( std::memory_order_relaxed );
+	Stats.mQueueToFirstRow = mQueueToFirstRow.GetSummary();
+	Stats.mQueueToComplete = mQueueToComplete.GetSummary();
+	Stats.mWriteMicrosecs = mWriteMicrosecs.GetSummary();
+	Stats.mFrameBytes = mFrameBytes.GetSummary();
+	Stats.mFrameMicrosecs = mFrameMicrosecs.GetSummary();
+	return Stats;
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+
+
+//	gr: matching values in c#
+namespace TLogLevel
+{
+	enum Type
+	{
+		None = 0,
+		Errors = 1,		//	exceptions caught at the exports
+		Calls = 2,		//	every export call & its duration. Not for shipping, it's on the render thread
+	};
+}
+
+//	override in the build to compile with a different level, SetLogLevel changes it at runtime
+#if !defined(POPWRITEPIXELS_DEFAULT_LOG_LEVEL)
+#define POPWRITEPIXELS_DEFAULT_LOG_LEVEL	TLogLevel::Errors
+#endif
+
+
+//	gr: matching layout in c#
+struct THistogramSummary
+{
+	uint64_t	mCount = 0;
+	uint64_t	mMean = 0;
+	uint64_t	mMax = 0;
+	uint64_t	mP50 = 0;		//	upper bound of the bucket, so within 2x
+	uint64_t	mP99 = 0;
+};
+
+struct TCacheStats
+{
+	uint64_t			mSubmissions = 0;
+	uint64_t			mCompleted = 0;
+	uint64_t			mWrites = 0;
+	uint64_t			mBytesWritten = 0;
+	uint64_t			mBytesSkipped = 0;
+	uint64_t			mFenceWaits = 0;		//	of the current texture
+	THistogramSummary	mQueueToFirstRow;		//	microsecs
+	THistogramSummary	mQueueToComplete;		//	microsecs
+	THistogramSummary	mWriteMicrosecs;		//	per WritePixels
+	THistogramSummary	mWriteBytes;			//	per WritePixels
+};
+
+struct TPluginStats
+{
+	uint64_t			mCachesAllocated = 0;
+	uint64_t			mSubmissions = 0;
+	uint64_t			mCompleted = 0;
+	uint64_t			mWrites = 0;
+	uint64_t			mBytesWritten = 0;
+	uint64_t			mFrames = 0;			//	render events
+	THistogramSummary	mQueueToFirstRow;
+	THistogramSummary	mQueueToComplete;
+	THistogramSummary	mWriteMicrosecs;
+	THistogramSummary	mFrameBytes;			//	per render event; one per frame with the scheduler
+	THistogramSummary	mFrameMicrosecs;
+};
+
+
+//	log2 buckets; bucket 0 is 0, bucket n is [2^(n-1), 2^n).
+//	Lock-free; each is normally only added to from one thread so the atomics don't contend
+class THistogram
+{
+public:
+	static const size_t	BucketCount = 40;
+
+public:
+	THistogram()	{	Reset();	}
+
+	void				Add(uint64_t Value);
+	void				Reset();
+	THistogramSummary	GetSummary() const;
+	//	copies up to BucketCount buckets, returns how many
+	size_t				GetBuckets(uint64_t* Buckets,size_t Count) const;
+
+private:
+	uint64_t			GetPercentile(float Percentile,uint64_t Count) const;
+
+private:
+	std::atomic<uint64_t>	mBuckets[BucketCount];
+	std::atomic<uint64_t>	mCount;
+	std::atomic<uint64_t>	mSum;
+	std::atomic<uint64_t>	mMax;
+};
+
+
+//	gr: matching values in c#, for GetPluginHistogram
+namespace TTelemetryMetric
+{
+	enum Type
+	{
+		QueueToFirstRow = 0,
+		QueueToComplete = 1,
+		WriteMicrosecs = 2,
+		FrameBytes = 3,
+		FrameMicrosecs = 4,
+	};
+}
+
+
+class TTelemetry
+{
+public:
+	TTelemetry() :
+		mSubmissions	( 0 ),
+		mCompleted		( 0 ),
+		mWrites			( 0 ),
+		mBytesWritten	( 0 ),
+		mFrames			( 0 )
+	{
+	}
+
+	void			Reset();
+	void			OnQueued();
+	void			OnWrite(uint64_t Bytes,uint64_t Microsecs);
+	void			OnFirstRow(uint64_t QueueMicrosecs);
+	void			OnComplete(uint64_t QueueMicrosecs);
+	void			OnFrame(uint64_t Bytes,uint64_t Microsecs);
+	THistogram&		GetHistogram(TTelemetryMetric::Type Metric);
+
+	TCacheStats		GetCacheStats() const;
+	TPluginStats	GetPluginStats() const;
+
+public:
+	std::atomic<uint64_t>	mSubmissions;
+	std::atomic<uint64_t>	mCompleted;
+	std::atomic<uint64_t>	mWrites;
+	std::atomic<uint64_t>	mBytesWritten;
+	std::atomic<uint64_t>	mFrames;
+	THistogram				mQueueToFirstRow;
+	THistogram				mQueueToComplete;
+	THistogram				mWriteMicrosecs;
+	THistogram				mWriteBytes;
+	THistogram				mFrameBytes;
+	THistogram				mFrameMicrosecs;
+};
+
+
+namespace PopWritePixels
+{
+	extern std::atomic<int>	gLogLevel;
+	inline bool				IsLogging(TLogLevel::Type Level)	{	return gLogLevel.load(std::memory_order_relaxed) >= Level;	}
+
+	TTelemetry&				GetPluginTelemetry();
+}
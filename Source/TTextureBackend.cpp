@@ -0,0 +1,606 @@
+#include "TTextureBackend.h"
+#include "TMemoryBudget.h"
+#include <SoyUnity.h>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+
+#if defined(ENABLE_DIRECTX)
+#include <SoyDirectx.h>
+#endif
+
+#if defined(ENABLE_OPENGL)
+#include "TOpenglTexture.h"
+#endif
+
+
+
+#if defined(ENABLE_DIRECTX)
+class TDirectxTexture : public TTextureBackend
+{
+public:
+	TDirectxTexture(void* TexturePtr,const SoyPixelsMeta& Meta,bool EnableMips);
+
+	virtual void	Write(const SoyPixelsImpl& Pixels,size_t RowFirst,size_t RowCount) override;
+	virtual void	WriteRect(const uint8_t* Bytes,size_t RowPitch,const TTextureRect& Rect,size_t MipLevel) override;
+	virtual void	WriteBlockRows(const uint8_t* Blocks,size_t BlockRowPitch,size_t BlockRowFirst,size_t BlockRowCount) override;
+	virtual void	GenerateMips() override;
+	virtual void*	GetNativeTexture() override;
+	virtual size_t	GetMipCount() const override	{	return mMipCount;	}
+	virtual std::shared_ptr<TTextureReader>	AllocReader(size_t SlotRows,size_t SlotCount) override;
+	virtual void	SetMinMipLevel(size_t MipLevel) override;
+
+private:
+	Directx::TContext&	GetContext();
+	ID3D11Texture2D*	GetTexture();
+
+public:
+	void*								mTexturePtr = nullptr;	//	client's texture
+	std::shared_ptr<Directx::TTexture>	mTexture;
+	bool								mAllocated = false;
+	size_t								mMipCount = 1;
+};
+
+
+//	a staging texture per slot, with an event query as its fence
+class TDirectxTextureReader : public TTextureReader
+{
+public:
+	TDirectxTextureReader(Directx::TContext& Context,ID3D11Texture2D* Texture,const SoyPixelsMeta& Meta,size_t SlotRows,size_t SlotCount);
+	~TDirectxTextureReader();
+
+	virtual void	BeginRead(size_t Slot,size_t RowFirst,size_t RowCount) override;
+	virtual bool	EndRead(size_t Slot,uint8_t* Dst,size_t DstRowPitch) override;
+
+private:
+	Directx::TContext&				mContext;
+	ID3D11Texture2D*				mTexture;
+	SoyPixelsMeta					mMeta;
+	std::vector<ID3D11Texture2D*>	mStaging;
+	std::vector<ID3D11Query*>		mQueries;
+	std::vector<size_t>				mSlotRowCounts;
+};
+#endif
+
+
+//	cpu copy with a simulated fence; a copy lands SoftwareReadLatency polls after it was issued, like a gpu
+//	a frame or so behind, so the ring & ordering are exercised headless
+class TSoftwareTextureReader : public TTextureReader
+{
+public:
+	static const size_t	SoftwareReadLatency = 1;
+
+public:
+	TSoftwareTextureReader(TSoftwareTexture& Texture,size_t SlotRows,size_t SlotCount);
+
+	virtual void	BeginRead(size_t Slot,size_t RowFirst,size_t RowCount) override;
+	virtual bool	EndRead(size_t Slot,uint8_t* Dst,size_t DstRowPitch) override;
+
+private:
+	TSoftwareTexture&					mTexture;
+	std::vector<std::vector<uint8_t>>	mSlots;
+	std::vector<size_t>					mSlotRowCounts;
+	std::vector<size_t>					mPollsUntilLanded;
+};
+
+
+
+size_t PopWritePixels::GetPixelSize(const SoyPixelsMeta& Meta)
+{
+	if ( Meta.GetWidth() == 0 )
+		return 0;
+	return Meta.GetRowDataSize() / Meta.GetWidth();
+}
+
+size_t PopWritePixels::GetMipCount(const SoyPixelsMeta& Meta)
+{
+	size_t Count = 1;
+	auto Width = Meta.GetWidth();
+	auto Height = Meta.GetHeight();
+	while ( Width > 1 || Height > 1 )
+	{
+		Width = std::max<size_t>( 1, Width/2 );
+		Height = std::max<size_t>( 1, Height/2 );
+		Count++;
+	}
+	return Count;
+}
+
+
+TTextureBackendType::Type PopWritePixels::GetDefaultTextureBackendType()
+{
+#if defined(ENABLE_DIRECTX)
+	if ( Unity::GetDirectxContextPtr() )
+		return TTextureBackendType::Directx;
+#endif
+#if defined(ENABLE_OPENGL)
+	if ( Unity::GetOpenglContextPtr() )
+		return TTextureBackendType::Opengl;
+#endif
+	//	software textures aren't something unity can show, so they're only made when asked for
+	throw Soy::AssertException("No device context");
+}
+
+
+std::shared_ptr<TTextureBackend> PopWritePixels::AllocTextureBackend(TTextureBackendType::Type Type,void* TexturePtr,const SoyPixelsMeta& Meta,bool EnableMips,TBlockFormat::Type BlockFormat)
+{
+	if ( Type == TTextureBackendType::Default )
+		Type = GetDefaultTextureBackendType();
+
+	std::shared_ptr<TTextureBackend> Texture;
+	switch ( Type )
+	{
+		case TTextureBackendType::Software:
+			if ( TexturePtr )
+				throw Soy::AssertException("Software texture backend cannot write to an existing native texture");
+			Texture.reset( new TSoftwareTexture( Meta, EnableMips ) );
+			break;
+
+#if defined(ENABLE_DIRECTX)
+		case TTextureBackendType::Directx:
+			Texture.reset( new TDirectxTexture( TexturePtr, Meta, EnableMips ) );
+			break;
+#endif
+
+#if defined(ENABLE_OPENGL)
+		case TTextureBackendType::Opengl:
+			Texture.reset( new TOpenglTexture( TexturePtr, Meta, EnableMips ) );
+			break;
+#endif
+
+		default:
+		{
+			std::stringstream Error;
+			Error << "Texture backend " << static_cast<int>(Type) << " not supported in this build";
+			throw Soy::AssertException(Error.str());
+		}
+	}
+
+	//	the client's textures aren't ours to count
+	if ( !TexturePtr )
+		Texture->SetTextureBytes( GetTextureBytes( Meta, EnableMips, BlockFormat ) );
+	return Texture;
+}
+
+
+TTextureBackend::~TTextureBackend()
+{
+	PopWritePixels::GetMemoryBudget().OnFree( mTextureBytes );
+}
+
+void TTextureBackend::SetTextureBytes(size_t Bytes)
+{
+	auto& Budget = PopWritePixels::GetMemoryBudget();
+	Budget.OnFree( mTextureBytes );
+	mTextureBytes = Bytes;
+	Budget.OnAlloc( mTextureBytes );
+}
+
+
+
+TTextureReader::~TTextureReader()
+{
+	PopWritePixels::GetMemoryBudget().OnFree( mStagingBytes );
+}
+
+void TTextureReader::SetStagingBytes(size_t Bytes)
+{
+	auto& Budget = PopWritePixels::GetMemoryBudget();
+	Budget.OnFree( mStagingBytes );
+	mStagingBytes = Bytes;
+	Budget.OnAlloc( mStagingBytes );
+}
+
+
+std::shared_ptr<TTextureReader> TTextureBackend::AllocReader(size_t SlotRows,size_t SlotCount)
+{
+	throw Soy::AssertException("Texture backend does not support readback");
+}
+
+void TTextureBackend::WriteRect(const uint8_t* Bytes,size_t RowPitch,const TTextureRect& Rect,size_t MipLevel)
+{
+	throw Soy::AssertException("Texture backend does not support rect writes");
+}
+
+void TTextureBackend::WriteBlockRows(const uint8_t* Blocks,size_t BlockRowPitch,size_t BlockRowFirst,size_t BlockRowCount)
+{
+	throw Soy::AssertException("Texture backend does not support compressed writes");
+}
+
+
+
+TSoftwareTexture::TSoftwareTexture(const SoyPixelsMeta& Meta,bool EnableMips) :
+	TTextureBackend	( Meta, EnableMips )
+{
+	auto MipCount = EnableMips ? PopWritePixels::GetMipCount(Meta) : 1;
+	mMips.resize( MipCount );
+	for ( size_t m=0;	m<MipCount;	m++ )
+		mMips[m].resize( GetMipMeta(m).GetDataSize() );
+}
+
+SoyPixelsMeta TSoftwareTexture::GetMipMeta(size_t MipLevel) const
+{
+	auto Width = std::max<size_t>( 1, mMeta.GetWidth() >> MipLevel );
+	auto Height = std::max<size_t>( 1, mMeta.GetHeight() >> MipLevel );
+	return SoyPixelsMeta( Width, Height, mMeta.GetFormat() );
+}
+
+uint8_t* TSoftwareTexture::GetMipPixels(size_t MipLevel)
+{
+	if ( MipLevel >= mMips.size() )
+		throw Soy::AssertException("Software texture mip level out of range");
+	return mMips[MipLevel].data();
+}
+
+void TSoftwareTexture::Write(const SoyPixelsImpl& Pixels,size_t RowFirst,size_t RowCount)
+{
+	auto RowSize = mMeta.GetRowDataSize();
+	if ( RowFirst + RowCount > mMeta.GetHeight() )
+		throw Soy::AssertException("Software texture write out of bounds");
+
+	auto& Src = Pixels.GetPixelsArray();
+	if ( Src.GetDataSize() < (RowFirst+RowCount) * RowSize )
+		throw Soy::AssertException("Not enough pixel data for rows");
+
+	auto* SrcRows = Src.GetArray() + (RowFirst * RowSize);
+	auto* DstRows = mMips[0].data() + (RowFirst * RowSize);
+	memcpy( DstRows, SrcRows, RowCount * RowSize );
+}
+
+void TSoftwareTexture::WriteRect(const uint8_t* Bytes,size_t RowPitch,const TTextureRect& Rect,size_t MipLevel)
+{
+	auto MipMeta = GetMipMeta( MipLevel );
+	if ( Rect.mX + Rect.mWidth > MipMeta.GetWidth() || Rect.mY + Rect.mHeight > MipMeta.GetHeight() )
+		throw Soy::AssertException("Software texture rect write out of bounds");
+
+	auto* Dst = GetMipPixels( MipLevel );
+	auto DstRowSize = MipMeta.GetRowDataSize();
+	auto PixelSize = PopWritePixels::GetPixelSize( MipMeta );
+	auto RectRowSize = Rect.mWidth * PixelSize;
+	for ( size_t y=0;	y<Rect.mHeight;	y++ )
+	{
+		auto* DstRow = Dst + ((Rect.mY+y) * DstRowSize) + (Rect.mX * PixelSize);
+		memcpy( DstRow, Bytes + (y * RowPitch), RectRowSize );
+	}
+}
+
+void TSoftwareTexture::WriteBlockRows(const uint8_t* Blocks,size_t BlockRowPitch,size_t BlockRowFirst,size_t BlockRowCount)
+{
+	auto BlockRows = (mMeta.GetHeight() + 3) / 4;
+	if ( BlockRowFirst + BlockRowCount > BlockRows )
+		throw Soy::AssertException("Software texture block write out of bounds");
+
+	//	we don't know the format, only its size
+	mBlocks.resize( BlockRowPitch * BlockRows );
+	memcpy( mBlocks.data() + (BlockRowFirst * BlockRowPitch), Blocks, BlockRowCount * BlockRowPitch );
+}
+
+void TSoftwareTexture::GenerateMips()
+{
+	//	2x2 box filter, assumes 8 bit channels like the rest of the plugin
+	auto Channels = mMeta.GetChannels();
+	for ( size_t m=1;	m<mMips.size();	m++ )
+	{
+		auto ParentMeta = GetMipMeta(m-1);
+		auto MipMeta = GetMipMeta(m);
+		auto* Parent = mMips[m-1].data();
+		auto* Mip = mMips[m].data();
+		auto ParentRowSize = ParentMeta.GetRowDataSize();
+
+		for ( size_t y=0;	y<MipMeta.GetHeight();	y++ )
+		{
+			auto y0 = std::min( y*2+0, ParentMeta.GetHeight()-1 );
+			auto y1 = std::min( y*2+1, ParentMeta.GetHeight()-1 );
+			for ( size_t x=0;	x<MipMeta.GetWidth();	x++ )
+			{
+				auto x0 = std::min( x*2+0, ParentMeta.GetWidth()-1 );
+				auto x1 = std::min( x*2+1, ParentMeta.GetWidth()-1 );
+				for ( size_t c=0;	c<Channels;	c++ )
+				{
+					unsigned Sum = 0;
+					Sum += Parent[ y0*ParentRowSize + x0*Channels + c ];
+					Sum += Parent[ y0*ParentRowSize + x1*Channels + c ];
+					Sum += Parent[ y1*ParentRowSize + x0*Channels + c ];
+					Sum += Parent[ y1*ParentRowSize + x1*Channels + c ];
+					Mip[ y*MipMeta.GetRowDataSize() + x*Channels + c ] = static_cast<uint8_t>( (Sum+2) / 4 );
+				}
+			}
+		}
+	}
+}
+
+void* TSoftwareTexture::GetNativeTexture()
+{
+	return mMips[0].data();
+}
+
+std::shared_ptr<TTextureReader> TSoftwareTexture::AllocReader(size_t SlotRows,size_t SlotCount)
+{
+	if ( !mBlocks.empty() )
+		throw Soy::AssertException("Can't read back a compressed software texture");
+	return std::shared_ptr<TTextureReader>( new TSoftwareTextureReader( *this, SlotRows, SlotCount ) );
+}
+
+
+
+TSoftwareTextureReader::TSoftwareTextureReader(TSoftwareTexture& Texture,size_t SlotRows,size_t SlotCount) :
+	TTextureReader		( SlotRows, SlotCount ),
+	mTexture			( Texture ),
+	mSlots				( SlotCount ),
+	mSlotRowCounts		( SlotCount, 0 ),
+	mPollsUntilLanded	( SlotCount, 0 )
+{
+	auto SlotSize = SlotRows * Texture.GetMeta().GetRowDataSize();
+	for ( auto& Slot : mSlots )
+		Slot.resize( SlotSize );
+	SetStagingBytes( SlotSize * SlotCount );
+}
+
+void TSoftwareTextureReader::BeginRead(size_t Slot,size_t RowFirst,size_t RowCount)
+{
+	auto& Meta = mTexture.GetMeta();
+	if ( RowCount > mSlotRows || RowFirst + RowCount > Meta.GetHeight() )
+		throw Soy::AssertException("Software texture read out of bounds");
+
+	auto RowSize = Meta.GetRowDataSize();
+	memcpy( mSlots[Slot].data(), mTexture.GetMipPixels(0) + (RowFirst * RowSize), RowCount * RowSize );
+	mSlotRowCounts[Slot] = RowCount;
+	mPollsUntilLanded[Slot] = SoftwareReadLatency;
+}
+
+bool TSoftwareTextureReader::EndRead(size_t Slot,uint8_t* Dst,size_t DstRowPitch)
+{
+	if ( mPollsUntilLanded[Slot] > 0 )
+	{
+		mPollsUntilLanded[Slot]--;
+		return false;
+	}
+
+	auto RowSize = mTexture.GetMeta().GetRowDataSize();
+	for ( size_t r=0;	r<mSlotRowCounts[Slot];	r++ )
+		memcpy( Dst + (r * DstRowPitch), mSlots[Slot].data() + (r * RowSize), RowSize );
+	return true;
+}
+
+
+
+#if defined(ENABLE_DIRECTX)
+TDirectxTexture::TDirectxTexture(void* TexturePtr,const SoyPixelsMeta& Meta,bool EnableMips) :
+	TTextureBackend	( Meta, EnableMips ),
+	mTexturePtr		( TexturePtr )
+{
+	if ( mTexturePtr )
+	{
+		mTexture.reset( new Directx::TTexture( static_cast<ID3D11Texture2D*>(mTexturePtr) ) );
+	}
+	else
+	{
+		auto& Context = GetContext();
+		//auto TextureMode = Directx::TTextureMode::WriteOnly;
+		static auto TextureMode = Directx::TTextureMode::RenderTarget;
+		//auto TextureMode = Directx::TTextureMode::GpuOnly;
+		mTexture.reset( new Directx::TTexture( mMeta, Context, TextureMode, mEnableMips ) );
+		mAllocated = true;
+
+		//	unity needs a shader resource view, which we can only make on the render thread
+		auto& Device = Context.LockGetDevice();
+		mTexture->GetResourceView(Device);
+		Context.Unlock();
+	}
+
+	D3D11_TEXTURE2D_DESC Desc;
+	GetTexture()->GetDesc( &Desc );
+	mMipCount = Desc.MipLevels;
+}
+
+Directx::TContext& TDirectxTexture::GetContext()
+{
+	auto DirectxContext = Unity::GetDirectxContextPtr();
+	if ( !DirectxContext )
+		throw Soy::AssertException("No device context");
+	return *DirectxContext;
+}
+
+void TDirectxTexture::Write(const SoyPixelsImpl& Pixels,size_t RowFirst,size_t RowCount)
+{
+	auto& Context = GetContext();
+	mTexture->Write( Pixels, Context, RowFirst, RowCount );
+}
+
+ID3D11Texture2D* TDirectxTexture::GetTexture()
+{
+	if ( mTexturePtr )
+		return static_cast<ID3D11Texture2D*>(mTexturePtr);
+	return mTexture->mTexture.mObject;
+}
+
+void TDirectxTexture::WriteRect(const uint8_t* Bytes,size_t RowPitch,const TTextureRect& Rect,size_t MipLevel)
+{
+	auto& DirectxContext = GetContext();
+	auto* Texture = GetTexture();
+
+	D3D11_BOX Box;
+	Box.left = static_cast<UINT>( Rect.mX );
+	Box.right = static_cast<UINT>( Rect.mX + Rect.mWidth );
+	Box.top = static_cast<UINT>( Rect.mY );
+	Box.bottom = static_cast<UINT>( Rect.mY + Rect.mHeight );
+	Box.front = 0;
+	Box.back = 1;
+
+	D3D11_TEXTURE2D_DESC Desc;
+	Texture->GetDesc( &Desc );
+	auto Subresource = D3D11CalcSubresource( static_cast<UINT>(MipLevel), 0, Desc.MipLevels );
+
+	auto& Context = DirectxContext.LockGetContext();
+	Context.UpdateSubresource( Texture, Subresource, &Box, Bytes, static_cast<UINT>(RowPitch), 0 );
+	DirectxContext.Unlock();
+}
+
+void TDirectxTexture::WriteBlockRows(const uint8_t* Blocks,size_t BlockRowPitch,size_t BlockRowFirst,size_t BlockRowCount)
+{
+	auto& DirectxContext = GetContext();
+	auto* Texture = GetTexture();
+
+	D3D11_TEXTURE2D_DESC Desc;
+	Texture->GetDesc( &Desc );
+
+	//	box is in texels, but must cover whole blocks (or reach the edge)
+	D3D11_BOX Box;
+	Box.left = 0;
+	Box.right = Desc.Width;
+	Box.top = static_cast<UINT>( BlockRowFirst * 4 );
+	Box.bottom = std::min<UINT>( Desc.Height, static_cast<UINT>( (BlockRowFirst + BlockRowCount) * 4 ) );
+	Box.front = 0;
+	Box.back = 1;
+
+	auto& Context = DirectxContext.LockGetContext();
+	Context.UpdateSubresource( Texture, 0, &Box, Blocks, static_cast<UINT>(BlockRowPitch), 0 );
+	DirectxContext.Unlock();
+}
+
+void TDirectxTexture::GenerateMips()
+{
+	//	we only own the views of textures we created
+	if ( !mAllocated )
+		return;
+
+	auto& DirectxContext = GetContext();
+
+	//	need a texture resource view for unity
+	auto& Device = DirectxContext.LockGetDevice();
+	auto& Resource = mTexture->GetResourceView(Device);
+	auto& Context = DirectxContext.LockGetContext();
+	Context.GenerateMips(&Resource);
+	DirectxContext.Unlock();
+	DirectxContext.Unlock();
+}
+
+void TDirectxTexture::SetMinMipLevel(size_t MipLevel)
+{
+	//	on the resource, so it applies to the client's views (and unity's) too
+	auto& DirectxContext = GetContext();
+	auto& Context = DirectxContext.LockGetContext();
+	Context.SetResourceMinLOD( GetTexture(), static_cast<FLOAT>(MipLevel) );
+	DirectxContext.Unlock();
+}
+
+std::shared_ptr<TTextureReader> TDirectxTexture::AllocReader(size_t SlotRows,size_t SlotCount)
+{
+	return std::shared_ptr<TTextureReader>( new TDirectxTextureReader( GetContext(), GetTexture(), mMeta, SlotRows, SlotCount ) );
+}
+
+void* TDirectxTexture::GetNativeTexture()
+{
+	if ( mTexturePtr )
+		return mTexturePtr;
+
+	//	unity needs a shader resource view
+	auto& ResourceView = mTexture->GetResourceView();
+	return static_cast<void*>(&ResourceView);
+}
+
+
+
+TDirectxTextureReader::TDirectxTextureReader(Directx::TContext& Context,ID3D11Texture2D* Texture,const SoyPixelsMeta& Meta,size_t SlotRows,size_t SlotCount) :
+	TTextureReader	( SlotRows, SlotCount ),
+	mContext		( Context ),
+	mTexture		( Texture ),
+	mMeta			( Meta ),
+	mStaging		( SlotCount, nullptr ),
+	mQueries		( SlotCount, nullptr ),
+	mSlotRowCounts	( SlotCount, 0 )
+{
+	D3D11_TEXTURE2D_DESC SourceDesc;
+	mTexture->GetDesc( &SourceDesc );
+	if ( SourceDesc.SampleDesc.Count > 1 )
+		throw Soy::AssertException("Can't read back a multisampled texture");
+
+	D3D11_TEXTURE2D_DESC Desc = {};
+	Desc.Width = SourceDesc.Width;
+	Desc.Height = static_cast<UINT>( SlotRows );
+	Desc.MipLevels = 1;
+	Desc.ArraySize = 1;
+	Desc.Format = SourceDesc.Format;
+	Desc.SampleDesc.Count = 1;
+	Desc.Usage = D3D11_USAGE_STAGING;
+	Desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+	D3D11_QUERY_DESC QueryDesc = {};
+	QueryDesc.Query = D3D11_QUERY_EVENT;
+
+	auto& Device = mContext.LockGetDevice();
+	for ( size_t s=0;	s<SlotCount;	s++ )
+	{
+		auto Result = Device.CreateTexture2D( &Desc, nullptr, &mStaging[s] );
+		if ( SUCCEEDED(Result) )
+			Result = Device.CreateQuery( &QueryDesc, &mQueries[s] );
+		if ( FAILED(Result) )
+		{
+			mContext.Unlock();
+			std::stringstream Error;
+			Error << "Failed to create readback staging (0x" << std::hex << Result << ")";
+			throw Soy::AssertException( Error.str() );
+		}
+	}
+	mContext.Unlock();
+	SetStagingBytes( SlotRows * mMeta.GetRowDataSize() * SlotCount );
+}
+
+TDirectxTextureReader::~TDirectxTextureReader()
+{
+	for ( auto* Staging : mStaging )
+		if ( Staging )
+			Staging->Release();
+	for ( auto* Query : mQueries )
+		if ( Query )
+			Query->Release();
+}
+
+void TDirectxTextureReader::BeginRead(size_t Slot,size_t RowFirst,size_t RowCount)
+{
+	if ( RowCount > mSlotRows || RowFirst + RowCount > mMeta.GetHeight() )
+		throw Soy::AssertException("Directx texture read out of bounds");
+
+	D3D11_BOX Box;
+	Box.left = 0;
+	Box.right = static_cast<UINT>( mMeta.GetWidth() );
+	Box.top = static_cast<UINT>( RowFirst );
+	Box.bottom = static_cast<UINT>( RowFirst + RowCount );
+	Box.front = 0;
+	Box.back = 1;
+
+	auto& Context = mContext.LockGetContext();
+	Context.CopySubresourceRegion( mStaging[Slot], 0, 0, 0, 0, mTexture, 0, &Box );
+	Context.End( mQueries[Slot] );
+	mContext.Unlock();
+	mSlotRowCounts[Slot] = RowCount;
+}
+
+bool TDirectxTextureReader::EndRead(size_t Slot,uint8_t* Dst,size_t DstRowPitch)
+{
+	auto& Context = mContext.LockGetContext();
+
+	//	don't flush, unity will soon enough
+	auto Result = Context.GetData( mQueries[Slot], nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH );
+	if ( Result == S_FALSE )
+	{
+		mContext.Unlock();
+		return false;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE Mapped;
+	if ( FAILED(Result) || FAILED( Context.Map( mStaging[Slot], 0, D3D11_MAP_READ, 0, &Mapped ) ) )
+	{
+		mContext.Unlock();
+		throw Soy::AssertException("Failed to map readback staging");
+	}
+
+	auto RowSize = mMeta.GetRowDataSize();
+	auto* Src = static_cast<const uint8_t*>( Mapped.pData );
+	for ( size_t r=0;	r<mSlotRowCounts[Slot];	r++ )
+		memcpy( Dst + (r * DstRowPitch), Src + (r * Mapped.RowPitch), RowSize );
+	Context.Unmap( mStaging[Slot], 0 );
+	mContext.Unlock();
+	return true;
+}
+#endif
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <SoyPixels.h>
+#include <memory>
+#include <vector>
+
+
+//	gr: matching values in c#
+namespace TTextureBackendType
+{
+	enum Type
+	{
+		Default = 0,	//	pick from the current graphics device
+		Software = 1,	//	texels in host memory, no graphics device required
+		Directx = 2,
+		Opengl = 3,		//	gl/gles3 via a pixel buffer ring, needs a current context
+	};
+}
+
+
+//	gr: matching values in c#
+//	4x4 block formats we can encode into. The texture itself must have been created in this format
+namespace TBlockFormat
+{
+	enum Type
+	{
+		None = 0,
+		BC1 = 1,		//	rgb, 8 bytes per block. DXT1
+		BC3 = 2,		//	rgba, 16 bytes per block. DXT5
+		BC7 = 3,		//	rgba, 16 bytes per block. mode 6 only
+		Etc2Rgb = 4,	//	8 bytes per block. etc1 compatible subset
+		Etc2Rgba = 5,	//	16 bytes per block. eac alpha + Etc2Rgb
+	};
+}
+
+
+class TTextureRect
+{
+public:
+	TTextureRect()	{}
+	TTextureRect(size_t x,size_t y,size_t Width,size_t Height) :
+		mX		( x ),
+		mY		( y ),
+		mWidth	( Width ),
+		mHeight	( Height )
+	{
+	}
+
+	size_t		mX = 0;
+	size_t		mY = 0;
+	size_t		mWidth = 0;
+	size_t		mHeight = 0;
+};
+
+
+//	copies rows of a texture's level 0 into a ring of staging slots, which are only mapped once the
+//	gpu says the copy has landed, so reading back never stalls the render thread
+class TTextureReader
+{
+public:
+	TTextureReader(size_t SlotRows,size_t SlotCount) :
+		mSlotRows	( SlotRows ),
+		mSlotCount	( SlotCount )
+	{
+	}
+	virtual ~TTextureReader();
+
+	//	render thread. Start copying rows into Slot (RowCount <= mSlotRows), replacing any copy not yet ended
+	virtual void	BeginRead(size_t Slot,size_t RowFirst,size_t RowCount)=0;
+	//	render thread. false while the copy into Slot is still in flight, otherwise its rows are copied to Dst
+	virtual bool	EndRead(size_t Slot,uint8_t* Dst,size_t DstRowPitch)=0;
+
+	size_t			GetStagingBytes() const		{	return mStagingBytes;	}
+
+protected:
+	void			SetStagingBytes(size_t Bytes);	//	for the memory budget
+
+public:
+	size_t			mSlotRows;
+	size_t			mSlotCount;
+
+private:
+	size_t			mStagingBytes = 0;
+};
+
+
+//	a texture we write pixels into, which the cache doesn't need to know the type of
+class TTextureBackend
+{
+public:
+	TTextureBackend(const SoyPixelsMeta& Meta,bool EnableMips) :
+		mMeta		( Meta ),
+		mEnableMips	( EnableMips )
+	{
+	}
+	virtual ~TTextureBackend();
+
+	virtual void	Write(const SoyPixelsImpl& Pixels,size_t RowFirst,size_t RowCount)=0;
+	//	Bytes is the top left of the rect, RowPitch the bytes between its rows
+	virtual void	WriteRect(const uint8_t* Bytes,size_t RowPitch,const TTextureRect& Rect,size_t MipLevel);
+	//	rows of 4x4 blocks for textures created in a block compressed format. BlockRowPitch is the bytes in one row of blocks
+	virtual void	WriteBlockRows(const uint8_t* Blocks,size_t BlockRowPitch,size_t BlockRowFirst,size_t BlockRowCount);
+	virtual void	GenerateMips()=0;
+	virtual void*	GetNativeTexture()=0;		//	whatever unity wants for CreateExternalTexture
+	virtual size_t	GetMipCount() const=0;		//	levels the texture actually has
+	virtual size_t	GetStagingBytes() const		{	return 0;	}	//	upload memory beside the texture (already in the memory budget)
+	virtual size_t	GetFenceWaits() const		{	return 0;	}	//	times an upload found the gpu behind, for profiling
+	//	false if uploading these rows now would have to wait for the gpu, so the caller can try again next frame
+	virtual bool	IsReadyToWrite(size_t RowSize,size_t RowCount)	{	return true;	}
+	//	sample only MipLevel and coarser, while the finer levels are still being written. 0 samples everything
+	virtual void	SetMinMipLevel(size_t MipLevel)	{}
+	//	render thread. Throws if this backend (or texture) can't be read back
+	virtual std::shared_ptr<TTextureReader>	AllocReader(size_t SlotRows,size_t SlotCount);
+
+	const SoyPixelsMeta&	GetMeta() const		{	return mMeta;	}
+	size_t			GetTextureBytes() const		{	return mTextureBytes;	}
+	//	what we allocated, for the memory budget. 0 for client textures
+	void			SetTextureBytes(size_t Bytes);
+
+protected:
+	SoyPixelsMeta	mMeta;
+	bool			mEnableMips;
+	size_t			mTextureBytes = 0;
+};
+
+
+//	cpu texture; reference implementation for other backends & headless profiling
+class TSoftwareTexture : public TTextureBackend
+{
+public:
+	TSoftwareTexture(const SoyPixelsMeta& Meta,bool EnableMips);
+
+	virtual void	Write(const SoyPixelsImpl& Pixels,size_t RowFirst,size_t RowCount) override;
+	virtual void	WriteRect(const uint8_t* Bytes,size_t RowPitch,const TTextureRect& Rect,size_t MipLevel) override;
+	virtual void	WriteBlockRows(const uint8_t* Blocks,size_t BlockRowPitch,size_t BlockRowFirst,size_t BlockRowCount) override;
+	virtual void	GenerateMips() override;
+	virtual void*	GetNativeTexture() override;
+
+	virtual size_t	GetMipCount() const override	{	return mMips.size();	}
+	virtual std::shared_ptr<TTextureReader>	AllocReader(size_t SlotRows,size_t SlotCount) override;
+	virtual void	SetMinMipLevel(size_t MipLevel) override	{	mMinMipLevel = MipLevel;	}
+	size_t			GetMinMipLevel() const			{	return mMinMipLevel;	}
+	SoyPixelsMeta	GetMipMeta(size_t MipLevel) const;
+	uint8_t*		GetMipPixels(size_t MipLevel);
+	const std::vector<uint8_t>&	GetBlocks() const	{	return mBlocks;	}
+
+private:
+	std::vector<std::vector<uint8_t>>	mMips;
+	std::vector<uint8_t>				mBlocks;	//	level 0 when written as compressed blocks
+	size_t								mMinMipLevel = 0;
+};
+
+
+namespace PopWritePixels
+{
+	//	TexturePtr is an existing native texture to write into (may be null to allocate a new one)
+	//	must be called on the render thread as devices may be required
+	std::shared_ptr<TTextureBackend>	AllocTextureBackend(TTextureBackendType::Type Type,void* TexturePtr,const SoyPixelsMeta& Meta,bool EnableMips,TBlockFormat::Type BlockFormat=TBlockFormat::None);
+	TTextureBackendType::Type			GetDefaultTextureBackendType();	//	throws if there's no device we support
+	size_t								GetMipCount(const SoyPixelsMeta& Meta);
+	size_t								GetPixelSize(const SoyPixelsMeta& Meta);	//	bytes; GetChannels() is only that for 8 bit formats
+}
@@ -0,0 +1,89 @@
+#include "TTextureDedupe.h"
+#include "TCache.h"
+#include "THash.h"
+#include "TWorkerPool.h"
+
+
+namespace PopWritePixels
+{
+	TTextureDedupe	gTextureDedupe;
+}
+
+
+TTextureDedupe& PopWritePixels::GetTextureDedupe()
+{
+	return gTextureDedupe;
+}
+
+
+void TContentHash::Start(TWorkerPool& Pool,std::shared_ptr<TPendingBytes> Pending,size_t DataSize)
+{
+	//	the pending bytes hold this, so only they are captured
+	auto Job = [Pending,DataSize]
+	{
+		auto& Hash = *Pending->mContentHash;
+		PopWritePixels::HashBytes128( Pending->mBytes, DataSize, Hash.mHash );
+		Hash.mReady = true;
+	};
+	Pool.Push( Job );
+}
+
+
+std::shared_ptr<TSharedTexture> TTextureDedupe::Find(const TContentKey& Key)
+{
+	std::lock_guard<std::mutex> Lock( mLock );
+	auto Match = mTextures.find( Key );
+	if ( Match == mTextures.end() )
+		return nullptr;
+
+	auto Texture = Match->second.lock();
+	if ( !Texture )
+		mTextures.erase( Match );
+	return Texture;
+}
+
+void TTextureDedupe::Register(std::shared_ptr<TSharedTexture> Texture)
+{
+	std::lock_guard<std::mutex> Lock( mLock );
+	RemoveExpired();
+	mTextures[Texture->mKey] = Texture;
+}
+
+void TTextureDedupe::Unregister(TSharedTexture& Texture)
+{
+	std::lock_guard<std::mutex> Lock( mLock );
+	auto Match = mTextures.find( Texture.mKey );
+	if ( Match == mTextures.end() )
+		return;
+
+	//	something newer may have the key
+	auto Registered = Match->second.lock();
+	if ( Registered && Registered.get() != &Texture )
+		return;
+	mTextures.erase( Match );
+}
+
+void TTextureDedupe::RemoveExpired()
+{
+	for ( auto it=mTextures.begin();	it!=mTextures.end();	)
+	{
+		if ( it->second.expired() )
+			it = mTextures.erase( it );
+		else
+			it++;
+	}
+}
+
+TDedupeStats TTextureDedupe::GetStats()
+{
+	TDedupeStats Stats;
+	Stats.mLookups = mLookups.load( std::memory_order_relaxed );
+	Stats.mHits = mHits.load( std::memory_order_relaxed );
+	Stats.mInFlightHits = mInFlightHits.load( std::memory_order_relaxed );
+	Stats.mBytesSaved = mBytesSaved.load( std::memory_order_relaxed );
+
+	std::lock_guard<std::mutex> Lock( mLock );
+	RemoveExpired();
+	Stats.mSharedTextures = mTextures.size();
+	return Stats;
+}
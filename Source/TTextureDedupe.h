@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <tuple>
+
+class TTextureBackend;
+class TPendingBytes;
+class TWorkerPool;
+
+
+//	gr: matching layout in c#
+struct TDedupeStats
+{
+	uint64_t	mLookups = 0;			//	hashed submissions
+	uint64_t	mHits = 0;				//	shared an existing texture instead of uploading
+	uint64_t	mInFlightHits = 0;		//	of those, the texture was still being written
+	uint64_t	mBytesSaved = 0;
+	uint64_t	mSharedTextures = 0;	//	textures currently registered
+};
+
+
+//	everything which has to match for two caches' textures to be interchangeable
+class TContentKey
+{
+public:
+	bool		operator<(const TContentKey& That) const
+	{
+		return std::tie( mHash[0], mHash[1], mWidth, mHeight, mFormat, mBlockFormat, mMips, mMipMode, mBackend ) <
+			std::tie( That.mHash[0], That.mHash[1], That.mWidth, That.mHeight, That.mFormat, That.mBlockFormat, That.mMips, That.mMipMode, That.mBackend );
+	}
+
+public:
+	uint64_t	mHash[2] = {0,0};
+	size_t		mWidth = 0;
+	size_t		mHeight = 0;
+	int			mFormat = 0;
+	int			mBlockFormat = 0;
+	bool		mMips = false;
+	int			mMipMode = 0;
+	int			mBackend = 0;
+};
+
+
+//	hash of a submission's bytes, made on a worker thread
+class TContentHash
+{
+public:
+	TContentHash() : mReady(false)	{}
+
+	//	the job keeps the pending bytes alive until it's hashed them
+	void				Start(TWorkerPool& Pool,std::shared_ptr<TPendingBytes> Pending,size_t DataSize);
+
+public:
+	std::atomic<bool>	mReady;
+	uint64_t			mHash[2] = {0,0};		//	valid once ready
+};
+
+
+//	one texture with known content, held by every cache using it. The cache which registered it
+//	writes it; the others follow its progress, and the next one takes over if the writer goes away
+class TSharedTexture
+{
+public:
+	TContentKey							mKey;
+	std::shared_ptr<TTextureBackend>	mTexture;
+	size_t								mRowsWritten = 0;	//	render thread
+	bool								mWriting = false;	//	render thread. false once abandoned or complete
+
+	bool		IsComplete() const		{	return mRowsWritten >= mKey.mHeight;	}
+};
+
+
+//	content-addressed textures. Holds them weakly; a texture goes when the last cache using it lets go
+class TTextureDedupe
+{
+public:
+	TTextureDedupe() :
+		mLookups		( 0 ),
+		mHits			( 0 ),
+		mInFlightHits	( 0 ),
+		mBytesSaved		( 0 )
+	{
+	}
+
+	std::shared_ptr<TSharedTexture>	Find(const TContentKey& Key);	//	null if nothing has this content
+	void				Register(std::shared_ptr<TSharedTexture> Texture);
+	void				Unregister(TSharedTexture& Texture);		//	when its only user is about to change it
+	TDedupeStats		GetStats();
+
+public:
+	std::atomic<uint64_t>	mLookups;
+	std::atomic<uint64_t>	mHits;
+	std::atomic<uint64_t>	mInFlightHits;
+	std::atomic<uint64_t>	mBytesSaved;
+
+private:
+	void				RemoveExpired();
+
+private:
+	std::mutex			mLock;
+	std::map<TContentKey,std::weak_ptr<TSharedTexture>>	mTextures;
+};
+
+
+namespace PopWritePixels
+{
+	TTextureDedupe&		GetTextureDedupe();
+}
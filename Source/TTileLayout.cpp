@@ -0,0 +1,75 @@
+#include "TTileLayout.h"
+#include <SoyTypes.h>
+#include <algorithm>
+
+
+namespace PopWritePixels
+{
+	//	every other bit of Code
+	uint32_t	CompactBits(uint64_t Code);
+}
+
+
+uint32_t PopWritePixels::CompactBits(uint64_t Code)
+{
+	Code &= 0x5555555555555555ull;
+	Code = (Code | (Code >> 1)) & 0x3333333333333333ull;
+	Code = (Code | (Code >> 2)) & 0x0f0f0f0f0f0f0f0full;
+	Code = (Code | (Code >> 4)) & 0x00ff00ff00ff00ffull;
+	Code = (Code | (Code >> 8)) & 0x0000ffff0000ffffull;
+	Code = (Code | (Code >> 16)) & 0x00000000ffffffffull;
+	return static_cast<uint32_t>( Code );
+}
+
+
+TTileLayout::TTileLayout(size_t Width,size_t Height,size_t TileWidth,size_t TileHeight,TTileOrder::Type Order) :
+	mWidth		( Width ),
+	mHeight		( Height ),
+	mTileWidth	( std::max<size_t>( 1, std::min( TileWidth, Width ) ) ),
+	mTileHeight	( std::max<size_t>( 1, std::min( TileHeight, Height ) ) ),
+	mOrder		( Order )
+{
+	mColumns = (mWidth + mTileWidth - 1) / mTileWidth;
+	mRows = (mHeight + mTileHeight - 1) / mTileHeight;
+	auto TileCount = mColumns * mRows;
+	mSequence.reserve( TileCount );
+
+	switch ( mOrder )
+	{
+		case TTileOrder::RowMajor:
+			for ( size_t t=0;	t<TileCount;	t++ )
+				mSequence.push_back( static_cast<uint32_t>( t ) );
+			break;
+
+		case TTileOrder::Morton:
+		{
+			//	walk the z-curve over the enclosing power-of-two square, skipping tiles outside
+			for ( uint64_t Code=0;	mSequence.size()<TileCount;	Code++ )
+			{
+				auto Column = PopWritePixels::CompactBits( Code );
+				auto Row = PopWritePixels::CompactBits( Code >> 1 );
+				if ( Column >= mColumns || Row >= mRows )
+					continue;
+				mSequence.push_back( static_cast<uint32_t>( Row * mColumns + Column ) );
+			}
+			break;
+		}
+
+		default:
+			throw Soy::AssertException("Unknown tile order");
+	}
+}
+
+bool TTileLayout::IsSame(size_t Width,size_t Height,size_t TileWidth,size_t TileHeight,TTileOrder::Type Order) const
+{
+	TileWidth = std::max<size_t>( 1, std::min( TileWidth, Width ) );
+	TileHeight = std::max<size_t>( 1, std::min( TileHeight, Height ) );
+	return mWidth == Width && mHeight == Height && mTileWidth == TileWidth && mTileHeight == TileHeight && mOrder == Order;
+}
+
+void TTileLayout::GetTile(size_t Index,size_t& Column,size_t& Row) const
+{
+	auto Tile = mSequence[Index];
+	Column = Tile % mColumns;
+	Row = Tile / mColumns;
+}
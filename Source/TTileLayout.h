@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+//	gr: matching values in c#
+namespace TTileOrder
+{
+	enum Type
+	{
+		RowMajor = 0,
+		Morton = 1,		//	z-order, keeps consecutive tiles close together in both axes
+	};
+}
+
+
+//	splits a Width x Height area into tiles, and the order to write them in
+class TTileLayout
+{
+public:
+	TTileLayout(size_t Width,size_t Height,size_t TileWidth,size_t TileHeight,TTileOrder::Type Order);
+
+	bool		IsSame(size_t Width,size_t Height,size_t TileWidth,size_t TileHeight,TTileOrder::Type Order) const;
+	size_t		GetTileCount() const		{	return mSequence.size();	}
+	//	nth tile to write, as column & row
+	void		GetTile(size_t Index,size_t& Column,size_t& Row) const;
+
+public:
+	size_t					mWidth;
+	size_t					mHeight;
+	size_t					mTileWidth;
+	size_t					mTileHeight;
+	size_t					mColumns;
+	size_t					mRows;
+	TTileOrder::Type		mOrder;
+	std::vector<uint32_t>	mSequence;		//	Row * mColumns + Column
+};
@@ -0,0 +1,65 @@
+#include "TWorkerPool.h"
+#include <SoyDebug.h>
+#include <algorithm>
+
+
+TWorkerPool& PopWritePixels::GetWorkerPool()
+{
+	//	leave a core for unity's main & render threads
+	auto Cores = std::thread::hardware_concurrency();
+	static TWorkerPool gPool( Cores > 1 ? Cores-1 : 1 );
+	return gPool;
+}
+
+
+TWorkerPool::TWorkerPool(size_t ThreadCount)
+{
+	ThreadCount = std::max<size_t>( 1, ThreadCount );
+	for ( size_t i=0;	i<ThreadCount;	i++ )
+		mThreads.push_back( std::thread( [this]{ Thread(); } ) );
+}
+
+TWorkerPool::~TWorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> Lock( mLock );
+		mRunning = false;
+	}
+	mWake.notify_all();
+	for ( auto& Thread : mThreads )
+		Thread.join();
+}
+
+void TWorkerPool::Push(std::function<void()> Job)
+{
+	{
+		std::lock_guard<std::mutex> Lock( mLock );
+		mJobs.push_back( Job );
+	}
+	mWake.notify_one();
+}
+
+void TWorkerPool::Thread()
+{
+	while ( true )
+	{
+		std::function<void()> Job;
+		{
+			std::unique_lock<std::mutex> Lock( mLock );
+			mWake.wait( Lock, [this]{ return !mRunning || !mJobs.empty(); } );
+			if ( !mRunning )
+				return;
+			Job = mJobs.front();
+			mJobs.pop_front();
+		}
+
+		try
+		{
+			Job();
+		}
+		catch(std::exception& e)
+		{
+			std::Debug << "Worker job exception: " << e.what() << std::endl;
+		}
+	}
+}
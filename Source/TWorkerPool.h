@@ -0,0 +1,36 @@
+#pragma once
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+
+//	plain thread pool for cpu work ahead of the render thread (conversion, compression, decoding...)
+class TWorkerPool
+{
+public:
+	TWorkerPool(size_t ThreadCount);
+	~TWorkerPool();
+
+	void			Push(std::function<void()> Job);
+	size_t			GetThreadCount() const		{	return mThreads.size();	}
+
+private:
+	void			Thread();
+
+private:
+	std::mutex							mLock;
+	std::condition_variable				mWake;
+	std::deque<std::function<void()>>	mJobs;
+	std::vector<std::thread>			mThreads;
+	bool								mRunning = true;
+};
+
+
+namespace PopWritePixels
+{
+	TWorkerPool&	GetWorkerPool();
+}
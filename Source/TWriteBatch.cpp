@@ -0,0 +1,104 @@
+#include "TWriteBatch.h"
+#include "TCache.h"
+#include "TTelemetry.h"
+#include <SoyDebug.h>
+#include <algorithm>
+
+
+namespace PopWritePixels
+{
+	TWriteBatchQueue	gWriteBatchQueue;
+}
+
+
+TWriteBatchQueue& PopWritePixels::GetWriteBatchQueue()
+{
+	return gWriteBatchQueue;
+}
+
+
+void TWriteBatchQueue::Push(const std::vector<int>& CacheHandles)
+{
+	std::lock_guard<std::mutex> Lock( mNewLock );
+	for ( auto CacheHandle : CacheHandles )
+	{
+		//	latest bytes win in the cache, so it only needs listing once
+		if ( std::find( mNew.begin(), mNew.end(), CacheHandle ) == mNew.end() )
+			mNew.push_back( CacheHandle );
+	}
+}
+
+void TWriteBatchQueue::Clear()
+{
+	std::lock_guard<std::mutex> Lock( mNewLock );
+	mNew.clear();
+	mActive.clear();
+}
+
+class TBatchedCache
+{
+public:
+	TCache*		mCache = nullptr;
+	int			mCacheHandle = -1;
+	int			mPriority = 0;		//	read once, as the main thread can change it while we sort
+};
+
+
+size_t TWriteBatchQueue::WritePending()
+{
+	{
+		std::lock_guard<std::mutex> Lock( mNewLock );
+		for ( auto CacheHandle : mNew )
+		{
+			if ( std::find( mActive.begin(), mActive.end(), CacheHandle ) == mActive.end() )
+				mActive.push_back( CacheHandle );
+		}
+		mNew.clear();
+	}
+
+	//	resolve handles once; released caches drop out here
+	std::vector<TBatchedCache> Caches;
+	for ( auto CacheHandle : mActive )
+	{
+		try
+		{
+			TBatchedCache Batched;
+			Batched.mCache = &PopWritePixels::GetCache( CacheHandle );
+			Batched.mCacheHandle = CacheHandle;
+			Batched.mPriority = Batched.mCache->mPriority;
+			Caches.push_back( Batched );
+		}
+		catch(std::exception&)
+		{
+			//	released since it was batched
+		}
+	}
+
+	auto Compare = [](const TBatchedCache& a,const TBatchedCache& b)
+	{
+		return a.mPriority > b.mPriority;
+	};
+	std::stable_sort( Caches.begin(), Caches.end(), Compare );
+
+	size_t BytesWritten = 0;
+	mActive.clear();
+	for ( auto& Batched : Caches )
+	{
+		auto& Cache = *Batched.mCache;
+		try
+		{
+			BytesWritten += Cache.WritePixels();
+		}
+		catch(std::exception& e)
+		{
+			if ( PopWritePixels::IsLogging( TLogLevel::Errors ) )
+				std::Debug << "WriteBatch cache " << Batched.mCacheHandle << " exception: " << e.what() << std::endl;
+			continue;
+		}
+
+		//	keep writing it every frame until it's done
+		if ( Cache.HasPendingWork() )
+			mActive.push_back( Batched.mCacheHandle );
+	}
+	return BytesWritten;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+
+//	gr: matching layout in c#
+//	one record of QueueWritePixelsBatch
+struct TBatchWrite
+{
+	uint8_t*	mBytes = nullptr;		//	ignored when mBuffer is set
+	int32_t		mBytesSize = 0;
+	int32_t		mBuffer = -1;			//	pooled buffer handle (AllocPixelBuffer) to hand over instead of mBytes
+	int32_t		mCache = -1;
+	int32_t		mPriority = 0;
+	int32_t		mX = 0;
+	int32_t		mY = 0;
+	int32_t		mWidth = 0;				//	0x0 = whole texture
+	int32_t		mHeight = 0;
+};
+
+
+//	the caches batched submissions went to, written by one render event per frame rather than
+//	one event per cache. The bytes themselves go through each cache's own submission slot,
+//	this is just the list of who to write, in priority order, until they finish
+class TWriteBatchQueue
+{
+public:
+	void				Push(const std::vector<int>& CacheHandles);	//	any thread
+	size_t				WritePending();		//	render thread. returns bytes written
+	void				Clear();			//	render thread, when something else (the scheduler) writes every cache
+
+private:
+	std::mutex			mNewLock;
+	std::vector<int>	mNew;				//	pushed since the last write
+	std::vector<int>	mActive;			//	render thread only
+};
+
+
+namespace PopWritePixels
+{
+	TWriteBatchQueue&	GetWriteBatchQueue();
+}
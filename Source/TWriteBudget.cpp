@@ -0,0 +1,56 @@
+#include "TWriteBudget.h"
+#include <algorithm>
+#include <chrono>
+
+
+
+uint64_t PopWritePixels::GetMicrosecsNow()
+{
+	auto Now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration_cast<std::chrono::microseconds>(Now).count();
+}
+
+
+void TWriteRateMeter::Add(size_t Bytes,uint64_t Microsecs)
+{
+	//	sub-microsecond writes (tiny, or timer resolution) would give us infinity
+	Microsecs = std::max<uint64_t>( 1, Microsecs );
+	auto Rate = static_cast<float>(Bytes) / static_cast<float>(Microsecs);
+
+	if ( mSampleCount == 0 )
+	{
+		mBytesPerMicrosecond = Rate;
+	}
+	else
+	{
+		float Smoothed = mBytesPerMicrosecond;
+		mBytesPerMicrosecond = Smoothed + (Rate - Smoothed) * mSmoothing;
+	}
+	mSampleCount++;
+}
+
+
+size_t TWriteBudget::GetRowCount(size_t RowDataSize,const TWriteRateMeter& Rate,size_t LastRowCount) const
+{
+	RowDataSize = std::max<size_t>( 1, RowDataSize );
+	size_t RowCount = SIZE_MAX;
+
+	if ( mBytes > 0 )
+		RowCount = std::min<size_t>( RowCount, mBytes / RowDataSize );
+
+	if ( mMicrosecs > 0 )
+	{
+		//	no idea how fast we are yet, write one row to find out
+		if ( !Rate.HasMeasurement() )
+			return 1;
+
+		auto BudgetBytes = static_cast<double>(Rate.GetBytesPerMicrosecond()) * static_cast<double>(mMicrosecs);
+		auto TimeRows = static_cast<size_t>( BudgetBytes / RowDataSize );
+		//	the first measurements are dominated by overhead, so only grow gradually
+		//	rather than trusting a single sample and hitching
+		TimeRows = std::min<size_t>( TimeRows, std::max<size_t>( 1, LastRowCount ) * 2 );
+		RowCount = std::min( RowCount, TimeRows );
+	}
+
+	return std::max<size_t>( 1, RowCount );
+}
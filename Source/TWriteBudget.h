@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+
+
+//	rolling measurement of how fast Write()s actually go on this device.
+//	Added to on the render thread, read on any (eg. to size a prefetch when queueing)
+class TWriteRateMeter
+{
+public:
+	TWriteRateMeter() :
+		mBytesPerMicrosecond	( 0 ),
+		mSampleCount			( 0 )
+	{
+	}
+	TWriteRateMeter(const TWriteRateMeter& That) :
+		mSmoothing				( That.mSmoothing ),
+		mBytesPerMicrosecond	( That.mBytesPerMicrosecond.load() ),
+		mSampleCount			( That.mSampleCount.load() )
+	{
+	}
+	TWriteRateMeter&	operator=(const TWriteRateMeter& That)
+	{
+		mSmoothing = That.mSmoothing;
+		mBytesPerMicrosecond = That.mBytesPerMicrosecond.load();
+		mSampleCount = That.mSampleCount.load();
+		return *this;
+	}
+
+	void		Add(size_t Bytes,uint64_t Microsecs);
+	float		GetBytesPerMicrosecond() const	{	return mBytesPerMicrosecond;	}
+	bool		HasMeasurement() const			{	return mSampleCount > 0;	}
+
+public:
+	float				mSmoothing = 0.25f;			//	weight of newest sample
+	std::atomic<float>	mBytesPerMicrosecond;
+	std::atomic<size_t>	mSampleCount;
+};
+
+
+//	per-frame limit, in time and/or bytes. Zero means no limit for that unit.
+//	Set from the main thread while the render thread reads it, so the render thread works from a copy
+class TWriteBudget
+{
+public:
+	TWriteBudget() :
+		mMicrosecs	( 0 ),
+		mBytes		( 0 )
+	{
+	}
+	TWriteBudget(const TWriteBudget& That) :
+		mMicrosecs	( That.mMicrosecs.load() ),
+		mBytes		( That.mBytes.load() )
+	{
+	}
+	TWriteBudget&	operator=(const TWriteBudget& That)
+	{
+		mMicrosecs = That.mMicrosecs.load();
+		mBytes = That.mBytes.load();
+		return *this;
+	}
+
+	bool		IsEnabled() const	{	return mMicrosecs > 0 || mBytes > 0;	}
+
+	//	how many rows fit into this budget given the measured rate.
+	//	always >= 1 so we progress
+	size_t		GetRowCount(size_t RowDataSize,const TWriteRateMeter& Rate,size_t LastRowCount) const;
+
+public:
+	std::atomic<uint64_t>	mMicrosecs;
+	std::atomic<uint64_t>	mBytes;
+};
+
+
+namespace PopWritePixels
+{
+	uint64_t	GetMicrosecsNow();
+}
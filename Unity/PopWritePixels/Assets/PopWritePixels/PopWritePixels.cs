@@ -17,12 +17,69 @@ public static class PopWritePixels
 #error Unsupported platform
 #endif
 
+	//	matches TTextureBackendType
+	public enum TextureBackend
+	{
+		Default = 0,
+		Software = 1,	//	texels in host memory; for headless testing, not usable as a unity texture
+		Directx = 2,
+		Opengl = 3,		//	streams through a pixel buffer ring; needs gl/gles3 on the render thread
+	};
+
+	//	matches TPixelConversion
+	public enum PixelConversion
+	{
+		None = 0,
+		RgbToRgba = 1,
+		SwapRedBlue = 2,			//	BGRA <-> RGBA
+		FloatToHalf = 3,
+		Uint16ToUint8 = 4,
+		LinearFloatToSrgb8 = 5,		//	RGBA float to RGBA32
+	};
+
+	//	matches TBlockFormat. the texture must be created in the matching TextureFormat
+	public enum BlockFormat
+	{
+		None = 0,
+		BC1 = 1,		//	TextureFormat.DXT1
+		BC3 = 2,		//	TextureFormat.DXT5
+		BC7 = 3,		//	TextureFormat.BC7
+		Etc2Rgb = 4,	//	TextureFormat.ETC2_RGB
+		Etc2Rgba = 5,	//	TextureFormat.ETC2_RGBA8
+	};
+
+	//	matches TCompressQuality
+	public enum CompressQuality
+	{
+		Fast = 0,
+		Normal = 1,
+		High = 2,
+	};
+
+	//	matches TTileOrder
+	public enum TileOrder
+	{
+		RowMajor = 0,
+		Morton = 1,
+	};
+
+	//	matches TMipMode
+	public enum MipMode
+	{
+		Gpu = 0,		//	regenerate the whole chain when the write finishes
+		Cpu = 1,		//	mip rows are built & written with each band
+		Progressive = 2,	//	mips smallest first, so a blurry texture is usable early (see GetResidentMip)
+	};
+
 	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
 	private static extern int AllocCacheTexture2D(IntPtr TexturePtr, int Width, int Height, TextureFormat PixelFormat);
 
 	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
 	private static extern int AllocCacheTexture(int Width, int Height, TextureFormat PixelFormat, bool EnableMips);
 
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern int AllocCacheTextureWithBackend(int Width, int Height, TextureFormat PixelFormat, bool EnableMips, TextureBackend Backend);
+
 	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
 	private static extern void ReleaseCache(int Cache);
 
@@ -32,25 +89,541 @@ public static class PopWritePixels
 	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
 	private static extern bool QueueWritePixels(int Cache, System.IntPtr ByteData, int ByteDataSize);
 
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+	private static extern bool QueueWritePixelsFile(int Cache, string Filename, ulong Offset, ulong Size);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern bool QueueWritePixelsDecode(int Cache, byte[] ByteData, int ByteDataSize);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+	private static extern bool QueueWritePixelsDecodeFile(int Cache, string Filename);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+	private static extern bool QueueWritePixelsBaked(int Cache, string Filename);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern bool QueueWritePixelsRegion(int Cache, byte[] ByteData, int ByteDataSize, int x, int y, int Width, int Height);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern bool QueueWritePixelsConvert(int Cache, byte[] ByteData, int ByteDataSize, PixelConversion Conversion);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern bool QueueWritePixelsConvert(int Cache, System.IntPtr ByteData, int ByteDataSize, PixelConversion Conversion);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern int AllocCacheTextureCompressed(IntPtr TexturePtr, int Width, int Height, BlockFormat Format);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern bool QueueWritePixelsCompress(int Cache, byte[] ByteData, int ByteDataSize, CompressQuality Quality);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern bool QueueWritePixelsCompress(int Cache, System.IntPtr ByteData, int ByteDataSize, CompressQuality Quality);
+
+	//	single-thread megapixels per second, to pick a format & quality for this device
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	public static extern float BenchmarkBlockCompression(BlockFormat Format, CompressQuality Quality, int Width, int Height);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern void SetChangeDetection(int Cache, bool Enable, int TileWidth);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern ulong GetBytesSkipped(int Cache);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern void SetMipMode(int Cache, int MipMode);
+
+	//	matches TDedupeStats
+	[StructLayout(LayoutKind.Sequential)]
+	public struct DedupeStats
+	{
+		public ulong Lookups;
+		public ulong Hits;
+		public ulong InFlightHits;		//	shared while the first cache was still writing it
+		public ulong BytesSaved;
+		public ulong SharedTextures;
+
+		public float HitRate { get { return Lookups == 0 ? 0 : (float)Hits / (float)Lookups; } }
+	};
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern void SetContentDedupe(int Cache, bool Enable);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern bool GetDedupeStats(ref DedupeStats Stats);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern int AllocPixelBuffer(int Size, ref IntPtr Pointer);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern void FreePixelBuffer(int BufferHandle);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern bool QueueWritePixelBuffer(int Cache, int BufferHandle);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	public static extern void TrimPixelBufferPool();
+
+	//	matches TBatchWrite
+	[StructLayout(LayoutKind.Sequential)]
+	public struct BatchWrite
+	{
+		public IntPtr Bytes;		//	ignored when Buffer is set
+		public int BytesSize;
+		public int Buffer;			//	PixelBuffer handle, -1 to use Bytes
+		public int Cache;
+		public int Priority;
+		public int x;
+		public int y;
+		public int Width;			//	0x0 = whole texture
+		public int Height;
+	};
+
+	//	matches TStreamStats
+	[StructLayout(LayoutKind.Sequential)]
+	public struct StreamStats
+	{
+		public ulong FramesQueued;
+		public ulong FramesPresented;
+		public ulong FramesDropped;
+		public ulong FrameNumber;
+		public HistogramSummary Latency;	//	microsecs from frame timestamp to presented
+	};
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern void SetStreamMode(int Cache, int RingSize, int QueueDepth);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern bool QueueStreamFrame(int Cache, System.IntPtr ByteData, int ByteDataSize, ulong TimestampMicrosecs);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern bool QueueStreamFrameBuffer(int Cache, int BufferHandle, ulong TimestampMicrosecs);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern bool GetStreamStats(int Cache, ref StreamStats Stats);
+
+	//	clock for stream frame timestamps
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	public static extern ulong GetPluginTimeMicrosecs();
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern bool QueueWritePixelsBatch(BatchWrite[] Writes, int WriteCount);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern IntPtr GetWriteBatchFunc();
+
 	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
 	private static extern int GetRowsWritten(int Cache);
 
+	//	matches TCompletionStatus
+	public enum CompletionStatus
+	{
+		Complete = 0,
+		Failed = 1,
+	};
+
+	//	matches TCompletion. Times are GetPluginTimeMicrosecs()
+	[StructLayout(LayoutKind.Sequential)]
+	public struct Completion
+	{
+		public int Cache;
+		public CompletionStatus Status;
+		public uint Submission;
+		public uint RowsWritten;
+		public ulong QueueTime;
+		public ulong FirstRowTime;		//	0 if nothing was written
+		public ulong CompleteTime;
+	};
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern int DrainCompletions([In, Out] Completion[] Completions, int MaxCount);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern ulong GetCompletionsDropped();
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern void SetTileChunking(int Cache, int TileWidth, int TileHeight, TileOrder Order);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern void SetWriteTilesPerFrame(int Cache, int TilesPerFrame);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern int GetTilesWritten(int Cache);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern int GetTileCount(int Cache);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern int GetResidentMip(int Cache);
+
 	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
 	private static extern IntPtr GetCacheTexture(int Cache);
 
+	//	matches TMemoryUsage
+	[StructLayout(LayoutKind.Sequential)]
+	public struct MemoryUsage
+	{
+		public ulong BudgetBytes;			//	0 = no limit
+		public ulong UsedBytes;
+		public ulong HighWaterBytes;		//	since ResetPluginStats()
+		public ulong PooledBytes;			//	PixelBuffers, not part of the budget
+		public ulong Evictions;
+		public ulong EvictedBytes;
+		public ulong AllocationsDeferred;	//	frames a texture waited for room
+	};
+
+	//	limit on textures (with mips) & staging the plugin allocates, 0 = none. Over it, idle jobs
+	//	are evicted least recently used first, and new textures wait until there's room
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	public static extern void SetMemoryBudget(ulong Bytes);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern bool GetMemoryUsage(ref MemoryUsage Usage);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern ulong GetCacheMemoryBytes(int Cache);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern void SetCacheEvictable(int Cache, bool Evictable);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern bool IsCacheEvicted(int Cache);
+
 	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
 	private static extern IntPtr GetWritePixelsToCacheFunc();
 
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern int AllocReadback(IntPtr TexturePtr, int Width, int Height, TextureFormat PixelFormat, TextureBackend Backend);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern int AllocCacheReadback(int Cache);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern void ReleaseReadback(int Readback);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern void SetReadRowsPerFrame(int Readback, int ReadRowsPerFrame);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern bool QueueReadPixels(int Readback, IntPtr ByteData, int ByteDataSize);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern int GetRowsRead(int Readback);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern IntPtr GetReadPixels(int Readback, ref int ByteDataSize);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern IntPtr GetReadPixelsFunc();
+
 	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
 	private static extern void SetWriteRowsPerFrame(int Cache, int RowsPerFrame);
 
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern void SetWriteBudget(int Cache, int Microsecs, int Bytes);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	public static extern void SetDefaultWriteBudget(int Microsecs, int Bytes);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern float GetWriteBytesPerMicrosecond(int Cache);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern IntPtr GetWriteAllPendingCachesFunc();
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	public static extern void SetFrameWriteBudget(int Microsecs, int Bytes);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern void SetCachePriority(int Cache, int Priority);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern void SetCacheDeadline(int Cache, int MicrosecsFromNow);
+
+	//	matches TLogLevel
+	public enum LogLevel
+	{
+		None = 0,
+		Errors = 1,
+		Calls = 2,		//	every call & its duration, not for shipping
+	};
+
+	//	matches TTelemetryMetric
+	public enum TelemetryMetric
+	{
+		QueueToFirstRow = 0,
+		QueueToComplete = 1,
+		WriteMicrosecs = 2,
+		FrameBytes = 3,
+		FrameMicrosecs = 4,
+	};
+
+	//	matches THistogramSummary. Percentiles are bucket upper bounds, so within 2x
+	[StructLayout(LayoutKind.Sequential)]
+	public struct HistogramSummary
+	{
+		public ulong Count;
+		public ulong Mean;
+		public ulong Max;
+		public ulong P50;
+		public ulong P99;
+	};
+
+	//	matches TCacheStats. latencies are microseconds
+	[StructLayout(LayoutKind.Sequential)]
+	public struct CacheStats
+	{
+		public ulong Submissions;
+		public ulong Completed;
+		public ulong Writes;
+		public ulong BytesWritten;
+		public ulong BytesSkipped;
+		public ulong FenceWaits;
+		public HistogramSummary QueueToFirstRow;
+		public HistogramSummary QueueToComplete;
+		public HistogramSummary WriteMicrosecs;
+		public HistogramSummary WriteBytes;
+	};
+
+	//	matches TPluginStats
+	[StructLayout(LayoutKind.Sequential)]
+	public struct PluginStats
+	{
+		public ulong CachesAllocated;
+		public ulong Submissions;
+		public ulong Completed;
+		public ulong Writes;
+		public ulong BytesWritten;
+		public ulong Frames;
+		public HistogramSummary QueueToFirstRow;
+		public HistogramSummary QueueToComplete;
+		public HistogramSummary WriteMicrosecs;
+		public HistogramSummary FrameBytes;
+		public HistogramSummary FrameMicrosecs;
+	};
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	public static extern void SetLogLevel(LogLevel Level);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern bool GetCacheStats(int Cache, ref CacheStats Stats);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern bool GetPluginStats(ref PluginStats Stats);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern int GetPluginHistogram(TelemetryMetric Metric, ulong[] Buckets, int BucketCount);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	public static extern void ResetPluginStats();
+
+	//	matches TAtlasStats
+	[StructLayout(LayoutKind.Sequential)]
+	public struct AtlasStats
+	{
+		public int PageCount;
+		public int ImageCount;
+		public ulong UsedPixels;
+		public ulong FreePixels;
+		public ulong LargestFreePixels;
+		public float Fragmentation;
+	};
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern int AllocAtlas(int PageWidth, int PageHeight, TextureFormat PixelFormat, int MaxPages, int Padding, TextureBackend Backend);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern void ReleaseAtlas(int Atlas);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern int AtlasAddImage(int Atlas, byte[] ByteData, int ByteDataSize, int Width, int Height, ref int Page, float[] UvRect);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern void AtlasFreeImage(int Atlas, int Image);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern int GetAtlasPageCount(int Atlas);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern IntPtr GetAtlasPageTexture(int Atlas, int Page);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern bool GetAtlasStats(int Atlas, ref AtlasStats Stats);
+
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern IntPtr GetWriteAtlasesFunc();
+
+	//	when true, jobs don't issue their own render events; call IssueWriteAllPendingCaches() once per frame instead
+	public static bool UseScheduler = false;
+	static IntPtr? WriteAllPendingCachesFunction = null;
+
+	public static void IssueWriteAllPendingCaches()
+	{
+		if (!WriteAllPendingCachesFunction.HasValue)
+			WriteAllPendingCachesFunction = GetWriteAllPendingCachesFunc();
+		GL.IssuePluginEvent(WriteAllPendingCachesFunction.Value, 0);
+	}
+
+	//	when true, jobs learn they've finished from the plugin's completion queue instead of polling every frame,
+	//	and don't issue their own events; call UpdateJobs() once a frame, which writes them all with the scheduler
+	public static bool UseCompletionQueue = false;
+	static Dictionary<int, WeakReference> CompletionJobs = new Dictionary<int, WeakReference>();
+	static Completion[] CompletionBuffer = new Completion[256];
+	static ulong CompletionsDropped = 0;
+
+	public static void UpdateJobs()
+	{
+		IssueWriteAllPendingCaches();
+		DrainCompletions();
+	}
+
+	//	hand finished writes to their jobs. UpdateJobs() does this
+	public static void DrainCompletions()
+	{
+		while (true)
+		{
+			var Count = DrainCompletions(CompletionBuffer, CompletionBuffer.Length);
+			if (Count < 0)
+				throw new System.Exception("DrainCompletions returned error");
+
+			for (int i = 0; i < Count; i++)
+			{
+				WeakReference JobRef;
+				if (!CompletionJobs.TryGetValue(CompletionBuffer[i].Cache, out JobRef))
+					continue;
+				var Job = JobRef.Target as JobCache;
+				if (Job != null)
+					Job.OnCompletion(CompletionBuffer[i]);
+			}
+
+			if (Count < CompletionBuffer.Length)
+				break;
+		}
+
+		//	the queue filled up and lost some, so find out the slow way
+		var Dropped = GetCompletionsDropped();
+		if (Dropped != CompletionsDropped)
+		{
+			CompletionsDropped = Dropped;
+			foreach (var JobRef in CompletionJobs.Values)
+			{
+				var Job = JobRef.Target as JobCache;
+				if (Job != null)
+					Job.PollCompletion();
+			}
+		}
+	}
+
+	public static PluginStats GetPluginStats()
+	{
+		var Stats = new PluginStats();
+		if (!GetPluginStats(ref Stats))
+			throw new System.Exception("GetPluginStats returned error");
+		return Stats;
+	}
+
+	public static MemoryUsage GetMemoryUsage()
+	{
+		var Usage = new MemoryUsage();
+		if (!GetMemoryUsage(ref Usage))
+			throw new System.Exception("GetMemoryUsage returned error");
+		return Usage;
+	}
+
+	public static DedupeStats GetDedupeStats()
+	{
+		var Stats = new DedupeStats();
+		if (!GetDedupeStats(ref Stats))
+			throw new System.Exception("GetDedupeStats returned error");
+		return Stats;
+	}
+
+	//	log2 buckets; [0] is 0, [n] counts values in [2^(n-1), 2^n)
+	public static ulong[] GetPluginHistogram(TelemetryMetric Metric)
+	{
+		var Buckets = new ulong[40];
+		var Count = GetPluginHistogram(Metric, Buckets, Buckets.Length);
+		if (Count < 0)
+			throw new System.Exception("GetPluginHistogram returned error");
+		System.Array.Resize(ref Buckets, Count);
+		return Buckets;
+	}
+
+	//	measured across all caches, use to tune budgets per device
+	public static float GetPluginWriteBytesPerMicrosecond()
+	{
+		return GetWriteBytesPerMicrosecond(-1);
+	}
+
+
+
+
+	//	native memory leased from the plugin's pool. Fill it, then JobCache.QueueWrite() it,
+	//	after which the plugin owns it and returns it to the pool once written
+	public class PixelBuffer
+	{
+		public int? Handle = null;
+		public IntPtr Pointer = IntPtr.Zero;
+		public int Size = 0;
+
+		public PixelBuffer(int Size)
+		{
+			Handle = AllocPixelBuffer(Size, ref Pointer);
+			if (Handle == -1 || Pointer == IntPtr.Zero)
+				throw new System.Exception("Failed to allocate pixel buffer of " + Size + " bytes");
+			this.Size = Size;
+		}
+
+		~PixelBuffer()
+		{
+			//	gr: can't call plugin from the finaliser thread safely, if we leak, it'll stay leased
+		}
+
+		public void Write(byte[] Bytes)
+		{
+			if (Bytes.Length > Size)
+				throw new System.Exception("Too many bytes (" + Bytes.Length + ") for pixel buffer of " + Size);
+			Marshal.Copy(Bytes, 0, Pointer, Bytes.Length);
+		}
+
+#if UNITY_2018_1_OR_NEWER
+		//	requires "allow unsafe code". Not valid after the buffer has been queued
+		public unsafe Unity.Collections.NativeArray<byte> GetNativeArray()
+		{
+			var Array = Unity.Collections.LowLevel.Unsafe.NativeArrayUnsafeUtility.ConvertExistingDataToNativeArray<byte>(Pointer.ToPointer(), Size, Unity.Collections.Allocator.None);
+#if ENABLE_UNITY_COLLECTIONS_CHECKS
+			Unity.Collections.LowLevel.Unsafe.NativeArrayUnsafeUtility.SetAtomicSafetyHandle(ref Array, Unity.Collections.LowLevel.Unsafe.AtomicSafetyHandle.Create());
+#endif
+			return Array;
+		}
+#endif
 
+		//	hand ownership to the plugin
+		public int Submit()
+		{
+			if (!Handle.HasValue)
+				throw new System.Exception("Pixel buffer already submitted or freed");
+			var SubmitHandle = Handle.Value;
+			Handle = null;
+			Pointer = IntPtr.Zero;
+			return SubmitHandle;
+		}
 
+		//	return to the pool without writing
+		public void Free()
+		{
+			if (!Handle.HasValue)
+				return;
+			FreePixelBuffer(Handle.Value);
+			Handle = null;
+			Pointer = IntPtr.Zero;
+		}
+	}
 
 	public class JobCache
 	{
 		int? CacheIndex = null;
 		IntPtr PluginFunction;
+		internal bool Batched = false;	//	written by WriteBatch's event instead of our own
 		Camera.CameraCallback IssueEventCallback = null;
 
 		int? RowCount = null;	//	store height/row count for progress counter
@@ -64,6 +637,19 @@ public static class PopWritePixels
 		TextureFormat? NewFormat = null;
 		Texture2D NewTexture = null;
 		bool? NewTextureMips = null;
+		TextureBackend NewBackend = TextureBackend.Default;
+
+		//	queued & finished submission ids, which match the plugin's
+		uint Submissions = 0;
+		uint CompletedSubmission = 0;
+		uint FailedSubmission = 0;
+		Completion? LastCompletion = null;
+
+		//	stream mode; the plugin's front texture changes as frames are presented
+		bool Streaming = false;
+		bool Deduplicated = false;
+		bool Evictable = false;
+		IntPtr NewTexturePtr = IntPtr.Zero;
 
 		public JobCache(Texture2D texture)
 		{
@@ -75,21 +661,40 @@ public static class PopWritePixels
 
 			RowCount = texture.height;
 			PluginFunction = GetWritePixelsToCacheFunc();
+			CompletionJobs[CacheIndex.Value] = new WeakReference(this);
+		}
+
+		//	texture must have been created in the matching compressed format. Use QueueWrite(..., CompressQuality) to write RGBA32
+		public JobCache(Texture2D texture, BlockFormat Format)
+		{
+			TexturePtr = texture.GetNativeTexturePtr();
+			CacheIndex = AllocCacheTextureCompressed(TexturePtr, texture.width, texture.height, Format);
+			if (CacheIndex == -1)
+				throw new System.Exception("Failed to allocate cache index");
+
+			RowCount = texture.height;
+			PluginFunction = GetWritePixelsToCacheFunc();
+			CompletionJobs[CacheIndex.Value] = new WeakReference(this);
 		}
 
-		public JobCache(int Width, int Height, TextureFormat TextureFormat, bool GenerateMips)
+		public JobCache(int Width, int Height, TextureFormat TextureFormat, bool GenerateMips, TextureBackend Backend = TextureBackend.Default)
 		{
 			//	gr: replace format with channels?
-			CacheIndex = AllocCacheTexture(Width, Height, TextureFormat, GenerateMips);
+			if (Backend == TextureBackend.Default)
+				CacheIndex = AllocCacheTexture(Width, Height, TextureFormat, GenerateMips);
+			else
+				CacheIndex = AllocCacheTextureWithBackend(Width, Height, TextureFormat, GenerateMips, Backend);
 			if (CacheIndex == -1)
 				throw new System.Exception("Failed to allocate cache index");
 
 			NewTextureMips = GenerateMips;
+			NewBackend = Backend;
 			RowCount = Height;
 			NewWidth = Width;
 			NewHeight = Height;
 			NewFormat = TextureFormat;
 			PluginFunction = GetWritePixelsToCacheFunc();
+			CompletionJobs[CacheIndex.Value] = new WeakReference(this);
 		}
 
 		~JobCache()
@@ -102,9 +707,118 @@ public static class PopWritePixels
 			PopWritePixels.SetWriteRowsPerFrame(CacheIndex.Value, RowsPerFrame);
 		}
 
+		//	write in 2D tiles rather than rows, for textures too wide to write a row per frame. TileWidth 0 goes back to rows
+		public void SetTileChunking(int TileWidth, int TileHeight = 0, TileOrder Order = TileOrder.Morton)
+		{
+			PopWritePixels.SetTileChunking(CacheIndex.Value, TileWidth, TileHeight, Order);
+		}
+
+		public void SetWriteTilesPerFrame(int TilesPerFrame)
+		{
+			PopWritePixels.SetWriteTilesPerFrame(CacheIndex.Value, TilesPerFrame);
+		}
+
+		//	resize the rows written each frame to fit in this time and/or byte budget. zero disables
+		public void SetWriteBudget(int Microsecs, int Bytes = 0)
+		{
+			PopWritePixels.SetWriteBudget(CacheIndex.Value, Microsecs, Bytes);
+		}
+
+		public float GetWriteBytesPerMicrosecond()
+		{
+			return PopWritePixels.GetWriteBytesPerMicrosecond(CacheIndex.Value);
+		}
+
+		//	only used by the scheduler
+		public void SetPriority(int Priority)
+		{
+			PopWritePixels.SetCachePriority(CacheIndex.Value, Priority);
+		}
+
+		//	only used by the scheduler. negative clears
+		public void SetDeadline(int MicrosecsFromNow)
+		{
+			PopWritePixels.SetCacheDeadline(CacheIndex.Value, MicrosecsFromNow);
+		}
+
+		//	for video/camera feeds. Queue frames as they arrive and call QueueUpdate() every frame; the newest
+		//	complete frame is presented each time, older ones are dropped. RingSize textures are cycled so the one
+		//	being sampled isn't written; GetTexture() follows the front one. RingSize 0 turns it off, otherwise it must be 2 or more
+		public void SetStreamMode(int RingSize = 3, int QueueDepth = 2)
+		{
+			if (RingSize == 1)
+				throw new System.Exception("Stream ring needs at least 2 textures");
+			PopWritePixels.SetStreamMode(CacheIndex.Value, RingSize, QueueDepth);
+			Streaming = RingSize > 0;
+		}
+
+		//	share the texture of any other deduplicating job with the same pixels & format instead of uploading.
+		//	GetTexture() follows the shared texture, which changes when this job gets different pixels
+		public void SetContentDedupe(bool Enable)
+		{
+			PopWritePixels.SetContentDedupe(CacheIndex.Value, Enable);
+			Deduplicated = Enable;
+		}
+
+		//	say we're not showing the texture (eg. off screen), so the memory budget may free it. Once evicted,
+		//	queue the pixels again to bring it back; GetTexture() then follows the new texture
+		public void SetEvictable(bool Enable)
+		{
+			PopWritePixels.SetCacheEvictable(CacheIndex.Value, Enable);
+			Evictable = Enable;
+		}
+
+		public bool IsEvicted()
+		{
+			return IsCacheEvicted(CacheIndex.Value);
+		}
+
+		//	texture & staging. Shared (deduplicated) textures count in every job using them
+		public ulong GetMemoryBytes()
+		{
+			return GetCacheMemoryBytes(CacheIndex.Value);
+		}
+
+		//	Timestamp is capture time in GetPluginTimeMicrosecs() time, for latency. 0 = now.
+		//	the buffer is the plugin's from here, and returns to the pool once written or dropped
+		public void QueueStreamFrame(PixelBuffer Buffer, ulong TimestampMicrosecs = 0)
+		{
+			if (!QueueStreamFrameBuffer(CacheIndex.Value, Buffer.Submit(), TimestampMicrosecs))
+				throw new System.Exception("QueueStreamFrameBuffer returned error");
+			Submissions++;
+		}
+
+		//	copied, as a dropped frame's bytes would otherwise never be known to be free
+		public void QueueStreamFrame(byte[] Bytes, ulong TimestampMicrosecs = 0)
+		{
+			var Buffer = new PixelBuffer(Bytes.Length);
+			Buffer.Write(Bytes);
+			QueueStreamFrame(Buffer, TimestampMicrosecs);
+		}
+
+		//	Bytes must stay alive until a later frame has been presented
+		public void QueueStreamFrame(System.IntPtr Bytes, int Bytes_Length, ulong TimestampMicrosecs = 0)
+		{
+			if (!PopWritePixels.QueueStreamFrame(CacheIndex.Value, Bytes, Bytes_Length, TimestampMicrosecs))
+				throw new System.Exception("QueueStreamFrame returned error");
+			Submissions++;
+		}
+
+		public StreamStats GetStreamStats()
+		{
+			var Stats = new StreamStats();
+			if (!PopWritePixels.GetStreamStats(CacheIndex.Value, ref Stats))
+				throw new System.Exception("GetStreamStats returned error");
+			return Stats;
+		}
+
 		//	queue a write update
 		public void QueueUpdate(Camera AfterCamera = null)
 		{
+			//	scheduler or batch writes us
+			if (UseScheduler || UseCompletionQueue || Batched)
+				return;
+
 			//	queue a write
 			if (AfterCamera != null)
 			{
@@ -123,45 +837,202 @@ public static class PopWritePixels
 			}
 		}
 
+		void OnQueued(Camera AfterCamera)
+		{
+			Submissions++;
+			QueueUpdate(AfterCamera);
+		}
+
+		//	a batch queued a write to us
+		internal void OnBatchQueued()
+		{
+			Submissions++;
+		}
+
+		internal void OnCompletion(Completion Completion)
+		{
+			//	an older submission may finish after a newer one was queued
+			if (Completion.Submission < CompletedSubmission)
+				return;
+			if (Completion.Status == CompletionStatus.Failed)
+				FailedSubmission = Completion.Submission;
+			else
+				CompletedSubmission = Completion.Submission;
+			LastCompletion = Completion;
+		}
+
+		internal void PollCompletion()
+		{
+			if (!CacheIndex.HasValue)
+				return;
+			if (GetRowsWritten(CacheIndex.Value) >= RowCount)
+				CompletedSubmission = Submissions;
+		}
+
+		//	timings of the last write to finish, when using the completion queue
+		public Completion? GetLastCompletion()
+		{
+			return LastCompletion;
+		}
+
 		public void QueueWrite(System.IntPtr Bytes, int Bytes_Length, bool Copy = false, Camera AfterCamera = null)
 		{
-			//	todo: make copy of bytes here, but it'll be slow
-			//			we can pin/get GC handle for byte[] but intptr won't work that way
+			//	todo: copy into a PixelBuffer without unsafe code
 			if (Copy)
-				throw new System.Exception("Currently not copying, assuming caller won't delete bytes over the next frame");
+				throw new System.Exception("Currently not copying IntPtrs, use a PixelBuffer");
 
 			if (!QueueWritePixels(CacheIndex.Value, Bytes, Bytes_Length))
 				throw new System.Exception("SetCacheBytes returned error");
 
-			QueueUpdate(AfterCamera);
+			OnQueued(AfterCamera);
 		}
 
 		public void QueueWrite(byte[] Bytes, bool Copy = false, Camera AfterCamera = null)
 		{
-			//	todo: make copy of bytes here, but it'll be slow
-			//			we can pin/get GC handle for byte[] but intptr won't work that way
+			//	copy into pooled memory so the caller can let go of the array
 			if (Copy)
-				throw new System.Exception("Currently not copying, assuming caller won't delete bytes over the next frame");
+			{
+				var Buffer = new PixelBuffer(Bytes.Length);
+				Buffer.Write(Bytes);
+				QueueWrite(Buffer, AfterCamera);
+				return;
+			}
 
 			if (!QueueWritePixels(CacheIndex.Value, Bytes, Bytes.Length))
 				throw new System.Exception("SetCacheBytes returned error");
 
-			//	queue a write
-			if (AfterCamera != null)
-			{
-				if (IssueEventCallback == null)
-				{
-					IssueEventCallback = (c) => {
-						if (c == AfterCamera)
-							GL.IssuePluginEvent(PluginFunction, CacheIndex.Value);
-					};
-					Camera.onPostRender += IssueEventCallback;
-				}
-			}
-			else
-			{
-				GL.IssuePluginEvent(PluginFunction, CacheIndex.Value);
-			}
+			OnQueued(AfterCamera);
+		}
+
+		//	bytes are converted to the texture's format on plugin threads (eg. RGB24 camera frames into an RGBA32 texture)
+		//	Bytes must stay alive until the job has finished
+		public void QueueWrite(byte[] Bytes, PixelConversion Conversion, Camera AfterCamera = null)
+		{
+			if (!QueueWritePixelsConvert(CacheIndex.Value, Bytes, Bytes.Length, Conversion))
+				throw new System.Exception("QueueWritePixelsConvert returned error");
+
+			OnQueued(AfterCamera);
+		}
+
+		public void QueueWrite(System.IntPtr Bytes, int Bytes_Length, PixelConversion Conversion, Camera AfterCamera = null)
+		{
+			if (!QueueWritePixelsConvert(CacheIndex.Value, Bytes, Bytes_Length, Conversion))
+				throw new System.Exception("QueueWritePixelsConvert returned error");
+
+			OnQueued(AfterCamera);
+		}
+
+		//	RGBA32 bytes are compressed into the texture's block format on plugin threads, uploading as block rows finish
+		//	Bytes must stay alive until the job has finished
+		public void QueueWrite(byte[] Bytes, CompressQuality Quality, Camera AfterCamera = null)
+		{
+			if (!QueueWritePixelsCompress(CacheIndex.Value, Bytes, Bytes.Length, Quality))
+				throw new System.Exception("QueueWritePixelsCompress returned error");
+
+			OnQueued(AfterCamera);
+		}
+
+		public void QueueWrite(System.IntPtr Bytes, int Bytes_Length, CompressQuality Quality, Camera AfterCamera = null)
+		{
+			if (!QueueWritePixelsCompress(CacheIndex.Value, Bytes, Bytes_Length, Quality))
+				throw new System.Exception("QueueWritePixelsCompress returned error");
+
+			OnQueued(AfterCamera);
+		}
+
+		//	write straight from raw pixels (or blocks) in a file, from Offset. Size 0 = to the end of the file.
+		//	the plugin maps the file, so nothing is loaded into managed memory
+		public void QueueWriteFile(string Filename, ulong Offset = 0, ulong Size = 0, Camera AfterCamera = null)
+		{
+			if (!QueueWritePixelsFile(CacheIndex.Value, Filename, Offset, Size))
+				throw new System.Exception("QueueWritePixelsFile returned error");
+
+			OnQueued(AfterCamera);
+		}
+
+		//	png bytes (same size as the texture) are decoded on a plugin thread and uploaded as rows decode,
+		//	so GetProgress() covers decoding too. The bytes are copied
+		public void QueueWriteDecode(byte[] PngBytes, Camera AfterCamera = null)
+		{
+			if (!QueueWritePixelsDecode(CacheIndex.Value, PngBytes, PngBytes.Length))
+				throw new System.Exception("QueueWritePixelsDecode returned error");
+
+			OnQueued(AfterCamera);
+		}
+
+		public void QueueWriteDecodeFile(string Filename, Camera AfterCamera = null)
+		{
+			if (!QueueWritePixelsDecodeFile(CacheIndex.Value, Filename))
+				throw new System.Exception("QueueWritePixelsDecodeFile returned error");
+
+			OnQueued(AfterCamera);
+		}
+
+		//	a container from PopWritePixelsBaker (must match this cache's size, format & block format).
+		//	Mips and compression were done offline, so the file's rows go straight to the texture
+		public void QueueWriteBaked(string Filename, Camera AfterCamera = null)
+		{
+			if (!QueueWritePixelsBaked(CacheIndex.Value, Filename))
+				throw new System.Exception("QueueWritePixelsBaked returned error");
+
+			OnQueued(AfterCamera);
+		}
+
+		//	write just part of the texture, Bytes are only the region's pixels
+		public void QueueWriteRegion(byte[] Bytes, int x, int y, int Width, int Height, Camera AfterCamera = null)
+		{
+			if (!QueueWritePixelsRegion(CacheIndex.Value, Bytes, Bytes.Length, x, y, Width, Height))
+				throw new System.Exception("QueueWritePixelsRegion returned error");
+
+			OnQueued(AfterCamera);
+		}
+
+		//	only write rows (or tiles of TileWidth) that changed since the last full write
+		public void SetChangeDetection(bool Enable, int TileWidth = 0)
+		{
+			PopWritePixels.SetChangeDetection(CacheIndex.Value, Enable, TileWidth);
+		}
+
+		internal int GetHandle()
+		{
+			return CacheIndex.Value;
+		}
+
+		public ulong GetBytesSkipped()
+		{
+			return PopWritePixels.GetBytesSkipped(CacheIndex.Value);
+		}
+
+		public CacheStats GetStats()
+		{
+			var Stats = new CacheStats();
+			if (!PopWritePixels.GetCacheStats(CacheIndex.Value, ref Stats))
+				throw new System.Exception("GetCacheStats returned error");
+			return Stats;
+		}
+
+		public void SetMipMode(MipMode Mode)
+		{
+			PopWritePixels.SetMipMode(CacheIndex.Value, (int)Mode);
+		}
+
+		//	finest mip that's completely written; the texture can be shown once this isn't -1.
+		//	with MipMode.Progressive that's a frame or two, well before HasFinished()
+		public int GetResidentMip()
+		{
+			var Mip = PopWritePixels.GetResidentMip(CacheIndex.Value);
+			if (Mip < -1)
+				throw new System.Exception("GetResidentMip returned error");
+			return Mip;
+		}
+
+		//	Buffer is handed to the plugin and can't be used afterwards
+		public void QueueWrite(PixelBuffer Buffer, Camera AfterCamera = null)
+		{
+			if (!QueueWritePixelBuffer(CacheIndex.Value, Buffer.Submit()))
+				throw new System.Exception("QueueWritePixelBuffer returned error");
+
+			OnQueued(AfterCamera);
 		}
 
 		public float GetProgress()
@@ -174,8 +1045,29 @@ public static class PopWritePixels
 			return RowsWritten / (float)RowCount;
 		}
 
+		//	finer grained than GetProgress when writing whole textures in tiles
+		public float GetTileProgress()
+		{
+			var TilesWritten = GetTilesWritten(CacheIndex.Value);
+			var TileCount = GetTileCount(CacheIndex.Value);
+
+			if (TilesWritten < 0 || TileCount < 0)
+				throw new System.Exception("Error with GetTilesWritten(): " + TilesWritten);
+
+			if (TileCount == 0)
+				return GetProgress();
+			return TilesWritten / (float)TileCount;
+		}
+
 		public bool HasFinished()
 		{
+			if (UseCompletionQueue && !Streaming)
+			{
+				if (Submissions > 0 && FailedSubmission == Submissions)
+					throw new System.Exception("Write failed");
+				return Submissions > 0 && CompletedSubmission >= Submissions;
+			}
+
 			var RowsWritten = GetRowsWritten(CacheIndex.Value);
 
 			if (RowsWritten < 0)
@@ -193,16 +1085,30 @@ public static class PopWritePixels
 		public Texture GetTexture(bool LinearFilter)
 		{
 			//	already created
-			if (NewTexture)
+			if (NewTexture && !Streaming && !Deduplicated && !Evictable)
 				return NewTexture;
 
+			//	the plugin's pointer would be host memory, which crashes unity
+			if (NewBackend == TextureBackend.Software)
+				throw new System.Exception("Software backend caches have no texture unity can use");
+
 			var TexturePtr = GetCacheTexture(CacheIndex.Value);
 			//	catch this, as it crashes unity if we create textures with it
 			if (TexturePtr == IntPtr.Zero)
 				throw new System.Exception("Cache texture is null");
 
+			//	follow the stream's front texture, whichever texture has our content, or the one made after eviction
+			if (NewTexture)
+			{
+				if (TexturePtr != NewTexturePtr)
+					NewTexture.UpdateExternalTexture(TexturePtr);
+				NewTexturePtr = TexturePtr;
+				return NewTexture;
+			}
+
 			//	create new texture
 			NewTexture = Texture2D.CreateExternalTexture(NewWidth.Value, NewHeight.Value, NewFormat.Value, NewTextureMips.Value, LinearFilter, TexturePtr);
+			NewTexturePtr = TexturePtr;
 			return NewTexture;
 		}
 
@@ -228,6 +1134,7 @@ public static class PopWritePixels
 
 			if (CacheIndex.HasValue)
 			{
+				CompletionJobs.Remove(CacheIndex.Value);
 				//	if we release here with a texture still using the plugin's texture, we may crash!
 				ReleaseCache(CacheIndex.Value);
 				CacheIndex = null;
@@ -235,6 +1142,302 @@ public static class PopWritePixels
 		}
 	}
 
+	//	many small images packed into a few big textures. Images added in a frame are written
+	//	to their page together, by IssueWrite() or IssueWriteAllPendingCaches()
+	public class Atlas
+	{
+		int? AtlasIndex = null;
+		int PageWidth;
+		int PageHeight;
+		TextureFormat Format;
+		List<Texture2D> PageTextures = new List<Texture2D>();
+		static IntPtr? WriteAtlasesFunction = null;
+
+		public struct Image
+		{
+			public int Handle;
+			public int Page;
+			public Rect Uv;		//	in texture row order
+		};
+
+		public Atlas(int PageWidth, int PageHeight, TextureFormat Format, int MaxPages = 8, int Padding = 1, TextureBackend Backend = TextureBackend.Default)
+		{
+			AtlasIndex = AllocAtlas(PageWidth, PageHeight, Format, MaxPages, Padding, Backend);
+			if (AtlasIndex == -1)
+				throw new System.Exception("Failed to allocate atlas");
+
+			this.PageWidth = PageWidth;
+			this.PageHeight = PageHeight;
+			this.Format = Format;
+		}
+
+		~Atlas()
+		{
+			Release();
+		}
+
+		public Image Add(byte[] Bytes, int Width, int Height)
+		{
+			var Page = -1;
+			var UvRect = new float[4];
+			var Handle = AtlasAddImage(AtlasIndex.Value, Bytes, Bytes.Length, Width, Height, ref Page, UvRect);
+			if (Handle == -1)
+				throw new System.Exception("AtlasAddImage returned error");
+
+			var NewImage = new Image();
+			NewImage.Handle = Handle;
+			NewImage.Page = Page;
+			NewImage.Uv = new Rect(UvRect[0], UvRect[1], UvRect[2], UvRect[3]);
+			return NewImage;
+		}
+
+		public void Free(Image OldImage)
+		{
+			AtlasFreeImage(AtlasIndex.Value, OldImage.Handle);
+		}
+
+		//	not needed if using the scheduler
+		public void IssueWrite()
+		{
+			if (!WriteAtlasesFunction.HasValue)
+				WriteAtlasesFunction = GetWriteAtlasesFunc();
+			GL.IssuePluginEvent(WriteAtlasesFunction.Value, 0);
+		}
+
+		//	null until the page has been written once
+		public Texture GetPageTexture(int Page, bool LinearFilter)
+		{
+			while (PageTextures.Count <= Page)
+				PageTextures.Add(null);
+			if (PageTextures[Page])
+				return PageTextures[Page];
+
+			var TexturePtr = GetAtlasPageTexture(AtlasIndex.Value, Page);
+			if (TexturePtr == IntPtr.Zero)
+				return null;
+
+			PageTextures[Page] = Texture2D.CreateExternalTexture(PageWidth, PageHeight, Format, false, LinearFilter, TexturePtr);
+			return PageTextures[Page];
+		}
+
+		public int GetPageCount()
+		{
+			return GetAtlasPageCount(AtlasIndex.Value);
+		}
+
+		public AtlasStats GetStats()
+		{
+			var Stats = new AtlasStats();
+			if (!GetAtlasStats(AtlasIndex.Value, ref Stats))
+				throw new System.Exception("GetAtlasStats returned error");
+			return Stats;
+		}
+
+		public void Release()
+		{
+			foreach (var PageTexture in PageTextures)
+				if (PageTexture)
+					Texture2D.Destroy(PageTexture);
+			PageTextures.Clear();
+
+			if (AtlasIndex.HasValue)
+			{
+				ReleaseAtlas(AtlasIndex.Value);
+				AtlasIndex = null;
+			}
+		}
+	}
+
+	//	collects writes to many jobs, then queues them all in one call. Jobs added to a batch are then
+	//	written by one IssueWrite() a frame (or the scheduler) rather than issuing their own events
+	public class WriteBatch
+	{
+		List<BatchWrite> Writes = new List<BatchWrite>();
+		List<JobCache> Jobs = new List<JobCache>();
+		static IntPtr? WriteBatchFunction = null;
+
+		public int Count { get { return Writes.Count; } }
+
+		//	Bytes must stay alive until the job has finished
+		public void Add(JobCache Job, IntPtr Bytes, int Bytes_Length, int Priority = 0)
+		{
+			AddRegion(Job, Bytes, Bytes_Length, 0, 0, 0, 0, Priority);
+		}
+
+		public void AddRegion(JobCache Job, IntPtr Bytes, int Bytes_Length, int x, int y, int Width, int Height, int Priority = 0)
+		{
+			var Write = new BatchWrite();
+			Write.Bytes = Bytes;
+			Write.BytesSize = Bytes_Length;
+			Write.Buffer = -1;
+			Write.Cache = Job.GetHandle();
+			Write.Priority = Priority;
+			Write.x = x;
+			Write.y = y;
+			Write.Width = Width;
+			Write.Height = Height;
+			Writes.Add(Write);
+			Jobs.Add(Job);
+			Job.Batched = true;
+		}
+
+		//	the buffer is handed to the plugin now, whether or not Submit() succeeds
+		public void Add(JobCache Job, PixelBuffer Buffer, int Priority = 0)
+		{
+			var Write = new BatchWrite();
+			Write.Bytes = IntPtr.Zero;
+			Write.Buffer = Buffer.Submit();
+			Write.Cache = Job.GetHandle();
+			Write.Priority = Priority;
+			Writes.Add(Write);
+			Jobs.Add(Job);
+			Job.Batched = true;
+		}
+
+		//	copied, so the array can be let go of
+		public void Add(JobCache Job, byte[] Bytes, int Priority = 0)
+		{
+			var Buffer = new PixelBuffer(Bytes.Length);
+			Buffer.Write(Bytes);
+			Add(Job, Buffer, Priority);
+		}
+
+		//	queue everything added, then start again
+		public void Submit()
+		{
+			if (Writes.Count == 0)
+				return;
+
+			var WriteArray = Writes.ToArray();
+			var WriteJobs = Jobs.ToArray();
+			Writes.Clear();
+			Jobs.Clear();
+			if (!QueueWritePixelsBatch(WriteArray, WriteArray.Length))
+				throw new System.Exception("QueueWritePixelsBatch returned error");
+			foreach (var Job in WriteJobs)
+				Job.OnBatchQueued();
+		}
+
+		//	once a frame while any batched job is unfinished. not needed if using the scheduler
+		public static void IssueWrite()
+		{
+			if (UseScheduler)
+				return;
+			if (!WriteBatchFunction.HasValue)
+				WriteBatchFunction = GetWriteBatchFunc();
+			GL.IssuePluginEvent(WriteBatchFunction.Value, 0);
+		}
+	}
+
+	//	copies a texture back to the cpu a few rows a frame through fenced staging, so unlike ReadPixels
+	//	nothing waits for the gpu. Call Update() once a frame until HasFinished()
+	public class ReadbackJob
+	{
+		int? ReadbackIndex = null;
+		int RowCount;
+		byte[] Bytes = null;
+		GCHandle BytesHandle;
+		static IntPtr? ReadPixelsFunction = null;
+
+		public ReadbackJob(Texture2D texture, TextureBackend Backend = TextureBackend.Default)
+		{
+			ReadbackIndex = AllocReadback(texture.GetNativeTexturePtr(), texture.width, texture.height, texture.format, Backend);
+			if (ReadbackIndex == -1)
+				throw new System.Exception("Failed to allocate readback");
+			RowCount = texture.height;
+		}
+
+		//	reads whatever texture the job has written, including headless (software backend) ones
+		public ReadbackJob(JobCache Job, int Height)
+		{
+			ReadbackIndex = AllocCacheReadback(Job.GetHandle());
+			if (ReadbackIndex == -1)
+				throw new System.Exception("Failed to allocate readback");
+			RowCount = Height;
+		}
+
+		~ReadbackJob()
+		{
+			Release();
+		}
+
+		//	also the size of each staging slot
+		public void SetReadRowsPerFrame(int RowsPerFrame)
+		{
+			PopWritePixels.SetReadRowsPerFrame(ReadbackIndex.Value, RowsPerFrame);
+		}
+
+		//	rows land in Pixels (pinned until the next queue or release) from the top down.
+		//	null reads into a plugin buffer instead, see GetPixels()
+		public void Queue(byte[] Pixels = null)
+		{
+			Unpin();
+			var Pointer = IntPtr.Zero;
+			if (Pixels != null)
+			{
+				Bytes = Pixels;
+				BytesHandle = GCHandle.Alloc(Bytes, GCHandleType.Pinned);
+				Pointer = BytesHandle.AddrOfPinnedObject();
+			}
+			if (!QueueReadPixels(ReadbackIndex.Value, Pointer, Pixels != null ? Pixels.Length : 0))
+				throw new System.Exception("QueueReadPixels returned error");
+		}
+
+		//	once a frame while unfinished
+		public void Update()
+		{
+			if (!ReadPixelsFunction.HasValue)
+				ReadPixelsFunction = GetReadPixelsFunc();
+			GL.IssuePluginEvent(ReadPixelsFunction.Value, ReadbackIndex.Value);
+		}
+
+		public int GetRowsRead()
+		{
+			var Rows = PopWritePixels.GetRowsRead(ReadbackIndex.Value);
+			if (Rows < 0)
+				throw new System.Exception("GetRowsRead returned error");
+			return Rows;
+		}
+
+		public float GetProgress()
+		{
+			return GetRowsRead() / (float)RowCount;
+		}
+
+		public bool HasFinished()
+		{
+			return GetRowsRead() >= RowCount;
+		}
+
+		//	where the last queue is reading to. Rows above GetRowsRead() are final
+		public IntPtr GetPixels(out int Size)
+		{
+			Size = 0;
+			var Pointer = PopWritePixels.GetReadPixels(ReadbackIndex.Value, ref Size);
+			if (Pointer == IntPtr.Zero)
+				throw new System.Exception("GetReadPixels returned error");
+			return Pointer;
+		}
+
+		void Unpin()
+		{
+			if (BytesHandle.IsAllocated)
+				BytesHandle.Free();
+			Bytes = null;
+		}
+
+		public void Release()
+		{
+			//	plugin lets go of our bytes first
+			if (ReadbackIndex.HasValue)
+			{
+				ReleaseReadback(ReadbackIndex.Value);
+				ReadbackIndex = null;
+			}
+			Unpin();
+		}
+	}
+
 	public static JobCache WritePixelsAsync(Texture texture, byte[] Pixels, Camera AfterCamera = null)
 	{
 		/*